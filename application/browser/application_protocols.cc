@@ -10,16 +10,21 @@
 
 #include "base/files/file_path.h"
 #include "base/memory/weak_ptr.h"
+#include "base/synchronization/lock.h"
 #include "base/threading/thread_restrictions.h"
 #include "base/threading/worker_pool.h"
 #include "content/public/browser/resource_request_info.h"
 #include "googleurl/src/url_util.h"
+#include "net/base/io_buffer.h"
+#include "net/base/mime_util.h"
 #include "net/base/net_errors.h"
 #include "net/http/http_response_headers.h"
 #include "net/http/http_response_info.h"
 #include "net/url_request/url_request_error_job.h"
 #include "net/url_request/url_request_file_job.h"
 #include "net/url_request/url_request_simple_job.h"
+#include "xwalk/application/browser/installer/xpk_archive.h"
+#include "xwalk/application/browser/installer/xpk_package.h"
 #include "xwalk/application/common/application.h"
 #include "xwalk/application/common/application_file_util.h"
 #include "xwalk/application/common/application_manifest_constants.h"
@@ -28,12 +33,15 @@
 
 using content::ResourceRequestInfo;
 using xwalk::application::Application;
+using xwalk::application::XPKArchive;
+using xwalk::application::XPKEntryReader;
+using xwalk::application::XPKPackage;
 
 namespace {
 
 net::HttpResponseHeaders* BuildHttpHeaders(
     const std::string& mime_type, const std::string& method,
-    const base::FilePath& file_path, const base::FilePath& relative_path,
+    bool is_found, const base::FilePath& relative_path,
     bool is_authority_match) {
   std::string raw_headers;
   if (method == "GET") {
@@ -41,7 +49,7 @@ net::HttpResponseHeaders* BuildHttpHeaders(
       raw_headers.append("HTTP/1.1 400 Bad Request");
     else if (!is_authority_match)
       raw_headers.append("HTTP/1.1 403 Forbidden");
-    else if (file_path.empty())
+    else if (!is_found)
       raw_headers.append("HTTP/1.1 404 Not Found");
     else
       raw_headers.append("HTTP/1.1 200 OK");
@@ -87,8 +95,8 @@ class URLRequestApplicationJob : public net::URLRequestFileJob {
     std::string mime_type;
     GetMimeType(&mime_type);
     std::string method = request()->method();
-    response_info_.headers = BuildHttpHeaders(mime_type, method, file_path_,
-        relative_path_, is_authority_match_);
+    response_info_.headers = BuildHttpHeaders(mime_type, method,
+        !file_path_.empty(), relative_path_, is_authority_match_);
     *info = response_info_;
   }
 
@@ -124,12 +132,174 @@ class URLRequestApplicationJob : public net::URLRequestFileJob {
   base::WeakPtrFactory<URLRequestApplicationJob> weak_factory_;
 };
 
+// The package of an application installed without unpacking it. It is
+// opened by the first request for one of its resources, and then shared.
+class ApplicationPackage
+    : public base::RefCountedThreadSafe<ApplicationPackage> {
+ public:
+  explicit ApplicationPackage(const base::FilePath& path)
+    : path_(path),
+      is_opened_(false) {
+  }
+
+  // Returns NULL if the package is invalid. It does blocking IO the first
+  // time.
+  scoped_refptr<XPKArchive> GetArchive() {
+    base::AutoLock lock(lock_);
+    if (!is_opened_) {
+      archive_ = XPKArchive::Open(path_);
+      is_opened_ = true;
+    }
+    return archive_;
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<ApplicationPackage>;
+  ~ApplicationPackage() {}
+
+  base::FilePath path_;
+  base::Lock lock_;
+  bool is_opened_;
+  scoped_refptr<XPKArchive> archive_;
+
+  DISALLOW_COPY_AND_ASSIGN(ApplicationPackage);
+};
+
+void OpenPackageEntry(scoped_refptr<ApplicationPackage> package,
+                      const base::FilePath& relative_path,
+                      scoped_ptr<XPKEntryReader>* reader) {
+  scoped_refptr<XPKArchive> archive = package->GetArchive();
+  XPKArchive::Entry entry;
+  if (!archive || !archive->FindEntry(relative_path, &entry))
+    return;
+
+  reader->reset(new XPKEntryReader(archive.get(), entry));
+  if (!(*reader)->Init())
+    reader->reset();
+}
+
+void ReadPackageEntry(XPKEntryReader* reader,
+                      scoped_refptr<net::IOBuffer> buf,
+                      int buf_size,
+                      int* result) {
+  *result = reader->Read(buf->data(), buf_size);
+}
+
+// Serves a resource from the package of the application. Its entry is
+// found and its data read from the mapped package on the worker pool.
+class URLRequestApplicationPackageJob : public net::URLRequestJob {
+ public:
+  URLRequestApplicationPackageJob(net::URLRequest* request,
+                                  net::NetworkDelegate* network_delegate,
+                                  ApplicationPackage* package,
+                                  const base::FilePath& relative_path)
+    : net::URLRequestJob(request, network_delegate),
+      package_(package),
+      relative_path_(relative_path),
+      weak_factory_(this) {
+  }
+
+  virtual void Start() OVERRIDE {
+    scoped_ptr<XPKEntryReader>* reader = new scoped_ptr<XPKEntryReader>;
+
+    bool posted = base::WorkerPool::PostTaskAndReply(
+        FROM_HERE,
+        base::Bind(&OpenPackageEntry, package_, relative_path_,
+                   base::Unretained(reader)),
+        base::Bind(&URLRequestApplicationPackageJob::OnEntryOpened,
+                   weak_factory_.GetWeakPtr(),
+                   base::Owned(reader)),
+        true /* task is slow */);
+    DCHECK(posted);
+  }
+
+  virtual bool GetMimeType(std::string* mime_type) const OVERRIDE {
+    return net::GetMimeTypeFromFile(relative_path_, mime_type);
+  }
+
+  virtual void GetResponseInfo(net::HttpResponseInfo* info) OVERRIDE {
+    std::string mime_type;
+    GetMimeType(&mime_type);
+    std::string method = request()->method();
+    response_info_.headers = BuildHttpHeaders(mime_type, method,
+        reader_.get() != NULL, relative_path_, true);
+    *info = response_info_;
+  }
+
+  virtual void Kill() OVERRIDE {
+    weak_factory_.InvalidateWeakPtrs();
+    net::URLRequestJob::Kill();
+  }
+
+  virtual bool ReadRawData(net::IOBuffer* buf, int buf_size,
+                           int* bytes_read) OVERRIDE {
+    if (!reader_) {
+      *bytes_read = 0;
+      return true;
+    }
+
+    // Reading the data faults the mapping in and may inflate it, which is
+    // done on the worker pool. The reader is handed over to the reply until
+    // the read is done, so it outlives the job if that is killed meanwhile.
+    scoped_ptr<XPKEntryReader>* reader =
+        new scoped_ptr<XPKEntryReader>(reader_.release());
+    int* result = new int(0);
+
+    bool posted = base::WorkerPool::PostTaskAndReply(
+        FROM_HERE,
+        base::Bind(&ReadPackageEntry, base::Unretained(reader->get()),
+                   make_scoped_refptr(buf), buf_size,
+                   base::Unretained(result)),
+        base::Bind(&URLRequestApplicationPackageJob::OnEntryRead,
+                   weak_factory_.GetWeakPtr(),
+                   base::Owned(reader), base::Owned(result)),
+        false /* task is slow */);
+    DCHECK(posted);
+
+    SetStatus(net::URLRequestStatus(net::URLRequestStatus::IO_PENDING, 0));
+    return false;
+  }
+
+ private:
+  virtual ~URLRequestApplicationPackageJob() {}
+
+  void OnEntryOpened(scoped_ptr<XPKEntryReader>* reader) {
+    reader_.reset(reader->release());
+    if (reader_)
+      set_expected_content_size(reader_->size());
+    NotifyHeadersComplete();
+  }
+
+  void OnEntryRead(scoped_ptr<XPKEntryReader>* reader, int* result) {
+    reader_.reset(reader->release());
+    if (*result < 0) {
+      NotifyDone(net::URLRequestStatus(net::URLRequestStatus::FAILED,
+                                       net::ERR_FAILED));
+    } else {
+      SetStatus(net::URLRequestStatus());
+      if (!*result)
+        NotifyDone(net::URLRequestStatus());
+    }
+    NotifyReadComplete(*result);
+  }
+
+  net::HttpResponseInfo response_info_;
+  scoped_refptr<ApplicationPackage> package_;
+  base::FilePath relative_path_;
+  scoped_ptr<XPKEntryReader> reader_;
+  base::WeakPtrFactory<URLRequestApplicationPackageJob> weak_factory_;
+};
+
 class ApplicationProtocolHandler
     : public net::URLRequestJobFactory::ProtocolHandler {
  public:
   explicit ApplicationProtocolHandler(const Application* application)
     : application_(application) {
     CHECK(application_);
+    // Applications installed with their package have it as their path.
+    if (application_->Path().MatchesExtension(
+            XPKPackage::kXPKPackageExtension))
+      package_ = new ApplicationPackage(application_->Path());
   }
 
   virtual ~ApplicationProtocolHandler() {}
@@ -140,6 +310,7 @@ class ApplicationProtocolHandler
 
  private:
   const Application* application_;
+  scoped_refptr<ApplicationPackage> package_;
   DISALLOW_COPY_AND_ASSIGN(ApplicationProtocolHandler);
 };
 
@@ -151,6 +322,13 @@ ApplicationProtocolHandler::MaybeCreateJob(
   bool is_authority_match = application_id == application_->ID();
   base::FilePath relative_path =
       xwalk::application::ApplicationURLToRelativeFilePath(request->url());
+  if (package_ && is_authority_match && !relative_path.empty()) {
+    return new URLRequestApplicationPackageJob(request,
+                                               network_delegate,
+                                               package_.get(),
+                                               relative_path);
+  }
+
   base::FilePath directory_path;
   if (is_authority_match)
     directory_path = application_->Path();
@@ -6,21 +6,85 @@
 
 #include <string>
 
+#include "base/command_line.h"
 #include "base/file_util.h"
+#include "base/json/json_string_value_serializer.h"
+#include "base/sys_info.h"
 #include "xwalk/application/browser/application_process_manager.h"
 #include "xwalk/application/browser/application_system.h"
+#include "xwalk/application/browser/installer/xpk_archive.h"
 #include "xwalk/application/browser/installer/xpk_extractor.h"
 #include "xwalk/application/common/application_file_util.h"
+#include "xwalk/application/common/application_manifest_constants.h"
+#include "xwalk/application/common/constants.h"
 #include "xwalk/runtime/browser/runtime_context.h"
+#include "xwalk/runtime/common/xwalk_switches.h"
 
 using xwalk::RuntimeContext;
 
+namespace errors = xwalk::application_manifest_errors;
+
 namespace xwalk {
 namespace application {
 
 const base::FilePath::CharType kApplicationsDir[] =
     FILE_PATH_LITERAL("applications");
 
+namespace {
+
+// Loads the application from the manifest found in its package, which is
+// kept at |installed_path| instead of being unpacked.
+scoped_refptr<Application> LoadPackagedApplication(
+    const base::FilePath& package_path,
+    const base::FilePath& installed_path,
+    const std::string& app_id,
+    std::string* error) {
+  scoped_refptr<XPKArchive> archive = XPKArchive::Open(package_path);
+  XPKArchive::Entry entry;
+  if (!archive ||
+      !archive->FindEntry(base::FilePath(kManifestFilename), &entry)) {
+    *error = errors::kManifestUnreadable;
+    return NULL;
+  }
+
+  XPKEntryReader reader(archive.get(), entry);
+  if (!reader.Init()) {
+    *error = errors::kManifestUnreadable;
+    return NULL;
+  }
+  std::string manifest_data;
+  char buffer[4096];
+  int result;
+  while ((result = reader.Read(buffer, sizeof(buffer))) > 0)
+    manifest_data.append(buffer, result);
+  if (result < 0) {
+    *error = errors::kManifestUnreadable;
+    return NULL;
+  }
+
+  JSONStringValueSerializer serializer(manifest_data);
+  scoped_ptr<base::Value> root(serializer.Deserialize(NULL, error));
+  if (!root) {
+    if (error->empty())
+      *error = errors::kManifestUnreadable;
+    else
+      *error = std::string(errors::kManifestParseError) + "  " + *error;
+    return NULL;
+  }
+  if (!root->IsType(base::Value::TYPE_DICTIONARY)) {
+    *error = errors::kManifestUnreadable;
+    return NULL;
+  }
+
+  return Application::Create(installed_path,
+                             Manifest::COMMAND_LINE,
+                             *static_cast<base::DictionaryValue*>(root.get()),
+                             app_id,
+                             error);
+}
+
+}  // namespace
+
 ApplicationService::ApplicationService(RuntimeContext* runtime_context)
     : runtime_context_(runtime_context),
       app_store_(new ApplicationStore(runtime_context)) {
@@ -44,6 +108,7 @@ bool ApplicationService::Install(const base::FilePath& path, std::string* id) {
     return false;
 
   base::FilePath unpacked_dir;
+  base::FilePath package_path;
   std::string app_id;
   if (!file_util::DirectoryExists(path)) {
     scoped_refptr<XPKExtractor> extractor = XPKExtractor::Create(path);
@@ -61,24 +126,48 @@ bool ApplicationService::Install(const base::FilePath& path, std::string* id) {
       return true;
     }
 
-    base::FilePath temp_dir;
-    extractor->Extract(&temp_dir);
-    unpacked_dir = data_dir.AppendASCII(app_id);
-    if (file_util::DirectoryExists(unpacked_dir) &&
-        !file_util::Delete(unpacked_dir, true))
-      return false;
-    if (!file_util::Move(temp_dir, unpacked_dir))
-      return false;
+    if (CommandLine::ForCurrentProcess()->HasSwitch(
+            switches::kXWalkKeepApplicationPackage)) {
+      if (!extractor->Verify())
+        return false;
+      package_path = data_dir.AppendASCII(app_id).AddExtension(
+          XPKPackage::kXPKPackageExtension);
+    } else {
+      unpacked_dir = data_dir.AppendASCII(app_id);
+      XPKPackage::ExtractTimings timings;
+      if (!extractor->Extract(unpacked_dir,
+                              base::SysInfo::NumberOfProcessors(),
+                              &timings))
+        return false;
+      VLOG(1) << "Extracted " << app_id << " in "
+              << (timings.directory + timings.read + timings.drain +
+                  timings.commit).InMilliseconds() << "ms: "
+              << "directory " << timings.directory.InMilliseconds() << "ms, "
+              << "read " << timings.read.InMilliseconds() << "ms, "
+              << "drain " << timings.drain.InMilliseconds() << "ms, "
+              << "unpack " << timings.unpack.InMilliseconds() << "ms, "
+              << "commit " << timings.commit.InMilliseconds() << "ms.";
+    }
   } else {
     unpacked_dir = path;
   }
 
   std::string error;
-  scoped_refptr<Application> application =
-      LoadApplication(unpacked_dir,
-                      app_id,
-                      Manifest::COMMAND_LINE,
-                      &error);
+  scoped_refptr<Application> application;
+  if (!package_path.empty()) {
+    // Only the manifest is read from the verified package, which is then
+    // moved as is. The other resources are served from it.
+    application = LoadPackagedApplication(path, package_path, app_id, &error);
+    if (application && !file_util::Move(path, package_path)) {
+      LOG(ERROR) << "Can't move the package to " << package_path.value();
+      return false;
+    }
+  } else {
+    application = LoadApplication(unpacked_dir,
+                                  app_id,
+                                  Manifest::COMMAND_LINE,
+                                  &error);
+  }
   if (!application) {
     LOG(ERROR) << "Error during application installation: " << error;
     return false;
@@ -6,8 +6,12 @@
 
 #include <utility>
 
+#include "base/command_line.h"
 #include "xwalk/application/common/application_file_util.h"
+#include "xwalk/application/common/db_store_json_impl.h"
+#include "xwalk/application/common/db_store_log_impl.h"
 #include "xwalk/runtime/browser/runtime_context.h"
+#include "xwalk/runtime/common/xwalk_switches.h"
 
 namespace xwalk {
 namespace application {
@@ -18,10 +22,24 @@ const char ApplicationStore::kApplicationPath[] = "path";
 
 const char ApplicationStore::kInstallTime[] = "install_time";
 
+namespace {
+
+// Most launches only need one application, a few are kept for the others.
+const size_t kMaxCachedApplications = 4;
+
+DBStore* CreateDBStore(const base::FilePath& path) {
+  if (CommandLine::ForCurrentProcess()->HasSwitch(
+          switches::kXWalkApplicationDBLog))
+    return new DBStoreLogImpl(path);
+  return new DBStoreJsonImpl(path);
+}
+
+}  // namespace
+
 ApplicationStore::ApplicationStore(xwalk::RuntimeContext* runtime_context)
     : runtime_context_(runtime_context),
-      db_store_(new DBStoreImpl(runtime_context->GetPath())),
-      applications_(new ApplicationMap) {
+      db_store_(CreateDBStore(runtime_context->GetPath())),
+      cache_(kMaxCachedApplications) {
   db_store_->AddObserver(this);
   db_store_->InitDB();
 }
@@ -35,30 +53,36 @@ bool ApplicationStore::AddApplication(
   if (Contains(application->ID()))
     return true;
 
-  if (!db_store_->Insert(application.get(), base::Time::Now()) ||
-      !Insert(application))
+  if (!db_store_->Insert(application.get(), base::Time::Now()))
     return false;
 
+  index_[application->ID()] = application->Path();
+  cache_.Put(application->ID(), application);
   return true;
 }
 
 bool ApplicationStore::Contains(const std::string& app_id) const {
-  return applications_->find(app_id) != applications_->end();
+  return index_.find(app_id) != index_.end();
 }
 
 scoped_refptr<const Application> ApplicationStore::GetApplicationByID(
     const std::string& application_id) const {
-  ApplicationMapIterator it = applications_->find(application_id);
-  if (it != applications_->end()) {
+  ApplicationCache::iterator it = cache_.Get(application_id);
+  if (it != cache_.end())
     return it->second;
-  }
 
-  return NULL;
+  scoped_refptr<const Application> application =
+      CreateApplication(application_id);
+  if (application)
+    cache_.Put(application_id, application);
+  return application;
 }
 
 void ApplicationStore::InitApplications(const base::DictionaryValue* db) {
   CHECK(db);
 
+  // Only the entries are checked here, the manifests are parsed when the
+  // applications are created.
   for (base::DictionaryValue::Iterator it(*db); !it.IsAtEnd();
        it.Advance()) {
     const std::string& id = it.key();
@@ -67,33 +91,37 @@ void ApplicationStore::InitApplications(const base::DictionaryValue* db) {
     std::string app_path;
     if (!it.value().GetAsDictionary(&value) ||
         !value->GetString(ApplicationStore::kApplicationPath, &app_path) ||
-        !value->GetDictionary(ApplicationStore::kManifestPath, &manifest))
-      break;
-
-    std::string error;
-    scoped_refptr<Application> application =
-        Application::Create(base::FilePath::FromUTF8Unsafe(app_path),
-                            Manifest::INTERNAL,
-                            *manifest,
-                            id,
-                            &error);
-    if (!application) {
-      LOG(ERROR) << "Load appliation error: " << error;
-      break;
-    }
-
-    if (!Insert(application)) {
-      LOG(ERROR) << "An error occurred while"
+        !value->GetDictionary(ApplicationStore::kManifestPath, &manifest)) {
+      LOG(ERROR) << "An error occurred while "
                     "initializing the application data.";
       break;
     }
+
+    index_[id] = base::FilePath::FromUTF8Unsafe(app_path);
   }
 }
 
-bool ApplicationStore::Insert(scoped_refptr<const Application> application) {
-  return applications_->insert(
-      std::pair<std::string, scoped_refptr<const Application> >(
-          application->ID(), application)).second;
+scoped_refptr<const Application> ApplicationStore::CreateApplication(
+    const std::string& application_id) const {
+  ApplicationIndex::const_iterator it = index_.find(application_id);
+  const base::DictionaryValue* db = db_store_->GetApplications();
+  const base::DictionaryValue* value;
+  const base::DictionaryValue* manifest;
+  if (it == index_.end() || !db ||
+      !db->GetDictionaryWithoutPathExpansion(application_id, &value) ||
+      !value->GetDictionary(ApplicationStore::kManifestPath, &manifest))
+    return NULL;
+
+  std::string error;
+  scoped_refptr<Application> application =
+      Application::Create(it->second,
+                          Manifest::INTERNAL,
+                          *manifest,
+                          application_id,
+                          &error);
+  if (!application)
+    LOG(ERROR) << "Load appliation error: " << error;
+  return application;
 }
 
 void ApplicationStore::OnDBValueChanged(const std::string& key,
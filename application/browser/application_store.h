@@ -8,9 +8,10 @@
 #include <map>
 #include <string>
 
+#include "base/containers/mru_cache.h"
 #include "base/memory/ref_counted.h"
 #include "xwalk/application/common/application.h"
-#include "xwalk/application/common/db_store_json_impl.h"
+#include "xwalk/application/common/db_store.h"
 
 namespace xwalk {
 class Runtime;
@@ -20,14 +21,10 @@ class RuntimeContext;
 namespace xwalk {
 namespace application {
 
+// Applications are only created from their database entries when asked for,
+// and the most recently used ones are kept around.
 class ApplicationStore: public DBStore::Observer {
  public:
-  typedef DBStoreJsonImpl DBStoreImpl;
-  typedef std::map<std::string, scoped_refptr<const Application> >
-      ApplicationMap;
-  typedef std::map<std::string, scoped_refptr<const Application> >::iterator
-      ApplicationMapIterator;
-
   // The constaints for application storage.
   static const char kManifestPath[];
   static const char kApplicationPath[];
@@ -49,11 +46,19 @@ class ApplicationStore: public DBStore::Observer {
   virtual void OnInitializationCompleted(bool succeeded) OVERRIDE;
 
  private:
+  // Maps the IDs of the installed applications to their paths.
+  typedef std::map<std::string, base::FilePath> ApplicationIndex;
+  typedef base::MRUCache<std::string, scoped_refptr<const Application> >
+      ApplicationCache;
+
   void InitApplications(const base::DictionaryValue* value);
-  bool Insert(scoped_refptr<const Application> application);
+  scoped_refptr<const Application> CreateApplication(
+      const std::string& application_id) const;
+
   xwalk::RuntimeContext* runtime_context_;
-  scoped_ptr<DBStoreImpl> db_store_;
-  scoped_ptr<ApplicationMap> applications_;
+  scoped_ptr<DBStore> db_store_;
+  ApplicationIndex index_;
+  mutable ApplicationCache cache_;
   DISALLOW_COPY_AND_ASSIGN(ApplicationStore);
 };
 
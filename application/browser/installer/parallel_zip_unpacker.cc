@@ -0,0 +1,394 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/application/browser/installer/parallel_zip_unpacker.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/memory/scoped_handle.h"
+#include "base/threading/simple_thread.h"
+#include "third_party/zlib/zlib.h"
+
+namespace xwalk {
+namespace application {
+
+using zip_format::ReadUInt16;
+using zip_format::ReadUInt32;
+using zip_format::kCentralHeaderSignature;
+using zip_format::kCentralHeaderSize;
+using zip_format::kDeflatedMethod;
+using zip_format::kEncryptedFlag;
+using zip_format::kEndOfCentralDirectorySize;
+using zip_format::kLocalHeaderSignature;
+using zip_format::kLocalHeaderSize;
+using zip_format::kStoredMethod;
+using zip_format::kZip64Value;
+
+namespace {
+
+// The end of central directory record can be followed by a comment.
+const size_t kMaxCommentSize = 0xffff;
+const char kEndOfCentralDirectoryMarker[] = "PK\x05\x06";
+
+// Compressed data read but not unpacked yet is limited to this, an entry
+// larger than it is unpacked alone.
+const size_t kMaxQueuedSize = 16 * 1024 * 1024;
+
+const size_t kOutputBufferSize = 1 << 16;
+
+}  // namespace
+
+class ParallelZipUnpacker::EntryTask
+    : public base::DelegateSimpleThread::Delegate {
+ public:
+  EntryTask(ParallelZipUnpacker* unpacker,
+            const Entry& entry,
+            scoped_ptr<std::string> data)
+      : unpacker_(unpacker),
+        entry_(entry),
+        data_(data.Pass()) {
+  }
+
+  // Deletes itself once done.
+  virtual void Run() OVERRIDE {
+    base::TimeTicks start = base::TimeTicks::Now();
+    bool succeeded = unpacker_->UnpackEntry(entry_, *data_);
+    unpacker_->EntryUnpacked(
+        data_->size(), succeeded, base::TimeTicks::Now() - start);
+    delete this;
+  }
+
+ private:
+  ParallelZipUnpacker* unpacker_;
+  Entry entry_;
+  scoped_ptr<std::string> data_;
+};
+
+ParallelZipUnpacker::Entry::Entry()
+    : method(0),
+      crc(0),
+      compressed_size(0),
+      uncompressed_size(0),
+      header_offset(0) {
+}
+
+ParallelZipUnpacker::ParallelZipUnpacker(const base::FilePath& target_path,
+                                         int thread_count)
+    : target_path_(target_path),
+      thread_count_(std::max(thread_count, 1)),
+      current_(0),
+      state_(STATE_ERROR),
+      position_(0),
+      queue_changed_(&lock_),
+      queued_size_(0),
+      failed_(false) {
+}
+
+ParallelZipUnpacker::~ParallelZipUnpacker() {
+  // The workers use this object.
+  if (pool_)
+    pool_->JoinAll();
+}
+
+bool ParallelZipUnpacker::ReadCentralDirectory(FILE* file,
+                                               int64 offset,
+                                               int64 size) {
+  size_t tail_size = std::min<int64>(
+      size, kEndOfCentralDirectorySize + kMaxCommentSize);
+  if (tail_size < kEndOfCentralDirectorySize)
+    return false;
+  std::string tail(tail_size, '\0');
+  if (fseek(file, offset + size - tail_size, SEEK_SET) ||
+      fread(&tail[0], 1, tail_size, file) != tail_size)
+    return false;
+
+  size_t end = tail.rfind(kEndOfCentralDirectoryMarker,
+                          tail_size - kEndOfCentralDirectorySize);
+  if (end == std::string::npos) {
+    LOG(ERROR) << "The package content has no central directory.";
+    return false;
+  }
+
+  const char* record = tail.data() + end;
+  size_t count = ReadUInt16(record + 10);
+  uint32 directory_size = ReadUInt32(record + 12);
+  uint32 directory_offset = ReadUInt32(record + 16);
+  // The offsets are relative to the start of the archive, the directory
+  // should end where the record starts.
+  if (directory_offset == kZip64Value ||
+      directory_offset + static_cast<int64>(directory_size) !=
+          size - static_cast<int64>(tail_size - end)) {
+    LOG(ERROR) << "Invalid central directory in the package content.";
+    return false;
+  }
+
+  std::string directory(directory_size, '\0');
+  if (directory_size &&
+      (fseek(file, offset + directory_offset, SEEK_SET) ||
+       fread(&directory[0], 1, directory_size, file) != directory_size))
+    return false;
+
+  if (!ParseCentralDirectory(directory, count))
+    return false;
+
+  std::sort(entries_.begin(), entries_.end(), &ParallelZipUnpacker::IsBefore);
+  state_ = entries_.empty() ? STATE_DONE : STATE_SKIP;
+
+  pool_.reset(new base::DelegateSimpleThreadPool("XPKUnpacker",
+                                                 thread_count_));
+  pool_->Start();
+  return true;
+}
+
+// static
+bool ParallelZipUnpacker::IsBefore(const Entry& a, const Entry& b) {
+  return a.header_offset < b.header_offset;
+}
+
+bool ParallelZipUnpacker::ParseCentralDirectory(const std::string& directory,
+                                                size_t count) {
+  size_t position = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (directory.size() - position < kCentralHeaderSize)
+      return false;
+    const char* header = directory.data() + position;
+    if (ReadUInt32(header) != kCentralHeaderSignature)
+      return false;
+
+    Entry entry;
+    uint16 flags = ReadUInt16(header + 8);
+    entry.method = ReadUInt16(header + 10);
+    entry.crc = ReadUInt32(header + 16);
+    entry.compressed_size = ReadUInt32(header + 20);
+    entry.uncompressed_size = ReadUInt32(header + 24);
+    size_t name_size = ReadUInt16(header + 28);
+    // The name is followed by the extra field and the comment.
+    size_t variable_size =
+        name_size + ReadUInt16(header + 30) + ReadUInt16(header + 32);
+    entry.header_offset = ReadUInt32(header + 42);
+    if (directory.size() - position - kCentralHeaderSize < variable_size)
+      return false;
+    entry.name.assign(header + kCentralHeaderSize, name_size);
+    position += kCentralHeaderSize + variable_size;
+
+    if ((flags & kEncryptedFlag) ||
+        (entry.method != kStoredMethod && entry.method != kDeflatedMethod) ||
+        entry.compressed_size == kZip64Value ||
+        entry.uncompressed_size == kZip64Value ||
+        entry.header_offset == kZip64Value) {
+      LOG(ERROR) << "Unsupported entry in the package: " << entry.name;
+      return false;
+    }
+
+    base::FilePath relative_path = base::FilePath::FromUTF8Unsafe(entry.name);
+    if (entry.name.empty() || relative_path.IsAbsolute() ||
+        relative_path.ReferencesParent()) {
+      LOG(ERROR) << "Invalid entry name in the package: " << entry.name;
+      return false;
+    }
+    entries_.push_back(entry);
+  }
+  return true;
+}
+
+bool ParallelZipUnpacker::Write(const char* data, size_t size) {
+  while (size > 0) {
+    switch (state_) {
+      case STATE_SKIP: {
+        // Data descriptors, and anything else between the entries.
+        const Entry& entry = entries_[current_];
+        if (position_ > entry.header_offset) {
+          LOG(ERROR) << "Overlapping entries in the package content.";
+          state_ = STATE_ERROR;
+          break;
+        }
+        Consume(&data, &size,
+                std::min<int64>(size, entry.header_offset - position_));
+        if (position_ == entry.header_offset)
+          state_ = STATE_LOCAL_HEADER;
+        break;
+      }
+      case STATE_LOCAL_HEADER:
+        if (!Gather(&data, &size, kLocalHeaderSize))
+          return true;
+        if (ReadUInt32(pending_.data()) != kLocalHeaderSignature) {
+          LOG(ERROR) << "Unexpected data in the package content.";
+          state_ = STATE_ERROR;
+          break;
+        }
+        state_ = STATE_LOCAL_NAME;
+        break;
+      case STATE_LOCAL_NAME: {
+        // The local name and extra field are skipped, the data follows.
+        size_t header_size = kLocalHeaderSize +
+            ReadUInt16(pending_.data() + 26) + ReadUInt16(pending_.data() + 28);
+        if (!Gather(&data, &size, header_size))
+          return true;
+        if (!StartEntry())
+          state_ = STATE_ERROR;
+        break;
+      }
+      case STATE_DATA: {
+        size_t count = std::min<size_t>(
+            size, entries_[current_].compressed_size - data_->size());
+        data_->append(data, count);
+        Consume(&data, &size, count);
+        if (data_->size() == entries_[current_].compressed_size &&
+            !QueueEntry())
+          state_ = STATE_ERROR;
+        break;
+      }
+      case STATE_DONE:
+        // The central directory was read already.
+        return true;
+      case STATE_ERROR:
+        return false;
+    }
+  }
+  return state_ != STATE_ERROR;
+}
+
+bool ParallelZipUnpacker::Finish() {
+  if (pool_) {
+    pool_->JoinAll();
+    pool_.reset();
+  }
+
+  if (state_ != STATE_DONE || failed_) {
+    LOG(ERROR) << "The package content is truncated or invalid.";
+    return false;
+  }
+  return true;
+}
+
+bool ParallelZipUnpacker::Gather(const char** data, size_t* size,
+                                 size_t needed) {
+  if (pending_.size() < needed) {
+    size_t count = std::min(needed - pending_.size(), *size);
+    pending_.append(*data, count);
+    Consume(data, size, count);
+  }
+  return pending_.size() >= needed;
+}
+
+void ParallelZipUnpacker::Consume(const char** data, size_t* size,
+                                  size_t count) {
+  *data += count;
+  *size -= count;
+  position_ += count;
+}
+
+bool ParallelZipUnpacker::StartEntry() {
+  pending_.clear();
+  data_.reset(new std::string);
+  data_->reserve(entries_[current_].compressed_size);
+  state_ = STATE_DATA;
+  if (!entries_[current_].compressed_size)
+    return QueueEntry();
+  return true;
+}
+
+void ParallelZipUnpacker::NextEntry() {
+  ++current_;
+  state_ = current_ < entries_.size() ? STATE_SKIP : STATE_DONE;
+}
+
+bool ParallelZipUnpacker::QueueEntry() {
+  size_t size = data_->size();
+  {
+    base::AutoLock lock(lock_);
+    while (queued_size_ > 0 && queued_size_ + size > kMaxQueuedSize &&
+           !failed_)
+      queue_changed_.Wait();
+    if (failed_)
+      return false;
+    queued_size_ += size;
+  }
+
+  pool_->AddWork(new EntryTask(this, entries_[current_], data_.Pass()));
+  NextEntry();
+  return true;
+}
+
+bool ParallelZipUnpacker::UnpackEntry(const Entry& entry,
+                                      const std::string& data) const {
+  base::FilePath path =
+      target_path_.Append(base::FilePath::FromUTF8Unsafe(entry.name));
+  if (entry.name[entry.name.size() - 1] == '/')
+    return file_util::CreateDirectory(path);
+
+  if (!file_util::CreateDirectory(path.DirName()))
+    return false;
+  ScopedStdioHandle file(file_util::OpenFile(path, "wb"));
+  if (!file.get()) {
+    LOG(ERROR) << "Can't create " << path.value();
+    return false;
+  }
+
+  uint32 crc = crc32(0L, Z_NULL, 0);
+  size_t written = 0;
+  if (entry.method == kStoredMethod) {
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(data.data()),
+                data.size());
+    if (fwrite(data.data(), 1, data.size(), file.get()) != data.size())
+      return false;
+    written = data.size();
+  } else {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // Negative window bits for raw deflate data, without zlib header.
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+      return false;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = data.size();
+
+    std::vector<char> buffer(kOutputBufferSize);
+    int result;
+    do {
+      stream.next_out = reinterpret_cast<Bytef*>(&buffer[0]);
+      stream.avail_out = buffer.size();
+      result = inflate(&stream, Z_NO_FLUSH);
+      if (result != Z_OK && result != Z_STREAM_END)
+        break;
+      size_t count = buffer.size() - stream.avail_out;
+      crc = crc32(crc, reinterpret_cast<const Bytef*>(&buffer[0]), count);
+      if (fwrite(&buffer[0], 1, count, file.get()) != count) {
+        result = Z_ERRNO;
+        break;
+      }
+      written += count;
+    } while (result == Z_OK);
+    inflateEnd(&stream);
+
+    if (result != Z_STREAM_END || stream.avail_in) {
+      LOG(ERROR) << "Invalid compressed data for " << entry.name;
+      return false;
+    }
+  }
+
+  if (!file_util::CloseFile(file.Take()))
+    return false;
+  if (crc != entry.crc || written != entry.uncompressed_size) {
+    LOG(ERROR) << "CRC mismatch for " << entry.name;
+    return false;
+  }
+  return true;
+}
+
+void ParallelZipUnpacker::EntryUnpacked(size_t size,
+                                        bool succeeded,
+                                        base::TimeDelta time) {
+  base::AutoLock lock(lock_);
+  queued_size_ -= size;
+  unpack_time_ += time;
+  if (!succeeded)
+    failed_ = true;
+  queue_changed_.Signal();
+}
+
+}  // namespace application
+}  // namespace xwalk
@@ -0,0 +1,117 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_APPLICATION_BROWSER_INSTALLER_PARALLEL_ZIP_UNPACKER_H_
+#define XWALK_APPLICATION_BROWSER_INSTALLER_PARALLEL_ZIP_UNPACKER_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/time.h"
+#include "xwalk/application/browser/installer/zip_unpacker.h"
+
+namespace base {
+class DelegateSimpleThreadPool;
+}
+
+namespace xwalk {
+namespace application {
+
+// Unpacks a ZIP archive on several threads. The central directory is read
+// first, to know where each entry lies in the archive. The archive is then
+// given sequentially, and each entry is inflated and written by a worker
+// thread as soon as its data was read. The compressed data waiting for the
+// workers is limited, reading waits when there is too much of it.
+//
+// Only stored and deflated entries are supported.
+class ParallelZipUnpacker : public ZipUnpacker {
+ public:
+  // The entries are written under |target_path|, which should exist, by
+  // |thread_count| threads.
+  ParallelZipUnpacker(const base::FilePath& target_path, int thread_count);
+  virtual ~ParallelZipUnpacker();
+
+  // Reads the central directory of the archive found in the |size| bytes of
+  // |file| starting at |offset|. It should be called before Write(). The
+  // position in |file| is changed.
+  bool ReadCentralDirectory(FILE* file, int64 offset, int64 size);
+
+  // ZipUnpacker implementation. Finish() waits for the workers.
+  virtual bool Write(const char* data, size_t size) OVERRIDE;
+  virtual bool Finish() OVERRIDE;
+
+  // Time spent by the workers unpacking the entries, all threads together.
+  base::TimeDelta unpack_time() const { return unpack_time_; }
+
+ private:
+  class EntryTask;
+
+  struct Entry {
+    Entry();
+
+    std::string name;
+    uint16 method;
+    uint32 crc;
+    uint32 compressed_size;
+    uint32 uncompressed_size;
+    uint32 header_offset;
+  };
+
+  enum State {
+    STATE_SKIP,
+    STATE_LOCAL_HEADER,
+    STATE_LOCAL_NAME,
+    STATE_DATA,
+    STATE_DONE,
+    STATE_ERROR,
+  };
+
+  static bool IsBefore(const Entry& a, const Entry& b);
+  bool ParseCentralDirectory(const std::string& directory, size_t count);
+
+  // Moves bytes from |data| to |pending_| until it holds |needed| bytes.
+  // Returns false if there were not enough.
+  bool Gather(const char** data, size_t* size, size_t needed);
+  void Consume(const char** data, size_t* size, size_t count);
+  bool StartEntry();
+  void NextEntry();
+  // Queues the current entry for the workers, waiting for room in the queue.
+  bool QueueEntry();
+
+  // Called on the worker threads.
+  bool UnpackEntry(const Entry& entry, const std::string& data) const;
+  void EntryUnpacked(size_t size, bool succeeded, base::TimeDelta time);
+
+  base::FilePath target_path_;
+  int thread_count_;
+  scoped_ptr<base::DelegateSimpleThreadPool> pool_;
+
+  // Entries in the order of the archive.
+  std::vector<Entry> entries_;
+  size_t current_;
+  State state_;
+  // Position in the archive of the next byte given to Write().
+  int64 position_;
+  std::string pending_;
+  scoped_ptr<std::string> data_;
+
+  // Protects the members below, shared with the workers.
+  base::Lock lock_;
+  base::ConditionVariable queue_changed_;
+  size_t queued_size_;
+  bool failed_;
+  base::TimeDelta unpack_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelZipUnpacker);
+};
+
+}  // namespace application
+}  // namespace xwalk
+
+#endif  // XWALK_APPLICATION_BROWSER_INSTALLER_PARALLEL_ZIP_UNPACKER_H_
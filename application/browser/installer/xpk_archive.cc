@@ -0,0 +1,275 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/application/browser/installer/xpk_archive.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "base/logging.h"
+#include "xwalk/application/browser/installer/xpk_package.h"
+#include "xwalk/application/browser/installer/zip_unpacker.h"
+
+namespace xwalk {
+namespace application {
+
+using zip_format::ReadUInt16;
+using zip_format::ReadUInt32;
+using zip_format::kCentralHeaderSignature;
+using zip_format::kCentralHeaderSize;
+using zip_format::kDeflatedMethod;
+using zip_format::kEncryptedFlag;
+using zip_format::kEndOfCentralDirectorySignature;
+using zip_format::kEndOfCentralDirectorySize;
+using zip_format::kLocalHeaderSignature;
+using zip_format::kLocalHeaderSize;
+using zip_format::kStoredMethod;
+using zip_format::kZip64Value;
+
+namespace {
+
+// The archive comment, which follows the end of central directory record,
+// is at most that long.
+const size_t kMaxCommentSize = 0xffff;
+
+}  // namespace
+
+XPKArchive::Entry::Entry()
+    : method(0),
+      crc(0),
+      compressed_size(0),
+      uncompressed_size(0),
+      header_offset(0) {
+}
+
+XPKArchive::XPKArchive()
+    : zip_data_(NULL),
+      zip_size_(0) {
+}
+
+XPKArchive::~XPKArchive() {
+}
+
+// static
+scoped_refptr<XPKArchive> XPKArchive::Open(const base::FilePath& path) {
+  scoped_refptr<XPKArchive> archive(new XPKArchive);
+  if (!archive->file_.Initialize(path)) {
+    LOG(ERROR) << "Can't map the package " << path.value();
+    return NULL;
+  }
+  if (!archive->ReadIndex()) {
+    LOG(ERROR) << "The package " << path.value() << " is invalid.";
+    return NULL;
+  }
+  return archive;
+}
+
+bool XPKArchive::FindEntry(const base::FilePath& relative_path,
+                           Entry* entry) const {
+  std::string name = relative_path.AsUTF8Unsafe();
+#if defined(FILE_PATH_USES_WIN_SEPARATORS)
+  std::replace(name.begin(), name.end(), '\\', '/');
+#endif
+  std::map<std::string, Entry>::const_iterator it = index_.find(name);
+  if (it == index_.end())
+    return false;
+  *entry = it->second;
+  return true;
+}
+
+const char* XPKArchive::GetEntryData(const Entry& entry) const {
+  if (entry.header_offset > zip_size_ ||
+      zip_size_ - entry.header_offset < kLocalHeaderSize)
+    return NULL;
+
+  const char* header = zip_data_ + entry.header_offset;
+  if (ReadUInt32(header) != kLocalHeaderSignature)
+    return NULL;
+
+  // The name and extra field may differ from the central directory ones.
+  size_t offset = entry.header_offset + kLocalHeaderSize +
+      ReadUInt16(header + 26) + ReadUInt16(header + 28);
+  if (offset > zip_size_ || zip_size_ - offset < entry.compressed_size)
+    return NULL;
+  return zip_data_ + offset;
+}
+
+bool XPKArchive::ReadIndex() {
+  const char* data = reinterpret_cast<const char*>(file_.data());
+  size_t size = file_.length();
+
+  XPKPackage::Header header;
+  if (size < sizeof(header))
+    return false;
+  memcpy(&header, data, sizeof(header));
+  if (strncmp(XPKPackage::kXPKPackageHeaderMagic, header.magic,
+              sizeof(header.magic)) ||
+      header.key_size > XPKPackage::kMaxPublicKeySize ||
+      header.signature_size > XPKPackage::kMaxSignatureKeySize)
+    return false;
+
+  size_t zip_offset =
+      sizeof(header) + header.key_size + header.signature_size;
+  if (zip_offset > size)
+    return false;
+  zip_data_ = data + zip_offset;
+  zip_size_ = size - zip_offset;
+
+  // The end of central directory record is searched backwards, as it may be
+  // followed by a comment.
+  if (zip_size_ < kEndOfCentralDirectorySize)
+    return false;
+  size_t end = zip_size_ - kEndOfCentralDirectorySize;
+  size_t first = end > kMaxCommentSize ? end - kMaxCommentSize : 0;
+  while (ReadUInt32(zip_data_ + end) != kEndOfCentralDirectorySignature) {
+    if (end == first)
+      return false;
+    --end;
+  }
+
+  const char* record = zip_data_ + end;
+  size_t count = ReadUInt16(record + 10);
+  uint32 directory_size = ReadUInt32(record + 12);
+  uint32 directory_offset = ReadUInt32(record + 16);
+  if (directory_offset == kZip64Value) {
+    LOG(ERROR) << "ZIP64 archives are not supported.";
+    return false;
+  }
+  if (directory_offset > end || end - directory_offset < directory_size)
+    return false;
+
+  return ReadCentralDirectory(zip_data_ + directory_offset,
+                              directory_size, count);
+}
+
+bool XPKArchive::ReadCentralDirectory(const char* directory, size_t size,
+                                      size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    if (size < kCentralHeaderSize ||
+        ReadUInt32(directory) != kCentralHeaderSignature)
+      return false;
+
+    uint16 flags = ReadUInt16(directory + 8);
+    Entry entry;
+    entry.method = ReadUInt16(directory + 10);
+    entry.crc = ReadUInt32(directory + 16);
+    entry.compressed_size = ReadUInt32(directory + 20);
+    entry.uncompressed_size = ReadUInt32(directory + 24);
+    size_t name_size = ReadUInt16(directory + 28);
+    size_t record_size = kCentralHeaderSize + name_size +
+        ReadUInt16(directory + 30) + ReadUInt16(directory + 32);
+    entry.header_offset = ReadUInt32(directory + 42);
+    if (size < record_size || !name_size)
+      return false;
+
+    if (flags & kEncryptedFlag) {
+      LOG(ERROR) << "Encrypted entries are not supported.";
+      return false;
+    }
+    if (entry.method != kStoredMethod && entry.method != kDeflatedMethod) {
+      LOG(ERROR) << "Unsupported compression method: " << entry.method;
+      return false;
+    }
+    if (entry.compressed_size == kZip64Value ||
+        entry.uncompressed_size == kZip64Value ||
+        entry.header_offset == kZip64Value) {
+      LOG(ERROR) << "ZIP64 entries are not supported.";
+      return false;
+    }
+
+    std::string name(directory + kCentralHeaderSize, name_size);
+    // Directories have nothing to serve.
+    if (name[name.size() - 1] != '/')
+      index_[name] = entry;
+
+    directory += record_size;
+    size -= record_size;
+  }
+  return true;
+}
+
+XPKEntryReader::XPKEntryReader(XPKArchive* archive,
+                               const XPKArchive::Entry& entry)
+    : archive_(archive),
+      entry_(entry),
+      data_(NULL),
+      position_(0),
+      crc_(crc32(0L, Z_NULL, 0)),
+      stream_initialized_(false),
+      ended_(false) {
+  memset(&stream_, 0, sizeof(stream_));
+}
+
+XPKEntryReader::~XPKEntryReader() {
+  if (stream_initialized_)
+    inflateEnd(&stream_);
+}
+
+bool XPKEntryReader::Init() {
+  data_ = archive_->GetEntryData(entry_);
+  if (!data_)
+    return false;
+
+  if (entry_.method == kDeflatedMethod) {
+    // Negative window bits for raw deflate data, without zlib header.
+    if (inflateInit2(&stream_, -MAX_WBITS) != Z_OK)
+      return false;
+    stream_initialized_ = true;
+    stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data_));
+    stream_.avail_in = entry_.compressed_size;
+  } else if (entry_.compressed_size != entry_.uncompressed_size) {
+    return false;
+  }
+  return true;
+}
+
+int XPKEntryReader::Read(char* buffer, int size) {
+  DCHECK(data_);
+  if (ended_ || size <= 0)
+    return 0;
+
+  int result = entry_.method == kDeflatedMethod ?
+      ReadDeflated(buffer, size) : ReadStored(buffer, size);
+  if (result < 0)
+    return -1;
+
+  crc_ = crc32(crc_, reinterpret_cast<const Bytef*>(buffer), result);
+  position_ += result;
+  if (ended_ && !CheckEnd())
+    return -1;
+  return result;
+}
+
+int XPKEntryReader::ReadStored(char* buffer, int size) {
+  uint32 count = std::min<uint32>(size, entry_.uncompressed_size - position_);
+  memcpy(buffer, data_ + position_, count);
+  ended_ = position_ + count == entry_.uncompressed_size;
+  return count;
+}
+
+int XPKEntryReader::ReadDeflated(char* buffer, int size) {
+  stream_.next_out = reinterpret_cast<Bytef*>(buffer);
+  stream_.avail_out = size;
+  int result = inflate(&stream_, Z_NO_FLUSH);
+  // All the input is available, running out of it means it is truncated.
+  if (result != Z_OK && result != Z_STREAM_END)
+    return -1;
+  ended_ = result == Z_STREAM_END;
+  int count = size - stream_.avail_out;
+  // Nothing read before the end would be taken for the end.
+  if (!count && !ended_)
+    return -1;
+  return count;
+}
+
+bool XPKEntryReader::CheckEnd() {
+  if (position_ != entry_.uncompressed_size || crc_ != entry_.crc) {
+    LOG(ERROR) << "The package entry is corrupted.";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace application
+}  // namespace xwalk
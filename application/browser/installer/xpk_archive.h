@@ -0,0 +1,104 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_APPLICATION_BROWSER_INSTALLER_XPK_ARCHIVE_H_
+#define XWALK_APPLICATION_BROWSER_INSTALLER_XPK_ARCHIVE_H_
+
+#include <map>
+#include <string>
+
+#include "base/files/file_path.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/memory/ref_counted.h"
+#include "third_party/zlib/zlib.h"
+
+namespace xwalk {
+namespace application {
+
+// Gives access to the entries of an installed XPK package without unpacking
+// it. The package is mapped in memory, and its central directory is indexed
+// when it is opened. The signature isn't verified again, that is done when
+// the package is installed.
+class XPKArchive : public base::RefCountedThreadSafe<XPKArchive> {
+ public:
+  struct Entry {
+    Entry();
+
+    uint16 method;
+    uint32 crc;
+    uint32 compressed_size;
+    uint32 uncompressed_size;
+    uint32 header_offset;
+  };
+
+  // Returns NULL if the package can't be mapped or its central directory is
+  // invalid. It does blocking IO.
+  static scoped_refptr<XPKArchive> Open(const base::FilePath& path);
+
+  // Finds the file entry at |relative_path| in the package.
+  bool FindEntry(const base::FilePath& relative_path, Entry* entry) const;
+
+  // Returns the compressed data of |entry|, or NULL if its local header is
+  // invalid. It is valid as long as the archive is.
+  const char* GetEntryData(const Entry& entry) const;
+
+ private:
+  friend class base::RefCountedThreadSafe<XPKArchive>;
+
+  XPKArchive();
+  ~XPKArchive();
+
+  bool ReadIndex();
+  bool ReadCentralDirectory(const char* directory, size_t size, size_t count);
+
+  base::MemoryMappedFile file_;
+  // The ZIP archive following the header, key and signature of the package.
+  const char* zip_data_;
+  size_t zip_size_;
+  std::map<std::string, Entry> index_;
+
+  DISALLOW_COPY_AND_ASSIGN(XPKArchive);
+};
+
+// Reads the uncompressed data of an entry. Stored entries are copied from
+// the mapping into the given buffer, deflated entries are inflated straight
+// into it. The CRC-32 of the data is checked when its end is read.
+class XPKEntryReader {
+ public:
+  XPKEntryReader(XPKArchive* archive, const XPKArchive::Entry& entry);
+  ~XPKEntryReader();
+
+  // Returns false if the entry can't be read. It touches the local header
+  // of the entry, so it should be called where blocking IO is allowed.
+  bool Init();
+
+  // Reads up to |size| bytes into |buffer|. Returns the number of bytes
+  // read, 0 at the end of the entry, or -1 if its data is invalid. It faults
+  // the mapped data in, so it shouldn't be called on the IO thread either.
+  int Read(char* buffer, int size);
+
+  uint32 size() const { return entry_.uncompressed_size; }
+
+ private:
+  int ReadStored(char* buffer, int size);
+  int ReadDeflated(char* buffer, int size);
+  bool CheckEnd();
+
+  scoped_refptr<XPKArchive> archive_;
+  XPKArchive::Entry entry_;
+  const char* data_;
+  // Bytes of uncompressed data already read.
+  uint32 position_;
+  uint32 crc_;
+  z_stream stream_;
+  bool stream_initialized_;
+  bool ended_;
+
+  DISALLOW_COPY_AND_ASSIGN(XPKEntryReader);
+};
+
+}  // namespace application
+}  // namespace xwalk
+
+#endif  // XWALK_APPLICATION_BROWSER_INSTALLER_XPK_ARCHIVE_H_
@@ -0,0 +1,184 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/application/browser/installer/xpk_archive.h"
+
+#include <string>
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/path_service.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "xwalk/application/browser/installer/xpk_package.h"
+
+namespace xwalk {
+namespace application {
+
+namespace {
+
+void AppendUInt16(uint16 value, std::string* data) {
+  data->push_back(value & 0xff);
+  data->push_back(value >> 8);
+}
+
+void AppendUInt32(uint32 value, std::string* data) {
+  AppendUInt16(value & 0xffff, data);
+  AppendUInt16(value >> 16, data);
+}
+
+// Returns a package holding one stored entry, with a dummy key and signature.
+std::string CreateStoredPackage(const std::string& name,
+                                const std::string& contents) {
+  uint32 crc = crc32(0L, reinterpret_cast<const Bytef*>(contents.data()),
+                     contents.size());
+  std::string package(XPKPackage::kXPKPackageHeaderMagic,
+                      XPKPackage::kXPKPackageHeaderMagicSize);
+  AppendUInt32(1, &package);  // Key size.
+  AppendUInt32(1, &package);  // Signature size.
+  package += "ks";
+
+  std::string archive;
+  AppendUInt32(0x04034b50, &archive);
+  AppendUInt16(10, &archive);  // Version needed.
+  AppendUInt16(0, &archive);  // Flags.
+  AppendUInt16(0, &archive);  // Stored.
+  AppendUInt32(0, &archive);  // Time and date.
+  AppendUInt32(crc, &archive);
+  AppendUInt32(contents.size(), &archive);
+  AppendUInt32(contents.size(), &archive);
+  AppendUInt16(name.size(), &archive);
+  AppendUInt16(0, &archive);  // Extra field.
+  archive += name;
+  archive += contents;
+
+  size_t directory_offset = archive.size();
+  AppendUInt32(0x02014b50, &archive);
+  AppendUInt16(10, &archive);  // Version made by.
+  AppendUInt16(10, &archive);  // Version needed.
+  AppendUInt16(0, &archive);  // Flags.
+  AppendUInt16(0, &archive);  // Stored.
+  AppendUInt32(0, &archive);  // Time and date.
+  AppendUInt32(crc, &archive);
+  AppendUInt32(contents.size(), &archive);
+  AppendUInt32(contents.size(), &archive);
+  AppendUInt16(name.size(), &archive);
+  AppendUInt16(0, &archive);  // Extra field.
+  AppendUInt16(0, &archive);  // Comment.
+  AppendUInt16(0, &archive);  // Disk.
+  AppendUInt16(0, &archive);  // Internal attributes.
+  AppendUInt32(0, &archive);  // External attributes.
+  AppendUInt32(0, &archive);  // Local header offset.
+  archive += name;
+
+  size_t directory_size = archive.size() - directory_offset;
+  AppendUInt32(0x06054b50, &archive);
+  AppendUInt16(0, &archive);  // Disk.
+  AppendUInt16(0, &archive);  // Disk of the central directory.
+  AppendUInt16(1, &archive);  // Entries on the disk.
+  AppendUInt16(1, &archive);  // Entries.
+  AppendUInt32(directory_size, &archive);
+  AppendUInt32(directory_offset, &archive);
+  AppendUInt16(0, &archive);  // Comment.
+
+  return package + archive;
+}
+
+}  // namespace
+
+class XPKArchiveTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  }
+
+  base::FilePath GetTestPackagePath(const std::string& name) {
+    base::FilePath xpk_path;
+    PathService::Get(base::DIR_SOURCE_ROOT, &xpk_path);
+    return xpk_path.AppendASCII("xwalk")
+        .AppendASCII("application")
+        .AppendASCII("test")
+        .AppendASCII("unpacker")
+        .AppendASCII(name);
+  }
+
+  base::FilePath WritePackage(const std::string& package) {
+    base::FilePath path = temp_dir_.path().AppendASCII("test.xpk");
+    EXPECT_EQ(static_cast<int>(package.size()),
+              file_util::WriteFile(path, package.data(), package.size()));
+    return path;
+  }
+
+  // Reads the entry at |name| |chunk_size| bytes at a time. Returns false if
+  // it can't be found or read.
+  bool ReadEntry(XPKArchive* archive, const std::string& name,
+                 int chunk_size, std::string* contents) {
+    XPKArchive::Entry entry;
+    if (!archive->FindEntry(base::FilePath::FromUTF8Unsafe(name), &entry))
+      return false;
+    XPKEntryReader reader(archive, entry);
+    if (!reader.Init())
+      return false;
+
+    std::string buffer(chunk_size, '\0');
+    contents->clear();
+    int result;
+    while ((result = reader.Read(&buffer[0], chunk_size)) > 0)
+      contents->append(buffer.data(), result);
+    return result == 0 && contents->size() == reader.size();
+  }
+
+ protected:
+  base::ScopedTempDir temp_dir_;
+};
+
+TEST_F(XPKArchiveTest, ReadsDeflatedEntries) {
+  scoped_refptr<XPKArchive> archive =
+      XPKArchive::Open(GetTestPackagePath("good.xpk"));
+  ASSERT_TRUE(archive.get());
+
+  std::string contents;
+  const int kChunkSizes[] = { 1, 7, 4096 };
+  for (size_t i = 0; i < arraysize(kChunkSizes); ++i) {
+    EXPECT_TRUE(ReadEntry(archive.get(), "manifest.json", kChunkSizes[i],
+                          &contents));
+    EXPECT_NE(std::string::npos, contents.find("\"Hello, world\""));
+  }
+  EXPECT_TRUE(ReadEntry(archive.get(), "index.html", 4096, &contents));
+  EXPECT_FALSE(ReadEntry(archive.get(), "missing.html", 4096, &contents));
+}
+
+TEST_F(XPKArchiveTest, ReadsStoredEntries) {
+  scoped_refptr<XPKArchive> archive = XPKArchive::Open(
+      WritePackage(CreateStoredPackage("dir/file.txt", "contents")));
+  ASSERT_TRUE(archive.get());
+
+  std::string contents;
+  EXPECT_TRUE(ReadEntry(archive.get(), "dir/file.txt", 3, &contents));
+  EXPECT_EQ("contents", contents);
+  EXPECT_FALSE(ReadEntry(archive.get(), "dir", 3, &contents));
+}
+
+TEST_F(XPKArchiveTest, RejectsCorruptedEntries) {
+  std::string package = CreateStoredPackage("file.txt", "contents");
+  size_t position = package.find("contents");
+  package[position] ^= 1;
+  scoped_refptr<XPKArchive> archive = XPKArchive::Open(WritePackage(package));
+  ASSERT_TRUE(archive.get());
+
+  std::string contents;
+  EXPECT_FALSE(ReadEntry(archive.get(), "file.txt", 16, &contents));
+}
+
+TEST_F(XPKArchiveTest, RejectsInvalidPackages) {
+  EXPECT_FALSE(XPKArchive::Open(GetTestPackagePath("bad_zip.xpk")).get());
+  EXPECT_FALSE(
+      XPKArchive::Open(GetTestPackagePath("no_magic_header.xpk")).get());
+
+  // The end of central directory record is missing.
+  std::string package = CreateStoredPackage("file.txt", "contents");
+  package.resize(package.size() - 4);
+  EXPECT_FALSE(XPKArchive::Open(WritePackage(package)).get());
+}
+
+}  // namespace application
+}  // namespace xwalk
@@ -6,15 +6,11 @@
 
 #include "base/file_util.h"
 #include "base/logging.h"
-#include "base/path_service.h"
-#include "third_party/zlib/google/zip.h"
+#include "base/sys_info.h"
 
 namespace xwalk {
 namespace application {
 
-const base::FilePath::CharType kApplicationFileExtension[] =
-    FILE_PATH_LITERAL(".xpk");
-
 XPKExtractor::XPKExtractor() {
 }
 
@@ -25,7 +21,7 @@ XPKExtractor::~XPKExtractor() {
 scoped_refptr<XPKExtractor> XPKExtractor::Create(
     const base::FilePath& source_path) {
   if (file_util::PathExists(source_path) &&
-      source_path.MatchesExtension(kApplicationFileExtension)) {
+      source_path.MatchesExtension(XPKPackage::kXPKPackageExtension)) {
     return scoped_refptr<XPKExtractor>(new XPKExtractor(source_path));
   }
   return NULL;
@@ -40,39 +36,30 @@ std::string XPKExtractor::GetPackageID() const {
   return xpk_package_.get()?xpk_package_->Id():"";
 }
 
-bool XPKExtractor::Extract(base::FilePath* target_path) {
+bool XPKExtractor::Extract(const base::FilePath& target_path) {
+  return Extract(target_path, base::SysInfo::NumberOfProcessors(), NULL);
+}
+
+bool XPKExtractor::Extract(const base::FilePath& target_path,
+                           int concurrency,
+                           XPKPackage::ExtractTimings* timings) {
   if (!xpk_package_.get() ||
       !xpk_package_->IsOk()) {
     LOG(ERROR) << "XPK file is broken.";
     return false;
   }
 
-  if (!CreateTempDirectory()) {
-    LOG(ERROR) << "Can't create a temporary"
-                  "directory for extracting the package content.";
-    return false;
-  }
+  return xpk_package_->ExtractToPath(target_path, concurrency, timings);
+}
 
-  if (!zip::Unzip(source_path_, temp_dir_.path())) {
-    LOG(ERROR) << "An error occurred during package extraction";
+bool XPKExtractor::Verify() {
+  if (!xpk_package_.get() ||
+      !xpk_package_->IsOk()) {
+    LOG(ERROR) << "XPK file is broken.";
     return false;
   }
 
-  *target_path = temp_dir_.path();
-  return true;
-}
-
-// Create a temporary directory to decompress the XPK package.
-// As the package information might already exists under data_path,
-// it's safer to extract the XPK file into a temporary directory first.
-bool XPKExtractor::CreateTempDirectory() {
-  base::FilePath tmp;
-  PathService::Get(base::DIR_TEMP, &tmp);
-  if (tmp.empty())
-    return false;
-  if (!temp_dir_.CreateUniqueTempDirUnderPath(tmp))
-    return false;
-  return true;
+  return xpk_package_->Verify();
 }
 
 }  // namespace application
@@ -8,7 +8,6 @@
 #include <string>
 
 #include "base/memory/ref_counted.h"
-#include "base/files/scoped_temp_dir.h"
 #include "xwalk/application/browser/installer/xpk_package.h"
 
 namespace xwalk {
@@ -19,20 +18,24 @@ class XPKExtractor
  public:
   XPKExtractor();
   static scoped_refptr<XPKExtractor> Create(const base::FilePath& source_path);
-  // The function will unzip the XPK file and return the target path where
-  // to decompress by the parameter |target_path|.
-  bool Extract(base::FilePath* target_path);
+  // Verifies and unzips the XPK file into |target_path|, replacing its
+  // previous contents. Nothing is changed if the package is invalid.
+  bool Extract(const base::FilePath& target_path);
+  // Like above, unpacking on |concurrency| threads and reporting how long
+  // each phase took in |timings|, if not NULL.
+  bool Extract(const base::FilePath& target_path,
+               int concurrency,
+               XPKPackage::ExtractTimings* timings);
+  // Verifies the XPK file without unzipping it, for installing it as is.
+  bool Verify();
   std::string GetPackageID() const;
 
  private:
   friend class base::RefCountedThreadSafe<XPKExtractor>;
   ~XPKExtractor();
   explicit XPKExtractor(const base::FilePath& source_path);
-  bool CreateTempDirectory();
 
   base::FilePath source_path_;
-  // Temporary directory for unpacking.
-  base::ScopedTempDir temp_dir_;
   scoped_ptr<XPKPackage> xpk_package_;
 };
 
@@ -5,6 +5,7 @@
 #include "xwalk/application/browser/installer/xpk_extractor.h"
 
 #include "base/file_util.h"
+#include "base/files/file_enumerator.h"
 #include "base/files/scoped_temp_dir.h"
 #include "base/path_service.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -14,8 +15,9 @@ namespace application {
 
 class XPKExtractorTest : public testing::Test {
  public:
-  virtual ~XPKExtractorTest() {
-    temp_dir_.Delete();
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    target_path_ = temp_dir_.path().AppendASCII("app");
   }
 
   void SetupXPKExtractor(const std::string& xpk_name) {
@@ -31,48 +33,98 @@ class XPKExtractorTest : public testing::Test {
     extractor_ = XPKExtractor::Create(xpk_path);
   }
 
+  // The target directory and nothing else should be left.
+  bool TempDirHoldsOnlyTarget() {
+    base::FileEnumerator enumerator(
+        temp_dir_.path(), false,
+        base::FileEnumerator::FILES | base::FileEnumerator::DIRECTORIES);
+    base::FilePath path = enumerator.Next();
+    return path == target_path_ && enumerator.Next().empty();
+  }
+
  protected:
   base::ScopedTempDir temp_dir_;
+  base::FilePath target_path_;
   scoped_refptr<XPKExtractor> extractor_;
 };
 
 TEST_F(XPKExtractorTest, Good) {
   SetupXPKExtractor("good.xpk");
   EXPECT_FALSE(extractor_->GetPackageID().empty());
-  base::FilePath path;
-  EXPECT_TRUE(extractor_->Extract(&path));
-  EXPECT_TRUE(file_util::DirectoryExists(path));
-  EXPECT_TRUE(temp_dir_.Set(path));
+  EXPECT_TRUE(extractor_->Extract(target_path_, 1, NULL));
+  EXPECT_TRUE(file_util::DirectoryExists(target_path_));
+  EXPECT_TRUE(
+      file_util::PathExists(target_path_.AppendASCII("manifest.json")));
+  EXPECT_TRUE(TempDirHoldsOnlyTarget());
+}
+
+TEST_F(XPKExtractorTest, GoodInParallel) {
+  SetupXPKExtractor("good.xpk");
+  XPKPackage::ExtractTimings timings;
+  EXPECT_TRUE(extractor_->Extract(target_path_, 4, &timings));
+  EXPECT_TRUE(
+      file_util::PathExists(target_path_.AppendASCII("manifest.json")));
+  EXPECT_TRUE(file_util::PathExists(target_path_.AppendASCII("index.html")));
+  EXPECT_TRUE(TempDirHoldsOnlyTarget());
+}
+
+TEST_F(XPKExtractorTest, BadSignatureInParallel) {
+  SetupXPKExtractor("bad_signature.xpk");
+  EXPECT_FALSE(extractor_->Extract(target_path_, 4, NULL));
+  EXPECT_TRUE(file_util::IsDirectoryEmpty(temp_dir_.path()));
+}
+
+TEST_F(XPKExtractorTest, BadUnzipFileInParallel) {
+  SetupXPKExtractor("bad_zip.xpk");
+  EXPECT_FALSE(extractor_->Extract(target_path_, 4, NULL));
+  EXPECT_TRUE(file_util::IsDirectoryEmpty(temp_dir_.path()));
+}
+
+TEST_F(XPKExtractorTest, ReplacesPreviousContents) {
+  SetupXPKExtractor("good.xpk");
+  ASSERT_TRUE(file_util::CreateDirectory(target_path_));
+  base::FilePath old_file = target_path_.AppendASCII("old.html");
+  ASSERT_EQ(0, file_util::WriteFile(old_file, "", 0));
+  EXPECT_TRUE(extractor_->Extract(target_path_));
+  EXPECT_FALSE(file_util::PathExists(old_file));
+  EXPECT_TRUE(
+      file_util::PathExists(target_path_.AppendASCII("manifest.json")));
+}
+
+TEST_F(XPKExtractorTest, VerifyWithoutExtracting) {
+  SetupXPKExtractor("good.xpk");
+  EXPECT_TRUE(extractor_->Verify());
+  EXPECT_TRUE(file_util::IsDirectoryEmpty(temp_dir_.path()));
+
+  SetupXPKExtractor("bad_signature.xpk");
+  EXPECT_FALSE(extractor_->Verify());
 }
 
 TEST_F(XPKExtractorTest, BadMagicString) {
   SetupXPKExtractor("bad_magic.xpk");
-  base::FilePath path;
-  EXPECT_FALSE(extractor_->Extract(&path));
+  EXPECT_FALSE(extractor_->Extract(target_path_));
 }
 
 TEST_F(XPKExtractorTest, BadSignature) {
   SetupXPKExtractor("bad_signature.xpk");
-  base::FilePath path;
-  EXPECT_FALSE(extractor_->Extract(&path));
+  EXPECT_FALSE(extractor_->Extract(target_path_));
+  EXPECT_TRUE(file_util::IsDirectoryEmpty(temp_dir_.path()));
 }
 
 TEST_F(XPKExtractorTest, NoMagicHeader) {
   SetupXPKExtractor("no_magic_header.xpk");
-  base::FilePath path;
-  EXPECT_FALSE(extractor_->Extract(&path));
+  EXPECT_FALSE(extractor_->Extract(target_path_));
 }
 
 TEST_F(XPKExtractorTest, BadXPKPackageExtension) {
   SetupXPKExtractor("error.ext");
-  base::FilePath path;
   EXPECT_TRUE(extractor_ == NULL);
 }
 
 TEST_F(XPKExtractorTest, BadUnzipFile) {
   SetupXPKExtractor("bad_zip.xpk");
-  base::FilePath path;
-  EXPECT_FALSE(extractor_->Extract(&path));
+  EXPECT_FALSE(extractor_->Extract(target_path_));
+  EXPECT_TRUE(file_util::IsDirectoryEmpty(temp_dir_.path()));
 }
 
 }  // namespace application
@@ -5,7 +5,11 @@
 #include "xwalk/application/browser/installer/xpk_package.h"
 
 #include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/logging.h"
 #include "crypto/signature_verifier.h"
+#include "xwalk/application/browser/installer/parallel_zip_unpacker.h"
+#include "xwalk/application/browser/installer/zip_stream_unpacker.h"
 #include "xwalk/application/common/id_util.h"
 
 namespace xwalk {
@@ -16,8 +20,14 @@ const uint8 kSignatureAlgorithm[15] = {
   0xf7, 0x0d, 0x01, 0x01, 0x05, 0x05, 0x00
 };
 
+// Packages are read in large chunks, which are both verified and unpacked.
+const size_t kReadBufferSize = 1 << 20;
+
 const char XPKPackage::kXPKPackageHeaderMagic[] = "CrWk";
 
+const base::FilePath::CharType XPKPackage::kXPKPackageExtension[] =
+    FILE_PATH_LITERAL(".xpk");
+
 XPKPackage::XPKPackage() {
 }
 
@@ -68,18 +78,76 @@ XPKPackage::XPKPackage(Header header, ScopedStdioHandle* file)
   if (len < header_.signature_size)
     is_ok_ = false;
 
-  if (!Validate())
-    is_ok_ = false;
-
   std::string public_key =
       std::string(reinterpret_cast<char*>(&key_.front()), key_.size());
   id_ = GenerateId(public_key);
 }
 
-bool XPKPackage::Validate() {
-// Set the file read position to the beginning of compressed resource file,
-// which is behind the magic header, public key and signature key.
-  fseek(file_->get(), zip_addr_, SEEK_SET);
+bool XPKPackage::ExtractToPath(const base::FilePath& target_path,
+                               int concurrency,
+                               ExtractTimings* timings) {
+  if (!is_ok_)
+    return false;
+
+  ExtractTimings phases;
+  base::TimeTicks start = base::TimeTicks::Now();
+  base::ScopedTempDir unpack_dir;
+  if (!unpack_dir.CreateUniqueTempDirUnderPath(target_path.DirName())) {
+    LOG(ERROR) << "Can't create a directory for extracting the package.";
+    return false;
+  }
+
+  // The unpacker is destroyed before the directory, its workers are done
+  // with it then.
+  scoped_ptr<ZipUnpacker> unpacker;
+  ParallelZipUnpacker* parallel_unpacker = NULL;
+  if (concurrency > 1) {
+    fseek(file_->get(), 0, SEEK_END);
+    int64 zip_size = ftell(file_->get()) - zip_addr_;
+    parallel_unpacker =
+        new ParallelZipUnpacker(unpack_dir.path(), concurrency);
+    unpacker.reset(parallel_unpacker);
+    if (!parallel_unpacker->ReadCentralDirectory(
+            file_->get(), zip_addr_, zip_size))
+      return false;
+    phases.directory = base::TimeTicks::Now() - start;
+    start = base::TimeTicks::Now();
+  } else {
+    unpacker.reset(new ZipStreamUnpacker(unpack_dir.path()));
+  }
+
+  if (!ReadContent(unpacker.get()))
+    return false;
+  phases.read = base::TimeTicks::Now() - start;
+  start = base::TimeTicks::Now();
+
+  if (!unpacker->Finish())
+    return false;
+  if (parallel_unpacker) {
+    phases.drain = base::TimeTicks::Now() - start;
+    phases.unpack = parallel_unpacker->unpack_time();
+  }
+  start = base::TimeTicks::Now();
+
+  // Unpacking in the same directory makes this a rename.
+  if (file_util::PathExists(target_path) &&
+      !file_util::Delete(target_path, true))
+    return false;
+  if (!file_util::Move(unpack_dir.path(), target_path))
+    return false;
+  unpack_dir.Take();
+  phases.commit = base::TimeTicks::Now() - start;
+
+  if (timings)
+    *timings = phases;
+  return true;
+}
+
+bool XPKPackage::Verify() {
+  return is_ok_ && ReadContent(NULL);
+}
+
+bool XPKPackage::ReadContent(ZipUnpacker* unpacker) {
   crypto::SignatureVerifier verifier;
   if (!verifier.VerifyInit(kSignatureAlgorithm,
                            sizeof(kSignatureAlgorithm),
@@ -88,13 +156,24 @@ bool XPKPackage::Validate() {
                            &key_.front(),
                            key_.size()))
     return false;
-  unsigned char buf[1 << 12];
+
+  // Set the file read position to the beginning of compressed resource file,
+  // which is behind the magic header, public key and signature key.
+  fseek(file_->get(), zip_addr_, SEEK_SET);
+  std::vector<char> buf(kReadBufferSize);
   size_t len = 0;
-  while ((len = fread(buf, 1, sizeof(buf), file_->get())) > 0)
-    verifier.VerifyUpdate(buf, len);
-  if (!verifier.VerifyFinal())
-    return false;
+  while ((len = fread(&buf.front(), 1, buf.size(), file_->get())) > 0) {
+    verifier.VerifyUpdate(reinterpret_cast<const uint8*>(&buf.front()), len);
+    if (unpacker && !unpacker->Write(&buf.front(), len)) {
+      LOG(ERROR) << "An error occurred during package extraction";
+      return false;
+    }
+  }
 
+  if (!verifier.VerifyFinal()) {
+    LOG(ERROR) << "The signature of the package is invalid.";
+    return false;
+  }
   return true;
 }
 
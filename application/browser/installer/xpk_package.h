@@ -11,13 +11,17 @@
 #include "base/files/file_path.h"
 #include "base/memory/scoped_handle.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/time.h"
 
 namespace xwalk {
 namespace application {
 
+class ZipUnpacker;
+
 class XPKPackage {
  public:
   static const char kXPKPackageHeaderMagic[];
+  static const base::FilePath::CharType kXPKPackageExtension[];
   static const size_t kXPKPackageHeaderMagicSize = 4;
   static const uint32 kMaxPublicKeySize = 1 << 16;
   static const uint32 kMaxSignatureKeySize = 1 << 16;
@@ -30,13 +34,47 @@ class XPKPackage {
   XPKPackage();
   ~XPKPackage();
   static scoped_ptr<XPKPackage> Create(const base::FilePath& path);
-  // Validate the xpk file
+  // Whether the header, key and signature could be read. The signature is
+  // verified by Verify() or ExtractToPath().
   bool IsOk() const { return is_ok_; }
   const std::string& Id() const { return id_; }
 
+  // How long the phases of ExtractToPath() took.
+  struct ExtractTimings {
+    // Reading the central directory, when unpacking in parallel.
+    base::TimeDelta directory;
+    // Reading and verifying the package. It includes unpacking when done on
+    // a single thread, and waiting for the workers when too much data is
+    // queued for them otherwise.
+    base::TimeDelta read;
+    // Waiting for the workers to unpack the last entries.
+    base::TimeDelta drain;
+    // Unpacking on the workers, all of them together.
+    base::TimeDelta unpack;
+    // Replacing |target_path| with the unpacked files.
+    base::TimeDelta commit;
+  };
+
+  // Verifies the signature while unpacking the package into |target_path|,
+  // in a single pass over the file. The files are unpacked in a directory
+  // next to |target_path|, which only replaces it once the signature is
+  // verified, and is removed otherwise.
+  //
+  // With a |concurrency| above 1, the entries are unpacked by that many
+  // threads. |timings| is filled on success if not NULL.
+  bool ExtractToPath(const base::FilePath& target_path,
+                     int concurrency,
+                     ExtractTimings* timings);
+
+  // Verifies the signature of the package without unpacking it.
+  bool Verify();
+
  private:
   XPKPackage(Header header, ScopedStdioHandle* file);
-  bool Validate();
+
+  // Reads the package content, verifying its signature, and gives it to
+  // |unpacker| if not NULL.
+  bool ReadContent(ZipUnpacker* unpacker);
 
   Header header_;
   scoped_ptr<ScopedStdioHandle> file_;
@@ -0,0 +1,306 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/application/browser/installer/zip_stream_unpacker.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "base/file_util.h"
+#include "base/logging.h"
+
+namespace xwalk {
+namespace application {
+
+using zip_format::ReadUInt16;
+using zip_format::ReadUInt32;
+using zip_format::kCentralHeaderSignature;
+using zip_format::kDeflatedMethod;
+using zip_format::kDescriptorFlag;
+using zip_format::kDescriptorSignature;
+using zip_format::kDescriptorSize;
+using zip_format::kEncryptedFlag;
+using zip_format::kEndOfCentralDirectorySignature;
+using zip_format::kLocalHeaderSignature;
+using zip_format::kLocalHeaderSize;
+using zip_format::kSignatureSize;
+using zip_format::kStoredMethod;
+using zip_format::kZip64Value;
+
+namespace {
+
+const size_t kOutputBufferSize = 1 << 16;
+
+}  // namespace
+
+ZipStreamUnpacker::ZipStreamUnpacker(const base::FilePath& target_path)
+    : target_path_(target_path),
+      state_(STATE_SIGNATURE),
+      flags_(0),
+      method_(0),
+      expected_crc_(0),
+      compressed_size_(0),
+      name_size_(0),
+      extra_size_(0),
+      crc_(0),
+      remaining_(0),
+      stream_initialized_(false),
+      output_buffer_(kOutputBufferSize) {
+  memset(&stream_, 0, sizeof(stream_));
+}
+
+ZipStreamUnpacker::~ZipStreamUnpacker() {
+  if (stream_initialized_)
+    inflateEnd(&stream_);
+}
+
+bool ZipStreamUnpacker::Write(const char* data, size_t size) {
+  while (size > 0) {
+    switch (state_) {
+      case STATE_SIGNATURE:
+        if (!Gather(&data, &size, kSignatureSize))
+          return true;
+        if (!ReadSignature())
+          state_ = STATE_ERROR;
+        break;
+      case STATE_LOCAL_HEADER:
+        if (!Gather(&data, &size, kLocalHeaderSize))
+          return true;
+        if (!ReadLocalHeader())
+          state_ = STATE_ERROR;
+        break;
+      case STATE_NAME:
+        if (!Gather(&data, &size, kLocalHeaderSize + name_size_ + extra_size_))
+          return true;
+        if (!StartEntry())
+          state_ = STATE_ERROR;
+        break;
+      case STATE_DATA: {
+        size_t used = WriteEntryData(data, size);
+        data += used;
+        size -= used;
+        break;
+      }
+      case STATE_DESCRIPTOR: {
+        if (!Gather(&data, &size, kSignatureSize))
+          return true;
+        size_t descriptor_size = kDescriptorSize;
+        if (ReadUInt32(pending_.data()) == kDescriptorSignature)
+          descriptor_size += kSignatureSize;
+        if (!Gather(&data, &size, descriptor_size))
+          return true;
+        if (!ReadDescriptor())
+          state_ = STATE_ERROR;
+        break;
+      }
+      case STATE_DONE:
+        // The central directory is not needed.
+        return true;
+      case STATE_ERROR:
+        return false;
+    }
+  }
+  return state_ != STATE_ERROR;
+}
+
+bool ZipStreamUnpacker::Finish() {
+  if (state_ != STATE_DONE) {
+    LOG(ERROR) << "The package content is truncated or invalid.";
+    return false;
+  }
+  return true;
+}
+
+bool ZipStreamUnpacker::Gather(const char** data, size_t* size,
+                               size_t needed) {
+  if (pending_.size() < needed) {
+    size_t count = std::min(needed - pending_.size(), *size);
+    pending_.append(*data, count);
+    *data += count;
+    *size -= count;
+  }
+  return pending_.size() >= needed;
+}
+
+bool ZipStreamUnpacker::ReadSignature() {
+  uint32 signature = ReadUInt32(pending_.data());
+  if (signature == kLocalHeaderSignature) {
+    // The signature is kept, it is part of the local header.
+    state_ = STATE_LOCAL_HEADER;
+    return true;
+  }
+
+  if (signature == kCentralHeaderSignature ||
+      signature == kEndOfCentralDirectorySignature) {
+    pending_.clear();
+    state_ = STATE_DONE;
+    return true;
+  }
+
+  LOG(ERROR) << "Unexpected data in the package content.";
+  return false;
+}
+
+bool ZipStreamUnpacker::ReadLocalHeader() {
+  const char* header = pending_.data();
+  flags_ = ReadUInt16(header + 6);
+  method_ = ReadUInt16(header + 8);
+  expected_crc_ = ReadUInt32(header + 14);
+  compressed_size_ = ReadUInt32(header + 18);
+  name_size_ = ReadUInt16(header + 26);
+  extra_size_ = ReadUInt16(header + 28);
+
+  if (flags_ & kEncryptedFlag) {
+    LOG(ERROR) << "Encrypted entries are not supported.";
+    return false;
+  }
+
+  // The end of stored entries can't be found without their size.
+  if (!(method_ == kDeflatedMethod ||
+        (method_ == kStoredMethod && !(flags_ & kDescriptorFlag)))) {
+    LOG(ERROR) << "Unsupported compression method: " << method_;
+    return false;
+  }
+
+  if (compressed_size_ == kZip64Value) {
+    LOG(ERROR) << "ZIP64 entries are not supported.";
+    return false;
+  }
+
+  if (!name_size_)
+    return false;
+
+  state_ = STATE_NAME;
+  return true;
+}
+
+bool ZipStreamUnpacker::StartEntry() {
+  std::string name = pending_.substr(kLocalHeaderSize, name_size_);
+  pending_.clear();
+
+  base::FilePath relative_path = base::FilePath::FromUTF8Unsafe(name);
+  if (relative_path.IsAbsolute() || relative_path.ReferencesParent()) {
+    LOG(ERROR) << "Invalid entry name in the package: " << name;
+    return false;
+  }
+
+  base::FilePath path = target_path_.Append(relative_path);
+  if (name[name.size() - 1] == '/') {
+    if (!file_util::CreateDirectory(path))
+      return false;
+  } else {
+    if (!file_util::CreateDirectory(path.DirName()))
+      return false;
+    file_.Set(file_util::OpenFile(path, "wb"));
+    if (!file_.get()) {
+      LOG(ERROR) << "Can't create " << path.value();
+      return false;
+    }
+  }
+
+  crc_ = crc32(0L, Z_NULL, 0);
+  remaining_ = compressed_size_;
+  if (method_ == kDeflatedMethod) {
+    memset(&stream_, 0, sizeof(stream_));
+    // Negative window bits for raw deflate data, without zlib header.
+    if (inflateInit2(&stream_, -MAX_WBITS) != Z_OK)
+      return false;
+    stream_initialized_ = true;
+  }
+
+  state_ = STATE_DATA;
+  return true;
+}
+
+size_t ZipStreamUnpacker::WriteEntryData(const char* data, size_t size) {
+  bool has_size = !(flags_ & kDescriptorFlag);
+  if (has_size)
+    size = std::min<size_t>(size, remaining_);
+
+  size_t used = size;
+  bool ended;
+  if (method_ == kStoredMethod) {
+    if (!WriteOutput(data, size)) {
+      state_ = STATE_ERROR;
+      return 0;
+    }
+    ended = remaining_ == size;
+  } else {
+    stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream_.avail_in = size;
+    int result;
+    do {
+      stream_.next_out = reinterpret_cast<Bytef*>(&output_buffer_[0]);
+      stream_.avail_out = output_buffer_.size();
+      result = inflate(&stream_, Z_NO_FLUSH);
+      if ((result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) ||
+          !WriteOutput(&output_buffer_[0],
+                       output_buffer_.size() - stream_.avail_out)) {
+        state_ = STATE_ERROR;
+        return 0;
+      }
+    } while (result == Z_OK &&
+             (stream_.avail_in > 0 || stream_.avail_out == 0));
+
+    used = size - stream_.avail_in;
+    ended = result == Z_STREAM_END;
+    // The compressed data should end exactly where the header said.
+    if (has_size && ended != (remaining_ == used)) {
+      LOG(ERROR) << "Compressed data doesn't match its size.";
+      state_ = STATE_ERROR;
+      return 0;
+    }
+  }
+
+  remaining_ -= used;
+  if (ended && !FinishEntry())
+    state_ = STATE_ERROR;
+  return used;
+}
+
+bool ZipStreamUnpacker::WriteOutput(const char* data, size_t size) {
+  if (!size)
+    return true;
+  crc_ = crc32(crc_, reinterpret_cast<const Bytef*>(data), size);
+  // Directories have no file, their data is dropped.
+  return !file_.get() || fwrite(data, 1, size, file_.get()) == size;
+}
+
+bool ZipStreamUnpacker::FinishEntry() {
+  if (stream_initialized_) {
+    inflateEnd(&stream_);
+    stream_initialized_ = false;
+  }
+  if (file_.get() && !file_util::CloseFile(file_.Take()))
+    return false;
+
+  if (flags_ & kDescriptorFlag) {
+    state_ = STATE_DESCRIPTOR;
+    return true;
+  }
+  if (crc_ != expected_crc_) {
+    LOG(ERROR) << "CRC mismatch in the package content.";
+    return false;
+  }
+  state_ = STATE_SIGNATURE;
+  return true;
+}
+
+bool ZipStreamUnpacker::ReadDescriptor() {
+  const char* descriptor = pending_.data();
+  if (pending_.size() > kDescriptorSize)
+    descriptor += kSignatureSize;
+  uint32 crc = ReadUInt32(descriptor);
+  pending_.clear();
+
+  if (crc != crc_) {
+    LOG(ERROR) << "CRC mismatch in the package content.";
+    return false;
+  }
+  state_ = STATE_SIGNATURE;
+  return true;
+}
+
+}  // namespace application
+}  // namespace xwalk
@@ -0,0 +1,83 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_APPLICATION_BROWSER_INSTALLER_ZIP_STREAM_UNPACKER_H_
+#define XWALK_APPLICATION_BROWSER_INSTALLER_ZIP_STREAM_UNPACKER_H_
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/files/file_path.h"
+#include "base/memory/scoped_handle.h"
+#include "third_party/zlib/zlib.h"
+#include "xwalk/application/browser/installer/zip_unpacker.h"
+
+namespace xwalk {
+namespace application {
+
+// Unpacks a ZIP archive as it is read, so XPK packages can be verified and
+// unpacked in the same pass. The entries are found through their local
+// headers, the central directory at the end of the archive is skipped. Only
+// stored and deflated entries are supported.
+class ZipStreamUnpacker : public ZipUnpacker {
+ public:
+  // The entries are written under |target_path|, which should exist.
+  explicit ZipStreamUnpacker(const base::FilePath& target_path);
+  virtual ~ZipStreamUnpacker();
+
+  // ZipUnpacker implementation.
+  virtual bool Write(const char* data, size_t size) OVERRIDE;
+  virtual bool Finish() OVERRIDE;
+
+ private:
+  enum State {
+    STATE_SIGNATURE,
+    STATE_LOCAL_HEADER,
+    STATE_NAME,
+    STATE_DATA,
+    STATE_DESCRIPTOR,
+    STATE_DONE,
+    STATE_ERROR,
+  };
+
+  // Moves bytes from |data| to |pending_| until it holds |needed| bytes.
+  // Returns false if there were not enough.
+  bool Gather(const char** data, size_t* size, size_t needed);
+
+  bool ReadSignature();
+  bool ReadLocalHeader();
+  bool StartEntry();
+  // Returns the number of bytes of |data| used by the entry.
+  size_t WriteEntryData(const char* data, size_t size);
+  bool WriteOutput(const char* data, size_t size);
+  bool FinishEntry();
+  bool ReadDescriptor();
+
+  base::FilePath target_path_;
+  State state_;
+  std::string pending_;
+
+  // The entry being unpacked.
+  uint16 flags_;
+  uint16 method_;
+  uint32 expected_crc_;
+  uint32 compressed_size_;
+  size_t name_size_;
+  size_t extra_size_;
+  uint32 crc_;
+  // Compressed bytes left, when known from the local header.
+  uint32 remaining_;
+  ScopedStdioHandle file_;
+  z_stream stream_;
+  bool stream_initialized_;
+  std::vector<char> output_buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(ZipStreamUnpacker);
+};
+
+}  // namespace application
+}  // namespace xwalk
+
+#endif  // XWALK_APPLICATION_BROWSER_INSTALLER_ZIP_STREAM_UNPACKER_H_
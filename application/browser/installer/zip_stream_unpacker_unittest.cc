@@ -0,0 +1,132 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/application/browser/installer/zip_stream_unpacker.h"
+
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/path_service.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "xwalk/application/browser/installer/xpk_package.h"
+
+namespace xwalk {
+namespace application {
+
+namespace {
+
+void AppendUInt16(uint16 value, std::string* data) {
+  data->push_back(value & 0xff);
+  data->push_back(value >> 8);
+}
+
+void AppendUInt32(uint32 value, std::string* data) {
+  AppendUInt16(value & 0xffff, data);
+  AppendUInt16(value >> 16, data);
+}
+
+// Returns an archive with one stored entry, without central directory.
+std::string CreateStoredArchive(const std::string& name,
+                                const std::string& contents) {
+  std::string archive;
+  AppendUInt32(0x04034b50, &archive);
+  AppendUInt16(10, &archive);  // Version needed.
+  AppendUInt16(0, &archive);  // Flags.
+  AppendUInt16(0, &archive);  // Stored.
+  AppendUInt32(0, &archive);  // Time and date.
+  AppendUInt32(crc32(0L, reinterpret_cast<const Bytef*>(contents.data()),
+                     contents.size()), &archive);
+  AppendUInt32(contents.size(), &archive);
+  AppendUInt32(contents.size(), &archive);
+  AppendUInt16(name.size(), &archive);
+  AppendUInt16(0, &archive);  // Extra field.
+  archive += name;
+  archive += contents;
+  return archive;
+}
+
+const char kEndOfCentralDirectory[] = "PK\x05\x06";
+
+}  // namespace
+
+class ZipStreamUnpackerTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+  }
+
+  // Feeds |archive| to the unpacker |chunk_size| bytes at a time.
+  bool Unpack(const std::string& archive, size_t chunk_size) {
+    ZipStreamUnpacker unpacker(temp_dir_.path());
+    for (size_t i = 0; i < archive.size(); i += chunk_size) {
+      if (!unpacker.Write(archive.data() + i,
+                          std::min(chunk_size, archive.size() - i)))
+        return false;
+    }
+    return unpacker.Finish();
+  }
+
+ protected:
+  base::ScopedTempDir temp_dir_;
+};
+
+TEST_F(ZipStreamUnpackerTest, UnpacksInAnyChunkSize) {
+  base::FilePath xpk_path;
+  ASSERT_TRUE(PathService::Get(base::DIR_SOURCE_ROOT, &xpk_path));
+  xpk_path = xpk_path.AppendASCII("xwalk")
+      .AppendASCII("application")
+      .AppendASCII("test")
+      .AppendASCII("unpacker")
+      .AppendASCII("good.xpk");
+  std::string xpk;
+  ASSERT_TRUE(file_util::ReadFileToString(xpk_path, &xpk));
+  XPKPackage::Header header;
+  ASSERT_GT(xpk.size(), sizeof(header));
+  memcpy(&header, xpk.data(), sizeof(header));
+  std::string archive =
+      xpk.substr(sizeof(header) + header.key_size + header.signature_size);
+
+  const size_t kChunkSizes[] = { 1, 3, 64, archive.size() };
+  for (size_t i = 0; i < arraysize(kChunkSizes); ++i) {
+    EXPECT_TRUE(Unpack(archive, kChunkSizes[i])) << kChunkSizes[i];
+    std::string manifest;
+    EXPECT_TRUE(file_util::ReadFileToString(
+        temp_dir_.path().AppendASCII("manifest.json"), &manifest));
+    EXPECT_NE(std::string::npos, manifest.find("\"Hello, world\""));
+    EXPECT_TRUE(file_util::PathExists(
+        temp_dir_.path().AppendASCII("index.html")));
+  }
+}
+
+TEST_F(ZipStreamUnpackerTest, StoredEntries) {
+  std::string archive = CreateStoredArchive("dir/", "") +
+      CreateStoredArchive("dir/file.txt", "contents") +
+      kEndOfCentralDirectory;
+  EXPECT_TRUE(Unpack(archive, 5));
+
+  std::string contents;
+  EXPECT_TRUE(file_util::ReadFileToString(
+      temp_dir_.path().AppendASCII("dir").AppendASCII("file.txt"),
+      &contents));
+  EXPECT_EQ("contents", contents);
+}
+
+TEST_F(ZipStreamUnpackerTest, RejectsInvalidArchives) {
+  // Entries can't be written outside of the target.
+  EXPECT_FALSE(Unpack(CreateStoredArchive("../file.txt", "contents") +
+                      kEndOfCentralDirectory, 16));
+
+  std::string corrupted = CreateStoredArchive("file.txt", "contents") +
+      kEndOfCentralDirectory;
+  corrupted[corrupted.size() - 5] ^= 1;
+  EXPECT_FALSE(Unpack(corrupted, 16));
+
+  // The archive should end with the central directory.
+  EXPECT_FALSE(Unpack(CreateStoredArchive("file.txt", "contents"), 16));
+}
+
+}  // namespace application
+}  // namespace xwalk
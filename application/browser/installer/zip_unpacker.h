@@ -0,0 +1,67 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_APPLICATION_BROWSER_INSTALLER_ZIP_UNPACKER_H_
+#define XWALK_APPLICATION_BROWSER_INSTALLER_ZIP_UNPACKER_H_
+
+#include "base/basictypes.h"
+
+namespace xwalk {
+namespace application {
+
+// Unpacks a ZIP archive given sequentially, so that it can be verified while
+// it is read.
+class ZipUnpacker {
+ public:
+  virtual ~ZipUnpacker() {}
+
+  // Unpacks the next |size| bytes of the archive. Returns false if they are
+  // not valid or the entries couldn't be written, further calls fail then.
+  virtual bool Write(const char* data, size_t size) = 0;
+
+  // Returns true if the whole archive was unpacked.
+  virtual bool Finish() = 0;
+};
+
+// Values of the ZIP format used by the unpackers. Numbers are little endian.
+namespace zip_format {
+
+const uint32 kLocalHeaderSignature = 0x04034b50;
+const uint32 kCentralHeaderSignature = 0x02014b50;
+const uint32 kEndOfCentralDirectorySignature = 0x06054b50;
+const uint32 kDescriptorSignature = 0x08074b50;
+
+const size_t kSignatureSize = 4;
+const size_t kLocalHeaderSize = 30;
+const size_t kCentralHeaderSize = 46;
+const size_t kEndOfCentralDirectorySize = 22;
+// The CRC-32 and the sizes, which may be preceded by the signature.
+const size_t kDescriptorSize = 12;
+
+const uint16 kEncryptedFlag = 1 << 0;
+const uint16 kDescriptorFlag = 1 << 3;
+
+const uint16 kStoredMethod = 0;
+const uint16 kDeflatedMethod = 8;
+
+// Sizes and offsets of 0xffffffff are stored in the ZIP64 extra field.
+const uint32 kZip64Value = 0xffffffff;
+
+inline uint16 ReadUInt16(const char* data) {
+  const uint8* bytes = reinterpret_cast<const uint8*>(data);
+  return bytes[0] | (bytes[1] << 8);
+}
+
+inline uint32 ReadUInt32(const char* data) {
+  const uint8* bytes = reinterpret_cast<const uint8*>(data);
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+      (static_cast<uint32>(bytes[3]) << 24);
+}
+
+}  // namespace zip_format
+
+}  // namespace application
+}  // namespace xwalk
+
+#endif  // XWALK_APPLICATION_BROWSER_INSTALLER_ZIP_UNPACKER_H_
@@ -104,7 +104,7 @@ DBStoreJsonImpl::GetTaskRunnerForFile(
 }
 
 // static
-const base::FilePath GetDBPath(const base::FilePath& path) {
+base::FilePath DBStoreJsonImpl::GetDBPath(const base::FilePath& path) {
   return path.Append(kDBFileName);
 }
 
@@ -27,6 +27,8 @@ class DBStoreJsonImpl: public DBStore,
   static scoped_refptr<base::SequencedTaskRunner> GetTaskRunnerForFile(
       const base::FilePath& db_filename,
       base::SequencedWorkerPool* worker_pool);
+  // Returns the path of the database file in the data directory |path|.
+  static base::FilePath GetDBPath(const base::FilePath& path);
 
   // Implement the DBStore interface.
   virtual bool Insert(const Application* application,
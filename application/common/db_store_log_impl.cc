@@ -0,0 +1,238 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/application/common/db_store_log_impl.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "base/bind.h"
+#include "base/file_util.h"
+#include "base/files/important_file_writer.h"
+#include "base/hash.h"
+#include "base/json/json_file_value_serializer.h"
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
+#include "base/logging.h"
+#include "base/pickle.h"
+#include "content/public/browser/browser_thread.h"
+#include "xwalk/application/browser/application_store.h"
+#include "xwalk/application/common/db_store_json_impl.h"
+
+namespace xwalk {
+namespace application {
+
+namespace {
+
+const base::FilePath::CharType kLogFileName[] =
+    FILE_PATH_LITERAL("applications_log");
+
+// The log is not compacted before reaching this size, and then only when
+// less than half of it holds the current values.
+const size_t kMinCompactionSize = 64 * 1024;
+const size_t kCompactionFactor = 2;
+
+// Each record starts with this header, followed by a pickle with the key and
+// the value written as JSON.
+struct RecordHeader {
+  uint32_t size;
+  uint32_t checksum;
+};
+
+base::FilePath GetLogPath(const base::FilePath& path) {
+  return path.Append(kLogFileName);
+}
+
+void AppendToLog(const base::FilePath& path, const std::string& record) {
+  if (file_util::AppendToFile(path, record.data(), record.size()) !=
+      static_cast<int>(record.size()))
+    LOG(ERROR) << "Failed to append to " << path.value();
+}
+
+}  // namespace
+
+DBStoreLogImpl::DBStoreLogImpl(base::FilePath path)
+    : DBStore(path),
+      task_runner_(DBStoreJsonImpl::GetTaskRunnerForFile(
+          GetLogPath(path), content::BrowserThread::GetBlockingPool())),
+      log_size_(0),
+      live_size_(0) {
+}
+
+DBStoreLogImpl::DBStoreLogImpl(
+    base::FilePath path,
+    scoped_refptr<base::SequencedTaskRunner> task_runner)
+    : DBStore(path),
+      task_runner_(task_runner),
+      log_size_(0),
+      live_size_(0) {
+}
+
+DBStoreLogImpl::~DBStoreLogImpl() {
+}
+
+bool DBStoreLogImpl::InitDB() {
+  db_.reset(new base::DictionaryValue);
+  bool succeeded = (file_util::PathExists(data_path_) ||
+                    file_util::CreateDirectory(data_path_)) && LoadLog();
+
+  FOR_EACH_OBSERVER(DBStore::Observer,
+                    observers_,
+                    OnInitializationCompleted(succeeded));
+  return succeeded;
+}
+
+bool DBStoreLogImpl::LoadLog() {
+  const base::FilePath log_path = GetLogPath(data_path_);
+  std::string data;
+  if (file_util::ReadFileToString(log_path, &data)) {
+    if (ReadLog(data) == data.size())
+      return true;
+    LOG(WARNING) << "Dropping the damaged end of " << log_path.value();
+    return WriteSnapshot(true);
+  }
+
+  // The JSON database is removed once its contents are safely in the log.
+  const base::FilePath json_path = DBStoreJsonImpl::GetDBPath(data_path_);
+  if (file_util::PathExists(json_path)) {
+    int error_code;
+    std::string error_msg;
+    JSONFileValueSerializer serializer(json_path);
+    scoped_ptr<base::Value> value(
+        serializer.Deserialize(&error_code, &error_msg));
+    if (value && value->IsType(base::Value::TYPE_DICTIONARY))
+      db_.reset(static_cast<base::DictionaryValue*>(value.release()));
+    else
+      LOG(WARNING) << "Not migrating invalid database: " << error_msg;
+  }
+
+  if (!WriteSnapshot(true))
+    return false;
+  if (file_util::PathExists(json_path))
+    file_util::Delete(json_path, false);
+  return true;
+}
+
+size_t DBStoreLogImpl::ReadLog(const std::string& data) {
+  size_t offset = 0;
+  while (data.size() - offset >= sizeof(RecordHeader)) {
+    RecordHeader header;
+    memcpy(&header, data.data() + offset, sizeof(header));
+    const char* payload = data.data() + offset + sizeof(header);
+    if (header.size > data.size() - offset - sizeof(header) ||
+        base::Hash(payload, header.size) != header.checksum)
+      break;
+
+    Pickle pickle(payload, header.size);
+    PickleIterator iter(pickle);
+    std::string key;
+    std::string json;
+    if (!iter.ReadString(&key) || !iter.ReadString(&json))
+      break;
+    base::Value* value = base::JSONReader::Read(json);
+    if (!value)
+      break;
+
+    db_->Set(key, value);
+    size_t size = sizeof(header) + header.size;
+    RecordWritten(key, size);
+    offset += size;
+  }
+  return offset;
+}
+
+// static
+size_t DBStoreLogImpl::WriteRecord(const std::string& key,
+                                   const base::Value& value,
+                                   std::string* log) {
+  std::string json;
+  base::JSONWriter::Write(&value, &json);
+  Pickle pickle;
+  pickle.WriteString(key);
+  pickle.WriteString(json);
+
+  const char* payload = static_cast<const char*>(pickle.data());
+  RecordHeader header;
+  header.size = pickle.size();
+  header.checksum = base::Hash(payload, pickle.size());
+  log->append(reinterpret_cast<const char*>(&header), sizeof(header));
+  log->append(payload, pickle.size());
+  return sizeof(header) + pickle.size();
+}
+
+void DBStoreLogImpl::RecordWritten(const std::string& key, size_t size) {
+  RecordSizeMap::iterator it = record_sizes_.find(key);
+  if (it != record_sizes_.end()) {
+    live_size_ -= it->second;
+    it->second = size;
+  } else {
+    record_sizes_[key] = size;
+  }
+  live_size_ += size;
+  log_size_ += size;
+}
+
+bool DBStoreLogImpl::WriteSnapshot(bool wait) {
+  record_sizes_.clear();
+  log_size_ = 0;
+  live_size_ = 0;
+
+  std::string log;
+  for (base::DictionaryValue::Iterator it(*db_); !it.IsAtEnd(); it.Advance())
+    RecordWritten(it.key(), WriteRecord(it.key(), it.value(), &log));
+
+  const base::FilePath log_path = GetLogPath(data_path_);
+  if (wait)
+    return base::ImportantFileWriter::WriteFileAtomically(log_path, log);
+
+  task_runner_->PostTask(
+      FROM_HERE,
+      base::Bind(
+          base::IgnoreResult(&base::ImportantFileWriter::WriteFileAtomically),
+          log_path, log));
+  return true;
+}
+
+bool DBStoreLogImpl::NeedsCompaction() const {
+  return log_size_ >= kMinCompactionSize &&
+      log_size_ > kCompactionFactor * live_size_;
+}
+
+void DBStoreLogImpl::SetValue(const std::string& key, base::Value* value) {
+  DCHECK(value);
+  std::string record;
+  RecordWritten(key, WriteRecord(key, *value, &record));
+  db_->Set(key, value);
+
+  FOR_EACH_OBSERVER(
+      DBStore::Observer, observers_, OnDBValueChanged(key, value));
+
+  // The snapshot already includes the new record.
+  if (NeedsCompaction()) {
+    WriteSnapshot(false);
+    return;
+  }
+  task_runner_->PostTask(
+      FROM_HERE,
+      base::Bind(&AppendToLog, GetLogPath(data_path_), record));
+}
+
+bool DBStoreLogImpl::Insert(const Application* application,
+                            const base::Time install_time) {
+  std::string application_id = application->ID();
+  if (!db_->HasKey(application_id)) {
+    base::DictionaryValue* manifest =
+        application->GetManifest()->value()->DeepCopy();
+    scoped_ptr<base::DictionaryValue> value(new base::DictionaryValue);
+    value->Set(ApplicationStore::kManifestPath, manifest);
+    value->SetString(ApplicationStore::kApplicationPath,
+                     application->Path().value());
+    value->SetDouble(ApplicationStore::kInstallTime, install_time.ToDoubleT());
+    SetValue(application_id, value.release());
+  }
+  return true;
+}
+
+}  // namespace application
+}  // namespace xwalk
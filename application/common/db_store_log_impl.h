@@ -0,0 +1,74 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_APPLICATION_COMMON_DB_STORE_LOG_IMPL_H_
+#define XWALK_APPLICATION_COMMON_DB_STORE_LOG_IMPL_H_
+
+#include <map>
+#include <string>
+
+#include "base/sequenced_task_runner.h"
+#include "base/values.h"
+#include "xwalk/application/common/db_store.h"
+
+namespace xwalk {
+namespace application {
+
+// The log backend implementation of DBStore. Each change is appended to the
+// log file as a record with the key and its new value, so a write costs as
+// much as the changed value instead of the whole database. Once most of the
+// log is made of records that were overwritten, it is compacted by rewriting
+// it atomically with the last record of each key.
+//
+// A record cut short or not matching its checksum, as left by a crash while
+// appending, ends the log; the log is rewritten without it when loaded.
+//
+// When there is no log yet, the database of DBStoreJsonImpl is migrated.
+class DBStoreLogImpl: public DBStore {
+ public:
+  explicit DBStoreLogImpl(base::FilePath path);
+  // Files are written on |task_runner|.
+  DBStoreLogImpl(base::FilePath path,
+                 scoped_refptr<base::SequencedTaskRunner> task_runner);
+  virtual ~DBStoreLogImpl();
+
+  // Implement the DBStore interface.
+  virtual bool Insert(const Application* application,
+                      const base::Time install_time) OVERRIDE;
+
+  virtual bool InitDB() OVERRIDE;
+  virtual void SetValue(const std::string& key, base::Value* value) OVERRIDE;
+
+ private:
+  // Loads the log, or migrates the database of DBStoreJsonImpl if there is
+  // no log yet.
+  bool LoadLog();
+  // Reads the records in |data| into the database. Returns the size of the
+  // valid records at the start of |data|.
+  size_t ReadLog(const std::string& data);
+
+  // Appends the record of |key| and |value| to |log|, returning its size.
+  static size_t WriteRecord(const std::string& key, const base::Value& value,
+                            std::string* log);
+  void RecordWritten(const std::string& key, size_t size);
+
+  // Writes the whole database as the log, synchronously if |wait| is true.
+  bool WriteSnapshot(bool wait);
+  bool NeedsCompaction() const;
+
+  scoped_refptr<base::SequencedTaskRunner> task_runner_;
+
+  // Size of the last record of each key, used to know how much of the log is
+  // still used.
+  typedef std::map<std::string, size_t> RecordSizeMap;
+  RecordSizeMap record_sizes_;
+  size_t log_size_;
+  size_t live_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(DBStoreLogImpl);
+};
+
+}  // namespace application
+}  // namespace xwalk
+#endif  // XWALK_APPLICATION_COMMON_DB_STORE_LOG_IMPL_H_
@@ -0,0 +1,139 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/application/common/db_store_log_impl.h"
+
+#include <string>
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/json/json_file_value_serializer.h"
+#include "base/message_loop/message_loop.h"
+#include "base/path_service.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace xwalk {
+namespace application {
+
+namespace {
+
+const char kLogFileName[] = "applications_log";
+
+}  // namespace
+
+class DBStoreLogImplTest : public testing::Test {
+ public:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    db_path_ = temp_dir_.path().AppendASCII("db");
+  }
+
+  // Writes are done in the message loop, the database should be flushed
+  // before being opened again.
+  scoped_ptr<DBStoreLogImpl> OpenDB() {
+    scoped_ptr<DBStoreLogImpl> db_store(
+        new DBStoreLogImpl(db_path_, message_loop_.message_loop_proxy()));
+    EXPECT_TRUE(db_store->InitDB());
+    return db_store.Pass();
+  }
+
+  void Flush() {
+    message_loop_.RunUntilIdle();
+  }
+
+  int64 GetLogSize() {
+    int64 size = -1;
+    file_util::GetFileSize(db_path_.AppendASCII(kLogFileName), &size);
+    return size;
+  }
+
+ protected:
+  base::MessageLoop message_loop_;
+  base::ScopedTempDir temp_dir_;
+  base::FilePath db_path_;
+};
+
+TEST_F(DBStoreLogImplTest, PersistsValues) {
+  scoped_ptr<DBStoreLogImpl> db_store = OpenDB();
+  db_store->SetValue("first", base::Value::CreateStringValue("one"));
+  db_store->SetValue("second", base::Value::CreateIntegerValue(2));
+  db_store->SetValue("first", base::Value::CreateStringValue("three"));
+  Flush();
+
+  base::DictionaryValue expected;
+  expected.SetString("first", "three");
+  expected.SetInteger("second", 2);
+  EXPECT_TRUE(db_store->GetApplications()->Equals(&expected));
+
+  db_store = OpenDB();
+  EXPECT_TRUE(db_store->GetApplications()->Equals(&expected));
+}
+
+TEST_F(DBStoreLogImplTest, MigratesJsonDatabase) {
+  base::FilePath json_db_path;
+  ASSERT_TRUE(PathService::Get(base::DIR_SOURCE_ROOT, &json_db_path));
+  json_db_path = json_db_path.AppendASCII("xwalk")
+      .AppendASCII("application")
+      .AppendASCII("test")
+      .AppendASCII("db")
+      .AppendASCII("good");
+  ASSERT_TRUE(file_util::CopyDirectory(json_db_path, db_path_, true));
+
+  JSONFileValueSerializer serializer(db_path_.AppendASCII("applications_db"));
+  int error_code;
+  std::string error_msg;
+  scoped_ptr<base::Value> value(
+      serializer.Deserialize(&error_code, &error_msg));
+  ASSERT_TRUE(value);
+
+  scoped_ptr<DBStoreLogImpl> db_store = OpenDB();
+  EXPECT_TRUE(db_store->GetApplications()->Equals(value.get()));
+  EXPECT_FALSE(file_util::PathExists(db_path_.AppendASCII("applications_db")));
+
+  db_store = OpenDB();
+  EXPECT_TRUE(db_store->GetApplications()->Equals(value.get()));
+}
+
+TEST_F(DBStoreLogImplTest, DropsDamagedRecords) {
+  scoped_ptr<DBStoreLogImpl> db_store = OpenDB();
+  db_store->SetValue("kept", base::Value::CreateBooleanValue(true));
+  Flush();
+  int64 size = GetLogSize();
+  db_store->SetValue("lost", base::Value::CreateBooleanValue(true));
+  Flush();
+
+  // Cut the last record short, like a crash while appending it would.
+  std::string data;
+  base::FilePath log_path = db_path_.AppendASCII(kLogFileName);
+  ASSERT_TRUE(file_util::ReadFileToString(log_path, &data));
+  data.resize(data.size() - 1);
+  ASSERT_EQ(static_cast<int>(data.size()),
+            file_util::WriteFile(log_path, data.data(), data.size()));
+
+  db_store = OpenDB();
+  base::DictionaryValue expected;
+  expected.SetBoolean("kept", true);
+  EXPECT_TRUE(db_store->GetApplications()->Equals(&expected));
+  EXPECT_EQ(size, GetLogSize());
+}
+
+TEST_F(DBStoreLogImplTest, CompactsLog) {
+  scoped_ptr<DBStoreLogImpl> db_store = OpenDB();
+  const std::string large_value(1024, 'x');
+  for (int i = 0; i < 200; ++i) {
+    db_store->SetValue("key", base::Value::CreateStringValue(large_value));
+    Flush();
+  }
+  // Only a few overwritten records are left.
+  EXPECT_LT(GetLogSize(), 100 * 1024);
+
+  db_store->SetValue("key", base::Value::CreateStringValue("last"));
+  Flush();
+  db_store = OpenDB();
+  base::DictionaryValue expected;
+  expected.SetString("key", "last");
+  EXPECT_TRUE(db_store->GetApplications()->Equals(&expected));
+}
+
+}  // namespace application
+}  // namespace xwalk
@@ -8,6 +8,7 @@
 #include "base/strings/utf_string_conversions.h"
 #include "content/public/browser/browser_thread.h"
 #include "xwalk/jsapi/dialog.h"
+#include "xwalk/jsapi/dialog_functions.h"
 
 using content::BrowserThread;
 
@@ -24,6 +25,7 @@ DialogExtension::DialogExtension(RuntimeRegistry* runtime_registry)
     runtime_registry_(runtime_registry),
     owning_window_(NULL) {
   set_name("xwalk.experimental.dialog");
+  SetJavaScriptAPI(kSource_dialog_api, kFunctionNames);
   runtime_registry_->AddObserver(this);
 }
 
@@ -31,10 +33,6 @@ DialogExtension::~DialogExtension() {
   runtime_registry_->RemoveObserver(this);
 }
 
-const char* DialogExtension::GetJavaScriptAPI() {
-  return kSource_dialog_api;
-}
-
 XWalkExtensionInstance* DialogExtension::CreateInstance(
   const XWalkExtension::PostMessageCallback& post_message) {
   return new DialogInstance(this, post_message);
@@ -52,8 +50,8 @@ DialogInstance::DialogInstance(DialogExtension* extension,
   : XWalkInternalExtensionInstance(post_message),
     extension_(extension),
     dialog_(NULL) {
-  RegisterFunction("showOpenDialog", &DialogInstance::OnShowOpenDialog);
-  RegisterFunction("showSaveDialog", &DialogInstance::OnShowSaveDialog);
+  RegisterFunction(kShowOpenDialog, &DialogInstance::OnShowOpenDialog);
+  RegisterFunction(kShowSaveDialog, &DialogInstance::OnShowSaveDialog);
 }
 
 DialogInstance::~DialogInstance() {
@@ -71,8 +69,7 @@ void DialogInstance::HandleMessage(scoped_ptr<base::Value> msg) {
   XWalkInternalExtensionInstance::HandleMessage(msg.Pass());
 }
 
-void DialogInstance::OnShowOpenDialog(const std::string& function_name,
-                                     const std::string& callback_id,
+void DialogInstance::OnShowOpenDialog(int function_id, int callback_id,
                                      base::ListValue* args) {
   CHECK(BrowserThread::CurrentlyOn(BrowserThread::UI));
 
@@ -80,7 +77,8 @@ void DialogInstance::OnShowOpenDialog(const std::string& function_name,
       params(ShowOpenDialog::Params::Create(*args));
 
   if (!params) {
-    LOG(WARNING) << "Malformed parameters passed to " << function_name;
+    LOG(WARNING) << "Malformed parameters passed to "
+                 << kFunctionNames[function_id];
     return;
   }
 
@@ -96,8 +94,8 @@ void DialogInstance::OnShowOpenDialog(const std::string& function_name,
   // FIXME(jeez): implement file_type and file_extension support.
   base::FilePath::StringType file_extension;
 
-  std::pair<std::string, std::string>* data =
-      new std::pair<std::string, std::string>(function_name, callback_id);
+  std::pair<int, int>* data = new std::pair<int, int>(function_id,
+                                                     callback_id);
 
   if (!dialog_)
     dialog_ = ui::SelectFileDialog::Create(this, 0 /* policy */);
@@ -108,8 +106,7 @@ void DialogInstance::OnShowOpenDialog(const std::string& function_name,
                       extension_->owning_window_, data);
 }
 
-void DialogInstance::OnShowSaveDialog(const std::string& function_name,
-                                     const std::string& callback_id,
+void DialogInstance::OnShowSaveDialog(int function_id, int callback_id,
                                      base::ListValue* args) {
   CHECK(BrowserThread::CurrentlyOn(BrowserThread::UI));
 
@@ -117,7 +114,8 @@ void DialogInstance::OnShowSaveDialog(const std::string& function_name,
       params(ShowSaveDialog::Params::Create(*args));
 
   if (!params) {
-    LOG(WARNING) << "Malformed parameters passed to " << function_name;
+    LOG(WARNING) << "Malformed parameters passed to "
+                 << kFunctionNames[function_id];
     return;
   }
 
@@ -130,8 +128,8 @@ void DialogInstance::OnShowSaveDialog(const std::string& function_name,
   if (!dialog_)
     dialog_ = ui::SelectFileDialog::Create(this, 0 /* policy */);
 
-  std::pair<std::string, std::string>* data =
-      new std::pair<std::string, std::string>(function_name, callback_id);
+  std::pair<int, int>* data = new std::pair<int, int>(function_id,
+                                                     callback_id);
 
   base::FilePath filePath =
       base::FilePath::FromUTF8Unsafe(params->initial_path);
@@ -145,11 +143,11 @@ void DialogInstance::OnShowSaveDialog(const std::string& function_name,
 
 void DialogInstance::FileSelected(const base::FilePath& path, int,
                                  void* params) {
-  scoped_ptr<std::pair<std::string, std::string> >
-      data(static_cast<std::pair<std::string, std::string>*>(params));
+  scoped_ptr<std::pair<int, int> >
+      data(static_cast<std::pair<int, int>*>(params));
 
   std::string strPath = path.AsUTF8Unsafe();
-  if (data->first == "showOpenDialog") {
+  if (data->first == kShowOpenDialog) {
     std::vector<std::string> filesList;
     filesList.push_back(strPath);
     PostResult(data->second,
@@ -162,8 +160,8 @@ void DialogInstance::FileSelected(const base::FilePath& path, int,
 
 void DialogInstance::MultiFilesSelected(
     const std::vector<base::FilePath>& files, void* params) {
-  scoped_ptr<std::pair<std::string, std::string> >
-      data(static_cast<std::pair<std::string, std::string>*>(params));
+  scoped_ptr<std::pair<int, int> >
+      data(static_cast<std::pair<int, int>*>(params));
 
   std::vector<std::string> filesList;
   std::vector<base::FilePath>::const_iterator it;
@@ -31,7 +31,6 @@ class DialogExtension : public XWalkInternalExtension,
   virtual ~DialogExtension();
 
   // XWalkExtension implementation.
-  virtual const char* GetJavaScriptAPI() OVERRIDE;
   virtual XWalkExtensionInstance* CreateInstance(
     const PostMessageCallback& post_message) OVERRIDE;
 
@@ -64,10 +63,10 @@ class DialogInstance : public XWalkInternalExtensionInstance,
     const std::vector<base::FilePath>& files, void* params) OVERRIDE;
 
  private:
-  void OnShowOpenDialog(const std::string& function_name,
-                        const std::string& callback_id, base::ListValue* args);
-  void OnShowSaveDialog(const std::string& function_name,
-                        const std::string& callback_id, base::ListValue* args);
+  void OnShowOpenDialog(int function_id, int callback_id,
+                        base::ListValue* args);
+  void OnShowSaveDialog(int function_id, int callback_id,
+                        base::ListValue* args);
 
   DialogExtension* extension_;
   scoped_refptr<SelectFileDialog> dialog_;
@@ -5,17 +5,37 @@
 #include "xwalk/extensions/browser/xwalk_extension_internal.h"
 
 #include "base/logging.h"
-#include "base/strings/string_number_conversions.h"
-#include "base/strings/string_split.h"
+#include "base/strings/stringprintf.h"
+#include "base/values.h"
 
 namespace xwalk {
 namespace extensions {
 
+const char* XWalkInternalExtension::GetJavaScriptAPI() {
+  return javascript_api_.c_str();
+}
+
 XWalkExtensionInstance* XWalkInternalExtension::CreateInstance(
     const XWalkExtension::PostMessageCallback& post_message) {
   return new XWalkInternalExtensionInstance(post_message);
 }
 
+void XWalkInternalExtension::SetJavaScriptAPI(
+    const char* api, const char* const* function_names,
+    size_t function_count) {
+  // The ids are given to _setupExtensionInternal() through the extension
+  // object. They are prepended in the same line as the API code, so the line
+  // numbers of errors in the API code stay right.
+  javascript_api_ = "extension._functionIds = {";
+  for (size_t i = 0; i < function_count; ++i) {
+    base::StringAppendF(&javascript_api_, "%s\"%s\": %d",
+                        i ? ", " : "", function_names[i],
+                        static_cast<int>(i));
+  }
+  javascript_api_ += "}; ";
+  javascript_api_ += api;
+}
+
 XWalkInternalExtensionInstance::XWalkInternalExtensionInstance(
     const XWalkExtension::PostMessageCallback& post_message) {
   SetPostMessageCallback(post_message);
@@ -24,16 +44,6 @@ XWalkInternalExtensionInstance::XWalkInternalExtensionInstance(
 XWalkInternalExtensionInstance::~XWalkInternalExtensionInstance() {
 }
 
-XWalkInternalExtensionInstance::FunctionHandler*
-    XWalkInternalExtensionInstance::GetHandlerForFunction(
-    const std::string& function) {
-  FunctionHandlerMap::iterator iter = handlers_.find(function);
-  if (iter == handlers_.end())
-    return NULL;
-
-  return &iter->second;
-}
-
 void XWalkInternalExtensionInstance::HandleMessage(
     scoped_ptr<base::Value> msg) {
   base::ListValue* args;
@@ -45,48 +55,113 @@ void XWalkInternalExtensionInstance::HandleMessage(
     return;
   }
 
-  // The first parameter stands for the function signature.
-  std::string function_name;
-  if (!args->GetString(0, &function_name)) {
-    LOG(WARNING) << "The function name is not a string.";
+  // The function id and the callback id are appended after the function
+  // arguments, so they can be removed without shifting the arguments.
+  size_t size = args->GetSize();
+  int function_id;
+  if (!args->GetInteger(size - 1, &function_id)) {
+    LOG(WARNING) << "The function id is not an integer.";
+    return;
+  }
+
+  int callback_id;
+  if (!args->GetInteger(size - 2, &callback_id)) {
+    LOG(WARNING) << "The callback id is not an integer.";
     return;
   }
 
-  // The second parameter stands for callback id, the remaining
-  // ones are the function arguments.
-  std::string callback_id;
-  if (!args->GetString(1, &callback_id)) {
-    LOG(WARNING) << "The callback id is not a string.";
+  if (!IsFunctionRegistered(function_id)) {
+    DLOG(WARNING) << "Function not registered: " << function_id;
     return;
   }
 
-  FunctionHandler* handler = GetHandlerForFunction(function_name);
-  if (!handler) {
-    DLOG(WARNING) << "Function not registered: " << function_name;
+  args->Remove(size - 1, NULL);
+  args->Remove(size - 2, NULL);
+  if (!handlers_[function_id].is_null()) {
+    handlers_[function_id].Run(function_id, callback_id, args);
     return;
   }
 
-  // We reuse args to pass the extra arguments to the handler, so remove
-  // function_name and callback_id from it.
-  args->Remove(0, NULL);
-  args->Remove(0, NULL);
-  handler->Run(function_name, callback_id, args);
+  // The renderer may send messages as base::Value, e.g. when they nest too
+  // deep to be serialized.
+  std::string serialized_args;
+  XWalkSerializedValueWriter(&serialized_args).WriteValue(*args);
+  serialized_handlers_[function_id].Run(
+      function_id, callback_id,
+      XWalkSerializedValue(serialized_args.data(), serialized_args.size()));
+}
+
+void XWalkInternalExtensionInstance::HandleSerializedMessage(
+    const XWalkSerializedValue& msg) {
+  size_t size = msg.GetSize();
+  if (msg.type() != XWalkSerializedValue::TYPE_ARRAY || size < 2) {
+    LOG(WARNING) << "Invalid number of arguments.";
+    return;
+  }
+
+  XWalkSerializedValue::Iterator it(msg);
+  for (size_t i = 0; i < size - 2; ++i)
+    it.Advance();
+
+  int callback_id;
+  if (!it.value().GetAsInteger(&callback_id)) {
+    LOG(WARNING) << "The callback id is not an integer.";
+    return;
+  }
+
+  it.Advance();
+  int function_id;
+  if (!it.value().GetAsInteger(&function_id)) {
+    LOG(WARNING) << "The function id is not an integer.";
+    return;
+  }
+
+  if (!IsFunctionRegistered(function_id)) {
+    DLOG(WARNING) << "Function not registered: " << function_id;
+    return;
+  }
+
+  XWalkSerializedValue args = msg.GetArrayHead(size - 2);
+  if (!serialized_handlers_[function_id].is_null()) {
+    serialized_handlers_[function_id].Run(function_id, callback_id, args);
+    return;
+  }
+
+  scoped_ptr<base::Value> args_value = args.ToValue();
+  handlers_[function_id].Run(function_id, callback_id,
+                             static_cast<base::ListValue*>(args_value.get()));
+}
+
+void XWalkInternalExtensionInstance::EnsureHandlerSlot(int function_id) {
+  DCHECK_GE(function_id, 0);
+  if (static_cast<size_t>(function_id) < handlers_.size())
+    return;
+  handlers_.resize(function_id + 1);
+  serialized_handlers_.resize(function_id + 1);
+}
+
+bool XWalkInternalExtensionInstance::IsFunctionRegistered(
+    int function_id) const {
+  return function_id >= 0 &&
+      static_cast<size_t>(function_id) < handlers_.size() &&
+      (!handlers_[function_id].is_null() ||
+       !serialized_handlers_[function_id].is_null());
 }
 
 void XWalkInternalExtensionInstance::PostResult(
-    const std::string& callback_id, scoped_ptr<base::ListValue> result) {
+    int callback_id, scoped_ptr<base::ListValue> result) {
   DCHECK(result);
 
-  if (callback_id.empty()) {
-    DLOG(WARNING) << "Sending a reply with an empty callback id has no"
-        "practical effect. This code can be optimized by not creating "
+  if (callback_id == kNoCallback) {
+    DLOG(WARNING) << "Sending a reply without a callback id has no"
+        " practical effect. This code can be optimized by not creating "
         "and not posting the result.";
     return;
   }
 
-  // Prepend the callback id to the list, so the handlers
-  // on the JavaScript side know which callback should be evoked.
-  result->Insert(0, new base::StringValue(callback_id));
+  // Append the callback id to the list, so the handlers on the JavaScript
+  // side know which callback should be evoked.
+  result->AppendInteger(callback_id);
   PostMessageToJS(scoped_ptr<base::Value>(result.release()));
 }
 
@@ -5,11 +5,13 @@
 #ifndef XWALK_EXTENSIONS_BROWSER_XWALK_EXTENSION_INTERNAL_H_
 #define XWALK_EXTENSIONS_BROWSER_XWALK_EXTENSION_INTERNAL_H_
 
-#include <map>
 #include <string>
+#include <vector>
 #include "base/bind.h"
+#include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "xwalk/extensions/common/xwalk_extension.h"
+#include "xwalk/extensions/common/xwalk_extension_serialized_value.h"
 
 namespace xwalk {
 namespace extensions {
@@ -22,10 +24,31 @@ class XWalkInternalExtension : public XWalkExtension {
  public:
   XWalkInternalExtension() {}
 
+  virtual const char* GetJavaScriptAPI() OVERRIDE;
+
   virtual XWalkExtensionInstance* CreateInstance(
       const XWalkExtension::PostMessageCallback& post_message) OVERRIDE;
 
+ protected:
+  // Sets the JavaScript API code, which should call
+  // extension._setupExtensionInternal() and then use
+  // extension._internal.postMessage() with the name of the functions. The
+  // messages carry the index of the function in |function_names| instead of
+  // its name, which should be the kFunctionNames generated from the IDL
+  // describing the API, e.g. "xwalk/jsapi/runtime_functions.h". To be called
+  // in the constructor of the extension.
+  template <size_t N>
+  void SetJavaScriptAPI(const char* api,
+                        const char* const (&function_names)[N]) {
+    SetJavaScriptAPI(api, function_names, N);
+  }
+
  private:
+  void SetJavaScriptAPI(const char* api, const char* const* function_names,
+                        size_t function_count);
+
+  std::string javascript_api_;
+
   DISALLOW_COPY_AND_ASSIGN(XWalkInternalExtension);
 };
 
@@ -41,56 +64,83 @@ class XWalkInternalExtensionInstance : public XWalkExtensionInstance {
   virtual ~XWalkInternalExtensionInstance();
 
   virtual void HandleMessage(scoped_ptr<base::Value> msg) OVERRIDE;
+  virtual void HandleSerializedMessage(
+      const XWalkSerializedValue& msg) OVERRIDE;
+
+  // Callback ids are positive, this one is used when the JavaScript function
+  // was called without a callback.
+  static const int kNoCallback = 0;
 
  protected:
   // This method will register a function to handle a message tagged as
-  // |function_name|. When invoked, the handler will get as first parameter
-  // the |function_name| (which can be used in case a handler is in charge of
-  // more than one function). The |callback_id| is a unique identifier that
-  // should be returned on the PostResult() in case the function triggers a
-  // callback (empty string otherwise). Finally, |args| contains the list of
-  // parameters ready to be used as input for Params::Create() generated from
-  // the IDL description of the API.
+  // |function_id|, the id generated for the function from the IDL. When
+  // invoked, the handler will get as first parameter the |function_id|
+  // (which can be used in case a handler is in charge of more than one
+  // function). The |callback_id| is a unique identifier that should be
+  // returned on the PostResult() in case the function triggers a callback
+  // (kNoCallback otherwise). Finally, |args| contains the list of parameters
+  // ready to be used as input for Params::Create() generated from the IDL
+  // description of the API.
   //
   // The signature of a function handler shall like the following:
   //
-  //   void FooContext::OnShowBar(const std::string& function_name,
-  //                              const std::string& callback_id,
+  //   void FooContext::OnShowBar(int function_id, int callback_id,
   //                              base::ListValue* args)
   //
   // And register them like this, preferable at the FooContext constructor:
   //
-  //   RegisterFunction("showBar", &FooContext::OnShowBar);
-  //   RegisterFunction("getStuff", &FooContext::OnGetStuff);
+  //   RegisterFunction(jsapi::foo::kShowBar, &FooContext::OnShowBar);
+  //   RegisterFunction(jsapi::foo::kGetStuff, &FooContext::OnGetStuff);
   //   ...
   template <class T>
-  void RegisterFunction(const std::string& function_name,
-      void (T::*handler)(const std::string& function_name,
-      const std::string& callback_id, base::ListValue* args)) {
-    handlers_[function_name] = base::Bind(handler,
+  void RegisterFunction(int function_id,
+      void (T::*handler)(int function_id, int callback_id,
+                         base::ListValue* args)) {
+    EnsureHandlerSlot(function_id);
+    handlers_[function_id] = base::Bind(handler,
+        base::Unretained(static_cast<T*>(this)));
+    serialized_handlers_[function_id].Reset();
+  }
+
+  // Handlers can also read the arguments in place from the message serialized
+  // by the renderer, which saves converting big arguments to base::Value.
+  // |args| is an array, valid only during the call:
+  //
+  //   void FooContext::OnSendData(int function_id, int callback_id,
+  //                               const XWalkSerializedValue& args)
+  template <class T>
+  void RegisterFunction(int function_id,
+      void (T::*handler)(int function_id, int callback_id,
+                         const XWalkSerializedValue& args)) {
+    EnsureHandlerSlot(function_id);
+    serialized_handlers_[function_id] = base::Bind(handler,
         base::Unretained(static_cast<T*>(this)));
+    handlers_[function_id].Reset();
   }
 
   // Send the result back and invokes a callback on the renderer. The
   // |callback_id| must be the same as the one got on the function handler.
   // The |result| should be created using the output from Results::Create(),
   // function generated from the IDL describing the JavaScript API. It is a
-  // valid optimization not post a result in case the |callback_id| is an
-  // empty string, because it won't have any practical effect other than noise
+  // valid optimization not post a result in case the |callback_id| is
+  // kNoCallback, because it won't have any practical effect other than noise
   // at the IPC channel. This can be the case when the user of the JavaScript
   // API omits the callback. If the JavaScript function doesn't take a
   // callback at all, you won't need to call this method.
-  void PostResult(const std::string& callback_id,
-                  scoped_ptr<base::ListValue> result);
+  void PostResult(int callback_id, scoped_ptr<base::ListValue> result);
 
  private:
-  typedef base::Callback<void(const std::string&, const std::string&,
-                              base::ListValue*)> FunctionHandler;
-  typedef std::map<std::string, FunctionHandler> FunctionHandlerMap;
+  typedef base::Callback<void(int, int, base::ListValue*)> FunctionHandler;
+  typedef base::Callback<void(int, int, const XWalkSerializedValue&)>
+      SerializedFunctionHandler;
 
-  FunctionHandler* GetHandlerForFunction(const std::string& function);
+  void EnsureHandlerSlot(int function_id);
+  bool IsFunctionRegistered(int function_id) const;
 
-  FunctionHandlerMap handlers_;
+  // Indexed by function id, so dispatching a message doesn't involve
+  // comparing strings. Only one of the handlers of a function is set.
+  std::vector<FunctionHandler> handlers_;
+  std::vector<SerializedFunctionHandler> serialized_handlers_;
 
   DISALLOW_COPY_AND_ASSIGN(XWalkInternalExtensionInstance);
 };
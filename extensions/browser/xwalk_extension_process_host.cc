@@ -0,0 +1,194 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/browser/xwalk_extension_process_host.h"
+
+#include "base/command_line.h"
+#include "base/process_util.h"
+#include "base/stl_util.h"
+#include "base/values.h"
+#include "content/public/browser/browser_child_process_host.h"
+#include "content/public/browser/browser_thread.h"
+#include "content/public/common/child_process_host.h"
+#include "content/public/common/content_switches.h"
+#include "content/public/common/process_type.h"
+#include "xwalk/extensions/common/xwalk_extension_messages.h"
+#include "xwalk/extensions/common/xwalk_extension_switches.h"
+
+using content::BrowserThread;
+
+namespace xwalk {
+namespace extensions {
+
+namespace {
+
+// Embedders are free to use process types after the ones from content.
+const int kXWalkExtensionProcessType = content::PROCESS_TYPE_CONTENT_END + 1;
+
+}  // namespace
+
+XWalkExtensionProcessHost::XWalkExtensionProcessHost(
+    const base::FilePath& extensions_path)
+    : extensions_path_(extensions_path),
+      process_gone_(false),
+      next_stats_request_id_(0) {
+}
+
+XWalkExtensionProcessHost::~XWalkExtensionProcessHost() {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  // Nobody will get a channel from us anymore.
+  process_gone_ = true;
+  RunPendingChannelCallbacks();
+  RunPendingStatsCallbacks();
+}
+
+void XWalkExtensionProcessHost::StartProcess() {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  DCHECK(!process_);
+
+  process_.reset(content::BrowserChildProcessHost::Create(
+      kXWalkExtensionProcessType, this));
+  std::string channel_id = process_->GetHost()->CreateChannel();
+  CHECK(!channel_id.empty());
+
+  CommandLine* cmd_line = new CommandLine(
+      content::ChildProcessHost::GetChildPath(
+          content::ChildProcessHost::CHILD_NORMAL));
+  cmd_line->AppendSwitchASCII(switches::kProcessType,
+                              switches::kXWalkExtensionProcess);
+  cmd_line->AppendSwitchASCII(switches::kProcessChannelID, channel_id);
+
+  // The stats of the extensions are recorded where they run.
+  static const char* const kSwitchNames[] = {
+    switches::kXWalkEnableExtensionStats,
+  };
+  cmd_line->CopySwitchesFrom(*CommandLine::ForCurrentProcess(), kSwitchNames,
+                             arraysize(kSwitchNames));
+
+#if defined(OS_POSIX)
+  // The extension process runs the native code of external extensions, which
+  // expect the same environment they would have in the browser process, so
+  // it isn't sandboxed nor forked from the zygote.
+  process_->Launch(false, base::EnvironmentVector(), cmd_line);
+#else
+  NOTIMPLEMENTED();
+  delete cmd_line;
+  return;
+#endif
+
+  // Messages sent before the channel is connected are queued.
+  process_->GetHost()->Send(
+      new XWalkExtensionProcessMsg_RegisterExtensions(extensions_path_));
+}
+
+void XWalkExtensionProcessHost::CreateRenderProcessChannel(
+    int render_process_id, const ChannelHandleCallback& callback) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  DCHECK(!ContainsKey(pending_channel_callbacks_, render_process_id));
+  pending_channel_callbacks_[render_process_id] = callback;
+  if (process_gone_ || !process_) {
+    RunPendingChannelCallbacks();
+    return;
+  }
+
+  process_->GetHost()->Send(
+      new XWalkExtensionProcessMsg_CreateRenderProcessChannel(
+          render_process_id));
+}
+
+void XWalkExtensionProcessHost::CloseRenderProcessChannel(
+    int render_process_id) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  pending_channel_callbacks_.erase(render_process_id);
+  if (process_gone_ || !process_)
+    return;
+
+  process_->GetHost()->Send(
+      new XWalkExtensionProcessMsg_CloseRenderProcessChannel(
+          render_process_id));
+}
+
+void XWalkExtensionProcessHost::GetExtensionStats(
+    const ExtensionStatsCallback& callback) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
+  if (process_gone_ || !process_) {
+    callback.Run(scoped_ptr<base::DictionaryValue>());
+    return;
+  }
+
+  int request_id = next_stats_request_id_++;
+  pending_stats_callbacks_[request_id] = callback;
+  process_->GetHost()->Send(
+      new XWalkExtensionProcessMsg_GetExtensionStats(request_id));
+}
+
+bool XWalkExtensionProcessHost::OnMessageReceived(
+    const IPC::Message& message) {
+  bool handled = true;
+  IPC_BEGIN_MESSAGE_MAP(XWalkExtensionProcessHost, message)
+    IPC_MESSAGE_HANDLER(
+        XWalkExtensionProcessHostMsg_RenderProcessChannelCreated,
+        OnRenderProcessChannelCreated)
+    IPC_MESSAGE_HANDLER(XWalkExtensionProcessHostMsg_ExtensionStats,
+        OnExtensionStats)
+    IPC_MESSAGE_UNHANDLED(handled = false)
+  IPC_END_MESSAGE_MAP()
+  return handled;
+}
+
+void XWalkExtensionProcessHost::OnProcessCrashed(int exit_code) {
+  LOG(ERROR) << "Extension process crashed with exit code " << exit_code;
+}
+
+void XWalkExtensionProcessHost::OnChannelError() {
+  // The render processes can't get a channel from a dead extension process.
+  process_gone_ = true;
+  RunPendingChannelCallbacks();
+  RunPendingStatsCallbacks();
+}
+
+void XWalkExtensionProcessHost::OnRenderProcessChannelCreated(
+    int render_process_id, const IPC::ChannelHandle& handle) {
+  ChannelCallbackMap::iterator it =
+      pending_channel_callbacks_.find(render_process_id);
+  // The render process may have gone away meanwhile.
+  if (it == pending_channel_callbacks_.end())
+    return;
+
+  ChannelHandleCallback callback = it->second;
+  pending_channel_callbacks_.erase(it);
+  callback.Run(handle);
+}
+
+void XWalkExtensionProcessHost::OnExtensionStats(
+    int request_id, const base::DictionaryValue& stats) {
+  StatsCallbackMap::iterator it = pending_stats_callbacks_.find(request_id);
+  if (it == pending_stats_callbacks_.end())
+    return;
+
+  ExtensionStatsCallback callback = it->second;
+  pending_stats_callbacks_.erase(it);
+  callback.Run(make_scoped_ptr(stats.DeepCopy()));
+}
+
+void XWalkExtensionProcessHost::RunPendingChannelCallbacks() {
+  ChannelCallbackMap callbacks;
+  callbacks.swap(pending_channel_callbacks_);
+
+  ChannelCallbackMap::iterator it = callbacks.begin();
+  for (; it != callbacks.end(); ++it)
+    it->second.Run(IPC::ChannelHandle());
+}
+
+void XWalkExtensionProcessHost::RunPendingStatsCallbacks() {
+  StatsCallbackMap callbacks;
+  callbacks.swap(pending_stats_callbacks_);
+
+  StatsCallbackMap::iterator it = callbacks.begin();
+  for (; it != callbacks.end(); ++it)
+    it->second.Run(scoped_ptr<base::DictionaryValue>());
+}
+
+}  // namespace extensions
+}  // namespace xwalk
@@ -0,0 +1,90 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_BROWSER_XWALK_EXTENSION_PROCESS_HOST_H_
+#define XWALK_EXTENSIONS_BROWSER_XWALK_EXTENSION_PROCESS_HOST_H_
+
+#include <map>
+#include "base/callback.h"
+#include "base/files/file_path.h"
+#include "base/memory/scoped_ptr.h"
+#include "content/public/browser/browser_child_process_host_delegate.h"
+#include "ipc/ipc_channel_handle.h"
+
+namespace base {
+class DictionaryValue;
+}
+
+namespace content {
+class BrowserChildProcessHost;
+}
+
+namespace xwalk {
+namespace extensions {
+
+// Launches and talks to the extension process, where the external extensions
+// are loaded and run. A single extension process serves all the render
+// processes: it creates a channel for each of them to talk directly to it,
+// this class hands that channel over once it is ready.
+//
+// Except for the constructor, this class lives on the IO-thread and should be
+// destroyed there.
+class XWalkExtensionProcessHost
+    : public content::BrowserChildProcessHostDelegate {
+ public:
+  explicit XWalkExtensionProcessHost(const base::FilePath& extensions_path);
+  virtual ~XWalkExtensionProcessHost();
+
+  void StartProcess();
+
+  typedef base::Callback<void(const IPC::ChannelHandle& handle)>
+      ChannelHandleCallback;
+  // |callback| is called as soon as the extension process created the channel
+  // for the render process |render_process_id|, or with an empty handle if
+  // the process is gone.
+  void CreateRenderProcessChannel(int render_process_id,
+                                  const ChannelHandleCallback& callback);
+
+  // Lets the extension process destroy the instances of a render process that
+  // went away, along with its channel.
+  void CloseRenderProcessChannel(int render_process_id);
+
+  typedef base::Callback<void(scoped_ptr<base::DictionaryValue> stats)>
+      ExtensionStatsCallback;
+  // |callback| gets the stats of the extensions running in the extension
+  // process, see XWalkExtensionStatsRegistry::ToValue(), or NULL if the
+  // process is gone.
+  void GetExtensionStats(const ExtensionStatsCallback& callback);
+
+ private:
+  // content::BrowserChildProcessHostDelegate implementation.
+  virtual bool OnMessageReceived(const IPC::Message& message) OVERRIDE;
+  virtual void OnProcessCrashed(int exit_code) OVERRIDE;
+  virtual void OnChannelError() OVERRIDE;
+
+  void OnRenderProcessChannelCreated(int render_process_id,
+                                     const IPC::ChannelHandle& handle);
+  void OnExtensionStats(int request_id, const base::DictionaryValue& stats);
+  void RunPendingChannelCallbacks();
+  void RunPendingStatsCallbacks();
+
+  scoped_ptr<content::BrowserChildProcessHost> process_;
+  base::FilePath extensions_path_;
+
+  // Set once the extension process is gone, no channel can be created then.
+  bool process_gone_;
+  typedef std::map<int, ChannelHandleCallback> ChannelCallbackMap;
+  ChannelCallbackMap pending_channel_callbacks_;
+
+  int next_stats_request_id_;
+  typedef std::map<int, ExtensionStatsCallback> StatsCallbackMap;
+  StatsCallbackMap pending_stats_callbacks_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkExtensionProcessHost);
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_BROWSER_XWALK_EXTENSION_PROCESS_HOST_H_
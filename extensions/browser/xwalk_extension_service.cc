@@ -4,14 +4,19 @@
 
 #include "xwalk/extensions/browser/xwalk_extension_service.h"
 
+#include "base/bind.h"
 #include "base/callback.h"
 #include "base/command_line.h"
 #include "base/scoped_native_library.h"
+#include "base/values.h"
 #include "content/public/browser/browser_thread.h"
 #include "content/public/browser/notification_types.h"
 #include "content/public/browser/notification_service.h"
 #include "content/public/browser/render_process_host.h"
+#include "xwalk/extensions/browser/xwalk_extension_process_host.h"
+#include "xwalk/extensions/browser/xwalk_external_extension_watcher.h"
 #include "xwalk/extensions/common/xwalk_extension.h"
+#include "xwalk/extensions/common/xwalk_extension_messages.h"
 #include "xwalk/extensions/common/xwalk_extension_server.h"
 #include "xwalk/extensions/common/xwalk_extension_switches.h"
 
@@ -29,23 +34,68 @@ g_register_extensions_callback;
 
 // This object will be responsible for filtering messages on the
 // BrowserProcess <-> RenderProcess channel and getting them to the
-// in_process ExtensionServer.
+// in_process ExtensionServer. It also hands the render process the channel to
+// the extension process.
 class ExtensionServerMessageFilter : public IPC::ChannelProxy::MessageFilter {
  public:
   explicit ExtensionServerMessageFilter(XWalkExtensionServer* server);
 
+  // Sends |handle| to the render process, or keeps it until the filter is
+  // added to the channel. Nothing is sent if it is empty.
+  void SendExtensionProcessChannel(const IPC::ChannelHandle& handle);
+
   // IPC::ChannelProxy::MessageFilter Implementation.
+  virtual void OnFilterAdded(IPC::Channel* channel) OVERRIDE;
+  virtual void OnFilterRemoved() OVERRIDE;
+  virtual void OnChannelClosing() OVERRIDE;
   virtual bool OnMessageReceived(const IPC::Message& message) OVERRIDE;
 
  private:
   friend class IPC::ChannelProxy::MessageFilter;
   virtual ~ExtensionServerMessageFilter() {}
+
   XWalkExtensionServer* server_;
+  IPC::Channel* channel_;
+  bool is_closed_;
+  IPC::ChannelHandle pending_extension_process_channel_;
 };
 
 ExtensionServerMessageFilter::ExtensionServerMessageFilter(
     XWalkExtensionServer* server)
-    : server_(server) {
+    : server_(server),
+      channel_(NULL),
+      is_closed_(false) {
+}
+
+void ExtensionServerMessageFilter::SendExtensionProcessChannel(
+    const IPC::ChannelHandle& handle) {
+  if (handle.name.empty() || is_closed_)
+    return;
+
+  if (!channel_) {
+    pending_extension_process_channel_ = handle;
+    return;
+  }
+  channel_->Send(
+      new XWalkExtensionClientMsg_ExtensionProcessChannelCreated(handle));
+}
+
+void ExtensionServerMessageFilter::OnFilterAdded(IPC::Channel* channel) {
+  channel_ = channel;
+  if (!pending_extension_process_channel_.name.empty()) {
+    SendExtensionProcessChannel(pending_extension_process_channel_);
+    pending_extension_process_channel_ = IPC::ChannelHandle();
+  }
+}
+
+void ExtensionServerMessageFilter::OnFilterRemoved() {
+  channel_ = NULL;
+  is_closed_ = true;
+}
+
+void ExtensionServerMessageFilter::OnChannelClosing() {
+  channel_ = NULL;
+  is_closed_ = true;
 }
 
 bool ExtensionServerMessageFilter::OnMessageReceived(const IPC::Message& msg) {
@@ -53,60 +103,247 @@ bool ExtensionServerMessageFilter::OnMessageReceived(const IPC::Message& msg) {
 }
 
 
+XWalkExtensionService::RenderProcessExtensionData::RenderProcessExtensionData()
+    : in_process_server(NULL),
+      in_process_server_message_filter(NULL) {
+}
+
 XWalkExtensionService::XWalkExtensionService()
-    : render_process_host_(NULL),
-      in_process_server_message_filter_(NULL) {
+    : extension_process_enabled_(false),
+      extension_process_host_(NULL),
+      weak_factory_(this) {
   CommandLine* cmd_line = CommandLine::ForCurrentProcess();
   if (cmd_line->HasSwitch(switches::kXWalkEnableExtensionProcess)) {
+#if defined(OS_POSIX) && !defined(OS_ANDROID)
     VLOG(1) << "Extension process enabled.";
+    extension_process_enabled_ = true;
+#else
+    LOG(WARNING) << "Extension process is not supported in this platform.";
+#endif
   }
 
   registrar_.Add(this, content::NOTIFICATION_RENDERER_PROCESS_TERMINATED,
                  content::NotificationService::AllBrowserContextsAndSources());
+  registrar_.Add(this, content::NOTIFICATION_RENDERER_PROCESS_CLOSED,
+                 content::NotificationService::AllBrowserContextsAndSources());
+
+  // This object is created on the UI-thread but its deletion will happen on
+  // the IO-thread, after the servers using its extensions.
+  extensions_registry_.reset(new XWalkExtensionServer());
 
-  // This object is created on the UI-thread but it will live on the IO-thread.
-  // Its deletion will happen on the IO-thread.
-  in_process_extensions_server_.reset(new XWalkExtensionServer());
+  if (cmd_line->HasSwitch(switches::kXWalkExtensionScriptCacheDir)) {
+    extensions_registry_->EnableScriptDataPersistence(
+        cmd_line->GetSwitchValuePath(switches::kXWalkExtensionScriptCacheDir));
+  }
 
   if (!g_register_extensions_callback.is_null())
     g_register_extensions_callback.Run(this);
 }
 
 XWalkExtensionService::~XWalkExtensionService() {
+  RenderProcessDataMap::iterator it = render_process_data_.begin();
+  for (; it != render_process_data_.end(); ++it)
+    DeleteRenderProcessExtensionData(it->second);
+  render_process_data_.clear();
+
+  BrowserThread::DeleteSoon(BrowserThread::IO, FROM_HERE,
+                            extensions_registry_.release());
+
+  if (extension_process_host_) {
+    BrowserThread::DeleteSoon(BrowserThread::IO, FROM_HERE,
+                              extension_process_host_);
+  }
+
+  if (external_extension_watcher_) {
+    BrowserThread::DeleteSoon(BrowserThread::FILE, FROM_HERE,
+                              external_extension_watcher_.release());
+  }
 }
 
 bool XWalkExtensionService::RegisterExtension(
     scoped_ptr<XWalkExtension> extension) {
-  // Note: for now we only support registering new extensions before
-  // render process hosts were created.
-  CHECK(!render_process_host_);
-  return in_process_extensions_server_->RegisterExtension(extension.Pass());
+  XWalkExtension* shared_extension = extension.get();
+  if (!extensions_registry_->RegisterExtension(extension.Pass()))
+    return false;
+
+  // Render processes created from now on get the extension from the registry,
+  // the ones already running are told about it by their servers. The servers
+  // are deleted in the IO-thread after these tasks run.
+  RenderProcessDataMap::iterator it = render_process_data_.begin();
+  for (; it != render_process_data_.end(); ++it) {
+    BrowserThread::PostTask(BrowserThread::IO, FROM_HERE,
+        base::Bind(&XWalkExtensionServer::RegisterSharedExtension,
+                   base::Unretained(it->second.in_process_server),
+                   shared_extension));
+  }
+  return true;
+}
+
+bool XWalkExtensionService::UnregisterExtension(
+    const std::string& name, const base::Closure& drained_callback) {
+  scoped_ptr<XWalkExtension> extension =
+      extensions_registry_->UnregisterExtension(name);
+  if (!extension)
+    return false;
+
+  scoped_refptr<XWalkRetiredExtension> retired(
+      new XWalkRetiredExtension(extension.Pass(), drained_callback));
+  RenderProcessDataMap::iterator it = render_process_data_.begin();
+  for (; it != render_process_data_.end(); ++it) {
+    BrowserThread::PostTask(BrowserThread::IO, FROM_HERE,
+        base::Bind(&XWalkExtensionServer::RetireExtension,
+                   base::Unretained(it->second.in_process_server),
+                   retired));
+  }
+  return true;
+}
+
+void XWalkExtensionService::GetExtensionProcessStats(
+    const ExtensionStatsCallback& callback) {
+  // We live as long as the browser process, so this can't outlive us.
+  BrowserThread::PostTask(BrowserThread::UI, FROM_HERE,
+      base::Bind(&XWalkExtensionService::GetExtensionProcessStatsOnUIThread,
+                 base::Unretained(this), callback));
+}
+
+void XWalkExtensionService::GetExtensionProcessStatsOnUIThread(
+    const ExtensionStatsCallback& callback) {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::UI));
+  if (!extension_process_host_) {
+    callback.Run(scoped_ptr<base::DictionaryValue>());
+    return;
+  }
+
+  // The host is deleted in the IO-thread after this task runs.
+  BrowserThread::PostTask(BrowserThread::IO, FROM_HERE,
+      base::Bind(&XWalkExtensionProcessHost::GetExtensionStats,
+                 base::Unretained(extension_process_host_), callback));
 }
 
 void XWalkExtensionService::RegisterExternalExtensionsForPath(
     const base::FilePath& path) {
-  RegisterExternalExtensionsInDirectory(
-      in_process_extensions_server_.get(), path);
+  CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  bool watch = cmd_line->HasSwitch(switches::kXWalkWatchExternalExtensions);
+
+  if (extension_process_enabled_) {
+    LOG_IF(WARNING, watch) << "External extensions can't be watched when the"
+                           << " extension process is enabled.";
+    if (extension_process_host_) {
+      LOG(WARNING) << "The extension process was already started.";
+      return;
+    }
+    // A single extension process runs the external extensions for all the
+    // render processes. It is started right away so that it is ready by the
+    // time the first render process asks for its channel.
+    extension_process_host_ = new XWalkExtensionProcessHost(path);
+    BrowserThread::PostTask(BrowserThread::IO, FROM_HERE,
+        base::Bind(&XWalkExtensionProcessHost::StartProcess,
+                   base::Unretained(extension_process_host_)));
+    return;
+  }
+
+  RegisterExternalExtensionsInDirectory(extensions_registry_.get(), path,
+                                        &external_extensions_);
+
+  if (!watch || external_extension_watcher_)
+    return;
+
+  external_extension_watcher_.reset(
+      new XWalkExternalExtensionWatcher(path, weak_factory_.GetWeakPtr()));
+  BrowserThread::PostTask(BrowserThread::FILE, FROM_HERE,
+      base::Bind(&XWalkExternalExtensionWatcher::Start,
+                 base::Unretained(external_extension_watcher_.get())));
+}
+
+void XWalkExtensionService::OnExternalExtensionAdded(
+    const base::FilePath& path, scoped_ptr<XWalkExtension> extension) {
+  std::string name = extension->name();
+  if (RegisterExtension(extension.Pass()))
+    external_extensions_[path] = name;
+}
+
+void XWalkExtensionService::OnExternalExtensionRemoved(
+    const base::FilePath& path, const base::Closure& drained_callback) {
+  std::map<base::FilePath, std::string>::iterator it =
+      external_extensions_.find(path);
+  if (it == external_extensions_.end()) {
+    // The library didn't register any extension, nothing to wait for.
+    if (!drained_callback.is_null())
+      drained_callback.Run();
+    return;
+  }
+
+  if (!UnregisterExtension(it->second, drained_callback) &&
+      !drained_callback.is_null())
+    drained_callback.Run();
+  external_extensions_.erase(it);
 }
 
 void XWalkExtensionService::OnRenderProcessHostCreated(
     content::RenderProcessHost* host) {
-  // FIXME(cmarcelo): For now we support only one render process host.
-  if (render_process_host_)
+  if (render_process_data_.find(host->GetID()) != render_process_data_.end()) {
+    LOG(WARNING) << "Extensions were already set up for render process "
+                 << host->GetID();
     return;
+  }
+
+  RenderProcessExtensionData& data = render_process_data_[host->GetID()];
+  IPC::ChannelProxy* channel = host->GetChannel();
 
-  render_process_host_ = host;
+  data.in_process_server = new XWalkExtensionServer();
+  data.in_process_server->RegisterExtensionsFrom(*extensions_registry_);
 
-  IPC::ChannelProxy* channel = render_process_host_->GetChannel();
+  data.in_process_server_message_filter =
+      new ExtensionServerMessageFilter(data.in_process_server);
+  channel->AddFilter(data.in_process_server_message_filter);
+  data.in_process_server->Initialize(channel);
+
+  data.in_process_server->RegisterExtensionsInRenderProcess();
+
+  // The render process doesn't wait for the channel to the extension process,
+  // it is sent once created. Asking for it right away makes it ready before
+  // the render process loads any page, unless the extension process is still
+  // loading the external extensions.
+  if (extension_process_host_) {
+    XWalkExtensionProcessHost::ChannelHandleCallback send_channel = base::Bind(
+        &ExtensionServerMessageFilter::SendExtensionProcessChannel,
+        make_scoped_refptr(data.in_process_server_message_filter));
+    BrowserThread::PostTask(BrowserThread::IO, FROM_HERE,
+        base::Bind(&XWalkExtensionProcessHost::CreateRenderProcessChannel,
+                   base::Unretained(extension_process_host_), host->GetID(),
+                   send_channel));
+  }
+}
 
-  // The filter is owned by the IPC channel but we keep a reference to remove
-  // it from the Channel later during a RenderProcess shutdown.
-  in_process_server_message_filter_ =
-      new ExtensionServerMessageFilter(in_process_extensions_server_.get());
-  channel->AddFilter(in_process_server_message_filter_);
-  in_process_extensions_server_->Initialize(channel);
+void XWalkExtensionService::OnRenderProcessHostClosed(
+    content::RenderProcessHost* host) {
+  RenderProcessDataMap::iterator it = render_process_data_.find(host->GetID());
+  if (it == render_process_data_.end())
+    return;
+
+  // The channel may have already been reset for a process that crashed.
+  if (host->GetChannel()) {
+    host->GetChannel()->RemoveFilter(
+        it->second.in_process_server_message_filter);
+  }
+
+  DeleteRenderProcessExtensionData(it->second);
+  render_process_data_.erase(it);
+
+  if (extension_process_host_) {
+    BrowserThread::PostTask(BrowserThread::IO, FROM_HERE,
+        base::Bind(&XWalkExtensionProcessHost::CloseRenderProcessChannel,
+                   base::Unretained(extension_process_host_), host->GetID()));
+  }
+}
 
-  in_process_extensions_server_->RegisterExtensionsInRenderProcess();
+void XWalkExtensionService::DeleteRenderProcessExtensionData(
+    const RenderProcessExtensionData& data) {
+  // Invalidating the server here avoids it sending messages to the channel
+  // before it is destroyed on the IO-thread.
+  data.in_process_server->Invalidate();
+  BrowserThread::DeleteSoon(BrowserThread::IO, FROM_HERE,
+                            data.in_process_server);
 }
 
 // static
@@ -126,15 +363,7 @@ void XWalkExtensionService::Observe(int type,
     case content::NOTIFICATION_RENDERER_PROCESS_CLOSED: {
       content::RenderProcessHost* rph =
           content::Source<content::RenderProcessHost>(source).ptr();
-      if (rph == render_process_host_) {
-        in_process_extensions_server_->Invalidate();
-        render_process_host_->GetChannel()->RemoveFilter(
-            in_process_server_message_filter_);
-        BrowserThread::DeleteSoon(BrowserThread::IO, FROM_HERE,
-            in_process_extensions_server_.release());
-
-        in_process_server_message_filter_ = NULL;
-      }
+      OnRenderProcessHostClosed(rph);
     }
   }
 }
@@ -6,14 +6,17 @@
 #define XWALK_EXTENSIONS_BROWSER_XWALK_EXTENSION_SERVICE_H_
 
 #include <stdint.h>
+#include <map>
 #include <string>
 #include "base/callback_forward.h"
+#include "base/files/file_path.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
 #include "content/public/browser/notification_observer.h"
 #include "content/public/browser/notification_registrar.h"
 
 namespace base {
-class FilePath;
+class DictionaryValue;
 }
 
 namespace content {
@@ -26,7 +29,9 @@ namespace extensions {
 
 class ExtensionServerMessageFilter;
 class XWalkExtension;
+class XWalkExtensionProcessHost;
 class XWalkExtensionServer;
+class XWalkExternalExtensionWatcher;
 
 // This is the entry point for Crosswalk extensions. Its responsible for keeping
 // track of the extensions, and enable them on WebContents once they are
@@ -37,9 +42,20 @@ class XWalkExtensionService : public content::NotificationObserver {
   virtual ~XWalkExtensionService();
 
   // Returns false if it couldn't be registered because another one with the
-  // same name exists, otherwise returns true.
+  // same name exists, otherwise returns true. Extensions registered after
+  // render processes were created are made available to their new frames.
   bool RegisterExtension(scoped_ptr<XWalkExtension> extension);
 
+  // Removes the extension from the render processes, new frames won't get it.
+  // The instances already created keep running, once they are all gone the
+  // extension is deleted and |drained_callback|, if not null, is run in any
+  // thread. Returns false if there is no extension called |name|.
+  bool UnregisterExtension(const std::string& name,
+                           const base::Closure& drained_callback);
+
+  // When the extension process is enabled, the external extensions are
+  // loaded there instead of in the browser process. Otherwise |path| may be
+  // watched for changes, see switches::kXWalkWatchExternalExtensions.
   void RegisterExternalExtensionsForPath(const base::FilePath& path);
 
   // To be called when a new RenderProcessHost is created, will plug the
@@ -47,25 +63,76 @@ class XWalkExtensionService : public content::NotificationObserver {
   // XWalkContentBrowserClient::RenderProcessHostCreated().
   void OnRenderProcessHostCreated(content::RenderProcessHost* host);
 
+  typedef base::Callback<void(scoped_ptr<base::DictionaryValue> stats)>
+      ExtensionStatsCallback;
+  // Gets the stats of the extensions running in the extension process, the
+  // ones running here are in XWalkExtensionStatsRegistry. |callback| gets NULL
+  // if there is no extension process. Can be called from any thread, and
+  // |callback| may run in any thread.
+  void GetExtensionProcessStats(const ExtensionStatsCallback& callback);
+
   typedef base::Callback<void(XWalkExtensionService* extension_service)>
       RegisterExtensionsCallback;
   static void SetRegisterExtensionsCallbackForTesting(
       const RegisterExtensionsCallback& callback);
 
  private:
+  friend class XWalkExternalExtensionWatcher;
+
+  // Called by the watcher of the external extensions directory.
+  void OnExternalExtensionAdded(const base::FilePath& path,
+                                scoped_ptr<XWalkExtension> extension);
+  void OnExternalExtensionRemoved(const base::FilePath& path,
+                                  const base::Closure& drained_callback);
+
   // NotificationObserver implementation.
   virtual void Observe(int type, const content::NotificationSource& source,
                        const content::NotificationDetails& details) OVERRIDE;
 
-  // FIXME(cmarcelo): For now we support only one render process host.
-  content::RenderProcessHost* render_process_host_;
+  // Each render process gets its own server, so instances of different
+  // processes have independent lifetimes. All of them share the extensions
+  // registered in |extensions_registry_|.
+  struct RenderProcessExtensionData {
+    RenderProcessExtensionData();
+
+    // Lives on the IO-thread.
+    XWalkExtensionServer* in_process_server;
+
+    // The filter is owned by the IPC channel but we keep a reference to
+    // remove it from the channel later during a render process shutdown.
+    ExtensionServerMessageFilter* in_process_server_message_filter;
+  };
 
-  // This object lives on the IO-thread.
-  scoped_ptr<XWalkExtensionServer> in_process_extensions_server_;
-  ExtensionServerMessageFilter* in_process_server_message_filter_;
+  void OnRenderProcessHostClosed(content::RenderProcessHost* host);
+
+  // The extension process host is only set on the UI-thread.
+  void GetExtensionProcessStatsOnUIThread(
+      const ExtensionStatsCallback& callback);
+  void DeleteRenderProcessExtensionData(const RenderProcessExtensionData& data);
+
+  typedef std::map<int, RenderProcessExtensionData> RenderProcessDataMap;
+  RenderProcessDataMap render_process_data_;
+
+  // Holds the registered extensions. It isn't connected to any render process
+  // and is destroyed on the IO-thread after the servers sharing its
+  // extensions.
+  scoped_ptr<XWalkExtensionServer> extensions_registry_;
+
+  bool extension_process_enabled_;
+  // Only created if the extension process is enabled and there are external
+  // extensions. It serves all the render processes and lives on the
+  // IO-thread.
+  XWalkExtensionProcessHost* extension_process_host_;
+
+  // Names of the external extensions registered, keyed by library path.
+  std::map<base::FilePath, std::string> external_extensions_;
+  // Lives in the FILE thread.
+  scoped_ptr<XWalkExternalExtensionWatcher> external_extension_watcher_;
 
   content::NotificationRegistrar registrar_;
 
+  base::WeakPtrFactory<XWalkExtensionService> weak_factory_;
+
   DISALLOW_COPY_AND_ASSIGN(XWalkExtensionService);
 };
 
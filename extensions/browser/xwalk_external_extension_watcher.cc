@@ -0,0 +1,146 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/browser/xwalk_external_extension_watcher.h"
+
+#include <algorithm>
+#include "base/bind.h"
+#include "base/file_util.h"
+#include "base/files/file_enumerator.h"
+#include "content/public/browser/browser_thread.h"
+#include "xwalk/extensions/browser/xwalk_extension_service.h"
+#include "xwalk/extensions/common/xwalk_extension.h"
+#include "xwalk/extensions/common/xwalk_extension_server.h"
+
+using content::BrowserThread;
+
+namespace xwalk {
+namespace extensions {
+
+namespace {
+
+// Libraries are usually written in several steps, the directory is only
+// scanned once it has been quiet for this long.
+const int kScanDelayInMilliseconds = 1000;
+
+void PostToFileThread(const base::Closure& task) {
+  BrowserThread::PostTask(BrowserThread::FILE, FROM_HERE, task);
+}
+
+}  // namespace
+
+XWalkExternalExtensionWatcher::XWalkExternalExtensionWatcher(
+    const base::FilePath& dir,
+    base::WeakPtr<XWalkExtensionService> extension_service)
+    : dir_(dir),
+      extension_service_(extension_service),
+      weak_factory_(this) {
+}
+
+XWalkExternalExtensionWatcher::~XWalkExternalExtensionWatcher() {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::FILE));
+}
+
+void XWalkExternalExtensionWatcher::Start() {
+  DCHECK(BrowserThread::CurrentlyOn(BrowserThread::FILE));
+  known_libraries_ = ListLibraries();
+
+  if (!file_path_watcher_.Watch(
+          dir_, false,
+          base::Bind(&XWalkExternalExtensionWatcher::OnDirectoryChanged,
+                     weak_factory_.GetWeakPtr()))) {
+    LOG(WARNING) << "Couldn't watch external extensions directory "
+                 << dir_.AsUTF8Unsafe();
+  }
+}
+
+void XWalkExternalExtensionWatcher::OnDirectoryChanged(
+    const base::FilePath& path, bool error) {
+  if (error) {
+    LOG(WARNING) << "Error watching external extensions directory "
+                 << dir_.AsUTF8Unsafe();
+    return;
+  }
+
+  // Restarting the timer postpones the scan already scheduled.
+  scan_timer_.Start(FROM_HERE,
+                    base::TimeDelta::FromMilliseconds(kScanDelayInMilliseconds),
+                    this, &XWalkExternalExtensionWatcher::ScanDirectory);
+}
+
+void XWalkExternalExtensionWatcher::ScanDirectory() {
+  LibraryMap libraries = ListLibraries();
+
+  // Retire the extensions of libraries that were removed or replaced.
+  LibraryMap::iterator it = known_libraries_.begin();
+  while (it != known_libraries_.end()) {
+    LibraryMap::const_iterator current = libraries.find(it->first);
+    if (current != libraries.end() && current->second == it->second) {
+      ++it;
+      continue;
+    }
+
+    base::Closure drained_callback;
+    if (current != libraries.end()) {
+      retiring_libraries_.insert(it->first);
+      drained_callback = base::Bind(
+          &PostToFileThread,
+          base::Bind(&XWalkExternalExtensionWatcher::OnLibraryDrained,
+                     weak_factory_.GetWeakPtr(), it->first));
+    }
+
+    VLOG(1) << "Retiring external extension " << it->first.AsUTF8Unsafe();
+    BrowserThread::PostTask(BrowserThread::UI, FROM_HERE,
+        base::Bind(&XWalkExtensionService::OnExternalExtensionRemoved,
+                   extension_service_, it->first, drained_callback));
+    known_libraries_.erase(it++);
+  }
+
+  // Register the new ones. Libraries that fail to load are remembered too, so
+  // they are only tried again once modified.
+  for (it = libraries.begin(); it != libraries.end(); ++it) {
+    if (known_libraries_.count(it->first) ||
+        retiring_libraries_.count(it->first))
+      continue;
+
+    known_libraries_[it->first] = it->second;
+    scoped_ptr<XWalkExtension> extension = CreateExternalExtension(it->first);
+    if (!extension)
+      continue;
+
+    VLOG(1) << "Registering external extension " << it->first.AsUTF8Unsafe();
+    BrowserThread::PostTask(BrowserThread::UI, FROM_HERE,
+        base::Bind(&XWalkExtensionService::OnExternalExtensionAdded,
+                   extension_service_, it->first,
+                   base::Passed(&extension)));
+  }
+}
+
+void XWalkExternalExtensionWatcher::OnLibraryDrained(
+    const base::FilePath& path) {
+  retiring_libraries_.erase(path);
+  ScanDirectory();
+}
+
+XWalkExternalExtensionWatcher::LibraryMap
+XWalkExternalExtensionWatcher::ListLibraries() const {
+  LibraryMap libraries;
+  base::FileEnumerator enumerator(
+      dir_, false, base::FileEnumerator::FILES, FILE_PATH_LITERAL("*.so"));
+  for (base::FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    base::Time last_modified = enumerator.GetInfo().GetLastModifiedTime();
+
+    base::PlatformFileInfo descriptor_info;
+    if (file_util::GetFileInfo(path.ReplaceExtension(FILE_PATH_LITERAL("json")),
+                               &descriptor_info))
+      last_modified = std::max(last_modified, descriptor_info.last_modified);
+
+    libraries[path] = last_modified;
+  }
+  return libraries;
+}
+
+}  // namespace extensions
+}  // namespace xwalk
@@ -0,0 +1,67 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_BROWSER_XWALK_EXTERNAL_EXTENSION_WATCHER_H_
+#define XWALK_EXTENSIONS_BROWSER_XWALK_EXTERNAL_EXTENSION_WATCHER_H_
+
+#include <map>
+#include <set>
+#include "base/files/file_path.h"
+#include "base/files/file_path_watcher.h"
+#include "base/memory/weak_ptr.h"
+#include "base/time.h"
+#include "base/timer.h"
+
+namespace xwalk {
+namespace extensions {
+
+class XWalkExtensionService;
+
+// Watches the external extensions directory for libraries being added,
+// removed or replaced, and tells XWalkExtensionService to register or retire
+// the extensions accordingly. Libraries are loaded in the FILE thread, where
+// this object lives, the service is called in the UI thread.
+//
+// A replaced library is only loaded again once the instances created from the
+// old one are all gone, since the old library is still loaded until then.
+class XWalkExternalExtensionWatcher {
+ public:
+  XWalkExternalExtensionWatcher(
+      const base::FilePath& dir,
+      base::WeakPtr<XWalkExtensionService> extension_service);
+  ~XWalkExternalExtensionWatcher();
+
+  // Takes the libraries already in the directory as known, they should have
+  // been registered by the service, and starts watching it.
+  void Start();
+
+ private:
+  void OnDirectoryChanged(const base::FilePath& path, bool error);
+  void ScanDirectory();
+  void OnLibraryDrained(const base::FilePath& path);
+
+  // Libraries in the directory, with the last time they, or their descriptor,
+  // were modified.
+  typedef std::map<base::FilePath, base::Time> LibraryMap;
+  LibraryMap ListLibraries() const;
+
+  base::FilePath dir_;
+  base::WeakPtr<XWalkExtensionService> extension_service_;
+
+  base::FilePathWatcher file_path_watcher_;
+  base::OneShotTimer<XWalkExternalExtensionWatcher> scan_timer_;
+
+  LibraryMap known_libraries_;
+  // Replaced libraries waiting for the old extension to be drained.
+  std::set<base::FilePath> retiring_libraries_;
+
+  base::WeakPtrFactory<XWalkExternalExtensionWatcher> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkExternalExtensionWatcher);
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_BROWSER_XWALK_EXTERNAL_EXTENSION_WATCHER_H_
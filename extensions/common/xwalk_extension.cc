@@ -5,15 +5,27 @@
 #include "xwalk/extensions/common/xwalk_extension.h"
 
 #include "base/logging.h"
+#include "xwalk/extensions/common/xwalk_extension_serialized_value.h"
+#include "xwalk/extensions/common/xwalk_extension_stats.h"
 
 namespace xwalk {
 namespace extensions {
 
-XWalkExtension::XWalkExtension() {}
+XWalkExtension::XWalkExtension()
+    : message_batching_enabled_(false),
+      uses_dedicated_thread_(false) {}
 
 XWalkExtension::~XWalkExtension() {}
 
-XWalkExtensionInstance::XWalkExtensionInstance() {}
+void XWalkExtension::EnableMessageBatching(base::TimeDelta max_latency) {
+  DCHECK(max_latency >= base::TimeDelta());
+  message_batching_enabled_ = true;
+  message_batching_max_latency_ = max_latency;
+}
+
+XWalkExtensionInstance::XWalkExtensionInstance()
+    : always_account_messages_to_js_(false),
+      accounting_messages_to_js_(0) {}
 
 void XWalkExtensionInstance::SetPostMessageCallback(const
     XWalkExtension::PostMessageCallback& post_message) {
@@ -22,6 +34,61 @@ void XWalkExtensionInstance::SetPostMessageCallback(const
 
 XWalkExtensionInstance::~XWalkExtensionInstance() {}
 
+size_t XWalkExtensionInstance::OnMessagesToJSHandled(size_t count) {
+  bool drained;
+  size_t bytes = flow_control_.OnMessagesHandled(count, &drained);
+  if (drained)
+    HandleMessagesToJSDrained();
+  return bytes;
+}
+
+void XWalkExtensionInstance::SetMessagesToJSAcksCallback(
+    const base::Closure& callback, bool always) {
+  base::AutoLock lock(acks_lock_);
+  start_acks_callback_ = callback;
+  always_account_messages_to_js_ = always;
+  StartMessagesToJSAccountingIfNeeded();
+}
+
+void XWalkExtensionInstance::StartMessagesToJSAccountingIfNeeded() {
+  acks_lock_.AssertAcquired();
+  if (base::subtle::NoBarrier_Load(&accounting_messages_to_js_) ||
+      start_acks_callback_.is_null())
+    return;
+  if (!always_account_messages_to_js_ && !flow_control_.high_watermark())
+    return;
+
+  // The renderer must hear about the acks before any accounted message, or
+  // that message would never be acked and the queue would stay full.
+  start_acks_callback_.Run();
+  base::subtle::Release_Store(&accounting_messages_to_js_, 1);
+}
+
+void XWalkExtensionInstance::PostMessageToJS(scoped_ptr<base::Value> msg) {
+  // Sizing the message and acking it cost a walk of the value and an extra
+  // IPC, so it's only done when someone reads the accounting.
+  if (base::subtle::Acquire_Load(&accounting_messages_to_js_))
+    flow_control_.OnMessagePosted(XWalkExtensionStats::EstimateValueSize(*msg));
+  post_message_.Run(msg.Pass());
+}
+
+void XWalkExtensionInstance::SetMessageToJSWatermarks(size_t high_watermark,
+                                                      size_t low_watermark) {
+  flow_control_.SetWatermarks(high_watermark, low_watermark);
+
+  base::AutoLock lock(acks_lock_);
+  StartMessagesToJSAccountingIfNeeded();
+}
+
+bool XWalkExtensionInstance::CanPostMessageToJS() {
+  return !flow_control_.ShouldBlock();
+}
+
+void XWalkExtensionInstance::HandleSerializedMessage(
+    const XWalkSerializedValue& msg) {
+  HandleMessage(msg.ToValue());
+}
+
 scoped_ptr<base::Value> XWalkExtensionInstance::HandleSyncMessage(
     scoped_ptr<base::Value> msg) {
   LOG(FATAL) << "Sending sync message to extension which doesn't support it!";
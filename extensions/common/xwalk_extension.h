@@ -7,15 +7,20 @@
 
 #include <stdint.h>
 #include <string>
+#include "base/atomicops.h"
 #include "base/callback_forward.h"
 #include "base/callback.h"
+#include "base/synchronization/lock.h"
+#include "base/time.h"
 #include "base/values.h"
+#include "xwalk/extensions/common/xwalk_extension_flow_control.h"
 
 namespace xwalk {
 namespace extensions {
 
 class XWalkExtensionWrapper;
 class XWalkExtensionInstance;
+class XWalkSerializedValue;
 
 // Message exchanging interface to be implemented by Crosswalk extensions. This
 // is essentially a factory for XWalkExtensionInstance objects that will handle
@@ -41,9 +46,32 @@ class XWalkExtension {
 
   std::string name() const { return name_; }
 
+  bool message_batching_enabled() const { return message_batching_enabled_; }
+  base::TimeDelta message_batching_max_latency() const {
+    return message_batching_max_latency_;
+  }
+
+  bool uses_dedicated_thread() const { return uses_dedicated_thread_; }
+
  protected:
   void set_name(const std::string& name) { name_ = name; }
 
+  // By default messages posted by the instances are sent to the renderer right
+  // away. Extensions that post bursts of small messages, and don't mind the
+  // extra latency, can allow them to be batched together with other messages
+  // pending to the same renderer. Messages will be delayed at most by
+  // |max_latency|, a zero latency means they are sent at the end of the current
+  // task. Should be called before the extension is registered. External
+  // extensions use XW_MessageBatchingInterface_1 instead.
+  void EnableMessageBatching(base::TimeDelta max_latency);
+
+  // By default instances run as sequences on a small pool of threads shared by
+  // all extensions, so a handler that blocks for long holds one of the few
+  // threads every other instance needs. Extensions whose handlers block should
+  // ask for each of their instances to get a thread of its own instead. Only
+  // affects instances created afterwards.
+  void set_uses_dedicated_thread(bool value) { uses_dedicated_thread_ = value; }
+
  private:
   friend class XWalkExtensionWrapper;
   friend class XWalkExtensionInstance;
@@ -51,6 +79,11 @@ class XWalkExtension {
   // Name of extension, used for dispatching messages.
   std::string name_;
 
+  bool message_batching_enabled_;
+  base::TimeDelta message_batching_max_latency_;
+
+  bool uses_dedicated_thread_;
+
   DISALLOW_COPY_AND_ASSIGN(XWalkExtension);
 };
 
@@ -65,6 +98,12 @@ class XWalkExtensionInstance {
   // process.
   virtual void HandleMessage(scoped_ptr<base::Value> msg) = 0;
 
+  // Messages posted from JavaScript usually arrive serialized by the renderer,
+  // see XWalkSerializedValue, and are valid only during the call. Instances
+  // can override this to read them in place. The default implementation
+  // converts them to base::Value and calls HandleMessage().
+  virtual void HandleSerializedMessage(const XWalkSerializedValue& msg);
+
   // Allow to handle synchronous messages sent from JavaScript code. Renderer
   // will block until this function returns.
   virtual scoped_ptr<base::Value> HandleSyncMessage(
@@ -73,18 +112,51 @@ class XWalkExtensionInstance {
   void SetPostMessageCallback(
       const XWalkExtension::PostMessageCallback& post_message);
 
+  // Called by the runner when the renderer handled |count| more messages
+  // posted by this instance. Returns the bytes they amounted to.
+  size_t OnMessagesToJSHandled(size_t count);
+
+  // Messages posted to JS are only accounted, and acked by the renderer, once
+  // the instance sets watermarks, or right away when |always| is true. The
+  // runner calls this after creating the instance, |callback| is run once
+  // accounting starts, before the first accounted message is posted.
+  void SetMessagesToJSAcksCallback(const base::Closure& callback, bool always);
+
+  size_t queued_bytes_to_js() const { return flow_control_.queued_bytes(); }
+
  protected:
   explicit XWalkExtensionInstance();
 
   // Function to be used by extensions Instances to post messages back to
   // JavaScript in the renderer process. This function will take the ownership
-  // of the message.
-  void PostMessageToJS(scoped_ptr<base::Value> msg) {
-    post_message_.Run(msg.Pass());
-  }
+  // of the message. Thread-safe.
+  void PostMessageToJS(scoped_ptr<base::Value> msg);
+
+  // Messages posted to JS are queued until the renderer handles them. Once
+  // more than |high_watermark| bytes are queued CanPostMessageToJS() returns
+  // false, and HandleMessagesToJSDrained() is called when they are down to
+  // |low_watermark| again. PostMessageToJS() itself never blocks, it's up to
+  // the instance to stop producing. Disabled when |high_watermark| is zero,
+  // which is the default. Messages posted from other threads while the
+  // watermarks are first set may be left out of the accounting.
+  void SetMessageToJSWatermarks(size_t high_watermark, size_t low_watermark);
+  bool CanPostMessageToJS();
+
+  // Called in the extension thread.
+  virtual void HandleMessagesToJSDrained() {}
 
  private:
   XWalkExtension::PostMessageCallback post_message_;
+  XWalkExtensionFlowControl flow_control_;
+
+  void StartMessagesToJSAccountingIfNeeded();
+
+  // Guards the fields below, which are only touched when accounting may
+  // start. PostMessageToJS() just reads |accounting_messages_to_js_|.
+  base::Lock acks_lock_;
+  base::Closure start_acks_callback_;
+  bool always_account_messages_to_js_;
+  base::subtle::Atomic32 accounting_messages_to_js_;
 
   DISALLOW_COPY_AND_ASSIGN(XWalkExtensionInstance);
 };
@@ -0,0 +1,81 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_extension_flow_control.h"
+
+#include <algorithm>
+#include "base/logging.h"
+
+namespace xwalk {
+namespace extensions {
+
+XWalkExtensionFlowControl::XWalkExtensionFlowControl()
+    : queued_bytes_(0),
+      high_watermark_(0),
+      low_watermark_(0),
+      blocked_(false) {
+}
+
+XWalkExtensionFlowControl::~XWalkExtensionFlowControl() {
+}
+
+void XWalkExtensionFlowControl::SetWatermarks(size_t high_watermark,
+                                              size_t low_watermark) {
+  base::AutoLock lock(lock_);
+  high_watermark_ = high_watermark;
+  low_watermark_ = std::min(low_watermark, high_watermark);
+}
+
+void XWalkExtensionFlowControl::OnMessagePosted(size_t bytes) {
+  base::AutoLock lock(lock_);
+  message_sizes_.push_back(bytes);
+  queued_bytes_ += bytes;
+}
+
+size_t XWalkExtensionFlowControl::OnMessagesHandled(size_t count,
+                                                    bool* drained) {
+  base::AutoLock lock(lock_);
+  if (count > message_sizes_.size()) {
+    LOG(WARNING) << "Renderer handled more extension messages than posted.";
+    count = message_sizes_.size();
+  }
+
+  size_t bytes = 0;
+  for (size_t i = 0; i < count; ++i) {
+    bytes += message_sizes_.front();
+    message_sizes_.pop_front();
+  }
+  queued_bytes_ -= bytes;
+
+  *drained = blocked_ && queued_bytes_ <= low_watermark_;
+  if (*drained)
+    blocked_ = false;
+  return bytes;
+}
+
+bool XWalkExtensionFlowControl::ShouldBlock() {
+  base::AutoLock lock(lock_);
+  if (!high_watermark_ || queued_bytes_ <= high_watermark_)
+    return false;
+  blocked_ = true;
+  return true;
+}
+
+size_t XWalkExtensionFlowControl::queued_bytes() const {
+  base::AutoLock lock(lock_);
+  return queued_bytes_;
+}
+
+size_t XWalkExtensionFlowControl::high_watermark() const {
+  base::AutoLock lock(lock_);
+  return high_watermark_;
+}
+
+size_t XWalkExtensionFlowControl::low_watermark() const {
+  base::AutoLock lock(lock_);
+  return low_watermark_;
+}
+
+}  // namespace extensions
+}  // namespace xwalk
@@ -0,0 +1,63 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_FLOW_CONTROL_H_
+#define XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_FLOW_CONTROL_H_
+
+#include <deque>
+#include "base/basictypes.h"
+#include "base/synchronization/lock.h"
+
+namespace xwalk {
+namespace extensions {
+
+// Accounts the messages an instance posted to JS that the renderer didn't
+// handle yet. When the queued bytes go over the high watermark, the instance
+// should stop posting until they fall back to the low watermark, so a fast
+// producer can't pile up an unbounded amount of messages in the IPC channel
+// and in the render process. A zero high watermark disables flow control.
+// Instances only account their messages once they set watermarks or extension
+// stats are enabled, see XWalkExtensionInstance::SetMessagesToJSAcksCallback().
+//
+// All methods are thread-safe, since instances may post from any thread.
+class XWalkExtensionFlowControl {
+ public:
+  XWalkExtensionFlowControl();
+  ~XWalkExtensionFlowControl();
+
+  // |low_watermark| is clamped to |high_watermark|.
+  void SetWatermarks(size_t high_watermark, size_t low_watermark);
+
+  void OnMessagePosted(size_t bytes);
+
+  // Called when the renderer handled the |count| oldest messages not handled
+  // before. Returns the bytes they amounted to. |drained| is set when
+  // ShouldBlock() returned true since the last time it was set, and the
+  // queued bytes are now at or below the low watermark.
+  size_t OnMessagesHandled(size_t count, bool* drained);
+
+  // Returns true if the queued bytes are over the high watermark, in which
+  // case a drain will be reported once they go down.
+  bool ShouldBlock();
+
+  size_t queued_bytes() const;
+  size_t high_watermark() const;
+  size_t low_watermark() const;
+
+ private:
+  mutable base::Lock lock_;
+
+  std::deque<size_t> message_sizes_;
+  size_t queued_bytes_;
+  size_t high_watermark_;
+  size_t low_watermark_;
+  bool blocked_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkExtensionFlowControl);
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_FLOW_CONTROL_H_
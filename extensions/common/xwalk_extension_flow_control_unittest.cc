@@ -0,0 +1,77 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_extension_flow_control.h"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+using xwalk::extensions::XWalkExtensionFlowControl;
+
+TEST(XWalkExtensionFlowControlTest, DisabledByDefault) {
+  XWalkExtensionFlowControl flow_control;
+  flow_control.OnMessagePosted(1024 * 1024);
+  EXPECT_FALSE(flow_control.ShouldBlock());
+  EXPECT_EQ(1024u * 1024u, flow_control.queued_bytes());
+
+  bool drained;
+  EXPECT_EQ(1024u * 1024u, flow_control.OnMessagesHandled(1, &drained));
+  EXPECT_FALSE(drained);
+  EXPECT_EQ(0u, flow_control.queued_bytes());
+}
+
+TEST(XWalkExtensionFlowControlTest, HandledMessagesAreTakenInOrder) {
+  XWalkExtensionFlowControl flow_control;
+  flow_control.OnMessagePosted(10);
+  flow_control.OnMessagePosted(20);
+  flow_control.OnMessagePosted(30);
+
+  bool drained;
+  EXPECT_EQ(30u, flow_control.OnMessagesHandled(2, &drained));
+  EXPECT_EQ(30u, flow_control.queued_bytes());
+
+  // Acks for messages never posted are ignored.
+  EXPECT_EQ(30u, flow_control.OnMessagesHandled(5, &drained));
+  EXPECT_EQ(0u, flow_control.queued_bytes());
+}
+
+TEST(XWalkExtensionFlowControlTest, DrainIsReportedAtLowWatermark) {
+  XWalkExtensionFlowControl flow_control;
+  flow_control.SetWatermarks(100, 40);
+
+  for (int i = 0; i < 10; ++i)
+    flow_control.OnMessagePosted(10);
+  EXPECT_FALSE(flow_control.ShouldBlock());
+
+  flow_control.OnMessagePosted(10);
+  EXPECT_TRUE(flow_control.ShouldBlock());
+
+  bool drained;
+  flow_control.OnMessagesHandled(6, &drained);
+  EXPECT_FALSE(drained);
+  EXPECT_EQ(50u, flow_control.queued_bytes());
+
+  flow_control.OnMessagesHandled(1, &drained);
+  EXPECT_TRUE(drained);
+  EXPECT_FALSE(flow_control.ShouldBlock());
+
+  // Only reported once per blocking.
+  flow_control.OnMessagesHandled(1, &drained);
+  EXPECT_FALSE(drained);
+}
+
+TEST(XWalkExtensionFlowControlTest, NoDrainWithoutBlocking) {
+  XWalkExtensionFlowControl flow_control;
+  flow_control.SetWatermarks(100, 40);
+  flow_control.OnMessagePosted(200);
+
+  bool drained;
+  flow_control.OnMessagesHandled(1, &drained);
+  EXPECT_FALSE(drained);
+}
+
+TEST(XWalkExtensionFlowControlTest, LowWatermarkIsClamped) {
+  XWalkExtensionFlowControl flow_control;
+  flow_control.SetWatermarks(100, 400);
+  EXPECT_EQ(100u, flow_control.low_watermark());
+}
@@ -3,8 +3,13 @@
 // found in the LICENSE file.
 
 #include <stdint.h>
+#include <map>
 #include <string>
+#include <vector>
+#include "base/files/file_path.h"
+#include "base/shared_memory.h"
 #include "base/values.h"
+#include "ipc/ipc_channel_handle.h"
 #include "ipc/ipc_message_macros.h"
 
 // Note: it is safe to use numbers after LastIPCMsgStart since that limit
@@ -19,26 +24,143 @@ IPC_MESSAGE_CONTROL2(XWalkExtensionClientMsg_RegisterExtension,  // NOLINT(*)
                     std::string /* extension */,
                     std::string /* JS API code for extension */)
 
+// Sent when an extension is removed while the render process runs. Frames
+// created from then on don't get it, the instances already created keep
+// working until destroyed.
+IPC_MESSAGE_CONTROL1(XWalkExtensionClientMsg_UnregisterExtension,  // NOLINT(*)
+                    std::string /* extension */)
+
 
 IPC_MESSAGE_CONTROL2(XWalkExtensionServerMsg_CreateInstance,  // NOLINT(*)
                     int64_t /* instance id */,
                     std::string /* extension name */)
 
-IPC_MESSAGE_CONTROL2(XWalkExtensionServerMsg_PostMessageToNative,  // NOLINT(*)
+// Messages with priority are handled before the other async messages waiting
+// to be handled by the instance.
+IPC_MESSAGE_CONTROL3(XWalkExtensionServerMsg_PostMessageToNative,  // NOLINT(*)
                     int64_t /* instance id */,
-                    base::ListValue /* contents */)
+                    base::ListValue /* contents */,
+                    bool /* priority */)
+
+// Used instead of XWalkExtensionServerMsg_PostMessageToNative for messages
+// that could be serialized straight from the V8 values, the contents are in
+// the format read by XWalkSerializedValue.
+IPC_MESSAGE_CONTROL3(XWalkExtensionServerMsg_PostSerializedMessageToNative,  // NOLINT(*)
+                    int64_t /* instance id */,
+                    std::string /* contents */,
+                    bool /* priority */)
+
+// Used instead of XWalkExtensionServerMsg_PostMessageToNative for messages
+// that are big ArrayBuffers, the contents are transferred in a shared memory
+// buffer created by the render process.
+IPC_MESSAGE_CONTROL4(XWalkExtensionServerMsg_PostBinaryMessageToNative,  // NOLINT(*)
+                    int64_t /* instance id */,
+                    base::SharedMemoryHandle /* contents */,
+                    uint32 /* size of contents */,
+                    bool /* priority */)
 
 IPC_MESSAGE_CONTROL2(XWalkExtensionClientMsg_PostMessageToJS,  // NOLINT(*)
                     int64_t /* instance id */,
                     base::ListValue /* contents */)
 
+// Carries a batch of messages, possibly for different instances, that were
+// pending to be sent to the renderer. The message at a given index of the
+// contents is meant for the instance at the same index of the ids, and they
+// should be delivered in order.
+IPC_MESSAGE_CONTROL2(XWalkExtensionClientMsg_PostMessagesToJS,  // NOLINT(*)
+                    std::vector<int64_t> /* instance ids */,
+                    base::ListValue /* contents */)
+
+// Used instead of XWalkExtensionClientMsg_PostMessageToJS for big binary
+// messages, the contents are transferred in a shared memory buffer.
+IPC_MESSAGE_CONTROL3(XWalkExtensionClientMsg_PostBinaryMessageToJS,  // NOLINT(*)
+                    int64_t /* instance id */,
+                    base::SharedMemoryHandle /* contents */,
+                    uint32 /* size of contents */)
+
+// Sent when the server starts accounting the messages posted to JS by an
+// instance, because it set watermarks or extension stats are enabled. Only
+// the messages received after this one need to be acked.
+IPC_MESSAGE_CONTROL1(XWalkExtensionClientMsg_StartMessagesToJSAcks,  // NOLINT(*)
+                    int64_t /* instance id */)
+
+// Sent by the renderer once it handled messages posted to JS by an instance,
+// with the number of them. Acks are coalesced, so the count may cover several
+// messages. The server uses them for flow control.
+IPC_MESSAGE_CONTROL2(XWalkExtensionServerMsg_MessagesToJSHandled,  // NOLINT(*)
+                    int64_t /* instance id */,
+                    uint32 /* count */)
+
 IPC_SYNC_MESSAGE_CONTROL2_1(XWalkExtensionServerMsg_SendSyncMessageToNative,  // NOLINT(*)
                    int64_t /* instance id */,
                    base::ListValue /* input contents */,
                    base::ListValue /* output contents */)
 
+// Sent when persistence of the pre-compilation data of the JS API code is
+// enabled, with the entries created and stored by the browser, keyed by source
+// hash. Render processes never send data back to be stored.
+IPC_MESSAGE_CONTROL1(XWalkExtensionClientMsg_EnableScriptDataPersistence,  // NOLINT(*)
+                    std::map<std::string, std::string> /* entries */)
+
 IPC_MESSAGE_CONTROL1(XWalkExtensionServerMsg_DestroyInstance,  // NOLINT(*)
                    int64_t /* instance id */)
 
 IPC_MESSAGE_CONTROL1(XWalkExtensionClientMsg_InstanceDestroyed,  // NOLINT(*)
                    int64_t /* instance id */)
+
+#if defined(OS_POSIX)
+// Sent before the first sync message of an instance to get the slot used to
+// exchange them without going through IPC, see
+// XWalkExtensionSyncMessageSlot. The handles are invalid if it is not
+// available, and then sync messages keep using IPC.
+IPC_SYNC_MESSAGE_CONTROL1_2(XWalkExtensionServerMsg_CreateSyncMessageSlot,  // NOLINT(*)
+                   int64_t /* instance id */,
+                   base::SharedMemoryHandle /* slot memory */,
+                   base::FileDescriptor /* slot socket */)
+
+// Gets the reply of a sync message sent through the slot that didn't fit in
+// it.
+IPC_SYNC_MESSAGE_CONTROL1_1(XWalkExtensionServerMsg_GetOversizedSyncReply,  // NOLINT(*)
+                   int64_t /* instance id */,
+                   base::ListValue /* output contents */)
+#endif
+
+// Messages exchanged between the browser process and the extension process,
+// and the one used by the render process to get connected to the latter.
+const int XWalkExtensionProcessMsgStart = LastIPCMsgStart + 2;
+
+#undef IPC_MESSAGE_START
+#define IPC_MESSAGE_START XWalkExtensionProcessMsgStart
+
+IPC_MESSAGE_CONTROL1(XWalkExtensionProcessMsg_RegisterExtensions,  // NOLINT(*)
+                     base::FilePath /* extensions path */)
+
+// A single extension process serves all the render processes, each of them
+// talks to it through a channel of its own, created on request of the browser
+// process.
+IPC_MESSAGE_CONTROL1(XWalkExtensionProcessMsg_CreateRenderProcessChannel,  // NOLINT(*)
+                     int /* render process id */)
+
+IPC_MESSAGE_CONTROL1(XWalkExtensionProcessMsg_CloseRenderProcessChannel,  // NOLINT(*)
+                     int /* render process id */)
+
+IPC_MESSAGE_CONTROL2(  // NOLINT(*)
+    XWalkExtensionProcessHostMsg_RenderProcessChannelCreated,
+    int /* render process id */,
+    IPC::ChannelHandle /* channel id */)
+
+// The stats of the extensions running in the extension process, in the format
+// of XWalkExtensionStatsRegistry::ToValue(). They are empty unless the
+// process records them, see switches::kXWalkEnableExtensionStats.
+IPC_MESSAGE_CONTROL1(XWalkExtensionProcessMsg_GetExtensionStats,  // NOLINT(*)
+                     int /* request id */)
+
+IPC_MESSAGE_CONTROL2(XWalkExtensionProcessHostMsg_ExtensionStats,  // NOLINT(*)
+                     int /* request id */,
+                     base::DictionaryValue /* stats */)
+
+// Sent to the render process once its channel to the extension process is
+// created, it isn't sent if there is no extension process running.
+IPC_MESSAGE_CONTROL1(  // NOLINT(*)
+    XWalkExtensionClientMsg_ExtensionProcessChannelCreated,
+    IPC::ChannelHandle /* channel id */)
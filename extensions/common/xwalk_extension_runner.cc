@@ -4,6 +4,10 @@
 
 #include "xwalk/extensions/common/xwalk_extension_runner.h"
 
+#include "base/callback.h"
+#include "base/logging.h"
+#include "xwalk/extensions/common/xwalk_extension_serialized_value.h"
+
 namespace xwalk {
 namespace extensions {
 
@@ -11,19 +15,66 @@ XWalkExtensionRunner::XWalkExtensionRunner(const std::string& extension_name,
                                            Client* client, int64_t instance_id)
     : client_(client),
       extension_name_(extension_name),
-      instance_id_(instance_id) {}
+      instance_id_(instance_id),
+      stats_(XWalkExtensionStats::IsEnabled() ?
+             new XWalkExtensionInstanceStats(extension_name, instance_id) :
+             NULL) {}
 
 XWalkExtensionRunner::~XWalkExtensionRunner() {}
 
-void XWalkExtensionRunner::PostMessageToNative(scoped_ptr<base::Value> msg) {
-  HandleMessageFromClient(msg.Pass());
+void XWalkExtensionRunner::Destroy(const base::Closure& destroyed_callback) {
+  delete this;
+  if (!destroyed_callback.is_null())
+    destroyed_callback.Run();
+}
+
+void XWalkExtensionRunner::PostMessageToNative(
+    scoped_ptr<base::Value> msg, XWalkExtensionStats::Lane lane) {
+  if (stats_) {
+    stats_->RecordMessageToNative(XWalkExtensionStats::ASYNC_MESSAGE,
+                                  XWalkExtensionStats::EstimateValueSize(*msg));
+  }
+  HandleMessageFromClient(msg.Pass(), lane);
+}
+
+void XWalkExtensionRunner::PostSerializedMessageToNative(
+    scoped_ptr<std::string> msg, XWalkExtensionStats::Lane lane) {
+  if (stats_) {
+    stats_->RecordMessageToNative(XWalkExtensionStats::ASYNC_MESSAGE,
+                                  msg->size());
+  }
+  HandleSerializedMessageFromClient(msg.Pass(), lane);
 }
 
 void XWalkExtensionRunner::SendSyncMessageToNative(
     scoped_ptr<IPC::Message> ipc_reply, scoped_ptr<base::Value> msg) {
+  if (stats_) {
+    stats_->RecordMessageToNative(XWalkExtensionStats::SYNC_MESSAGE,
+                                  XWalkExtensionStats::EstimateValueSize(*msg));
+  }
   return HandleSyncMessageFromClient(ipc_reply.Pass(), msg.Pass());
 }
 
+void XWalkExtensionRunner::SendSyncMessageToNative(
+    scoped_ptr<base::Value> msg, const SyncReplyCallback& callback) {
+  if (stats_) {
+    stats_->RecordMessageToNative(XWalkExtensionStats::SYNC_MESSAGE,
+                                  XWalkExtensionStats::EstimateValueSize(*msg));
+  }
+  HandleSyncMessageFromClient(msg.Pass(), callback);
+}
+
+void XWalkExtensionRunner::HandleSerializedMessageFromClient(
+    scoped_ptr<std::string> msg, XWalkExtensionStats::Lane lane) {
+  XWalkSerializedValue value(msg->data(), msg->size());
+  if (!value.is_valid()) {
+    LOG(WARNING) << "Ignoring malformed message to extension "
+                 << extension_name_;
+    return;
+  }
+  HandleMessageFromClient(value.ToValue(), lane);
+}
+
 void XWalkExtensionRunner::PostMessageToClient(scoped_ptr<base::Value> msg) {
   client_->HandleMessageFromNative(this, msg.Pass());
 }
@@ -33,5 +84,9 @@ void XWalkExtensionRunner::PostReplyMessageToClient(
   client_->HandleReplyMessageFromNative(ipc_reply.Pass(), msg.Pass());
 }
 
+void XWalkExtensionRunner::StartMessagesToJSAcksInClient() {
+  client_->StartMessagesToJSAcks(this);
+}
+
 }  // namespace extensions
 }  // namespace xwalk
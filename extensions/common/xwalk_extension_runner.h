@@ -8,9 +8,11 @@
 #include <stdint.h>
 #include <string>
 #include "base/basictypes.h"
+#include "base/callback.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/values.h"
 #include "ipc/ipc_message.h"
+#include "xwalk/extensions/common/xwalk_extension_stats.h"
 
 namespace xwalk {
 namespace extensions {
@@ -34,6 +36,9 @@ class XWalkExtensionRunner {
         const XWalkExtensionRunner* runner, scoped_ptr<base::Value> msg) = 0;
     virtual void HandleReplyMessageFromNative(
         scoped_ptr<IPC::Message> ipc_reply, scoped_ptr<base::Value> msg) = 0;
+    // The messages posted by the runner from now on are accounted, and must
+    // be acked with AckMessagesToJS() once the renderer handles them.
+    virtual void StartMessagesToJSAcks(const XWalkExtensionRunner* runner) = 0;
    protected:
     virtual ~Client() {}
   };
@@ -42,27 +47,66 @@ class XWalkExtensionRunner {
       int64_t instance_id = -1);
   virtual ~XWalkExtensionRunner();
 
-  void PostMessageToNative(scoped_ptr<base::Value> msg);
+  // Destroys the runner and its extension context. Subclasses running the
+  // context in other threads may do it asynchronously, but the Client won't be
+  // called anymore after this returns. When not null, |destroyed_callback| is
+  // run once the context is gone, possibly in another thread.
+  virtual void Destroy(const base::Closure& destroyed_callback);
+
+  typedef base::Callback<void(scoped_ptr<base::Value>)> SyncReplyCallback;
+
+  // Messages posted in the priority lane are handled before the ones waiting
+  // in the normal lane, sync messages always go in the priority lane. The
+  // order is kept among the messages of each lane.
+  void PostMessageToNative(scoped_ptr<base::Value> msg,
+                           XWalkExtensionStats::Lane lane =
+                               XWalkExtensionStats::NORMAL_LANE);
+  // Same as above for a message serialized by the renderer, see
+  // XWalkSerializedValue. It is validated before reaching the context.
+  void PostSerializedMessageToNative(scoped_ptr<std::string> msg,
+                                     XWalkExtensionStats::Lane lane);
   void SendSyncMessageToNative(scoped_ptr<IPC::Message> ipc_reply,
                                 scoped_ptr<base::Value> msg);
+  // Instead of going back to the Client, the reply is given to |callback|,
+  // which may be run in any thread.
+  void SendSyncMessageToNative(scoped_ptr<base::Value> msg,
+                               const SyncReplyCallback& callback);
+
+  // Called when the renderer handled |count| more of the messages posted to
+  // it by the context, see XWalkExtensionInstance::SetMessageToJSWatermarks().
+  virtual void AckMessagesToJS(size_t count) = 0;
 
   std::string extension_name() const { return extension_name_; }
   int64_t instance_id() const { return instance_id_; }
 
+  // Messages to native are accounted here when they are received, subclasses
+  // should record when they get handled. NULL unless
+  // XWalkExtensionStats::IsEnabled().
+  XWalkExtensionInstanceStats* stats() const { return stats_.get(); }
+
  protected:
   void PostMessageToClient(scoped_ptr<base::Value> msg);
   void PostReplyMessageToClient(scoped_ptr<IPC::Message> ipc_reply,
                                 scoped_ptr<base::Value> msg);
+  void StartMessagesToJSAcksInClient();
 
-  virtual void HandleMessageFromClient(scoped_ptr<base::Value> msg) = 0;
+  virtual void HandleMessageFromClient(scoped_ptr<base::Value> msg,
+                                       XWalkExtensionStats::Lane lane) = 0;
+  // The default implementation converts the message to base::Value and calls
+  // HandleMessageFromClient().
+  virtual void HandleSerializedMessageFromClient(
+      scoped_ptr<std::string> msg, XWalkExtensionStats::Lane lane);
   virtual void HandleSyncMessageFromClient(scoped_ptr<IPC::Message> ipc_reply,
                                            scoped_ptr<base::Value> msg) = 0;
+  virtual void HandleSyncMessageFromClient(
+      scoped_ptr<base::Value> msg, const SyncReplyCallback& callback) = 0;
 
   Client* client_;
 
  private:
   std::string extension_name_;
   int64_t instance_id_;
+  scoped_ptr<XWalkExtensionInstanceStats> stats_;
   DISALLOW_COPY_AND_ASSIGN(XWalkExtensionRunner);
 };
 
@@ -0,0 +1,461 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_extension_serialized_value.h"
+
+#include <string.h>
+#include "base/logging.h"
+#include "base/values.h"
+
+namespace xwalk {
+namespace extensions {
+
+namespace {
+
+enum Tag {
+  TAG_UNDEFINED = 1,
+  TAG_NULL,
+  TAG_FALSE,
+  TAG_TRUE,
+  TAG_INTEGER,
+  TAG_DOUBLE,
+  TAG_STRING,
+  TAG_BINARY,
+  TAG_ARRAY,
+  TAG_OBJECT,
+};
+
+const size_t kSizeLength = sizeof(uint32_t);
+
+// Containers have their size and count written before the contents.
+const size_t kContainerHeaderLength = 2 * kSizeLength;
+
+size_t ReadSize(const char* data) {
+  uint32_t size;
+  memcpy(&size, data, kSizeLength);
+  return size;
+}
+
+// Reads a key, or the contents of a string, at the start of |data|. Returns
+// the number of bytes it takes, or 0 if it doesn't fit in |size|.
+size_t ReadSizedData(const char* data, size_t size, base::StringPiece* out) {
+  if (size < kSizeLength)
+    return 0;
+  size_t data_size = ReadSize(data);
+  if (size - kSizeLength < data_size)
+    return 0;
+  out->set(data + kSizeLength, data_size);
+  return kSizeLength + data_size;
+}
+
+}  // namespace
+
+const int XWalkSerializedValue::kMaxDepth;
+
+XWalkSerializedValueWriter::XWalkSerializedValueWriter(std::string* buffer)
+    : buffer_(buffer) {
+  DCHECK(buffer_);
+}
+
+XWalkSerializedValueWriter::~XWalkSerializedValueWriter() {}
+
+void XWalkSerializedValueWriter::WriteUndefined() {
+  WriteTag(TAG_UNDEFINED);
+}
+
+void XWalkSerializedValueWriter::WriteNull() {
+  WriteTag(TAG_NULL);
+}
+
+void XWalkSerializedValueWriter::WriteBoolean(bool value) {
+  WriteTag(value ? TAG_TRUE : TAG_FALSE);
+}
+
+void XWalkSerializedValueWriter::WriteInteger(int32_t value) {
+  WriteTag(TAG_INTEGER);
+  buffer_->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void XWalkSerializedValueWriter::WriteDouble(double value) {
+  WriteTag(TAG_DOUBLE);
+  buffer_->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void XWalkSerializedValueWriter::WriteString(const char* data, size_t size) {
+  WriteTag(TAG_STRING);
+  WriteSize(size);
+  buffer_->append(data, size);
+}
+
+void XWalkSerializedValueWriter::WriteBinary(const char* data, size_t size) {
+  WriteTag(TAG_BINARY);
+  WriteSize(size);
+  buffer_->append(data, size);
+}
+
+char* XWalkSerializedValueWriter::WriteStringInPlace(size_t size) {
+  WriteTag(TAG_STRING);
+  WriteSize(size);
+  size_t offset = buffer_->size();
+  buffer_->resize(offset + size);
+  return size ? &(*buffer_)[offset] : NULL;
+}
+
+size_t XWalkSerializedValueWriter::BeginArray() {
+  return BeginContainer(TAG_ARRAY);
+}
+
+void XWalkSerializedValueWriter::EndArray(size_t token, size_t count) {
+  EndContainer(token, count);
+}
+
+size_t XWalkSerializedValueWriter::BeginObject() {
+  return BeginContainer(TAG_OBJECT);
+}
+
+void XWalkSerializedValueWriter::WriteKey(const char* data, size_t size) {
+  WriteSize(size);
+  buffer_->append(data, size);
+}
+
+void XWalkSerializedValueWriter::EndObject(size_t token, size_t count) {
+  EndContainer(token, count);
+}
+
+void XWalkSerializedValueWriter::WriteValue(const base::Value& value) {
+  switch (value.GetType()) {
+    case base::Value::TYPE_NULL:
+      WriteNull();
+      return;
+    case base::Value::TYPE_BOOLEAN: {
+      bool boolean_value = false;
+      value.GetAsBoolean(&boolean_value);
+      WriteBoolean(boolean_value);
+      return;
+    }
+    case base::Value::TYPE_INTEGER: {
+      int int_value = 0;
+      value.GetAsInteger(&int_value);
+      WriteInteger(int_value);
+      return;
+    }
+    case base::Value::TYPE_DOUBLE: {
+      double double_value = 0;
+      value.GetAsDouble(&double_value);
+      WriteDouble(double_value);
+      return;
+    }
+    case base::Value::TYPE_STRING: {
+      std::string string_value;
+      value.GetAsString(&string_value);
+      WriteString(string_value.data(), string_value.size());
+      return;
+    }
+    case base::Value::TYPE_BINARY: {
+      const base::BinaryValue& binary_value =
+          static_cast<const base::BinaryValue&>(value);
+      WriteBinary(binary_value.GetBuffer(), binary_value.GetSize());
+      return;
+    }
+    case base::Value::TYPE_LIST: {
+      const base::ListValue& list_value =
+          static_cast<const base::ListValue&>(value);
+      size_t token = BeginArray();
+      for (base::ListValue::const_iterator it = list_value.begin();
+           it != list_value.end(); ++it)
+        WriteValue(**it);
+      EndArray(token, list_value.GetSize());
+      return;
+    }
+    case base::Value::TYPE_DICTIONARY: {
+      const base::DictionaryValue& dictionary_value =
+          static_cast<const base::DictionaryValue&>(value);
+      size_t token = BeginObject();
+      for (base::DictionaryValue::Iterator it(dictionary_value);
+           !it.IsAtEnd(); it.Advance()) {
+        WriteKey(it.key().data(), it.key().size());
+        WriteValue(it.value());
+      }
+      EndObject(token, dictionary_value.size());
+      return;
+    }
+  }
+  NOTREACHED();
+}
+
+void XWalkSerializedValueWriter::WriteTag(uint8_t tag) {
+  buffer_->push_back(static_cast<char>(tag));
+}
+
+void XWalkSerializedValueWriter::WriteSize(size_t size) {
+  CHECK_LE(size, static_cast<size_t>(kuint32max));
+  uint32_t size32 = static_cast<uint32_t>(size);
+  buffer_->append(reinterpret_cast<const char*>(&size32), sizeof(size32));
+}
+
+size_t XWalkSerializedValueWriter::BeginContainer(uint8_t tag) {
+  WriteTag(tag);
+  size_t token = buffer_->size();
+  buffer_->append(kContainerHeaderLength, '\0');
+  return token;
+}
+
+void XWalkSerializedValueWriter::EndContainer(size_t token, size_t count) {
+  size_t contents_size = buffer_->size() - token - kContainerHeaderLength;
+  CHECK_LE(contents_size, static_cast<size_t>(kuint32max));
+  CHECK_LE(count, static_cast<size_t>(kuint32max));
+  uint32_t header[2] = {
+    static_cast<uint32_t>(contents_size),
+    static_cast<uint32_t>(count)
+  };
+  memcpy(&(*buffer_)[token], header, sizeof(header));
+}
+
+XWalkSerializedValue::XWalkSerializedValue(const char* data, size_t size)
+    : type_(TYPE_INVALID),
+      data_(NULL),
+      size_(0),
+      count_(0),
+      boolean_value_(false) {
+  if (Parse(data, size) != size || !ValidateContents(0))
+    type_ = TYPE_INVALID;
+}
+
+XWalkSerializedValue::XWalkSerializedValue()
+    : type_(TYPE_INVALID),
+      data_(NULL),
+      size_(0),
+      count_(0),
+      boolean_value_(false) {}
+
+bool XWalkSerializedValue::GetAsBoolean(bool* out) const {
+  if (type_ != TYPE_BOOLEAN)
+    return false;
+  *out = boolean_value_;
+  return true;
+}
+
+bool XWalkSerializedValue::GetAsInteger(int* out) const {
+  if (type_ != TYPE_INTEGER)
+    return false;
+  int32_t value;
+  memcpy(&value, data_, sizeof(value));
+  *out = value;
+  return true;
+}
+
+bool XWalkSerializedValue::GetAsDouble(double* out) const {
+  if (type_ == TYPE_INTEGER) {
+    int value;
+    GetAsInteger(&value);
+    *out = value;
+    return true;
+  }
+  if (type_ != TYPE_DOUBLE)
+    return false;
+  memcpy(out, data_, sizeof(*out));
+  return true;
+}
+
+bool XWalkSerializedValue::GetAsString(base::StringPiece* out) const {
+  if (type_ != TYPE_STRING)
+    return false;
+  out->set(data_, size_);
+  return true;
+}
+
+bool XWalkSerializedValue::GetAsBinary(base::StringPiece* out) const {
+  if (type_ != TYPE_BINARY)
+    return false;
+  out->set(data_, size_);
+  return true;
+}
+
+XWalkSerializedValue XWalkSerializedValue::GetArrayHead(size_t count) const {
+  DCHECK_EQ(TYPE_ARRAY, type_);
+  DCHECK_LE(count, count_);
+
+  Iterator it(*this);
+  for (size_t i = 0; i < count; ++i)
+    it.Advance();
+
+  XWalkSerializedValue head(*this);
+  head.size_ = it.position_ - data_;
+  head.count_ = count;
+  return head;
+}
+
+scoped_ptr<base::Value> XWalkSerializedValue::ToValue() const {
+  switch (type_) {
+    case TYPE_INVALID:
+      NOTREACHED();
+      return scoped_ptr<base::Value>();
+    case TYPE_UNDEFINED:
+    case TYPE_NULL:
+      return scoped_ptr<base::Value>(base::Value::CreateNullValue());
+    case TYPE_BOOLEAN:
+      return scoped_ptr<base::Value>(
+          base::Value::CreateBooleanValue(boolean_value_));
+    case TYPE_INTEGER: {
+      int value;
+      GetAsInteger(&value);
+      return scoped_ptr<base::Value>(base::Value::CreateIntegerValue(value));
+    }
+    case TYPE_DOUBLE: {
+      double value;
+      GetAsDouble(&value);
+      return scoped_ptr<base::Value>(base::Value::CreateDoubleValue(value));
+    }
+    case TYPE_STRING:
+      return scoped_ptr<base::Value>(
+          new base::StringValue(std::string(data_, size_)));
+    case TYPE_BINARY:
+      return scoped_ptr<base::Value>(
+          base::BinaryValue::CreateWithCopiedBuffer(data_, size_));
+    case TYPE_ARRAY: {
+      scoped_ptr<base::ListValue> list(new base::ListValue);
+      for (Iterator it(*this); !it.IsAtEnd(); it.Advance())
+        list->Append(it.value().ToValue().release());
+      return list.PassAs<base::Value>();
+    }
+    case TYPE_OBJECT: {
+      scoped_ptr<base::DictionaryValue> dictionary(new base::DictionaryValue);
+      for (Iterator it(*this); !it.IsAtEnd(); it.Advance()) {
+        if (it.value().type() == TYPE_UNDEFINED)
+          continue;
+        dictionary->SetWithoutPathExpansion(it.key().as_string(),
+                                            it.value().ToValue().release());
+      }
+      return dictionary.PassAs<base::Value>();
+    }
+  }
+  NOTREACHED();
+  return scoped_ptr<base::Value>();
+}
+
+size_t XWalkSerializedValue::Parse(const char* data, size_t size) {
+  type_ = TYPE_INVALID;
+  count_ = 0;
+  if (size < 1)
+    return 0;
+
+  const char* contents = data + 1;
+  size_t available = size - 1;
+  size_t header_size = 0;
+  size_t contents_size = 0;
+  Type type = TYPE_INVALID;
+
+  switch (static_cast<uint8_t>(data[0])) {
+    case TAG_UNDEFINED:
+      type = TYPE_UNDEFINED;
+      break;
+    case TAG_NULL:
+      type = TYPE_NULL;
+      break;
+    case TAG_FALSE:
+    case TAG_TRUE:
+      type = TYPE_BOOLEAN;
+      boolean_value_ = data[0] == TAG_TRUE;
+      break;
+    case TAG_INTEGER:
+      type = TYPE_INTEGER;
+      contents_size = sizeof(int32_t);
+      break;
+    case TAG_DOUBLE:
+      type = TYPE_DOUBLE;
+      contents_size = sizeof(double);
+      break;
+    case TAG_STRING:
+    case TAG_BINARY:
+      type = data[0] == TAG_STRING ? TYPE_STRING : TYPE_BINARY;
+      header_size = kSizeLength;
+      if (available < header_size)
+        return 0;
+      contents_size = ReadSize(contents);
+      break;
+    case TAG_ARRAY:
+    case TAG_OBJECT:
+      type = data[0] == TAG_ARRAY ? TYPE_ARRAY : TYPE_OBJECT;
+      header_size = kContainerHeaderLength;
+      if (available < header_size)
+        return 0;
+      contents_size = ReadSize(contents);
+      count_ = ReadSize(contents + kSizeLength);
+      break;
+    default:
+      return 0;
+  }
+
+  if (available - header_size < contents_size) {
+    count_ = 0;
+    return 0;
+  }
+
+  type_ = type;
+  data_ = contents + header_size;
+  size_ = contents_size;
+  return 1 + header_size + contents_size;
+}
+
+bool XWalkSerializedValue::ValidateContents(int depth) const {
+  if (type_ != TYPE_ARRAY && type_ != TYPE_OBJECT)
+    return type_ != TYPE_INVALID;
+  if (depth >= kMaxDepth)
+    return false;
+
+  const char* position = data_;
+  size_t remaining = size_;
+  for (size_t i = 0; i < count_; ++i) {
+    if (type_ == TYPE_OBJECT) {
+      base::StringPiece key;
+      size_t key_size = ReadSizedData(position, remaining, &key);
+      if (!key_size)
+        return false;
+      position += key_size;
+      remaining -= key_size;
+    }
+
+    XWalkSerializedValue value;
+    size_t value_size = value.Parse(position, remaining);
+    if (!value_size || !value.ValidateContents(depth + 1))
+      return false;
+    position += value_size;
+    remaining -= value_size;
+  }
+  return remaining == 0;
+}
+
+XWalkSerializedValue::Iterator::Iterator(
+    const XWalkSerializedValue& container)
+    : has_keys_(container.type() == TYPE_OBJECT),
+      position_(container.data_),
+      remaining_(container.count_) {
+  DCHECK(container.type() == TYPE_ARRAY || container.type() == TYPE_OBJECT);
+  ReadCurrent();
+}
+
+XWalkSerializedValue::Iterator::~Iterator() {}
+
+void XWalkSerializedValue::Iterator::Advance() {
+  DCHECK(!IsAtEnd());
+  position_ = value_.data_ + value_.size_;
+  remaining_--;
+  ReadCurrent();
+}
+
+// The contents were validated when the outermost value was parsed, so sizes
+// don't need to be checked against the end of the container.
+void XWalkSerializedValue::Iterator::ReadCurrent() {
+  if (IsAtEnd())
+    return;
+
+  const char* position = position_;
+  if (has_keys_)
+    position += ReadSizedData(position, kuint32max, &key_);
+  value_.Parse(position, kuint32max);
+  DCHECK(value_.is_valid());
+}
+
+}  // namespace extensions
+}  // namespace xwalk
@@ -0,0 +1,177 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_SERIALIZED_VALUE_H_
+#define XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_SERIALIZED_VALUE_H_
+
+#include <stdint.h>
+#include <string>
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/strings/string_piece.h"
+
+namespace base {
+class Value;
+}
+
+namespace xwalk {
+namespace extensions {
+
+// Messages posted from JavaScript are written by the renderer in this compact
+// binary format straight from the V8 values, and read in place in the
+// extension thread, instead of building a base::Value tree on each side of
+// the IPC channel. Both ends always run the same build, so numbers are kept
+// in the host byte order.
+//
+// Each value starts with a one byte tag. Integers take 4 more bytes and
+// doubles 8. Strings, in UTF-8, and binary data are preceded by their size.
+// Arrays and objects are preceded by the size of their contents and the
+// number of elements or members, so readers can skip over them; object
+// members are a key, written like a string without its tag, and a value.
+class XWalkSerializedValueWriter {
+ public:
+  // Values are appended to |buffer|.
+  explicit XWalkSerializedValueWriter(std::string* buffer);
+  ~XWalkSerializedValueWriter();
+
+  void WriteUndefined();
+  void WriteNull();
+  void WriteBoolean(bool value);
+  void WriteInteger(int32_t value);
+  void WriteDouble(double value);
+  void WriteString(const char* data, size_t size);
+  void WriteBinary(const char* data, size_t size);
+
+  // Reserves a string of |size| bytes and returns where its contents should
+  // be written, to avoid copying them from a temporary buffer.
+  char* WriteStringInPlace(size_t size);
+
+  // The elements or members are written between these calls. Begin returns
+  // a token that should be given to End, with the number of them written.
+  size_t BeginArray();
+  void EndArray(size_t token, size_t count);
+  size_t BeginObject();
+  void WriteKey(const char* data, size_t size);
+  void EndObject(size_t token, size_t count);
+
+  // Writes |value|, used when a message was converted to base::Value already.
+  void WriteValue(const base::Value& value);
+
+ private:
+  void WriteTag(uint8_t tag);
+  void WriteSize(size_t size);
+  size_t BeginContainer(uint8_t tag);
+  void EndContainer(size_t token, size_t count);
+
+  std::string* buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkSerializedValueWriter);
+};
+
+// A view of a serialized value. It doesn't copy any data, so the buffer must
+// outlive it, and the views and string pieces obtained from it. Views can be
+// copied freely.
+class XWalkSerializedValue {
+ public:
+  enum Type {
+    TYPE_INVALID,
+    TYPE_UNDEFINED,
+    TYPE_NULL,
+    TYPE_BOOLEAN,
+    TYPE_INTEGER,
+    TYPE_DOUBLE,
+    TYPE_STRING,
+    TYPE_BINARY,
+    TYPE_ARRAY,
+    TYPE_OBJECT,
+  };
+
+  // Nesting deeper than this is rejected, so reading doesn't exhaust the
+  // stack.
+  static const int kMaxDepth = 100;
+
+  // Views the value in |data|, which should hold exactly one value. The whole
+  // value is validated, so it is of TYPE_INVALID if malformed, and the
+  // accessors of the view and of the ones obtained from it can trust the
+  // data.
+  XWalkSerializedValue(const char* data, size_t size);
+  XWalkSerializedValue();
+
+  Type type() const { return type_; }
+  bool is_valid() const { return type_ != TYPE_INVALID; }
+
+  // Return false if the value is not of the given type. Integers can be read
+  // as doubles too. Pieces point into the buffer.
+  bool GetAsBoolean(bool* out) const;
+  bool GetAsInteger(int* out) const;
+  bool GetAsDouble(double* out) const;
+  bool GetAsString(base::StringPiece* out) const;
+  bool GetAsBinary(base::StringPiece* out) const;
+
+  // Number of elements of an array or members of an object, zero for other
+  // types.
+  size_t GetSize() const { return count_; }
+
+  // Returns a view of the first |count| elements of an array.
+  XWalkSerializedValue GetArrayHead(size_t count) const;
+
+  // Converts to base::Value like content::V8ValueConverter converts the JS
+  // value it was written from: undefined becomes null in arrays and is left
+  // out of objects.
+  scoped_ptr<base::Value> ToValue() const;
+
+  class Iterator;
+
+ private:
+  // Parses the value at the start of |data|, without validating what is
+  // inside containers. Returns the number of bytes it takes, or 0 if the
+  // header doesn't fit in |size|.
+  size_t Parse(const char* data, size_t size);
+
+  // Checks the contents of arrays and objects, nested at |depth|.
+  bool ValidateContents(int depth) const;
+
+  Type type_;
+  // Contents of the value, without the tag and the sizes.
+  const char* data_;
+  size_t size_;
+  // For arrays and objects.
+  size_t count_;
+  bool boolean_value_;
+};
+
+// Goes through the elements of an array or the members of an object.
+//
+//   for (XWalkSerializedValue::Iterator it(value); !it.IsAtEnd();
+//        it.Advance()) {
+//     ... it.key() ... it.value() ...
+//   }
+class XWalkSerializedValue::Iterator {
+ public:
+  explicit Iterator(const XWalkSerializedValue& container);
+  ~Iterator();
+
+  bool IsAtEnd() const { return remaining_ == 0; }
+  void Advance();
+
+  // Empty for array elements.
+  const base::StringPiece& key() const { return key_; }
+  const XWalkSerializedValue& value() const { return value_; }
+
+ private:
+  friend class XWalkSerializedValue;
+
+  void ReadCurrent();
+
+  bool has_keys_;
+  const char* position_;
+  size_t remaining_;
+  base::StringPiece key_;
+  XWalkSerializedValue value_;
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_SERIALIZED_VALUE_H_
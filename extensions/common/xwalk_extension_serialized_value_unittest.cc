@@ -0,0 +1,182 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_extension_serialized_value.h"
+
+#include <string.h>
+#include <string>
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using xwalk::extensions::XWalkSerializedValue;
+using xwalk::extensions::XWalkSerializedValueWriter;
+
+namespace {
+
+scoped_ptr<base::Value> CreateTestValue() {
+  scoped_ptr<base::DictionaryValue> nested(new base::DictionaryValue);
+  nested->SetString("name", "crosswalk");
+  nested->Set("nothing", base::Value::CreateNullValue());
+
+  scoped_ptr<base::ListValue> list(new base::ListValue);
+  list->AppendInteger(-7);
+  list->Append(base::Value::CreateDoubleValue(0.5));
+  list->Append(base::Value::CreateBooleanValue(true));
+  list->AppendString(std::string("with\0nul", 8));
+  list->Append(base::BinaryValue::CreateWithCopiedBuffer("\x01\x02\x03", 3));
+  list->Append(nested.release());
+  list->Append(new base::ListValue);
+  return list.PassAs<base::Value>();
+}
+
+}  // namespace
+
+TEST(XWalkSerializedValueTest, RoundTripsValues) {
+  scoped_ptr<base::Value> value = CreateTestValue();
+  std::string buffer;
+  XWalkSerializedValueWriter(&buffer).WriteValue(*value);
+
+  XWalkSerializedValue serialized(buffer.data(), buffer.size());
+  ASSERT_TRUE(serialized.is_valid());
+  EXPECT_EQ(XWalkSerializedValue::TYPE_ARRAY, serialized.type());
+  EXPECT_EQ(7u, serialized.GetSize());
+
+  scoped_ptr<base::Value> result = serialized.ToValue();
+  ASSERT_TRUE(result);
+  EXPECT_TRUE(value->Equals(result.get()));
+}
+
+TEST(XWalkSerializedValueTest, ReadsInPlace) {
+  std::string buffer;
+  XWalkSerializedValueWriter writer(&buffer);
+  size_t token = writer.BeginObject();
+  writer.WriteKey("text", 4);
+  char* text = writer.WriteStringInPlace(5);
+  memcpy(text, "hello", 5);
+  writer.WriteKey("count", 5);
+  writer.WriteInteger(42);
+  writer.EndObject(token, 2);
+
+  XWalkSerializedValue serialized(buffer.data(), buffer.size());
+  ASSERT_EQ(XWalkSerializedValue::TYPE_OBJECT, serialized.type());
+
+  XWalkSerializedValue::Iterator it(serialized);
+  ASSERT_FALSE(it.IsAtEnd());
+  EXPECT_EQ("text", it.key());
+  base::StringPiece string_value;
+  ASSERT_TRUE(it.value().GetAsString(&string_value));
+  EXPECT_EQ("hello", string_value);
+  // The piece points into the buffer, nothing was copied.
+  EXPECT_GE(string_value.data(), buffer.data());
+  EXPECT_LT(string_value.data(), buffer.data() + buffer.size());
+
+  it.Advance();
+  ASSERT_FALSE(it.IsAtEnd());
+  EXPECT_EQ("count", it.key());
+  int int_value;
+  ASSERT_TRUE(it.value().GetAsInteger(&int_value));
+  EXPECT_EQ(42, int_value);
+  double double_value;
+  ASSERT_TRUE(it.value().GetAsDouble(&double_value));
+  EXPECT_EQ(42, double_value);
+  EXPECT_FALSE(it.value().GetAsString(&string_value));
+
+  it.Advance();
+  EXPECT_TRUE(it.IsAtEnd());
+}
+
+TEST(XWalkSerializedValueTest, UndefinedIsConvertedLikeJSON) {
+  std::string buffer;
+  XWalkSerializedValueWriter writer(&buffer);
+  size_t array_token = writer.BeginArray();
+  writer.WriteUndefined();
+  size_t object_token = writer.BeginObject();
+  writer.WriteKey("gone", 4);
+  writer.WriteUndefined();
+  writer.EndObject(object_token, 1);
+  writer.EndArray(array_token, 2);
+
+  XWalkSerializedValue serialized(buffer.data(), buffer.size());
+  ASSERT_TRUE(serialized.is_valid());
+  scoped_ptr<base::Value> result = serialized.ToValue();
+
+  base::ListValue expected;
+  expected.Append(base::Value::CreateNullValue());
+  expected.Append(new base::DictionaryValue);
+  EXPECT_TRUE(expected.Equals(result.get()));
+}
+
+TEST(XWalkSerializedValueTest, GetArrayHead) {
+  base::ListValue list;
+  list.AppendString("argument");
+  list.AppendInteger(1);
+  list.AppendInteger(2);
+  std::string buffer;
+  XWalkSerializedValueWriter(&buffer).WriteValue(list);
+
+  XWalkSerializedValue serialized(buffer.data(), buffer.size());
+  XWalkSerializedValue head = serialized.GetArrayHead(1);
+  EXPECT_EQ(1u, head.GetSize());
+
+  scoped_ptr<base::Value> result = head.ToValue();
+  base::ListValue expected;
+  expected.AppendString("argument");
+  EXPECT_TRUE(expected.Equals(result.get()));
+
+  EXPECT_EQ(0u, serialized.GetArrayHead(0).GetSize());
+  EXPECT_EQ(3u, serialized.GetArrayHead(3).GetSize());
+}
+
+TEST(XWalkSerializedValueTest, RejectsMalformedData) {
+  scoped_ptr<base::Value> value = CreateTestValue();
+  std::string buffer;
+  XWalkSerializedValueWriter(&buffer).WriteValue(*value);
+
+  for (size_t size = 0; size < buffer.size(); ++size) {
+    XWalkSerializedValue truncated(buffer.data(), size);
+    EXPECT_FALSE(truncated.is_valid()) << "Size " << size;
+  }
+
+  std::string trailing_data = buffer + '\x02';
+  EXPECT_FALSE(
+      XWalkSerializedValue(trailing_data.data(), trailing_data.size())
+          .is_valid());
+
+  std::string unknown_tag(1, '\x7f');
+  EXPECT_FALSE(
+      XWalkSerializedValue(unknown_tag.data(), unknown_tag.size())
+          .is_valid());
+
+  // An array claiming more elements than it holds.
+  std::string wrong_count;
+  XWalkSerializedValueWriter writer(&wrong_count);
+  size_t token = writer.BeginArray();
+  writer.WriteNull();
+  writer.EndArray(token, 2);
+  EXPECT_FALSE(
+      XWalkSerializedValue(wrong_count.data(), wrong_count.size()).is_valid());
+}
+
+TEST(XWalkSerializedValueTest, RejectsDeepNesting) {
+  std::string buffer;
+  XWalkSerializedValueWriter writer(&buffer);
+  size_t tokens[XWalkSerializedValue::kMaxDepth + 1];
+  for (int i = 0; i <= XWalkSerializedValue::kMaxDepth; ++i)
+    tokens[i] = writer.BeginArray();
+  for (int i = XWalkSerializedValue::kMaxDepth; i >= 0; --i)
+    writer.EndArray(tokens[i], i == XWalkSerializedValue::kMaxDepth ? 0 : 1);
+  EXPECT_FALSE(XWalkSerializedValue(buffer.data(), buffer.size()).is_valid());
+
+  // One level less is fine.
+  std::string shallower;
+  XWalkSerializedValueWriter shallower_writer(&shallower);
+  for (int i = 0; i < XWalkSerializedValue::kMaxDepth; ++i)
+    tokens[i] = shallower_writer.BeginArray();
+  for (int i = XWalkSerializedValue::kMaxDepth - 1; i >= 0; --i) {
+    shallower_writer.EndArray(
+        tokens[i], i == XWalkSerializedValue::kMaxDepth - 1 ? 0 : 1);
+  }
+  EXPECT_TRUE(
+      XWalkSerializedValue(shallower.data(), shallower.size()).is_valid());
+}
@@ -4,35 +4,196 @@
 
 #include "xwalk/extensions/common/xwalk_extension_server.h"
 
+#if defined(OS_POSIX)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <set>
+
+#include "base/bind.h"
 #include "base/file_util.h"
 #include "base/files/file_enumerator.h"
 #include "base/files/file_path.h"
+#include "base/json/json_reader.h"
+#include "base/message_loop/message_loop.h"
+#include "base/message_loop/message_loop_proxy.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/process_util.h"
+#include "base/shared_memory.h"
+#include "base/stl_util.h"
+#include "base/synchronization/lock.h"
+#include "base/values.h"
 #include "content/public/browser/render_process_host.h"
 #include "ipc/ipc_sender.h"
 #include "xwalk/extensions/common/xwalk_extension.h"
 #include "xwalk/extensions/common/xwalk_extension_external.h"
 #include "xwalk/extensions/common/xwalk_extension_messages.h"
+#include "xwalk/extensions/common/xwalk_extension_sync_message_slot.h"
 #include "xwalk/extensions/common/xwalk_extension_threaded_runner.h"
+#include "xwalk/extensions/common/xwalk_script_data_store.h"
 #include "xwalk/extensions/common/xwalk_external_extension.h"
 
 namespace xwalk {
 namespace extensions {
 
+#if defined(OS_POSIX)
+// Watches the socket of a slot for sync message requests. Requests are only
+// dispatched after all the async messages the render process posted before
+// them were received through IPC, so they reach the runner in the same order.
+class XWalkExtensionServer::SyncMessageSlotHost
+    : public base::MessageLoopForIO::Watcher {
+ public:
+  SyncMessageSlotHost(XWalkExtensionServer* server, int64_t instance_id,
+                      scoped_refptr<XWalkExtensionSyncMessageSlot> slot)
+      : server_(server),
+        instance_id_(instance_id),
+        slot_(slot),
+        async_messages_received_(0),
+        has_pending_request_(false),
+        pending_request_async_messages_(0) {}
+
+  virtual ~SyncMessageSlotHost() {}
+
+  bool StartWatching() {
+    return base::MessageLoopForIO::current()->WatchFileDescriptor(
+        slot_->socket(), true, base::MessageLoopForIO::WATCH_READ,
+        &watcher_, this);
+  }
+
+  void OnAsyncMessageReceived() {
+    async_messages_received_++;
+    if (has_pending_request_ &&
+        async_messages_received_ >= pending_request_async_messages_)
+      DispatchPendingRequest();
+  }
+
+  void SetOversizedReply(scoped_ptr<base::Value> reply) {
+    oversized_reply_ = reply.Pass();
+    slot_->SendReply(XWalkExtensionSyncMessageSlot::REPLY_TOO_LARGE);
+  }
+
+  scoped_ptr<base::Value> TakeOversizedReply() {
+    return oversized_reply_.Pass();
+  }
+
+  // base::MessageLoopForIO::Watcher implementation.
+  virtual void OnFileCanReadWithoutBlocking(int fd) OVERRIDE {
+    uint64_t async_messages_before;
+    bool closed;
+    while (slot_->ReadRequest(&async_messages_before, &closed)) {
+      if (has_pending_request_) {
+        LOG(WARNING) << "Ignoring sync message sent while another one is"
+                     << " pending for instance id: " << instance_id_;
+        continue;
+      }
+      has_pending_request_ = true;
+      pending_request_async_messages_ = async_messages_before;
+      if (async_messages_received_ >= pending_request_async_messages_)
+        DispatchPendingRequest();
+    }
+
+    if (closed)
+      watcher_.StopWatchingFileDescriptor();
+  }
+
+  virtual void OnFileCanWriteWithoutBlocking(int fd) OVERRIDE {}
+
+ private:
+  void DispatchPendingRequest() {
+    has_pending_request_ = false;
+
+    scoped_ptr<base::Value> msg(slot_->ReadValue());
+    if (!msg) {
+      LOG(WARNING) << "Ignoring invalid sync message for instance id: "
+                   << instance_id_;
+      msg.reset(base::Value::CreateNullValue());
+    }
+    server_->HandleSyncMessageFromSlot(instance_id_, msg.Pass(), slot_);
+  }
+
+  XWalkExtensionServer* server_;
+  int64_t instance_id_;
+  scoped_refptr<XWalkExtensionSyncMessageSlot> slot_;
+  base::MessageLoopForIO::FileDescriptorWatcher watcher_;
+
+  uint64_t async_messages_received_;
+  bool has_pending_request_;
+  uint64_t pending_request_async_messages_;
+
+  scoped_ptr<base::Value> oversized_reply_;
+
+  DISALLOW_COPY_AND_ASSIGN(SyncMessageSlotHost);
+};
+#endif
+
+XWalkRetiredExtension::XWalkRetiredExtension(
+    scoped_ptr<XWalkExtension> extension,
+    const base::Closure& drained_callback)
+    : extension_(extension.Pass()),
+      drained_callback_(drained_callback) {
+  name_ = extension_->name();
+}
+
+XWalkRetiredExtension::~XWalkRetiredExtension() {
+  extension_.reset();
+  if (!drained_callback_.is_null())
+    drained_callback_.Run();
+}
+
+class XWalkExtensionServer::OwnedExtensions
+    : public base::RefCountedThreadSafe<OwnedExtensions> {
+ public:
+  OwnedExtensions() {}
+
+  void Add(XWalkExtension* extension) {
+    base::AutoLock lock(lock_);
+    extensions_.insert(extension);
+  }
+
+  // Gives the ownership of |extension| back to the caller.
+  void Remove(XWalkExtension* extension) {
+    base::AutoLock lock(lock_);
+    extensions_.erase(extension);
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<OwnedExtensions>;
+
+  // May happen in any thread, e.g. the extension thread of the last context
+  // of the extensions.
+  ~OwnedExtensions() {
+    STLDeleteElements(&extensions_);
+  }
+
+  base::Lock lock_;
+  std::set<XWalkExtension*> extensions_;
+
+  DISALLOW_COPY_AND_ASSIGN(OwnedExtensions);
+};
+
 XWalkExtensionServer::XWalkExtensionServer()
-    : sender_(0) {
+    : sender_(0),
+      owns_extensions_(true),
+      owned_extensions_(new OwnedExtensions),
+      weak_factory_(this) {
 }
 
 XWalkExtensionServer::~XWalkExtensionServer() {
   if (!runners_.empty())
     LOG(WARNING) << "XWalkExtensionServer DTOR: RunnerMap is not empty!";
 
+#if defined(OS_POSIX)
+  SyncMessageSlotHostMap::iterator it_slot = sync_message_slot_hosts_.begin();
+  for (; it_slot != sync_message_slot_hosts_.end(); ++it_slot)
+    delete it_slot->second;
+  sync_message_slot_hosts_.clear();
+#endif
+
+  // This doesn't wait for the contexts, they keep the extensions alive.
   RunnerMap::iterator it_runner = runners_.begin();
   for (; it_runner != runners_.end(); ++it_runner)
-    delete it_runner->second;
-
-  ExtensionMap::iterator it = extensions_.begin();
-  for (; it != extensions_.end(); ++it)
-    delete it->second;
+    DestroyRunner(it_runner->second);
+  runners_.clear();
 }
 
 bool XWalkExtensionServer::OnMessageReceived(const IPC::Message& message) {
@@ -44,9 +205,21 @@ bool XWalkExtensionServer::OnMessageReceived(const IPC::Message& message) {
         OnDestroyInstance)
     IPC_MESSAGE_HANDLER(XWalkExtensionServerMsg_PostMessageToNative,
         OnPostMessageToNative)
+    IPC_MESSAGE_HANDLER(XWalkExtensionServerMsg_PostSerializedMessageToNative,
+        OnPostSerializedMessageToNative)
+    IPC_MESSAGE_HANDLER(XWalkExtensionServerMsg_PostBinaryMessageToNative,
+        OnPostBinaryMessageToNative)
+    IPC_MESSAGE_HANDLER(XWalkExtensionServerMsg_MessagesToJSHandled,
+        OnMessagesToJSHandled)
     IPC_MESSAGE_HANDLER_DELAY_REPLY(
         XWalkExtensionServerMsg_SendSyncMessageToNative,
         OnSendSyncMessageToNative)
+#if defined(OS_POSIX)
+    IPC_MESSAGE_HANDLER(XWalkExtensionServerMsg_CreateSyncMessageSlot,
+        OnCreateSyncMessageSlot)
+    IPC_MESSAGE_HANDLER(XWalkExtensionServerMsg_GetOversizedSyncReply,
+        OnGetOversizedSyncReply)
+#endif
     IPC_MESSAGE_UNHANDLED(handled = false)
   IPC_END_MESSAGE_MAP()
 
@@ -70,7 +243,7 @@ void XWalkExtensionServer::OnCreateInstance(int64_t instance_id,
 }
 
 void XWalkExtensionServer::OnPostMessageToNative(int64_t instance_id,
-    const base::ListValue& msg) {
+    const base::ListValue& msg, bool priority) {
   RunnerMap::const_iterator it = runners_.find(instance_id);
   if (it == runners_.end()) {
     LOG(WARNING) << "Can't PostMessage to invalid Extension instance id: "
@@ -86,7 +259,103 @@ void XWalkExtensionServer::OnPostMessageToNative(int64_t instance_id,
   // can be costly depending on the size of Value.
   base::Value* value;
   const_cast<base::ListValue*>(&msg)->Remove(0, &value);
-  (it->second)->PostMessageToNative(scoped_ptr<base::Value>(value));
+  (it->second)->PostMessageToNative(scoped_ptr<base::Value>(value),
+      priority ? XWalkExtensionStats::PRIORITY_LANE :
+                 XWalkExtensionStats::NORMAL_LANE);
+  OnAsyncMessagePosted(instance_id);
+}
+
+void XWalkExtensionServer::OnPostSerializedMessageToNative(
+    int64_t instance_id, const std::string& msg, bool priority) {
+  RunnerMap::const_iterator it = runners_.find(instance_id);
+  if (it == runners_.end()) {
+    LOG(WARNING) << "Can't PostMessage to invalid Extension instance id: "
+        << instance_id;
+    return;
+  }
+
+  // Like above, |msg| won't be used once we return, so we take its contents
+  // instead of copying them. The extension thread reads them in place.
+  scoped_ptr<std::string> contents(new std::string);
+  const_cast<std::string*>(&msg)->swap(*contents);
+  (it->second)->PostSerializedMessageToNative(contents.Pass(),
+      priority ? XWalkExtensionStats::PRIORITY_LANE :
+                 XWalkExtensionStats::NORMAL_LANE);
+  OnAsyncMessagePosted(instance_id);
+}
+
+namespace {
+
+// Returns NULL if |shared_memory| doesn't hold |size| bytes that can be
+// mapped.
+scoped_ptr<base::Value> ReadBinaryMessage(base::SharedMemory* shared_memory,
+                                          uint32 size) {
+#if defined(OS_POSIX)
+  // The size comes from the render process, mapping more than the buffer
+  // holds would fault when reading past its end.
+  struct stat buffer_stat;
+  if (fstat(shared_memory->handle().fd, &buffer_stat) ||
+      buffer_stat.st_size < static_cast<off_t>(size))
+    return scoped_ptr<base::Value>();
+#endif
+
+  if (!shared_memory->Map(size))
+    return scoped_ptr<base::Value>();
+
+  // The buffer is unmapped once the caller is done with it, so its contents
+  // are copied once, from the mapping straight into the value handed to the
+  // instance.
+  return scoped_ptr<base::Value>(base::BinaryValue::CreateWithCopiedBuffer(
+      static_cast<const char*>(shared_memory->memory()), size));
+}
+
+}  // namespace
+
+void XWalkExtensionServer::OnPostBinaryMessageToNative(int64_t instance_id,
+    base::SharedMemoryHandle handle, uint32 size, bool priority) {
+  // Take ownership of the handle first, so it is closed on every path.
+  base::SharedMemory shared_memory(handle, true);
+
+  RunnerMap::const_iterator it = runners_.find(instance_id);
+  if (it == runners_.end()) {
+    LOG(WARNING) << "Can't PostMessage to invalid Extension instance id: "
+        << instance_id;
+    return;
+  }
+
+  scoped_ptr<base::Value> value(ReadBinaryMessage(&shared_memory, size));
+  if (value) {
+    (it->second)->PostMessageToNative(value.Pass(),
+        priority ? XWalkExtensionStats::PRIORITY_LANE :
+                   XWalkExtensionStats::NORMAL_LANE);
+  } else {
+    LOG(WARNING) << "Invalid binary message for Extension instance id: "
+        << instance_id;
+  }
+
+  // The render process counted the message when sending it. Even if it is
+  // dropped here, a sync message sent through the slot may be waiting for it.
+  OnAsyncMessagePosted(instance_id);
+}
+
+void XWalkExtensionServer::OnAsyncMessagePosted(int64_t instance_id) {
+#if defined(OS_POSIX)
+  // A sync message sent through the slot may have been waiting for this one.
+  SyncMessageSlotHostMap::iterator it_slot =
+      sync_message_slot_hosts_.find(instance_id);
+  if (it_slot != sync_message_slot_hosts_.end())
+    it_slot->second->OnAsyncMessageReceived();
+#endif
+}
+
+void XWalkExtensionServer::OnMessagesToJSHandled(int64_t instance_id,
+                                                 uint32 count) {
+  // The instance may have been destroyed while the acks were on their way.
+  RunnerMap::const_iterator it = runners_.find(instance_id);
+  if (it == runners_.end())
+    return;
+
+  (it->second)->AckMessagesToJS(count);
 }
 
 bool XWalkExtensionServer::Send(IPC::Message* msg) {
@@ -132,6 +401,9 @@ bool ValidateExtensionName(const std::string& extension_name) {
 
 bool XWalkExtensionServer::RegisterExtension(
     scoped_ptr<XWalkExtension> extension) {
+  // A server either owns all its extensions or none of them.
+  CHECK(owns_extensions_);
+
   if (!ValidateExtensionName(extension->name())) {
     LOG(WARNING) << "Ignoring extension with invalid name: "
                  << extension->name();
@@ -145,12 +417,93 @@ bool XWalkExtensionServer::RegisterExtension(
   }
 
   std::string name = extension->name();
+  if (script_data_store_)
+    script_data_store_->AddExtensionSoon(name, extension->GetJavaScriptAPI());
+  owned_extensions_->Add(extension.get());
   extensions_[name] = extension.release();
   return true;
 }
 
+scoped_ptr<XWalkExtension> XWalkExtensionServer::UnregisterExtension(
+    const std::string& name) {
+  CHECK(owns_extensions_);
+  ExtensionMap::iterator it = extensions_.find(name);
+  if (it == extensions_.end())
+    return scoped_ptr<XWalkExtension>();
+
+  scoped_ptr<XWalkExtension> extension(it->second);
+  owned_extensions_->Remove(extension.get());
+  extensions_.erase(it);
+  return extension.Pass();
+}
+
+void XWalkExtensionServer::RegisterExtensionsFrom(
+    const XWalkExtensionServer& server) {
+  CHECK(extensions_.empty());
+  extensions_ = server.extensions_;
+  owns_extensions_ = false;
+  owned_extensions_ = server.owned_extensions_;
+
+  script_data_store_ = server.script_data_store_;
+}
+
+namespace {
+
+// Binary messages bigger than this are sent to the renderer in a shared memory
+// buffer instead of being serialized inline in the IPC message.
+const size_t kBinaryMessageSharedMemoryThreshold = 64 * 1024;
+
+}  // namespace
+
+bool XWalkExtensionServer::PostBinaryMessageInSharedMemory(
+    int64_t instance_id, const base::BinaryValue& msg) {
+#if defined(OS_POSIX)
+  size_t size = msg.GetSize();
+  base::SharedMemory shared_memory;
+  if (!shared_memory.CreateAndMapAnonymous(size))
+    return false;
+  memcpy(shared_memory.memory(), msg.GetBuffer(), size);
+
+  // On POSIX the process handle is ignored and the file descriptor is simply
+  // duplicated, the IPC channel takes care of passing it along.
+  base::SharedMemoryHandle handle;
+  if (!shared_memory.ShareToProcess(base::GetCurrentProcessHandle(), &handle))
+    return false;
+
+  return Send(new XWalkExtensionClientMsg_PostBinaryMessageToJS(
+      instance_id, handle, size));
+#else
+  // FIXME: Sharing memory on Windows requires the handle of the process on the
+  // other side of the channel, use inline messages until we have it.
+  return false;
+#endif
+}
+
 void XWalkExtensionServer::HandleMessageFromNative(
     const XWalkExtensionRunner* runner, scoped_ptr<base::Value> msg) {
+  if (runner->stats()) {
+    runner->stats()->RecordMessageToJS(
+        XWalkExtensionStats::EstimateValueSize(*msg));
+  }
+
+  ExtensionMap::const_iterator it = extensions_.find(runner->extension_name());
+  if (it != extensions_.end() && it->second->message_batching_enabled() &&
+      !msg->IsType(base::Value::TYPE_BINARY)) {
+    QueueMessageToJS(runner->instance_id(), msg.Pass(),
+                     it->second->message_batching_max_latency());
+    return;
+  }
+
+  FlushPendingMessagesToJS();
+
+  if (msg->IsType(base::Value::TYPE_BINARY)) {
+    const base::BinaryValue* binary_msg =
+        static_cast<const base::BinaryValue*>(msg.get());
+    if (binary_msg->GetSize() >= kBinaryMessageSharedMemoryThreshold &&
+        PostBinaryMessageInSharedMemory(runner->instance_id(), *binary_msg))
+      return;
+  }
+
   base::ListValue list;
   list.Append(msg.release());
 
@@ -160,6 +513,8 @@ void XWalkExtensionServer::HandleMessageFromNative(
 
 void XWalkExtensionServer::HandleReplyMessageFromNative(
       scoped_ptr<IPC::Message> ipc_reply, scoped_ptr<base::Value> msg) {
+  FlushPendingMessagesToJS();
+
   base::ListValue result;
   result.Append(msg.release());
 
@@ -167,12 +522,55 @@ void XWalkExtensionServer::HandleReplyMessageFromNative(
   Send(ipc_reply.release());
 }
 
+void XWalkExtensionServer::StartMessagesToJSAcks(
+    const XWalkExtensionRunner* runner) {
+  // Queued messages were posted before accounting started, so they must reach
+  // the renderer before it starts acking.
+  FlushPendingMessagesToJS();
+  Send(new XWalkExtensionClientMsg_StartMessagesToJSAcks(
+      runner->instance_id()));
+}
+
+void XWalkExtensionServer::QueueMessageToJS(int64_t instance_id,
+    scoped_ptr<base::Value> msg, base::TimeDelta max_latency) {
+  pending_instance_ids_.push_back(instance_id);
+  pending_messages_.Append(msg.release());
+
+  // Only schedule a new flush if this message can't wait for the one already
+  // scheduled. Stale flushes find an empty queue and do nothing.
+  base::TimeTicks flush_time = base::TimeTicks::Now() + max_latency;
+  if (pending_instance_ids_.size() > 1 && flush_time >= pending_flush_time_)
+    return;
+  pending_flush_time_ = flush_time;
+
+  base::MessageLoopProxy::current()->PostDelayedTask(
+      FROM_HERE,
+      base::Bind(&XWalkExtensionServer::FlushPendingMessagesToJS,
+                 weak_factory_.GetWeakPtr()),
+      max_latency);
+}
+
+void XWalkExtensionServer::FlushPendingMessagesToJS() {
+  if (pending_instance_ids_.empty())
+    return;
+
+  std::vector<int64_t> instance_ids;
+  instance_ids.swap(pending_instance_ids_);
+  Send(new XWalkExtensionClientMsg_PostMessagesToJS(instance_ids,
+                                                    pending_messages_));
+  pending_messages_.Clear();
+}
+
 void XWalkExtensionServer::OnSendSyncMessageToNative(int64_t instance_id,
     const base::ListValue& msg, IPC::Message* ipc_reply) {
   RunnerMap::const_iterator it = runners_.find(instance_id);
   if (it == runners_.end()) {
     LOG(WARNING) << "Can't SendSyncMessage to invalid Extension instance id: "
         << instance_id;
+    // The render process is blocked until it gets a reply, e.g. when the
+    // instance couldn't be created because its extension was retired.
+    HandleReplyMessageFromNative(scoped_ptr<IPC::Message>(ipc_reply),
+        scoped_ptr<base::Value>(base::Value::CreateNullValue()));
     return;
   }
 
@@ -193,12 +591,165 @@ void XWalkExtensionServer::OnDestroyInstance(int64_t instance_id) {
     return;
   }
 
-  delete it->second;
+  // This doesn't block: the runner acknowledges when the context is gone.
+  std::string extension_name = it->second->extension_name();
+  DestroyRunner(it->second);
   runners_.erase(it);
+  ReleaseRetiredExtensionIfUnused(extension_name);
+
+#if defined(OS_POSIX)
+  DestroySyncMessageSlotHost(instance_id);
+#endif
 
   Send(new XWalkExtensionClientMsg_InstanceDestroyed(instance_id));
 }
 
+#if defined(OS_POSIX)
+void XWalkExtensionServer::OnCreateSyncMessageSlot(int64_t instance_id,
+    base::SharedMemoryHandle* memory, base::FileDescriptor* socket) {
+  *memory = base::SharedMemory::NULLHandle();
+  *socket = base::FileDescriptor();
+
+  if (runners_.find(instance_id) == runners_.end() ||
+      sync_message_slot_hosts_.find(instance_id) !=
+          sync_message_slot_hosts_.end())
+    return;
+
+  // The slot socket is watched in our message loop.
+  if (!XWalkExtensionSyncMessageSlot::IsSupported() ||
+      base::MessageLoop::current()->type() != base::MessageLoop::TYPE_IO)
+    return;
+
+  base::SharedMemoryHandle peer_memory;
+  int peer_socket;
+  scoped_refptr<XWalkExtensionSyncMessageSlot> slot =
+      XWalkExtensionSyncMessageSlot::Create(&peer_memory, &peer_socket);
+  if (!slot)
+    return;
+
+  scoped_ptr<SyncMessageSlotHost> host(
+      new SyncMessageSlotHost(this, instance_id, slot));
+  if (!host->StartWatching()) {
+    // Closes the memory handle when it goes out of scope.
+    base::SharedMemory peer_shared_memory(peer_memory, false);
+    if (HANDLE_EINTR(close(peer_socket)) < 0)
+      PLOG(ERROR) << "close";
+    return;
+  }
+  sync_message_slot_hosts_[instance_id] = host.release();
+
+  // Both are closed here once the reply is sent.
+  *memory = peer_memory;
+  *socket = base::FileDescriptor(peer_socket, true);
+}
+
+void XWalkExtensionServer::OnGetOversizedSyncReply(int64_t instance_id,
+                                                   base::ListValue* reply) {
+  scoped_ptr<base::Value> value;
+  SyncMessageSlotHostMap::iterator it =
+      sync_message_slot_hosts_.find(instance_id);
+  if (it != sync_message_slot_hosts_.end())
+    value = it->second->TakeOversizedReply();
+  if (!value)
+    value.reset(base::Value::CreateNullValue());
+  reply->Append(value.release());
+}
+
+namespace {
+
+// Runs in the extension thread, so the render process gets the reply without
+// waiting for our thread. Messages the instance posted before replying may
+// still be on their way through IPC, but the render process can't handle them
+// before the sync message returns anyway.
+void ReplySyncMessageInSlot(
+    scoped_refptr<XWalkExtensionSyncMessageSlot> slot,
+    scoped_refptr<base::MessageLoopProxy> server_loop,
+    int64_t instance_id,
+    const base::Callback<void(int64_t, scoped_ptr<base::Value>)>&
+        oversized_reply_callback,
+    scoped_ptr<base::Value> reply) {
+  if (slot->WriteValue(*reply)) {
+    slot->SendReply(XWalkExtensionSyncMessageSlot::REPLY_IN_SLOT);
+    return;
+  }
+
+  server_loop->PostTask(FROM_HERE,
+      base::Bind(oversized_reply_callback, instance_id, base::Passed(&reply)));
+}
+
+}  // namespace
+
+void XWalkExtensionServer::HandleSyncMessageFromSlot(
+    int64_t instance_id, scoped_ptr<base::Value> msg,
+    scoped_refptr<XWalkExtensionSyncMessageSlot> slot) {
+  RunnerMap::const_iterator it = runners_.find(instance_id);
+  if (it == runners_.end()) {
+    LOG(WARNING) << "Can't SendSyncMessage to invalid Extension instance id: "
+        << instance_id;
+    ReplySyncMessageInSlot(slot, base::MessageLoopProxy::current(),
+        instance_id,
+        base::Bind(&XWalkExtensionServer::OnOversizedSyncReply,
+                   weak_factory_.GetWeakPtr()),
+        scoped_ptr<base::Value>(base::Value::CreateNullValue()));
+    return;
+  }
+
+  (it->second)->SendSyncMessageToNative(msg.Pass(),
+      base::Bind(&ReplySyncMessageInSlot, slot,
+                 base::MessageLoopProxy::current(), instance_id,
+                 base::Bind(&XWalkExtensionServer::OnOversizedSyncReply,
+                            weak_factory_.GetWeakPtr())));
+}
+
+void XWalkExtensionServer::OnOversizedSyncReply(
+    int64_t instance_id, scoped_ptr<base::Value> reply) {
+  SyncMessageSlotHostMap::iterator it =
+      sync_message_slot_hosts_.find(instance_id);
+  if (it == sync_message_slot_hosts_.end())
+    return;
+  it->second->SetOversizedReply(reply.Pass());
+}
+
+void XWalkExtensionServer::DestroySyncMessageSlotHost(int64_t instance_id) {
+  SyncMessageSlotHostMap::iterator it =
+      sync_message_slot_hosts_.find(instance_id);
+  if (it == sync_message_slot_hosts_.end())
+    return;
+  delete it->second;
+  sync_message_slot_hosts_.erase(it);
+}
+#endif
+
+void XWalkExtensionServer::DestroyRunner(XWalkExtensionRunner* runner) {
+  scoped_refptr<XWalkRetiredExtension> retired;
+  RetiredExtensionMap::iterator it =
+      retired_extensions_.find(runner->extension_name());
+  if (it != retired_extensions_.end())
+    retired = it->second;
+  runner->Destroy(base::Bind(&XWalkExtensionServer::OnRunnerDestroyed,
+                             owned_extensions_, retired));
+}
+
+// static
+void XWalkExtensionServer::OnRunnerDestroyed(
+    scoped_refptr<OwnedExtensions> extensions,
+    scoped_refptr<XWalkRetiredExtension> retired) {
+}
+
+void XWalkExtensionServer::ReleaseRetiredExtensionIfUnused(
+    const std::string& name) {
+  RetiredExtensionMap::iterator it = retired_extensions_.find(name);
+  if (it == retired_extensions_.end())
+    return;
+
+  RunnerMap::const_iterator it_runner = runners_.begin();
+  for (; it_runner != runners_.end(); ++it_runner) {
+    if (it_runner->second->extension_name() == name)
+      return;
+  }
+  retired_extensions_.erase(it);
+}
+
 void XWalkExtensionServer::RegisterExtensionsInRenderProcess() {
   // Having a sender means we have a RenderProcessHost ready.
   DCHECK(sender_);
@@ -209,6 +760,55 @@ void XWalkExtensionServer::RegisterExtensionsInRenderProcess() {
     Send(new XWalkExtensionClientMsg_RegisterExtension(
         extension->name(), extension->GetJavaScriptAPI()));
   }
+
+  // Entries still being created when the render process starts are created
+  // again there, but not stored.
+  if (script_data_store_) {
+    Send(new XWalkExtensionClientMsg_EnableScriptDataPersistence(
+        script_data_store_->GetEntries()));
+  }
+}
+
+void XWalkExtensionServer::EnableScriptDataPersistence(
+    const base::FilePath& dir) {
+  CHECK(owns_extensions_);
+  scoped_refptr<XWalkScriptDataStore> store(new XWalkScriptDataStore(dir));
+  if (!store->Load())
+    return;
+
+  script_data_store_ = store;
+  ExtensionMap::iterator it = extensions_.begin();
+  for (; it != extensions_.end(); ++it) {
+    script_data_store_->AddExtensionSoon(it->first,
+                                         it->second->GetJavaScriptAPI());
+  }
+}
+
+void XWalkExtensionServer::RegisterSharedExtension(XWalkExtension* extension) {
+  DCHECK(!owns_extensions_);
+  if (extensions_.find(extension->name()) != extensions_.end()) {
+    LOG(WARNING) << "Ignoring extension with name already registered: "
+                 << extension->name();
+    return;
+  }
+
+  extensions_[extension->name()] = extension;
+  Send(new XWalkExtensionClientMsg_RegisterExtension(
+      extension->name(), extension->GetJavaScriptAPI()));
+}
+
+void XWalkExtensionServer::RetireExtension(
+    scoped_refptr<XWalkRetiredExtension> retired) {
+  DCHECK(!owns_extensions_);
+  const std::string& name = retired->name();
+  if (!extensions_.erase(name))
+    return;
+  Send(new XWalkExtensionClientMsg_UnregisterExtension(name));
+
+  // Runners destroyed from now on hold the retired extension until their
+  // context is gone, see DestroyRunner().
+  retired_extensions_[name] = retired;
+  ReleaseRetiredExtensionIfUnused(name);
 }
 
 void XWalkExtensionServer::Invalidate() {
@@ -216,8 +816,103 @@ void XWalkExtensionServer::Invalidate() {
   sender_ = 0;
 }
 
+namespace {
+
+// A library may come with a descriptor next to it, named after the library
+// with a .json extension, e.g. libfoo.so and libfoo.json:
+//
+//   { "name": "foo", "jsapi": "foo_api.js" }
+//
+// The JavaScript API file is relative to the descriptor. Extensions with a
+// descriptor are registered without loading their library. Since their
+// options can't be set by XW_Initialize() before that, the descriptor can also
+// have "batching", the maximum latency in milliseconds for message batching,
+// and "dedicated_thread".
+bool ReadExtensionDescriptor(
+    const base::FilePath& descriptor_path, std::string* name,
+    std::string* js_api, XWalkExternalExtension::DescriptorOptions* options) {
+  std::string descriptor;
+  if (!file_util::ReadFileToString(descriptor_path, &descriptor))
+    return false;
+
+  scoped_ptr<base::Value> value(base::JSONReader::Read(descriptor));
+  base::DictionaryValue* dict;
+  if (!value || !value->GetAsDictionary(&dict))
+    return false;
+
+  std::string js_api_file;
+  if (!dict->GetString("name", name) || !dict->GetString("jsapi", &js_api_file))
+    return false;
+
+  if (dict->HasKey("batching")) {
+    int max_latency_ms;
+    if (!dict->GetInteger("batching", &max_latency_ms) || max_latency_ms < 0)
+      return false;
+    options->message_batching_enabled = true;
+    options->message_batching_max_latency =
+        base::TimeDelta::FromMilliseconds(max_latency_ms);
+  }
+
+  if (dict->HasKey("dedicated_thread") &&
+      !dict->GetBoolean("dedicated_thread", &options->uses_dedicated_thread))
+    return false;
+
+  base::FilePath js_api_path =
+      descriptor_path.DirName().Append(base::FilePath::FromUTF8Unsafe(
+          js_api_file));
+  return file_util::ReadFileToString(js_api_path, js_api);
+}
+
+}  // namespace
+
+scoped_ptr<XWalkExtension> CreateExternalExtension(
+    const base::FilePath& path) {
+  base::FilePath descriptor_path =
+      path.ReplaceExtension(FILE_PATH_LITERAL("json"));
+  if (file_util::PathExists(descriptor_path)) {
+    std::string name;
+    std::string js_api;
+    XWalkExternalExtension::DescriptorOptions options;
+    if (ReadExtensionDescriptor(descriptor_path, &name, &js_api, &options)) {
+      return scoped_ptr<XWalkExtension>(
+          new XWalkExternalExtension(path, name, js_api, options));
+    }
+    LOG(WARNING) << "Couldn't read descriptor "
+                 << descriptor_path.AsUTF8Unsafe()
+                 << ", loading the extension library now.";
+  }
+
+  // FIXME(cmarcelo): Once we get rid of the current C API in favor of the new
+  // one, move this NativeLibrary manipulation back inside
+  // XWalkExternalExtension.
+  base::ScopedNativeLibrary library(path);
+  if (!library.is_valid()) {
+    LOG(WARNING) << "Ignoring " << path.AsUTF8Unsafe()
+                 << " as external extension because is not valid library.";
+    return scoped_ptr<XWalkExtension>();
+  }
+
+  if (library.GetFunctionPointer("XW_Initialize")) {
+    scoped_ptr<XWalkExternalExtension> extension(
+        new XWalkExternalExtension(path, library.Release()));
+    if (extension->is_valid())
+      return extension.PassAs<XWalkExtension>();
+  } else if (library.GetFunctionPointer("xwalk_extension_init")) {
+    scoped_ptr<old::XWalkExternalExtension> extension(
+        new old::XWalkExternalExtension(library.Release()));
+    if (extension->is_valid())
+      return extension.PassAs<XWalkExtension>();
+  } else {
+    LOG(WARNING) << "Ignoring " << path.AsUTF8Unsafe()
+                 << " as external extension because"
+                 << " doesn't contain valid entry point.";
+  }
+  return scoped_ptr<XWalkExtension>();
+}
+
 void RegisterExternalExtensionsInDirectory(
-    XWalkExtensionServer* server, const base::FilePath& dir) {
+    XWalkExtensionServer* server, const base::FilePath& dir,
+    std::map<base::FilePath, std::string>* registered) {
   CHECK(server);
 
   if (!file_util::DirectoryExists(dir)) {
@@ -234,31 +929,14 @@ void RegisterExternalExtensionsInDirectory(
 
   for (base::FilePath extension_path = libraries.Next();
         !extension_path.empty(); extension_path = libraries.Next()) {
-    // FIXME(cmarcelo): Once we get rid of the current C API in favor of the new
-    // one, move this NativeLibrary manipulation back inside
-    // XWalkExternalExtension.
-    base::ScopedNativeLibrary library(extension_path);
-    if (!library.is_valid()) {
-      LOG(WARNING) << "Ignoring " << extension_path.AsUTF8Unsafe()
-                   << " as external extension because is not valid library.";
+    scoped_ptr<XWalkExtension> extension =
+        CreateExternalExtension(extension_path);
+    if (!extension)
       continue;
-    }
 
-    if (library.GetFunctionPointer("XW_Initialize")) {
-      scoped_ptr<XWalkExternalExtension> extension(
-          new XWalkExternalExtension(extension_path, library.Release()));
-      if (extension->is_valid())
-        server->RegisterExtension(extension.PassAs<XWalkExtension>());
-    } else if (library.GetFunctionPointer("xwalk_extension_init")) {
-      scoped_ptr<old::XWalkExternalExtension> extension(
-          new old::XWalkExternalExtension(library.Release()));
-      if (extension->is_valid())
-        server->RegisterExtension(extension.PassAs<XWalkExtension>());
-    } else {
-      LOG(WARNING) << "Ignoring " << extension_path.AsUTF8Unsafe()
-                   << " as external extension because"
-                   << " doesn't contain valid entry point.";
-    }
+    std::string name = extension->name();
+    if (server->RegisterExtension(extension.Pass()) && registered)
+      (*registered)[extension_path] = name;
   }
 }
 
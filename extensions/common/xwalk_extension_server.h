@@ -8,17 +8,21 @@
 #include <stdint.h>
 #include <map>
 #include <string>
-
+#include <vector>
+
+#include "base/callback.h"
+#include "base/files/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
+#include "base/shared_memory.h"
 #include "base/synchronization/cancellation_flag.h"
+#include "base/time.h"
 #include "base/values.h"
 #include "ipc/ipc_channel_proxy.h"
 #include "ipc/ipc_listener.h"
 #include "xwalk/extensions/common/xwalk_extension_runner.h"
 
-namespace base {
-class FilePath;
-}
-
 namespace content {
 class RenderProcessHost;
 }
@@ -31,6 +35,30 @@ namespace xwalk {
 namespace extensions {
 
 class XWalkExtension;
+class XWalkExtensionSyncMessageSlot;
+class XWalkScriptDataStore;
+
+// Keeps an extension removed from the servers alive while instances created
+// from it still run. The extension is deleted, and |drained_callback| run,
+// when the last reference goes away, which may happen in any thread.
+class XWalkRetiredExtension
+    : public base::RefCountedThreadSafe<XWalkRetiredExtension> {
+ public:
+  XWalkRetiredExtension(scoped_ptr<XWalkExtension> extension,
+                        const base::Closure& drained_callback);
+
+  const std::string& name() const { return name_; }
+
+ private:
+  friend class base::RefCountedThreadSafe<XWalkRetiredExtension>;
+  ~XWalkRetiredExtension();
+
+  scoped_ptr<XWalkExtension> extension_;
+  std::string name_;
+  base::Closure drained_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkRetiredExtension);
+};
 
 // This class holds the Native context of Extensions. It can live in the Browser
 // Process (for in-process extensions) or on the Extension Process. It
@@ -48,37 +76,147 @@ class XWalkExtensionServer : public IPC::Listener,
   bool Send(IPC::Message* msg);
 
   bool RegisterExtension(scoped_ptr<XWalkExtension> extension);
+
+  // Removes the extension from a server that owns its extensions, giving the
+  // ownership back. Returns NULL if there is no extension called |name|.
+  scoped_ptr<XWalkExtension> UnregisterExtension(const std::string& name);
+
+  // Makes the extensions registered in |server| available in this one, along
+  // with its script data persistence settings. |server| keeps the ownership of
+  // the extensions, but they are kept alive until this server and the contexts
+  // created by it are gone.
+  void RegisterExtensionsFrom(const XWalkExtensionServer& server);
   void RegisterExtensionsInRenderProcess();
 
+  // Used on servers sharing extensions of another server once they are
+  // connected to a render process, to add or remove extensions at runtime.
+  // |extension| is owned by the other server. The instances of a retired
+  // extension keep running, and a reference to |retired| is held until they
+  // are all gone.
+  void RegisterSharedExtension(XWalkExtension* extension);
+  void RetireExtension(scoped_refptr<XWalkRetiredExtension> retired);
+
+  // Loads the pre-compilation data for JS API code stored in |dir|, and
+  // creates there the data for the extensions registered in this server that
+  // don't have it yet. Render processes get the stored data but can't add to
+  // it. This does blocking disk I/O, so it should be called during the
+  // startup. Servers sharing the extensions share the stored data too.
+  void EnableScriptDataPersistence(const base::FilePath& dir);
+
   void Invalidate();
 
  private:
   // Message Handlers
   void OnCreateInstance(int64_t instance_id, std::string name);
   void OnDestroyInstance(int64_t instance_id);
-  void OnPostMessageToNative(int64_t instance_id, const base::ListValue& msg);
+  void OnPostMessageToNative(int64_t instance_id, const base::ListValue& msg,
+                             bool priority);
+  void OnPostSerializedMessageToNative(int64_t instance_id,
+                                       const std::string& msg, bool priority);
+  void OnPostBinaryMessageToNative(int64_t instance_id,
+                                   base::SharedMemoryHandle handle,
+                                   uint32 size, bool priority);
+  // Called after an async message from the instance was queued.
+  void OnAsyncMessagePosted(int64_t instance_id);
+  void OnMessagesToJSHandled(int64_t instance_id, uint32 count);
   void OnSendSyncMessageToNative(int64_t instance_id,
       const base::ListValue& msg, IPC::Message* ipc_reply);
+#if defined(OS_POSIX)
+  void OnCreateSyncMessageSlot(int64_t instance_id,
+                               base::SharedMemoryHandle* memory,
+                               base::FileDescriptor* socket);
+  void OnGetOversizedSyncReply(int64_t instance_id, base::ListValue* reply);
+
+  // Sync messages that arrive through a slot are handled like the ones that
+  // come through IPC, but the extension thread writes the reply in the slot
+  // directly. Replies that don't fit are handed back to us to be fetched
+  // through IPC.
+  class SyncMessageSlotHost;
+  void HandleSyncMessageFromSlot(
+      int64_t instance_id, scoped_ptr<base::Value> msg,
+      scoped_refptr<XWalkExtensionSyncMessageSlot> slot);
+  void OnOversizedSyncReply(int64_t instance_id,
+                            scoped_ptr<base::Value> reply);
+  void DestroySyncMessageSlotHost(int64_t instance_id);
+#endif
 
   // XWalkExtensionRunner::Client implementation.
   virtual void HandleMessageFromNative(const XWalkExtensionRunner* runner,
                                         scoped_ptr<base::Value> msg) OVERRIDE;
   virtual void HandleReplyMessageFromNative(
       scoped_ptr<IPC::Message> ipc_reply, scoped_ptr<base::Value> msg) OVERRIDE;
+  virtual void StartMessagesToJSAcks(
+      const XWalkExtensionRunner* runner) OVERRIDE;
+
+  // Messages from extensions that enabled batching are queued here and sent
+  // together in a single IPC message. Messages sent right away flush the queue
+  // before, to keep the order in which they were produced.
+  void QueueMessageToJS(int64_t instance_id, scoped_ptr<base::Value> msg,
+                        base::TimeDelta max_latency);
+  void FlushPendingMessagesToJS();
+
+  bool PostBinaryMessageInSharedMemory(int64_t instance_id,
+                                       const base::BinaryValue& msg);
+
+  // Owns the extensions registered in a server, and deletes them when the last
+  // reference goes away. Servers sharing the extensions hold a reference too.
+  class OwnedExtensions;
+
+  // Runners are destroyed asynchronously, the extension contexts they hold may
+  // still refer to our extensions after the runner was removed from the map,
+  // or after we are gone. They keep a reference to the extensions until then.
+  void DestroyRunner(XWalkExtensionRunner* runner);
+  // Bound to the callback run from the extension thread once the context is
+  // gone, only to hold the references.
+  static void OnRunnerDestroyed(scoped_refptr<OwnedExtensions> extensions,
+                                scoped_refptr<XWalkRetiredExtension> retired);
+
+  // Drops the reference to the retired extension |name| once no runner uses
+  // it anymore.
+  void ReleaseRetiredExtensionIfUnused(const std::string& name);
 
   IPC::Sender* sender_;
 
   typedef std::map<std::string, XWalkExtension*> ExtensionMap;
   ExtensionMap extensions_;
+  bool owns_extensions_;
+  scoped_refptr<OwnedExtensions> owned_extensions_;
 
   typedef std::map<int64_t, XWalkExtensionRunner*> RunnerMap;
   RunnerMap runners_;
 
+  typedef std::map<std::string, scoped_refptr<XWalkRetiredExtension> >
+      RetiredExtensionMap;
+  RetiredExtensionMap retired_extensions_;
+
+#if defined(OS_POSIX)
+  typedef std::map<int64_t, SyncMessageSlotHost*> SyncMessageSlotHostMap;
+  SyncMessageSlotHostMap sync_message_slot_hosts_;
+#endif
+
   base::CancellationFlag sender_cancellation_flag_;
+
+  scoped_refptr<XWalkScriptDataStore> script_data_store_;
+
+  std::vector<int64_t> pending_instance_ids_;
+  base::ListValue pending_messages_;
+  base::TimeTicks pending_flush_time_;
+
+  base::WeakPtrFactory<XWalkExtensionServer> weak_factory_;
 };
 
+// Registers the external extensions found in |dir|. Libraries that come with a
+// descriptor are only loaded when their first instance is created.
+//
+// When |registered| is given, the name of the extension registered from each
+// library is stored there, keyed by the library path.
 void RegisterExternalExtensionsInDirectory(
-    XWalkExtensionServer* server, const base::FilePath& dir);
+    XWalkExtensionServer* server, const base::FilePath& dir,
+    std::map<base::FilePath, std::string>* registered = NULL);
+
+// Creates the extension for the library at |path|, using its descriptor if
+// there is one. Returns NULL if the library isn't a valid extension.
+scoped_ptr<XWalkExtension> CreateExternalExtension(const base::FilePath& path);
 
 bool ValidateExtensionNameForTesting(const std::string& extension_name);
 
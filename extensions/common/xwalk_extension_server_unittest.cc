@@ -4,10 +4,32 @@
 
 #include "xwalk/extensions/common/xwalk_extension_server.h"
 
+#include <map>
+#include <string>
 #include "base/basictypes.h"
+#include "base/callback_helpers.h"
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop/message_loop.h"
+#include "base/process_util.h"
+#include "base/run_loop.h"
+#include "base/shared_memory.h"
+#include "base/synchronization/waitable_event.h"
+#include "ipc/ipc_sender.h"
 #include "testing/gtest/include/gtest/gtest.h"
+#include "xwalk/extensions/common/xwalk_extension.h"
+#include "xwalk/extensions/common/xwalk_extension_messages.h"
+#include "xwalk/extensions/common/xwalk_extension_sync_message_slot.h"
+#include "xwalk/extensions/common/xwalk_script_data_store.h"
 
+using xwalk::extensions::CreateExternalExtension;
 using xwalk::extensions::ValidateExtensionNameForTesting;
+using xwalk::extensions::XWalkExtension;
+using xwalk::extensions::XWalkExtensionInstance;
+using xwalk::extensions::XWalkExtensionServer;
+using xwalk::extensions::XWalkExtensionSyncMessageSlot;
+using xwalk::extensions::XWalkScriptDataStore;
 
 TEST(XWalkExtensionServerTest, ValidateExtensionName) {
   const std::string valid_names[] = {
@@ -42,3 +64,317 @@ TEST(XWalkExtensionServerTest, ValidateExtensionName) {
         << "Extension name should be invalid: " << invalid_names[i];
   }
 }
+
+namespace {
+
+base::WaitableEvent g_posted(false, false);
+
+// Posts back the messages it gets, and replies to sync messages with them.
+// Sets watermarks before echoing "watermarks".
+class BatchingEchoInstance : public XWalkExtensionInstance {
+ public:
+  explicit BatchingEchoInstance(
+      const XWalkExtension::PostMessageCallback& post_message) {
+    SetPostMessageCallback(post_message);
+  }
+
+  virtual void HandleMessage(scoped_ptr<base::Value> msg) OVERRIDE {
+    std::string contents;
+    if (msg->GetAsString(&contents) && contents == "watermarks")
+      SetMessageToJSWatermarks(1024, 512);
+    PostMessageToJS(scoped_ptr<base::Value>(msg->DeepCopy()));
+    PostMessageToJS(msg.Pass());
+    g_posted.Signal();
+  }
+  virtual scoped_ptr<base::Value> HandleSyncMessage(
+      scoped_ptr<base::Value> msg) OVERRIDE {
+    return msg.Pass();
+  }
+};
+
+class BatchingEchoExtension : public XWalkExtension {
+ public:
+  explicit BatchingEchoExtension(base::TimeDelta max_latency) {
+    set_name("batching");
+    EnableMessageBatching(max_latency);
+  }
+
+  virtual const char* GetJavaScriptAPI() OVERRIDE { return ""; }
+  virtual XWalkExtensionInstance* CreateInstance(
+      const PostMessageCallback& post_message) OVERRIDE {
+    return new BatchingEchoInstance(post_message);
+  }
+};
+
+// Keeps the messages sent by the server, and quits the current run loop when
+// one of type |quit_type| is sent.
+class TestSender : public IPC::Sender {
+ public:
+  TestSender() : quit_type_(0) {}
+
+  virtual bool Send(IPC::Message* msg) OVERRIDE {
+    messages_.push_back(msg);
+    if (msg->type() == quit_type_ && !quit_closure_.is_null())
+      base::ResetAndReturn(&quit_closure_).Run();
+    return true;
+  }
+
+  void RunUntilSent(uint32 type) {
+    base::RunLoop run_loop;
+    quit_type_ = type;
+    quit_closure_ = run_loop.QuitClosure();
+    run_loop.Run();
+  }
+
+  const ScopedVector<IPC::Message>& messages() const { return messages_; }
+
+ private:
+  ScopedVector<IPC::Message> messages_;
+  uint32 quit_type_;
+  base::Closure quit_closure_;
+};
+
+const int64_t kInstanceId = 1;
+
+scoped_ptr<IPC::Message> CreatePostMessage(const std::string& contents) {
+  base::ListValue msg;
+  msg.AppendString(contents);
+  return scoped_ptr<IPC::Message>(
+      new XWalkExtensionServerMsg_PostMessageToNative(kInstanceId, msg,
+                                                      false));
+}
+
+}  // namespace
+
+class XWalkExtensionServerBatchingTest : public testing::Test {
+ protected:
+  void CreateServer(base::TimeDelta max_latency) {
+    server_.reset(new XWalkExtensionServer);
+    server_->Initialize(&sender_);
+    ASSERT_TRUE(server_->RegisterExtension(scoped_ptr<XWalkExtension>(
+        new BatchingEchoExtension(max_latency))));
+    server_->OnMessageReceived(
+        XWalkExtensionServerMsg_CreateInstance(kInstanceId, "batching"));
+  }
+
+  virtual void TearDown() OVERRIDE {
+    server_->OnMessageReceived(
+        XWalkExtensionServerMsg_DestroyInstance(kInstanceId));
+    server_.reset();
+    base::RunLoop().RunUntilIdle();
+  }
+
+  base::MessageLoop loop_;
+  TestSender sender_;
+  scoped_ptr<XWalkExtensionServer> server_;
+};
+
+TEST_F(XWalkExtensionServerBatchingTest, FlushOnTimeout) {
+  CreateServer(base::TimeDelta::FromMilliseconds(500));
+  server_->OnMessageReceived(*CreatePostMessage("hello"));
+  g_posted.Wait();
+
+  // Both messages are queued when the instance posts them, and only sent once
+  // the latency allowed by the extension passed.
+  base::RunLoop().RunUntilIdle();
+  EXPECT_TRUE(sender_.messages().empty());
+
+  sender_.RunUntilSent(XWalkExtensionClientMsg_PostMessagesToJS::ID);
+  ASSERT_EQ(1u, sender_.messages().size());
+  XWalkExtensionClientMsg_PostMessagesToJS::Param params;
+  ASSERT_TRUE(XWalkExtensionClientMsg_PostMessagesToJS::Read(
+      sender_.messages()[0], &params));
+  ASSERT_EQ(2u, params.a.size());
+  EXPECT_EQ(kInstanceId, params.a[0]);
+  EXPECT_EQ(kInstanceId, params.a[1]);
+  ASSERT_EQ(2u, params.b.GetSize());
+  std::string contents;
+  EXPECT_TRUE(params.b.GetString(1, &contents));
+  EXPECT_EQ("hello", contents);
+}
+
+TEST_F(XWalkExtensionServerBatchingTest, FlushOnSyncReply) {
+  // The batch would never be sent because of the latency.
+  CreateServer(base::TimeDelta::FromHours(1));
+  server_->OnMessageReceived(*CreatePostMessage("hello"));
+  g_posted.Wait();
+  base::RunLoop().RunUntilIdle();
+  EXPECT_TRUE(sender_.messages().empty());
+
+  base::ListValue msg;
+  msg.AppendString("sync");
+  base::ListValue reply;
+  scoped_ptr<IPC::Message> sync_msg(
+      new XWalkExtensionServerMsg_SendSyncMessageToNative(kInstanceId, msg,
+                                                          &reply));
+  server_->OnMessageReceived(*sync_msg);
+  sender_.RunUntilSent(IPC_REPLY_ID);
+
+  // The pending messages were posted before the reply, so they go first.
+  ASSERT_EQ(2u, sender_.messages().size());
+  EXPECT_EQ(static_cast<uint32>(XWalkExtensionClientMsg_PostMessagesToJS::ID),
+            sender_.messages()[0]->type());
+  EXPECT_TRUE(sender_.messages()[1]->is_reply());
+}
+
+TEST_F(XWalkExtensionServerBatchingTest, AcksStartOnceWatermarksAreSet) {
+  CreateServer(base::TimeDelta::FromHours(1));
+  server_->OnMessageReceived(*CreatePostMessage("hello"));
+  g_posted.Wait();
+  base::RunLoop().RunUntilIdle();
+  EXPECT_TRUE(sender_.messages().empty());
+
+  server_->OnMessageReceived(*CreatePostMessage("watermarks"));
+  sender_.RunUntilSent(XWalkExtensionClientMsg_StartMessagesToJSAcks::ID);
+  g_posted.Wait();
+
+  // The messages queued before weren't accounted, so the renderer must get
+  // them before it starts acking.
+  ASSERT_EQ(2u, sender_.messages().size());
+  EXPECT_EQ(static_cast<uint32>(XWalkExtensionClientMsg_PostMessagesToJS::ID),
+            sender_.messages()[0]->type());
+  XWalkExtensionClientMsg_StartMessagesToJSAcks::Param params;
+  ASSERT_TRUE(XWalkExtensionClientMsg_StartMessagesToJSAcks::Read(
+      sender_.messages()[1], &params));
+  EXPECT_EQ(kInstanceId, params.a);
+}
+
+#if defined(OS_POSIX)
+TEST_F(XWalkExtensionServerBatchingTest, BinaryMessagesInSharedMemory) {
+  CreateServer(base::TimeDelta::FromHours(1));
+  const size_t kSize = 128 * 1024;
+
+  base::SharedMemory shared_memory;
+  ASSERT_TRUE(shared_memory.CreateAndMapAnonymous(kSize));
+  memset(shared_memory.memory(), 'x', kSize);
+
+  // The size sent by the render process can't be trusted, bigger than the
+  // buffer holds is dropped instead of reading past its end.
+  base::SharedMemoryHandle handle;
+  ASSERT_TRUE(shared_memory.ShareToProcess(base::GetCurrentProcessHandle(),
+                                           &handle));
+  server_->OnMessageReceived(XWalkExtensionServerMsg_PostBinaryMessageToNative(
+      kInstanceId, handle, kSize * 2, false));
+  EXPECT_FALSE(g_posted.TimedWait(base::TimeDelta::FromMilliseconds(100)));
+
+  ASSERT_TRUE(shared_memory.ShareToProcess(base::GetCurrentProcessHandle(),
+                                           &handle));
+  server_->OnMessageReceived(XWalkExtensionServerMsg_PostBinaryMessageToNative(
+      kInstanceId, handle, kSize, false));
+  g_posted.Wait();
+}
+#endif
+
+#if defined(OS_POSIX)
+TEST(XWalkExtensionServerTest, DroppedBinaryMessagesReleaseSyncMessages) {
+  if (!XWalkExtensionSyncMessageSlot::IsSupported())
+    return;
+
+  // The slot socket is watched in the server message loop.
+  base::MessageLoop loop(base::MessageLoop::TYPE_IO);
+  TestSender sender;
+  scoped_ptr<XWalkExtensionServer> server(new XWalkExtensionServer);
+  server->Initialize(&sender);
+  ASSERT_TRUE(server->RegisterExtension(scoped_ptr<XWalkExtension>(
+      new BatchingEchoExtension(base::TimeDelta::FromHours(1)))));
+  server->OnMessageReceived(
+      XWalkExtensionServerMsg_CreateInstance(kInstanceId, "batching"));
+
+  base::SharedMemoryHandle slot_memory;
+  base::FileDescriptor slot_socket;
+  server->OnMessageReceived(XWalkExtensionServerMsg_CreateSyncMessageSlot(
+      kInstanceId, &slot_memory, &slot_socket));
+  ASSERT_EQ(1u, sender.messages().size());
+  TupleTypes<XWalkExtensionServerMsg_CreateSyncMessageSlot::ReplyParam>::
+      ValueTuple slot_params;
+  ASSERT_TRUE(XWalkExtensionServerMsg_CreateSyncMessageSlot::ReadReplyParam(
+      sender.messages()[0], &slot_params));
+  scoped_refptr<XWalkExtensionSyncMessageSlot> slot =
+      XWalkExtensionSyncMessageSlot::Open(slot_params.a, slot_params.b.fd);
+  ASSERT_TRUE(slot);
+
+  // The buffer is smaller than the size sent with it, so the message can't
+  // be mapped and is dropped.
+  base::SharedMemory shared_memory;
+  ASSERT_TRUE(shared_memory.CreateAndMapAnonymous(1024));
+  base::SharedMemoryHandle handle;
+  ASSERT_TRUE(shared_memory.ShareToProcess(base::GetCurrentProcessHandle(),
+                                           &handle));
+  server->OnMessageReceived(XWalkExtensionServerMsg_PostBinaryMessageToNative(
+      kInstanceId, handle, 128 * 1024, false));
+
+  // The render process counted the dropped message, the sync one is still
+  // dispatched once it is received.
+  ASSERT_TRUE(slot->WriteValue(base::StringValue("sync")));
+  ASSERT_TRUE(slot->SendRequest(1));
+  base::RunLoop().RunUntilIdle();
+  EXPECT_EQ(XWalkExtensionSyncMessageSlot::REPLY_IN_SLOT,
+            slot->WaitForReply());
+
+  server->OnMessageReceived(
+      XWalkExtensionServerMsg_DestroyInstance(kInstanceId));
+  server.reset();
+  base::RunLoop().RunUntilIdle();
+}
+#endif
+
+TEST(XWalkExtensionServerTest, RenderProcessesGetStoredScriptData) {
+  base::MessageLoop loop;
+  base::ScopedTempDir dir;
+  ASSERT_TRUE(dir.CreateUniqueTempDir());
+
+  // Stored by a previous run.
+  scoped_refptr<XWalkScriptDataStore> store(
+      new XWalkScriptDataStore(dir.path()));
+  ASSERT_TRUE(store->Load());
+  store->AddExtension("batching", "");
+  std::map<std::string, std::string> entries = store->GetEntries();
+  ASSERT_EQ(1u, entries.size());
+
+  XWalkExtensionServer registry;
+  registry.EnableScriptDataPersistence(dir.path());
+  ASSERT_TRUE(registry.RegisterExtension(scoped_ptr<XWalkExtension>(
+      new BatchingEchoExtension(base::TimeDelta()))));
+
+  // Every render process, not only the first one, gets the stored entries.
+  for (int i = 0; i < 2; ++i) {
+    TestSender sender;
+    XWalkExtensionServer server;
+    server.RegisterExtensionsFrom(registry);
+    server.Initialize(&sender);
+    server.RegisterExtensionsInRenderProcess();
+
+    ASSERT_EQ(2u, sender.messages().size());
+    XWalkExtensionClientMsg_EnableScriptDataPersistence::Param params;
+    ASSERT_TRUE(XWalkExtensionClientMsg_EnableScriptDataPersistence::Read(
+        sender.messages()[1], &params));
+    EXPECT_EQ(entries, params.a);
+    server.Invalidate();
+  }
+}
+
+TEST(XWalkExtensionServerTest, DeferredExtensionOptionsFromDescriptor) {
+  base::ScopedTempDir dir;
+  ASSERT_TRUE(dir.CreateUniqueTempDir());
+  const char kJavaScriptAPI[] = "exports.foo = 1;";
+  ASSERT_EQ(static_cast<int>(strlen(kJavaScriptAPI)), file_util::WriteFile(
+      dir.path().AppendASCII("foo_api.js"), kJavaScriptAPI,
+      strlen(kJavaScriptAPI)));
+  const std::string descriptor =
+      "{ \"name\": \"foo\", \"jsapi\": \"foo_api.js\","
+      "  \"batching\": 10, \"dedicated_thread\": true }";
+  ASSERT_EQ(static_cast<int>(descriptor.size()), file_util::WriteFile(
+      dir.path().AppendASCII("libfoo.json"), descriptor.data(),
+      descriptor.size()));
+
+  // The library isn't loaded, so its options are known before it is
+  // registered.
+  scoped_ptr<XWalkExtension> extension(
+      CreateExternalExtension(dir.path().AppendASCII("libfoo.so")));
+  ASSERT_TRUE(extension);
+  EXPECT_EQ("foo", extension->name());
+  EXPECT_TRUE(extension->message_batching_enabled());
+  EXPECT_EQ(base::TimeDelta::FromMilliseconds(10),
+            extension->message_batching_max_latency());
+  EXPECT_TRUE(extension->uses_dedicated_thread());
+}
@@ -0,0 +1,332 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_extension_stats.h"
+
+#include <algorithm>
+#include "base/command_line.h"
+#include "base/debug/trace_event.h"
+#include "base/lazy_instance.h"
+#include "base/memory/singleton.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/values.h"
+#include "xwalk/extensions/common/xwalk_extension_switches.h"
+
+namespace xwalk {
+namespace extensions {
+
+const char kXWalkExtensionsTraceCategory[] = "xwalk.extensions";
+
+namespace {
+
+// Bucket i counts the samples smaller than 2^i microseconds, the last one
+// also gets everything bigger than that.
+const size_t kLatencyHistogramBucketCount = 25;
+
+const char* const kMessageTypeNames[] = { "async", "sync" };
+const char* const kLaneNames[] = { "priority", "normal" };
+
+struct StatsEnabled {
+  StatsEnabled()
+      : value(CommandLine::ForCurrentProcess()->HasSwitch(
+            switches::kXWalkEnableExtensionStats)) {}
+  bool value;
+};
+
+base::LazyInstance<StatsEnabled>::Leaky g_stats_enabled =
+    LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+XWalkExtensionLatencyHistogram::XWalkExtensionLatencyHistogram()
+    : buckets_(kLatencyHistogramBucketCount, 0),
+      count_(0) {
+}
+
+XWalkExtensionLatencyHistogram::~XWalkExtensionLatencyHistogram() {
+}
+
+void XWalkExtensionLatencyHistogram::AddSample(base::TimeDelta sample) {
+  int64_t microseconds = std::max<int64_t>(sample.InMicroseconds(), 0);
+  size_t bucket = 0;
+  while (bucket < kLatencyHistogramBucketCount - 1 &&
+         microseconds >= (static_cast<int64_t>(1) << bucket))
+    bucket++;
+
+  buckets_[bucket]++;
+  count_++;
+  total_ += sample;
+  max_ = std::max(max_, sample);
+}
+
+scoped_ptr<base::DictionaryValue>
+XWalkExtensionLatencyHistogram::ToValue() const {
+  scoped_ptr<base::DictionaryValue> value(new base::DictionaryValue);
+  value->SetDouble("count", count_);
+  value->SetDouble("total_us", total_.InMicroseconds());
+  value->SetDouble("max_us", max_.InMicroseconds());
+
+  // Only the non-empty buckets are listed, keyed by their upper bound.
+  base::DictionaryValue* buckets = new base::DictionaryValue;
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    if (buckets_[i]) {
+      buckets->SetDouble(base::Int64ToString(static_cast<int64_t>(1) << i),
+                         buckets_[i]);
+    }
+  }
+  value->Set("buckets", buckets);
+  return value.Pass();
+}
+
+XWalkExtensionStats::XWalkExtensionStats()
+    : messages_to_js_(0),
+      bytes_to_js_(0),
+      queued_bytes_to_js_(0),
+      max_queued_bytes_to_js_(0),
+      pending_messages_(0),
+      max_pending_messages_(0) {
+  for (int i = 0; i < MESSAGE_TYPE_COUNT; ++i) {
+    messages_to_native_[i] = 0;
+    bytes_to_native_[i] = 0;
+  }
+}
+
+XWalkExtensionStats::~XWalkExtensionStats() {
+}
+
+void XWalkExtensionStats::RecordMessageToNative(MessageType type,
+                                                size_t bytes) {
+  base::AutoLock lock(lock_);
+  messages_to_native_[type]++;
+  bytes_to_native_[type] += bytes;
+  pending_messages_++;
+  max_pending_messages_ = std::max(max_pending_messages_, pending_messages_);
+}
+
+void XWalkExtensionStats::RecordMessageHandled(MessageType type, Lane lane,
+                                               base::TimeDelta queue_time,
+                                               base::TimeDelta handler_time) {
+  base::AutoLock lock(lock_);
+  pending_messages_--;
+  queue_time_[type].AddSample(queue_time);
+  lane_queue_time_[lane].AddSample(queue_time);
+  handler_time_[type].AddSample(handler_time);
+}
+
+void XWalkExtensionStats::RecordMessageToJS(size_t bytes) {
+  base::AutoLock lock(lock_);
+  messages_to_js_++;
+  bytes_to_js_ += bytes;
+  queued_bytes_to_js_ += bytes;
+  max_queued_bytes_to_js_ = std::max(max_queued_bytes_to_js_,
+                                     queued_bytes_to_js_);
+}
+
+void XWalkExtensionStats::RecordMessagesToJSHandled(size_t bytes) {
+  base::AutoLock lock(lock_);
+  queued_bytes_to_js_ -= bytes;
+}
+
+int XWalkExtensionStats::pending_messages() const {
+  base::AutoLock lock(lock_);
+  return pending_messages_;
+}
+
+int64_t XWalkExtensionStats::queued_bytes_to_js() const {
+  base::AutoLock lock(lock_);
+  return queued_bytes_to_js_;
+}
+
+scoped_ptr<base::DictionaryValue> XWalkExtensionStats::ToValue() const {
+  base::AutoLock lock(lock_);
+  scoped_ptr<base::DictionaryValue> value(new base::DictionaryValue);
+
+  // Counters are exposed as doubles since they may not fit in an int.
+  for (int i = 0; i < MESSAGE_TYPE_COUNT; ++i) {
+    base::DictionaryValue* type_value = new base::DictionaryValue;
+    type_value->SetDouble("messages", messages_to_native_[i]);
+    type_value->SetDouble("bytes", bytes_to_native_[i]);
+    type_value->Set("queue_time", queue_time_[i].ToValue().release());
+    type_value->Set("handler_time", handler_time_[i].ToValue().release());
+    value->Set(kMessageTypeNames[i], type_value);
+  }
+
+  base::DictionaryValue* lanes_value = new base::DictionaryValue;
+  for (int i = 0; i < LANE_COUNT; ++i) {
+    base::DictionaryValue* lane_value = new base::DictionaryValue;
+    lane_value->Set("queue_time", lane_queue_time_[i].ToValue().release());
+    lanes_value->Set(kLaneNames[i], lane_value);
+  }
+  value->Set("lanes", lanes_value);
+
+  base::DictionaryValue* to_js_value = new base::DictionaryValue;
+  to_js_value->SetDouble("messages", messages_to_js_);
+  to_js_value->SetDouble("bytes", bytes_to_js_);
+  to_js_value->SetDouble("queued_bytes", queued_bytes_to_js_);
+  to_js_value->SetDouble("max_queued_bytes", max_queued_bytes_to_js_);
+  value->Set("to_js", to_js_value);
+
+  value->SetInteger("pending_messages", pending_messages_);
+  value->SetInteger("max_pending_messages", max_pending_messages_);
+  return value.Pass();
+}
+
+// static
+size_t XWalkExtensionStats::EstimateValueSize(const base::Value& value) {
+  switch (value.GetType()) {
+    case base::Value::TYPE_STRING: {
+      std::string str;
+      value.GetAsString(&str);
+      return str.size();
+    }
+    case base::Value::TYPE_BINARY:
+      return static_cast<const base::BinaryValue&>(value).GetSize();
+    case base::Value::TYPE_LIST: {
+      const base::ListValue& list = static_cast<const base::ListValue&>(value);
+      size_t size = 0;
+      for (base::ListValue::const_iterator it = list.begin();
+           it != list.end(); ++it)
+        size += EstimateValueSize(**it);
+      return size;
+    }
+    case base::Value::TYPE_DICTIONARY: {
+      const base::DictionaryValue& dict =
+          static_cast<const base::DictionaryValue&>(value);
+      size_t size = 0;
+      for (base::DictionaryValue::Iterator it(dict); !it.IsAtEnd();
+           it.Advance())
+        size += it.key().size() + EstimateValueSize(it.value());
+      return size;
+    }
+    default:
+      return sizeof(double);
+  }
+}
+
+// static
+bool XWalkExtensionStats::IsEnabled() {
+  return g_stats_enabled.Get().value;
+}
+
+XWalkExtensionInstanceStats::XWalkExtensionInstanceStats(
+    const std::string& extension_name, int64_t instance_id)
+    : extension_name_(extension_name),
+      instance_id_(instance_id),
+      extension_stats_(XWalkExtensionStatsRegistry::GetInstance()->
+                       GetExtensionStats(extension_name)) {
+  XWalkExtensionStatsRegistry::GetInstance()->AddInstanceStats(this);
+}
+
+XWalkExtensionInstanceStats::~XWalkExtensionInstanceStats() {
+  XWalkExtensionStatsRegistry::GetInstance()->RemoveInstanceStats(this);
+}
+
+void XWalkExtensionInstanceStats::RecordMessageToNative(
+    XWalkExtensionStats::MessageType type, size_t bytes) {
+  stats_.RecordMessageToNative(type, bytes);
+  extension_stats_->RecordMessageToNative(type, bytes);
+  TracePendingMessages();
+}
+
+void XWalkExtensionInstanceStats::RecordMessageHandled(
+    XWalkExtensionStats::MessageType type, XWalkExtensionStats::Lane lane,
+    base::TimeDelta queue_time, base::TimeDelta handler_time) {
+  stats_.RecordMessageHandled(type, lane, queue_time, handler_time);
+  extension_stats_->RecordMessageHandled(type, lane, queue_time,
+                                         handler_time);
+  TracePendingMessages();
+}
+
+void XWalkExtensionInstanceStats::RecordMessageToJS(size_t bytes) {
+  stats_.RecordMessageToJS(bytes);
+  extension_stats_->RecordMessageToJS(bytes);
+  TraceQueuedBytesToJS();
+}
+
+void XWalkExtensionInstanceStats::RecordMessagesToJSHandled(size_t bytes) {
+  stats_.RecordMessagesToJSHandled(bytes);
+  extension_stats_->RecordMessagesToJSHandled(bytes);
+  TraceQueuedBytesToJS();
+}
+
+void XWalkExtensionInstanceStats::TracePendingMessages() {
+  TRACE_COUNTER_ID1(kXWalkExtensionsTraceCategory,
+                    "XWalkExtensionPendingMessages", this,
+                    stats_.pending_messages());
+}
+
+void XWalkExtensionInstanceStats::TraceQueuedBytesToJS() {
+  TRACE_COUNTER_ID1(kXWalkExtensionsTraceCategory,
+                    "XWalkExtensionQueuedBytesToJS", this,
+                    stats_.queued_bytes_to_js());
+}
+
+// static
+XWalkExtensionStatsRegistry* XWalkExtensionStatsRegistry::GetInstance() {
+  // Instance stats may be destroyed in extension threads late in shutdown.
+  return Singleton<XWalkExtensionStatsRegistry,
+                   LeakySingletonTraits<XWalkExtensionStatsRegistry> >::get();
+}
+
+XWalkExtensionStatsRegistry::XWalkExtensionStatsRegistry() {
+}
+
+XWalkExtensionStatsRegistry::~XWalkExtensionStatsRegistry() {
+  ExtensionStatsMap::iterator it = extension_stats_.begin();
+  for (; it != extension_stats_.end(); ++it)
+    delete it->second;
+}
+
+XWalkExtensionStats* XWalkExtensionStatsRegistry::GetExtensionStats(
+    const std::string& extension_name) {
+  base::AutoLock lock(lock_);
+  XWalkExtensionStats*& stats = extension_stats_[extension_name];
+  if (!stats)
+    stats = new XWalkExtensionStats;
+  return stats;
+}
+
+void XWalkExtensionStatsRegistry::AddInstanceStats(
+    XWalkExtensionInstanceStats* instance_stats) {
+  base::AutoLock lock(lock_);
+  instance_stats_.insert(instance_stats);
+}
+
+void XWalkExtensionStatsRegistry::RemoveInstanceStats(
+    XWalkExtensionInstanceStats* instance_stats) {
+  base::AutoLock lock(lock_);
+  instance_stats_.erase(instance_stats);
+}
+
+scoped_ptr<base::DictionaryValue> XWalkExtensionStatsRegistry::ToValue() const {
+  base::AutoLock lock(lock_);
+  scoped_ptr<base::DictionaryValue> value(new base::DictionaryValue);
+
+  base::DictionaryValue* extensions = new base::DictionaryValue;
+  ExtensionStatsMap::const_iterator it = extension_stats_.begin();
+  for (; it != extension_stats_.end(); ++it) {
+    // Extension names contain dots, so avoid path expansion.
+    extensions->SetWithoutPathExpansion(it->first,
+                                        it->second->ToValue().release());
+  }
+  value->Set("extensions", extensions);
+
+  base::ListValue* instances = new base::ListValue;
+  std::set<XWalkExtensionInstanceStats*>::const_iterator it_instance =
+      instance_stats_.begin();
+  for (; it_instance != instance_stats_.end(); ++it_instance) {
+    const XWalkExtensionInstanceStats* instance_stats = *it_instance;
+    base::DictionaryValue* instance =
+        instance_stats->stats().ToValue().release();
+    instance->SetString("extension", instance_stats->extension_name());
+    instance->SetDouble("instance_id", instance_stats->instance_id());
+    instances->Append(instance);
+  }
+  value->Set("instances", instances);
+
+  return value.Pass();
+}
+
+}  // namespace extensions
+}  // namespace xwalk
@@ -0,0 +1,182 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_STATS_H_
+#define XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_STATS_H_
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/lock.h"
+#include "base/time.h"
+
+template <typename T> struct DefaultSingletonTraits;
+
+namespace base {
+class DictionaryValue;
+class Value;
+}
+
+namespace xwalk {
+namespace extensions {
+
+// Tracing category used by the extension system, enable it to get the time
+// spent handling each message, the number of pending messages and the bytes
+// queued to JS per instance.
+extern const char kXWalkExtensionsTraceCategory[];
+
+// Histogram of durations with exponential buckets, from 1us up to ~16s.
+class XWalkExtensionLatencyHistogram {
+ public:
+  XWalkExtensionLatencyHistogram();
+  ~XWalkExtensionLatencyHistogram();
+
+  void AddSample(base::TimeDelta sample);
+  scoped_ptr<base::DictionaryValue> ToValue() const;
+
+ private:
+  std::vector<int64_t> buckets_;
+  int64_t count_;
+  base::TimeDelta total_;
+  base::TimeDelta max_;
+};
+
+// Counters and latency histograms of the messages exchanged by an extension,
+// or by one of its instances. All methods are thread-safe.
+class XWalkExtensionStats {
+ public:
+  enum MessageType {
+    ASYNC_MESSAGE,
+    SYNC_MESSAGE,
+    MESSAGE_TYPE_COUNT
+  };
+
+  // Messages waiting for the extension thread are queued in lanes. Sync
+  // messages and async messages posted with priority go in the priority lane,
+  // which is always serviced first.
+  enum Lane {
+    PRIORITY_LANE,
+    NORMAL_LANE,
+    LANE_COUNT
+  };
+
+  XWalkExtensionStats();
+  ~XWalkExtensionStats();
+
+  // Called when a message from JS is queued to be handled by the extension.
+  void RecordMessageToNative(MessageType type, size_t bytes);
+  // Called once the extension handled a message, |queue_time| is the time it
+  // waited in |lane| to be handled in the extension thread.
+  void RecordMessageHandled(MessageType type, Lane lane,
+                            base::TimeDelta queue_time,
+                            base::TimeDelta handler_time);
+  // Messages to JS stay queued until the renderer says it handled them.
+  void RecordMessageToJS(size_t bytes);
+  void RecordMessagesToJSHandled(size_t bytes);
+
+  int pending_messages() const;
+  int64_t queued_bytes_to_js() const;
+
+  scoped_ptr<base::DictionaryValue> ToValue() const;
+
+  // Rough size of |value| in memory, used to account the bytes exchanged
+  // without serializing the messages again.
+  static size_t EstimateValueSize(const base::Value& value);
+
+  // Stats are only recorded with --enable-extension-stats, since accounting
+  // every message isn't free. The switch is only read once.
+  static bool IsEnabled();
+
+ private:
+  mutable base::Lock lock_;
+
+  int64_t messages_to_native_[MESSAGE_TYPE_COUNT];
+  int64_t bytes_to_native_[MESSAGE_TYPE_COUNT];
+  int64_t messages_to_js_;
+  int64_t bytes_to_js_;
+  int64_t queued_bytes_to_js_;
+  int64_t max_queued_bytes_to_js_;
+  int pending_messages_;
+  int max_pending_messages_;
+
+  XWalkExtensionLatencyHistogram queue_time_[MESSAGE_TYPE_COUNT];
+  XWalkExtensionLatencyHistogram handler_time_[MESSAGE_TYPE_COUNT];
+  XWalkExtensionLatencyHistogram lane_queue_time_[LANE_COUNT];
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkExtensionStats);
+};
+
+// Stats of a single extension instance. Everything recorded here is also
+// accounted in the stats of its extension, which outlive the instance. Lives
+// as long as the runner of the instance.
+class XWalkExtensionInstanceStats {
+ public:
+  XWalkExtensionInstanceStats(const std::string& extension_name,
+                              int64_t instance_id);
+  ~XWalkExtensionInstanceStats();
+
+  void RecordMessageToNative(XWalkExtensionStats::MessageType type,
+                             size_t bytes);
+  void RecordMessageHandled(XWalkExtensionStats::MessageType type,
+                            XWalkExtensionStats::Lane lane,
+                            base::TimeDelta queue_time,
+                            base::TimeDelta handler_time);
+  void RecordMessageToJS(size_t bytes);
+  void RecordMessagesToJSHandled(size_t bytes);
+
+  const std::string& extension_name() const { return extension_name_; }
+  int64_t instance_id() const { return instance_id_; }
+  const XWalkExtensionStats& stats() const { return stats_; }
+
+ private:
+  void TracePendingMessages();
+  void TraceQueuedBytesToJS();
+
+  std::string extension_name_;
+  int64_t instance_id_;
+  XWalkExtensionStats stats_;
+  XWalkExtensionStats* extension_stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkExtensionInstanceStats);
+};
+
+// Keeps the stats of all extensions and live instances of the process.
+class XWalkExtensionStatsRegistry {
+ public:
+  static XWalkExtensionStatsRegistry* GetInstance();
+
+  // The stats of an extension are created on demand and never destroyed.
+  XWalkExtensionStats* GetExtensionStats(const std::string& extension_name);
+
+  void AddInstanceStats(XWalkExtensionInstanceStats* instance_stats);
+  void RemoveInstanceStats(XWalkExtensionInstanceStats* instance_stats);
+
+  // Returns a dictionary with an "extensions" dictionary keyed by extension
+  // name and an "instances" list with the stats of each live instance.
+  scoped_ptr<base::DictionaryValue> ToValue() const;
+
+ private:
+  friend struct DefaultSingletonTraits<XWalkExtensionStatsRegistry>;
+
+  XWalkExtensionStatsRegistry();
+  ~XWalkExtensionStatsRegistry();
+
+  mutable base::Lock lock_;
+
+  typedef std::map<std::string, XWalkExtensionStats*> ExtensionStatsMap;
+  ExtensionStatsMap extension_stats_;
+
+  std::set<XWalkExtensionInstanceStats*> instance_stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkExtensionStatsRegistry);
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_STATS_H_
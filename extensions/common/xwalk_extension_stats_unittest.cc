@@ -0,0 +1,105 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_extension_stats.h"
+
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using xwalk::extensions::XWalkExtensionInstanceStats;
+using xwalk::extensions::XWalkExtensionStats;
+using xwalk::extensions::XWalkExtensionStatsRegistry;
+
+namespace {
+
+double GetDouble(const base::DictionaryValue& value, const std::string& path) {
+  double result = -1;
+  EXPECT_TRUE(value.GetDouble(path, &result)) << path;
+  return result;
+}
+
+// Other tests may have instances alive, so only count the ones of |name|.
+size_t CountInstancesOfExtension(const std::string& name) {
+  scoped_ptr<base::DictionaryValue> value =
+      XWalkExtensionStatsRegistry::GetInstance()->ToValue();
+  base::ListValue* instances;
+  EXPECT_TRUE(value->GetList("instances", &instances));
+
+  size_t count = 0;
+  for (size_t i = 0; i < instances->GetSize(); ++i) {
+    base::DictionaryValue* instance;
+    std::string extension_name;
+    if (instances->GetDictionary(i, &instance) &&
+        instance->GetString("extension", &extension_name) &&
+        extension_name == name)
+      count++;
+  }
+  return count;
+}
+
+}  // namespace
+
+TEST(XWalkExtensionStatsTest, EstimateValueSize) {
+  base::StringValue string_value("12345");
+  EXPECT_EQ(5u, XWalkExtensionStats::EstimateValueSize(string_value));
+
+  base::ListValue list_value;
+  list_value.AppendString("abc");
+  list_value.AppendString("de");
+  EXPECT_EQ(5u, XWalkExtensionStats::EstimateValueSize(list_value));
+
+  base::DictionaryValue dict_value;
+  dict_value.SetString("key", "value");
+  EXPECT_EQ(8u, XWalkExtensionStats::EstimateValueSize(dict_value));
+}
+
+TEST(XWalkExtensionStatsTest, InstanceStatsAreAccountedInExtension) {
+  const std::string name = "stats_test_extension";
+  XWalkExtensionStats* extension_stats =
+      XWalkExtensionStatsRegistry::GetInstance()->GetExtensionStats(name);
+
+  {
+    XWalkExtensionInstanceStats first(name, 0);
+    XWalkExtensionInstanceStats second(name, 1);
+
+    first.RecordMessageToNative(XWalkExtensionStats::ASYNC_MESSAGE, 10);
+    first.RecordMessageToNative(XWalkExtensionStats::ASYNC_MESSAGE, 20);
+    second.RecordMessageToNative(XWalkExtensionStats::SYNC_MESSAGE, 5);
+    EXPECT_EQ(2, first.stats().pending_messages());
+    EXPECT_EQ(3, extension_stats->pending_messages());
+
+    first.RecordMessageHandled(XWalkExtensionStats::ASYNC_MESSAGE,
+                               XWalkExtensionStats::NORMAL_LANE,
+                               base::TimeDelta::FromMicroseconds(3),
+                               base::TimeDelta::FromMilliseconds(2));
+    second.RecordMessageToJS(7);
+    second.RecordMessageToJS(3);
+    second.RecordMessagesToJSHandled(7);
+    EXPECT_EQ(1, first.stats().pending_messages());
+    EXPECT_EQ(3, second.stats().queued_bytes_to_js());
+
+    EXPECT_EQ(2u, CountInstancesOfExtension(name));
+  }
+
+  scoped_ptr<base::DictionaryValue> value = extension_stats->ToValue();
+  EXPECT_EQ(2, GetDouble(*value, "async.messages"));
+  EXPECT_EQ(30, GetDouble(*value, "async.bytes"));
+  EXPECT_EQ(1, GetDouble(*value, "sync.messages"));
+  EXPECT_EQ(1, GetDouble(*value, "async.queue_time.count"));
+  EXPECT_EQ(1, GetDouble(*value, "lanes.normal.queue_time.count"));
+  EXPECT_EQ(0, GetDouble(*value, "lanes.priority.queue_time.count"));
+  EXPECT_EQ(2000, GetDouble(*value, "async.handler_time.max_us"));
+  EXPECT_EQ(1, GetDouble(*value, "async.handler_time.buckets.2048"));
+  EXPECT_EQ(10, GetDouble(*value, "to_js.bytes"));
+  EXPECT_EQ(3, GetDouble(*value, "to_js.queued_bytes"));
+  EXPECT_EQ(10, GetDouble(*value, "to_js.max_queued_bytes"));
+
+  int max_pending_messages;
+  ASSERT_TRUE(value->GetInteger("max_pending_messages",
+                                &max_pending_messages));
+  EXPECT_EQ(3, max_pending_messages);
+
+  // Destroyed instances are not listed anymore.
+  EXPECT_EQ(0u, CountInstancesOfExtension(name));
+}
@@ -13,4 +13,43 @@ namespace switches {
 const char kXWalkEnableExtensionProcess[] =
     "enable-extension-process";
 
+// Value of the --type switch for the extension process.
+const char kXWalkExtensionProcess[] =
+    "xwalk-extension-process";
+
+// Maximum number of threads shared by all extension instances running in the
+// process, 4 by default. Each instance runs as a sequence on this pool, so
+// while that many instances are blocked in their handlers, the others can't
+// run. Extensions that block should ask for a dedicated thread instead, which
+// isn't taken from this pool.
+const char kXWalkExtensionThreadPoolSize[] =
+    "extension-thread-pool-size";
+
+// Directory where the browser stores the pre-compilation data it creates for
+// the extensions JS API code, so that render processes don't need to create
+// it, in this run or later ones. No data is persisted if not present.
+const char kXWalkExtensionScriptCacheDir[] =
+    "extension-script-cache-dir";
+
+const char kXWalkDisableExtensionSyncFastPath[] =
+    "disable-extension-sync-fast-path";
+
+// Makes the render process convert the messages posted to extensions to
+// base::Value before sending them, instead of serializing them straight from
+// the JS values.
+const char kXWalkDisableExtensionSerializedMessages[] =
+    "disable-extension-serialized-messages";
+
+// Watches the external extensions directory, so libraries added, removed or
+// replaced there are registered or retired while the runtime is running. Not
+// supported together with the extension process.
+const char kXWalkWatchExternalExtensions[] =
+    "watch-external-extensions";
+
+// Records extension message stats and exposes them through
+// xwalk.runtime.getExtensionStats(). The stats cover the extension instances
+// of every render process, so they are meant for monitoring tools only.
+const char kXWalkEnableExtensionStats[] =
+    "enable-extension-stats";
+
 }  // namespace switches
@@ -9,6 +9,13 @@
 namespace switches {
 
 extern const char kXWalkEnableExtensionProcess[];
+extern const char kXWalkExtensionProcess[];
+extern const char kXWalkExtensionThreadPoolSize[];
+extern const char kXWalkExtensionScriptCacheDir[];
+extern const char kXWalkDisableExtensionSyncFastPath[];
+extern const char kXWalkDisableExtensionSerializedMessages[];
+extern const char kXWalkWatchExternalExtensions[];
+extern const char kXWalkEnableExtensionStats[];
 
 }  // namespace switches
 
@@ -0,0 +1,193 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_extension_sync_message_slot.h"
+
+#include <string.h>
+#include <vector>
+
+#if defined(OS_POSIX)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/process_util.h"
+#include "base/values.h"
+#include "ipc/ipc_message.h"
+#include "ipc/ipc_message_utils.h"
+
+namespace xwalk {
+namespace extensions {
+
+namespace {
+
+// The slot starts with the size of the pickled message.
+struct SlotHeader {
+  uint32_t size;
+};
+
+const size_t kPayloadCapacity =
+    XWalkExtensionSyncMessageSlot::kSize - sizeof(SlotHeader);
+
+}  // namespace
+
+// static
+bool XWalkExtensionSyncMessageSlot::IsSupported() {
+#if defined(OS_LINUX)
+  return true;
+#else
+  return false;
+#endif
+}
+
+#if defined(OS_POSIX)
+
+// static
+scoped_refptr<XWalkExtensionSyncMessageSlot>
+XWalkExtensionSyncMessageSlot::Create(base::SharedMemoryHandle* peer_memory,
+                                      int* peer_socket) {
+#if defined(OS_LINUX)
+  scoped_ptr<base::SharedMemory> memory(new base::SharedMemory);
+  if (!memory->CreateAndMapAnonymous(kSize))
+    return NULL;
+  if (!memory->ShareToProcess(base::GetCurrentProcessHandle(), peer_memory))
+    return NULL;
+
+  // Sequenced packets keep the boundaries between requests.
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) != 0) {
+    PLOG(WARNING) << "Couldn't create socket for sync messages";
+    close(peer_memory->fd);
+    return NULL;
+  }
+  if (fcntl(fds[0], F_SETFL, O_NONBLOCK) != 0) {
+    close(fds[0]);
+    close(fds[1]);
+    close(peer_memory->fd);
+    return NULL;
+  }
+
+  *peer_socket = fds[1];
+  return new XWalkExtensionSyncMessageSlot(memory.Pass(), fds[0]);
+#else
+  return NULL;
+#endif
+}
+
+// static
+scoped_refptr<XWalkExtensionSyncMessageSlot>
+XWalkExtensionSyncMessageSlot::Open(base::SharedMemoryHandle memory_handle,
+                                    int socket) {
+  scoped_ptr<base::SharedMemory> memory(
+      new base::SharedMemory(memory_handle, false));
+  if (!memory->Map(kSize)) {
+    if (socket >= 0)
+      close(socket);
+    return NULL;
+  }
+  return new XWalkExtensionSyncMessageSlot(memory.Pass(), socket);
+}
+
+XWalkExtensionSyncMessageSlot::XWalkExtensionSyncMessageSlot(
+    scoped_ptr<base::SharedMemory> memory, int socket)
+    : memory_(memory.Pass()),
+      socket_(socket) {
+}
+
+XWalkExtensionSyncMessageSlot::~XWalkExtensionSyncMessageSlot() {
+  if (socket_ >= 0 && HANDLE_EINTR(close(socket_)) < 0)
+    PLOG(ERROR) << "close";
+}
+
+bool XWalkExtensionSyncMessageSlot::WriteValue(const base::Value& value) {
+  // Values can't be pickled directly, so we wrap them in a list just like the
+  // IPC messages do.
+  base::ListValue list;
+  list.Append(value.DeepCopy());
+
+  IPC::Message pickle;
+  IPC::WriteParam(&pickle, list);
+  if (pickle.size() > kPayloadCapacity)
+    return false;
+
+  char* memory = static_cast<char*>(memory_->memory());
+  SlotHeader header = { static_cast<uint32_t>(pickle.size()) };
+  memcpy(memory, &header, sizeof(header));
+  memcpy(memory + sizeof(header), pickle.data(), pickle.size());
+  return true;
+}
+
+scoped_ptr<base::Value> XWalkExtensionSyncMessageSlot::ReadValue() {
+  const char* memory = static_cast<const char*>(memory_->memory());
+  SlotHeader header;
+  memcpy(&header, memory, sizeof(header));
+  if (header.size > kPayloadCapacity)
+    return scoped_ptr<base::Value>();
+
+  std::vector<char> data(memory + sizeof(header),
+                         memory + sizeof(header) + header.size);
+  if (data.empty())
+    return scoped_ptr<base::Value>();
+
+  IPC::Message pickle(&data[0], data.size());
+  PickleIterator iter(pickle);
+  base::ListValue list;
+  if (!IPC::ReadParam(&pickle, &iter, &list))
+    return scoped_ptr<base::Value>();
+
+  base::Value* value;
+  if (!list.Remove(0, &value))
+    return scoped_ptr<base::Value>();
+  return scoped_ptr<base::Value>(value);
+}
+
+bool XWalkExtensionSyncMessageSlot::SendRequest(
+    uint64_t async_messages_before) {
+  ssize_t sent = HANDLE_EINTR(send(socket_, &async_messages_before,
+                                   sizeof(async_messages_before), 0));
+  return sent == sizeof(async_messages_before);
+}
+
+XWalkExtensionSyncMessageSlot::ReplyStatus
+XWalkExtensionSyncMessageSlot::WaitForReply() {
+  char status;
+  ssize_t received = HANDLE_EINTR(recv(socket_, &status, sizeof(status), 0));
+  if (received != sizeof(status))
+    return REPLY_NONE;
+  if (status != REPLY_IN_SLOT && status != REPLY_TOO_LARGE)
+    return REPLY_NONE;
+  return static_cast<ReplyStatus>(status);
+}
+
+bool XWalkExtensionSyncMessageSlot::ReadRequest(
+    uint64_t* async_messages_before, bool* closed) {
+  *closed = false;
+  ssize_t received = HANDLE_EINTR(recv(socket_, async_messages_before,
+                                       sizeof(*async_messages_before), 0));
+  if (received == 0 || (received < 0 && errno != EAGAIN &&
+                        errno != EWOULDBLOCK))
+    *closed = true;
+  return received == sizeof(*async_messages_before);
+}
+
+bool XWalkExtensionSyncMessageSlot::SendReply(ReplyStatus status) {
+  char status_byte = status;
+  // The render process could be gone already, which is not worth a SIGPIPE.
+  int flags = 0;
+#if defined(MSG_NOSIGNAL)
+  flags = MSG_NOSIGNAL;
+#endif
+  ssize_t sent = HANDLE_EINTR(send(socket_, &status_byte, sizeof(status_byte),
+                                   flags));
+  return sent == sizeof(status_byte);
+}
+
+#endif  // defined(OS_POSIX)
+
+}  // namespace extensions
+}  // namespace xwalk
@@ -0,0 +1,89 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_SYNC_MESSAGE_SLOT_H_
+#define XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_SYNC_MESSAGE_SLOT_H_
+
+#include <stdint.h>
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/shared_memory.h"
+
+namespace base {
+class Value;
+}
+
+namespace xwalk {
+namespace extensions {
+
+// Shared memory area and socket used by a render process to send sync messages
+// to an extension instance without going through the IPC channel, so they
+// skip the IO thread hops in both processes.
+//
+// The render process writes the request in the shared memory and sends the
+// number of async messages it posted before it through the socket, so the
+// server can keep the order between them. The server writes the reply in the
+// same area and sends back a byte telling how to get it. The render process
+// stays blocked on the socket meanwhile, if the server side goes away it gets
+// unblocked by the socket being closed.
+//
+// Only available on Linux for now, elsewhere sync messages always use IPC.
+class XWalkExtensionSyncMessageSlot
+    : public base::RefCountedThreadSafe<XWalkExtensionSyncMessageSlot> {
+ public:
+  // Messages that don't fit here go through IPC.
+  static const size_t kSize = 64 * 1024;
+
+  enum ReplyStatus {
+    REPLY_IN_SLOT = 1,
+    // The reply is waiting in the server, to be fetched through IPC.
+    REPLY_TOO_LARGE,
+    // The server side is gone.
+    REPLY_NONE
+  };
+
+  static bool IsSupported();
+
+  // Creates a new slot for the server side. |peer_memory| and |peer_socket|
+  // should be sent to the render process, which takes their ownership.
+  static scoped_refptr<XWalkExtensionSyncMessageSlot> Create(
+      base::SharedMemoryHandle* peer_memory, int* peer_socket);
+  // Opens in the render process the slot created by the server.
+  static scoped_refptr<XWalkExtensionSyncMessageSlot> Open(
+      base::SharedMemoryHandle memory, int socket);
+
+  int socket() const { return socket_; }
+
+  // Returns false if |value| doesn't fit in the slot.
+  bool WriteValue(const base::Value& value);
+  // The contents are copied before being parsed, since the other side could
+  // change them meanwhile. Returns NULL if they are not valid.
+  scoped_ptr<base::Value> ReadValue();
+
+  // Used by the render process.
+  bool SendRequest(uint64_t async_messages_before);
+  ReplyStatus WaitForReply();
+
+  // Used by the server, the socket is non-blocking on its side.
+  bool ReadRequest(uint64_t* async_messages_before, bool* closed);
+  bool SendReply(ReplyStatus status);
+
+ private:
+  friend class base::RefCountedThreadSafe<XWalkExtensionSyncMessageSlot>;
+
+  XWalkExtensionSyncMessageSlot(scoped_ptr<base::SharedMemory> memory,
+                                int socket);
+  ~XWalkExtensionSyncMessageSlot();
+
+  scoped_ptr<base::SharedMemory> memory_;
+  int socket_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkExtensionSyncMessageSlot);
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_SYNC_MESSAGE_SLOT_H_
@@ -0,0 +1,93 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_extension_sync_message_slot.h"
+
+#include <string>
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using xwalk::extensions::XWalkExtensionSyncMessageSlot;
+
+#if defined(OS_LINUX)
+
+namespace {
+
+// Both ends of the slot live in this process for the tests.
+void CreateSlotPair(scoped_refptr<XWalkExtensionSyncMessageSlot>* server,
+                    scoped_refptr<XWalkExtensionSyncMessageSlot>* client) {
+  base::SharedMemoryHandle memory;
+  int socket;
+  *server = XWalkExtensionSyncMessageSlot::Create(&memory, &socket);
+  ASSERT_TRUE(server->get());
+  *client = XWalkExtensionSyncMessageSlot::Open(memory, socket);
+  ASSERT_TRUE(client->get());
+}
+
+}  // namespace
+
+TEST(XWalkExtensionSyncMessageSlotTest, RoundTrip) {
+  scoped_refptr<XWalkExtensionSyncMessageSlot> server;
+  scoped_refptr<XWalkExtensionSyncMessageSlot> client;
+  CreateSlotPair(&server, &client);
+
+  uint64_t async_messages_before;
+  bool closed;
+  EXPECT_FALSE(server->ReadRequest(&async_messages_before, &closed));
+  EXPECT_FALSE(closed);
+
+  ASSERT_TRUE(client->WriteValue(base::StringValue("request")));
+  ASSERT_TRUE(client->SendRequest(42));
+  ASSERT_TRUE(server->ReadRequest(&async_messages_before, &closed));
+  EXPECT_EQ(42u, async_messages_before);
+
+  scoped_ptr<base::Value> request = server->ReadValue();
+  ASSERT_TRUE(request);
+  EXPECT_TRUE(base::StringValue("request").Equals(request.get()));
+
+  ASSERT_TRUE(server->WriteValue(base::FundamentalValue(7)));
+  ASSERT_TRUE(server->SendReply(XWalkExtensionSyncMessageSlot::REPLY_IN_SLOT));
+  EXPECT_EQ(XWalkExtensionSyncMessageSlot::REPLY_IN_SLOT,
+            client->WaitForReply());
+
+  scoped_ptr<base::Value> reply = client->ReadValue();
+  ASSERT_TRUE(reply);
+  EXPECT_TRUE(base::FundamentalValue(7).Equals(reply.get()));
+}
+
+TEST(XWalkExtensionSyncMessageSlotTest, ValueTooLarge) {
+  scoped_refptr<XWalkExtensionSyncMessageSlot> server;
+  scoped_refptr<XWalkExtensionSyncMessageSlot> client;
+  CreateSlotPair(&server, &client);
+
+  std::string large(XWalkExtensionSyncMessageSlot::kSize, 'x');
+  EXPECT_FALSE(client->WriteValue(base::StringValue(large)));
+
+  std::string small(XWalkExtensionSyncMessageSlot::kSize / 2, 'x');
+  EXPECT_TRUE(client->WriteValue(base::StringValue(small)));
+}
+
+TEST(XWalkExtensionSyncMessageSlotTest, ServerGone) {
+  scoped_refptr<XWalkExtensionSyncMessageSlot> server;
+  scoped_refptr<XWalkExtensionSyncMessageSlot> client;
+  CreateSlotPair(&server, &client);
+
+  server = NULL;
+  EXPECT_EQ(XWalkExtensionSyncMessageSlot::REPLY_NONE, client->WaitForReply());
+}
+
+TEST(XWalkExtensionSyncMessageSlotTest, ClientGone) {
+  scoped_refptr<XWalkExtensionSyncMessageSlot> server;
+  scoped_refptr<XWalkExtensionSyncMessageSlot> client;
+  CreateSlotPair(&server, &client);
+
+  client = NULL;
+  uint64_t async_messages_before;
+  bool closed;
+  EXPECT_FALSE(server->ReadRequest(&async_messages_before, &closed));
+  EXPECT_TRUE(closed);
+  EXPECT_FALSE(server->SendReply(XWalkExtensionSyncMessageSlot::REPLY_IN_SLOT));
+}
+
+#endif  // defined(OS_LINUX)
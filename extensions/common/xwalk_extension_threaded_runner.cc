@@ -5,14 +5,65 @@
 #include "xwalk/extensions/common/xwalk_extension_threaded_runner.h"
 
 #include "base/bind.h"
+#include "base/command_line.h"
+#include "base/debug/trace_event.h"
+#include "base/lazy_instance.h"
+#include "base/sequenced_task_runner.h"
 #include "base/single_thread_task_runner.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/synchronization/lock.h"
-#include "base/threading/thread.h"
-#include "base/threading/thread_restrictions.h"
+#include "base/threading/worker_pool.h"
+#include "xwalk/extensions/common/xwalk_extension_serialized_value.h"
+#include "xwalk/extensions/common/xwalk_extension_switches.h"
 
 namespace xwalk {
 namespace extensions {
 
+namespace {
+
+const size_t kDefaultExtensionThreadPoolSize = 4;
+
+size_t GetExtensionThreadPoolSize() {
+  CommandLine* cmd_line = CommandLine::ForCurrentProcess();
+  if (!cmd_line->HasSwitch(switches::kXWalkExtensionThreadPoolSize))
+    return kDefaultExtensionThreadPoolSize;
+
+  std::string value =
+      cmd_line->GetSwitchValueASCII(switches::kXWalkExtensionThreadPoolSize);
+  int pool_size;
+  if (!base::StringToInt(value, &pool_size) || pool_size <= 0) {
+    LOG(WARNING) << "Ignoring invalid extension thread pool size: " << value;
+    return kDefaultExtensionThreadPoolSize;
+  }
+  return pool_size;
+}
+
+// The pool is never shut down: extension contexts are destroyed by their
+// runners before the process goes away, and the worker threads are reclaimed
+// with the process.
+class ExtensionWorkerPool {
+ public:
+  ExtensionWorkerPool()
+      : pool_(new base::SequencedWorkerPool(GetExtensionThreadPoolSize(),
+                                            "XWalk_ExtensionWorker")) {}
+
+  base::SequencedWorkerPool* pool() const { return pool_.get(); }
+
+ private:
+  scoped_refptr<base::SequencedWorkerPool> pool_;
+};
+
+base::LazyInstance<ExtensionWorkerPool>::Leaky g_extension_worker_pool =
+    LAZY_INSTANCE_INITIALIZER;
+
+// Stopping the dedicated thread joins it, so it's done where blocking is
+// allowed, once the thread has run its last task.
+void StopDedicatedThread(scoped_ptr<base::Thread> thread) {
+  thread->Stop();
+}
+
+}  // namespace
+
 // This object is responsible for calling the client on behalf of the extension
 // thread. When the threaded runner is destroyed, it detaches this object so
 // pending tasks posted to client_task_runner are ignored gracefully.
@@ -46,6 +97,14 @@ class XWalkExtensionThreadedRunner::PostHelper {
     runner_->PostReplyMessageToClient(ipc_reply.Pass(), msg.Pass());
   }
 
+  void StartMessagesToJSAcksInClient() {
+    base::AutoLock lock(lock_);
+    if (!runner_)
+      return;
+    CHECK(runner_->client_task_runner_ == base::MessageLoopProxy::current());
+    runner_->StartMessagesToJSAcksInClient();
+  }
+
   // The helper will be destroyed when this function leaves and the scoped_ptr
   // goes out of scope. We post this function passing the internal helper object
   // in the client task runner so that is run after all pending post messages
@@ -62,13 +121,20 @@ XWalkExtensionThreadedRunner::XWalkExtensionThreadedRunner(
     base::SingleThreadTaskRunner* client_task_runner, int64_t instance_id)
     : XWalkExtensionRunner(extension->name(), client, instance_id),
       extension_(extension),
-      sync_message_event_(false, false),
       client_task_runner_(client_task_runner),
       helper_(new PostHelper(this)) {
   CHECK(client_task_runner_);
-  std::string thread_name = "XWalk_ExtensionThread_" + extension_->name();
-  thread_.reset(new base::Thread(thread_name.c_str()));
-  thread_->Start();
+  if (extension->uses_dedicated_thread()) {
+    std::string thread_name = "XWalk_ExtensionThread_" + extension->name();
+    thread_.reset(new base::Thread(thread_name.c_str()));
+    CHECK(thread_->Start());
+    task_runner_ = thread_->message_loop_proxy();
+  } else {
+    base::SequencedWorkerPool* pool = GetWorkerPool();
+    sequence_token_ = pool->GetSequenceToken();
+    task_runner_ = pool->GetSequencedTaskRunnerWithShutdownBehavior(
+        sequence_token_, base::SequencedWorkerPool::CONTINUE_ON_SHUTDOWN);
+  }
   PostTaskToExtensionThread(
       FROM_HERE,
       base::Bind(&XWalkExtensionThreadedRunner::CreateContext,
@@ -76,57 +142,131 @@ XWalkExtensionThreadedRunner::XWalkExtensionThreadedRunner(
 }
 
 XWalkExtensionThreadedRunner::~XWalkExtensionThreadedRunner() {
+  DCHECK(!context_);
+  DCHECK(!helper_);
+}
+
+void XWalkExtensionThreadedRunner::Destroy(
+    const base::Closure& destroyed_callback) {
   // Invalidate our helper poster. From now on calls to post will be ignored
   // since the client doesn't care about us anymore.
   helper_->Invalidate();
 
-  // All Context related code should run in the thread.
+  // All Context related code should run in the extension thread. We don't wait
+  // for it here, so the browser thread is never blocked by an extension that
+  // is still busy; the runner deletes itself once the context is gone.
   PostTaskToExtensionThread(
       FROM_HERE,
       base::Bind(&XWalkExtensionThreadedRunner::DestroyContext,
-                 base::Unretained(this)));
-
-  // Waiting on the browser thread is frowned upon since it might cause jank
-  // (there's no way to know how much time the extension thread might be blocked
-  // for).  However, it's not safe to destroy the extension context from a
-  // thread other than the extension thread.  We temporarily turn off this
-  // restriction, wait for the extension thread to be properly destroyed, and
-  // enable the restriction again.
-  //
-  // FIXME(leandro): Find a way to properly destroy an extension context without
-  // blocking the browser thread.
-  base::ThreadRestrictions::ScopedAllowIO allow_io;
-  thread_->Stop();
+                 base::Unretained(this), destroyed_callback));
 }
 
-void XWalkExtensionThreadedRunner::HandleMessageFromClient(
-    scoped_ptr<base::Value> msg) {
+// Acks don't wait in the lanes, they don't call the extension unless it has
+// to be told that it can post messages again.
+void XWalkExtensionThreadedRunner::AckMessagesToJS(size_t count) {
   PostTaskToExtensionThread(
       FROM_HERE,
+      base::Bind(&XWalkExtensionThreadedRunner::CallMessagesToJSHandled,
+                 base::Unretained(this), count));
+}
+
+// static
+base::SequencedWorkerPool* XWalkExtensionThreadedRunner::GetWorkerPool() {
+  return g_extension_worker_pool.Get().pool();
+}
+
+void XWalkExtensionThreadedRunner::HandleMessageFromClient(
+    scoped_ptr<base::Value> msg, XWalkExtensionStats::Lane lane) {
+  PostTaskToLane(
+      lane, FROM_HERE,
       base::Bind(&XWalkExtensionThreadedRunner::CallHandleMessage,
                  base::Unretained(this),
+                 lane,
+                 base::TimeTicks::Now(),
+                 base::Passed(&msg)));
+}
+
+void XWalkExtensionThreadedRunner::HandleSerializedMessageFromClient(
+    scoped_ptr<std::string> msg, XWalkExtensionStats::Lane lane) {
+  PostTaskToLane(
+      lane, FROM_HERE,
+      base::Bind(&XWalkExtensionThreadedRunner::CallHandleSerializedMessage,
+                 base::Unretained(this),
+                 lane,
+                 base::TimeTicks::Now(),
                  base::Passed(&msg)));
 }
 
 void XWalkExtensionThreadedRunner::HandleSyncMessageFromClient(
     scoped_ptr<IPC::Message> ipc_reply, scoped_ptr<base::Value> msg) {
-  PostTaskToExtensionThread(
-      FROM_HERE,
+  PostTaskToLane(
+      XWalkExtensionStats::PRIORITY_LANE, FROM_HERE,
       base::Bind(&XWalkExtensionThreadedRunner::CallHandleSyncMessage,
                  base::Unretained(this),
+                 base::TimeTicks::Now(),
                  base::Passed(&ipc_reply),
                  base::Passed(&msg)));
 }
 
+void XWalkExtensionThreadedRunner::HandleSyncMessageFromClient(
+    scoped_ptr<base::Value> msg, const SyncReplyCallback& callback) {
+  PostTaskToLane(
+      XWalkExtensionStats::PRIORITY_LANE, FROM_HERE,
+      base::Bind(
+          &XWalkExtensionThreadedRunner::CallHandleSyncMessageWithCallback,
+          base::Unretained(this),
+          base::TimeTicks::Now(),
+          callback,
+          base::Passed(&msg)));
+}
+
 bool XWalkExtensionThreadedRunner::CalledOnExtensionThread() const {
-  return base::MessageLoop::current() == thread_->message_loop();
+  if (thread_)
+    return task_runner_->RunsTasksOnCurrentThread();
+  return GetWorkerPool()->IsRunningSequenceOnCurrentThread(sequence_token_);
 }
 
 bool XWalkExtensionThreadedRunner::PostTaskToExtensionThread(
     const tracked_objects::Location& from_here,
     const base::Closure& task) {
-  // FIXME(cmarcelo): Can we cache this message_loop_proxy?
-  return thread_->message_loop_proxy()->PostTask(from_here, task);
+  return task_runner_->PostTask(from_here, task);
+}
+
+void XWalkExtensionThreadedRunner::PostTaskToLane(
+    XWalkExtensionStats::Lane lane,
+    const tracked_objects::Location& from_here,
+    const base::Closure& task) {
+  {
+    base::AutoLock lock(lanes_lock_);
+    lanes_[lane].push_back(task);
+  }
+  PostTaskToExtensionThread(
+      from_here,
+      base::Bind(&XWalkExtensionThreadedRunner::RunNextLaneTask,
+                 base::Unretained(this)));
+}
+
+// Every task queued in a lane posts one of these, but they don't necessarily
+// run the task that posted them: the oldest task of the priority lane runs
+// first, so a sync message doesn't wait behind the async ones already posted.
+// Since there's one call per queued task, all of them run before the context
+// is destroyed.
+void XWalkExtensionThreadedRunner::RunNextLaneTask() {
+  CHECK(CalledOnExtensionThread());
+  base::Closure task;
+  {
+    base::AutoLock lock(lanes_lock_);
+    for (int i = 0; i < XWalkExtensionStats::LANE_COUNT; ++i) {
+      if (lanes_[i].empty())
+        continue;
+      task = lanes_[i].front();
+      lanes_[i].pop_front();
+      break;
+    }
+  }
+  DCHECK(!task.is_null());
+  if (!task.is_null())
+    task.Run();
 }
 
 void XWalkExtensionThreadedRunner::CreateContext() {
@@ -136,16 +276,25 @@ void XWalkExtensionThreadedRunner::CreateContext() {
       &XWalkExtensionThreadedRunner::PostMessageToClientTaskRunner,
       base::Unretained(this)));
   if (!instance) {
+    // Messages sent to this runner will be dropped until the client destroys
+    // it, we can't delete ourselves since the client still refers to us.
     VLOG(0) << "Could not create instance for extension '"
-            << extension_->name() << "'. Destroying extension thread.";
-    delete this;
+            << extension_->name() << "'. Ignoring its messages.";
     return;
   }
 
   context_.reset(instance);
+
+  // The stats need the bytes queued in the renderer, otherwise messages only
+  // get accounted and acked if the instance sets watermarks.
+  context_->SetMessagesToJSAcksCallback(
+      base::Bind(&XWalkExtensionThreadedRunner::StartMessagesToJSAcks,
+                 base::Unretained(this)),
+      stats() != NULL);
 }
 
-void XWalkExtensionThreadedRunner::DestroyContext() {
+void XWalkExtensionThreadedRunner::DestroyContext(
+    const base::Closure& destroyed_callback) {
   CHECK(CalledOnExtensionThread());
   context_.reset();
 
@@ -154,21 +303,72 @@ void XWalkExtensionThreadedRunner::DestroyContext() {
   client_task_runner_->PostTask(
       FROM_HERE,
       base::Bind(&PostHelper::Destroy, base::Passed(&helper_)));
+
+  if (!destroyed_callback.is_null())
+    destroyed_callback.Run();
+
+  // The thread can't be stopped from itself.
+  if (thread_) {
+    base::WorkerPool::PostTask(
+        FROM_HERE,
+        base::Bind(&StopDedicatedThread, base::Passed(&thread_)),
+        false);
+  }
+
+  // This was the last task for this runner, the client already forgot about
+  // us, so nobody else refers to this object.
+  delete this;
 }
 
 void XWalkExtensionThreadedRunner::CallHandleMessage(
+    XWalkExtensionStats::Lane lane, base::TimeTicks post_time,
     scoped_ptr<base::Value> msg) {
   CHECK(CalledOnExtensionThread());
-  CHECK(context_);
-  context_->HandleMessage(msg.Pass());
+  TRACE_EVENT2(kXWalkExtensionsTraceCategory,
+               "XWalkExtensionThreadedRunner::CallHandleMessage",
+               "extension", extension_name(), "instance", instance_id());
+
+  base::TimeTicks start_time = base::TimeTicks::Now();
+  if (context_)
+    context_->HandleMessage(msg.Pass());
+
+  if (stats()) {
+    stats()->RecordMessageHandled(XWalkExtensionStats::ASYNC_MESSAGE, lane,
+                                  start_time - post_time,
+                                  base::TimeTicks::Now() - start_time);
+  }
 }
 
-void XWalkExtensionThreadedRunner::CallHandleSyncMessage(
-    scoped_ptr<IPC::Message> ipc_reply, scoped_ptr<base::Value> msg) {
+// The message is read in place by the context, it is only validated here.
+void XWalkExtensionThreadedRunner::CallHandleSerializedMessage(
+    XWalkExtensionStats::Lane lane, base::TimeTicks post_time,
+    scoped_ptr<std::string> msg) {
   CHECK(CalledOnExtensionThread());
+  TRACE_EVENT2(kXWalkExtensionsTraceCategory,
+               "XWalkExtensionThreadedRunner::CallHandleSerializedMessage",
+               "extension", extension_name(), "instance", instance_id());
+
+  base::TimeTicks start_time = base::TimeTicks::Now();
+  XWalkSerializedValue value(msg->data(), msg->size());
+  if (!value.is_valid()) {
+    LOG(WARNING) << "Ignoring malformed message to extension "
+                 << extension_name();
+  } else if (context_) {
+    context_->HandleSerializedMessage(value);
+  }
+
+  if (stats()) {
+    stats()->RecordMessageHandled(XWalkExtensionStats::ASYNC_MESSAGE, lane,
+                                  start_time - post_time,
+                                  base::TimeTicks::Now() - start_time);
+  }
+}
 
+void XWalkExtensionThreadedRunner::CallHandleSyncMessage(
+    base::TimeTicks post_time, scoped_ptr<IPC::Message> ipc_reply,
+    scoped_ptr<base::Value> msg) {
   scoped_ptr<base::Value> result_msg(
-      context_->HandleSyncMessage(msg.Pass()));
+      RunSyncMessageHandler(post_time, msg.Pass()));
 
   client_task_runner_->PostTask(
       FROM_HERE,
@@ -178,6 +378,45 @@ void XWalkExtensionThreadedRunner::CallHandleSyncMessage(
                  base::Passed(&result_msg)));
 }
 
+void XWalkExtensionThreadedRunner::CallHandleSyncMessageWithCallback(
+    base::TimeTicks post_time, const SyncReplyCallback& callback,
+    scoped_ptr<base::Value> msg) {
+  callback.Run(RunSyncMessageHandler(post_time, msg.Pass()));
+}
+
+void XWalkExtensionThreadedRunner::CallMessagesToJSHandled(size_t count) {
+  CHECK(CalledOnExtensionThread());
+  if (!context_)
+    return;
+  size_t bytes = context_->OnMessagesToJSHandled(count);
+  if (stats())
+    stats()->RecordMessagesToJSHandled(bytes);
+}
+
+scoped_ptr<base::Value> XWalkExtensionThreadedRunner::RunSyncMessageHandler(
+    base::TimeTicks post_time, scoped_ptr<base::Value> msg) {
+  CHECK(CalledOnExtensionThread());
+  TRACE_EVENT2(kXWalkExtensionsTraceCategory,
+               "XWalkExtensionThreadedRunner::CallHandleSyncMessage",
+               "extension", extension_name(), "instance", instance_id());
+
+  base::TimeTicks start_time = base::TimeTicks::Now();
+
+  // Even without a context we need to reply, otherwise the renderer would be
+  // blocked forever.
+  scoped_ptr<base::Value> result_msg(context_ ?
+      context_->HandleSyncMessage(msg.Pass()) :
+      scoped_ptr<base::Value>(base::Value::CreateNullValue()));
+
+  if (stats()) {
+    stats()->RecordMessageHandled(XWalkExtensionStats::SYNC_MESSAGE,
+                                  XWalkExtensionStats::PRIORITY_LANE,
+                                  start_time - post_time,
+                                  base::TimeTicks::Now() - start_time);
+  }
+  return result_msg.Pass();
+}
+
 void XWalkExtensionThreadedRunner::PostMessageToClientTaskRunner(
     scoped_ptr<base::Value> msg) {
   client_task_runner_->PostTask(
@@ -187,5 +426,14 @@ void XWalkExtensionThreadedRunner::PostMessageToClientTaskRunner(
                  base::Passed(&msg)));
 }
 
+void XWalkExtensionThreadedRunner::StartMessagesToJSAcks() {
+  // Posted like the messages, so the client gets it before the first message
+  // that needs an ack.
+  client_task_runner_->PostTask(
+      FROM_HERE,
+      base::Bind(&PostHelper::StartMessagesToJSAcksInClient,
+                 base::Unretained(helper_.get())));
+}
+
 }  // namespace extensions
 }  // namespace xwalk
@@ -5,17 +5,22 @@
 #ifndef XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_THREADED_RUNNER_H_
 #define XWALK_EXTENSIONS_COMMON_XWALK_EXTENSION_THREADED_RUNNER_H_
 
+#include <deque>
 #include <string>
 #include "base/callback_forward.h"
 #include "base/compiler_specific.h"
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
-#include "base/synchronization/waitable_event.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "base/threading/thread.h"
+#include "base/time.h"
 #include "xwalk/extensions/common/xwalk_extension.h"
 #include "xwalk/extensions/common/xwalk_extension_runner.h"
 
 namespace base {
+class SequencedTaskRunner;
 class SingleThreadTaskRunner;
-class Thread;
 }
 
 namespace tracked_objects {
@@ -25,45 +30,100 @@ class Location;
 namespace xwalk {
 namespace extensions {
 
-// Creates and runs an extension context in a thread. All operations from the
-// extension context will be called in the separated thread.
+// Creates and runs an extension context as a sequence in a worker pool shared
+// by all the runners of the process. All operations from the extension context
+// are called in order and never concurrently, but consecutive calls are not
+// guaranteed to happen in the same OS thread. The size of the pool can be set
+// with the --extension-thread-pool-size switch.
+//
+// Handlers that block hold a pool thread meanwhile, so as many blocked
+// instances as there are threads stall all the others. Extensions that block
+// can ask for a dedicated thread, see XWalkExtension::uses_dedicated_thread(),
+// then the runner starts a thread of its own for the context.
+//
+// Messages wait for the extension thread in lanes, so sync messages and the
+// async ones posted with priority don't queue behind bulk async traffic. See
+// XWalkExtensionStats::Lane.
 //
 // The given task runner correspond to the thread that will handle the calls
-// to Client. After XWalkExtensionThreadedRunner is deleted, the client will
-// not be called anymore.
+// to Client. After Destroy() is called, the client will not be called anymore.
+// Destruction doesn't block the caller: the runner stays alive until the
+// context is destroyed in the extension thread, and then deletes itself.
 class XWalkExtensionThreadedRunner : public XWalkExtensionRunner {
  public:
   XWalkExtensionThreadedRunner(
       XWalkExtension* extension, Client* client,
       base::SingleThreadTaskRunner* client_task_runner,
       int64_t instance_id = -1);
-  virtual ~XWalkExtensionThreadedRunner();
+
+  // XWalkExtensionRunner implementation.
+  virtual void Destroy(const base::Closure& destroyed_callback) OVERRIDE;
+  virtual void AckMessagesToJS(size_t count) OVERRIDE;
+
+  // Returns the pool where all the extension contexts of the process run.
+  static base::SequencedWorkerPool* GetWorkerPool();
 
  private:
+  // Use Destroy() instead.
+  virtual ~XWalkExtensionThreadedRunner();
+
   // XWalkExtensionRunner implementation.
-  virtual void HandleMessageFromClient(scoped_ptr<base::Value> msg) OVERRIDE;
+  virtual void HandleMessageFromClient(
+      scoped_ptr<base::Value> msg, XWalkExtensionStats::Lane lane) OVERRIDE;
+  virtual void HandleSerializedMessageFromClient(
+      scoped_ptr<std::string> msg, XWalkExtensionStats::Lane lane) OVERRIDE;
   virtual void HandleSyncMessageFromClient(
       scoped_ptr<IPC::Message> ipc_reply, scoped_ptr<base::Value> msg) OVERRIDE;
+  virtual void HandleSyncMessageFromClient(
+      scoped_ptr<base::Value> msg,
+      const SyncReplyCallback& callback) OVERRIDE;
 
   bool CalledOnExtensionThread() const;
   bool PostTaskToExtensionThread(const tracked_objects::Location& from_here,
                                  const base::Closure& task);
+  // Message handling tasks are queued in lanes instead of being posted
+  // directly, see RunNextLaneTask().
+  void PostTaskToLane(XWalkExtensionStats::Lane lane,
+                      const tracked_objects::Location& from_here,
+                      const base::Closure& task);
+  void RunNextLaneTask();
   void CreateContext();
-  void DestroyContext();
-
-  void CallHandleMessage(scoped_ptr<base::Value> msg);
-  void CallHandleSyncMessage(scoped_ptr<IPC::Message> ipc_reply,
+  void DestroyContext(const base::Closure& destroyed_callback);
+
+  // |post_time| is when the message was queued in |lane|.
+  void CallHandleMessage(XWalkExtensionStats::Lane lane,
+                         base::TimeTicks post_time,
+                         scoped_ptr<base::Value> msg);
+  void CallHandleSerializedMessage(XWalkExtensionStats::Lane lane,
+                                   base::TimeTicks post_time,
+                                   scoped_ptr<std::string> msg);
+  void CallHandleSyncMessage(base::TimeTicks post_time,
+                             scoped_ptr<IPC::Message> ipc_reply,
                              scoped_ptr<base::Value> msg);
+  void CallHandleSyncMessageWithCallback(base::TimeTicks post_time,
+                                         const SyncReplyCallback& callback,
+                                         scoped_ptr<base::Value> msg);
+  void CallMessagesToJSHandled(size_t count);
+  scoped_ptr<base::Value> RunSyncMessageHandler(base::TimeTicks post_time,
+                                                scoped_ptr<base::Value> msg);
 
   void PostMessageToClientTaskRunner(scoped_ptr<base::Value> msg);
+  void StartMessagesToJSAcks();
 
   scoped_ptr<XWalkExtensionInstance> context_;
-  scoped_ptr<base::Thread> thread_;
   XWalkExtension* extension_;
 
-  base::WaitableEvent sync_message_event_;
+  base::SequencedWorkerPool::SequenceToken sequence_token_;
+  // Only used for extensions that asked for a dedicated thread, then the
+  // context runs there instead of in the pool.
+  scoped_ptr<base::Thread> thread_;
+  scoped_refptr<base::SequencedTaskRunner> task_runner_;
+
   base::SingleThreadTaskRunner* client_task_runner_;
 
+  base::Lock lanes_lock_;
+  std::deque<base::Closure> lanes_[XWalkExtensionStats::LANE_COUNT];
+
   class PostHelper;
   scoped_ptr<PostHelper> helper_;
 
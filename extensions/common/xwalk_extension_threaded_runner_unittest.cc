@@ -4,18 +4,26 @@
 
 #include "xwalk/extensions/common/xwalk_extension_threaded_runner.h"
 
+#include <string>
+#include <vector>
+
 #include "base/bind.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/message_loop/message_loop.h"
 #include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/synchronization/waitable_event.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/sequenced_worker_pool.h"
 #include "ipc/ipc_message.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 using base::MessageLoop;
+using base::SequencedWorkerPool;
 using xwalk::extensions::XWalkExtension;
 using xwalk::extensions::XWalkExtensionInstance;
 using xwalk::extensions::XWalkExtensionRunner;
+using xwalk::extensions::XWalkExtensionStats;
 using xwalk::extensions::XWalkExtensionThreadedRunner;
 
 namespace {
@@ -23,41 +31,71 @@ namespace {
 MessageLoop* g_main_message_loop = NULL;
 MessageLoop* g_extension_message_loop = NULL;
 base::WaitableEvent g_done(false, false);
+base::WaitableEvent g_unblock(false, false);
+// Messages handled by the extension other than the special ones below.
+std::vector<std::string> g_handled_messages;
 
 class TestExtensionInstance : public XWalkExtensionInstance {
  public:
   TestExtensionInstance(
       const XWalkExtension::PostMessageCallback post_message)
-      : extension_message_loop_(MessageLoop::current()) {
+      : sequence_token_(
+            SequencedWorkerPool::GetSequenceTokenForCurrentThread()) {
     SetPostMessageCallback(post_message);
-    EXPECT_NE(g_main_message_loop, extension_message_loop_);
+    EXPECT_NE(g_main_message_loop, MessageLoop::current());
+    EXPECT_TRUE(XWalkExtensionThreadedRunner::GetWorkerPool()->
+        IsRunningSequenceOnCurrentThread(sequence_token_));
     g_done.Signal();
   }
   virtual ~TestExtensionInstance() {
-    EXPECT_EQ(extension_message_loop_, MessageLoop::current());
+    EXPECT_TRUE(CalledOnExtensionSequence());
     g_done.Signal();
   }
 
  private:
+  bool CalledOnExtensionSequence() const {
+    return sequence_token_.Equals(
+        SequencedWorkerPool::GetSequenceTokenForCurrentThread());
+  }
+
   virtual void HandleMessage(scoped_ptr<base::Value> msg) OVERRIDE {
-    EXPECT_EQ(extension_message_loop_, MessageLoop::current());
+    EXPECT_TRUE(CalledOnExtensionSequence());
     std::string msg_str;
     msg->GetAsString(&msg_str);
     if (msg_str == "PING") {
       PostMessageToJS(scoped_ptr<base::Value>(
           base::Value::CreateStringValue("PONG")));
+    } else if (msg_str == "BLOCK") {
+      g_unblock.Wait();
+    } else if (msg_str == "FLOOD") {
+      // Each PONG is 4 bytes, so the third one goes over the high watermark.
+      SetMessageToJSWatermarks(8, 4);
+      int posted = 0;
+      while (CanPostMessageToJS()) {
+        PostMessageToJS(scoped_ptr<base::Value>(
+            base::Value::CreateStringValue("PONG")));
+        posted++;
+      }
+      g_handled_messages.push_back("FLOOD " + base::IntToString(posted));
+      g_done.Signal();
     } else {
+      g_handled_messages.push_back(msg_str);
       g_done.Signal();
     }
   }
+  virtual void HandleMessagesToJSDrained() OVERRIDE {
+    EXPECT_TRUE(CalledOnExtensionSequence());
+    g_handled_messages.push_back("DRAINED");
+    g_done.Signal();
+  }
   virtual scoped_ptr<base::Value> HandleSyncMessage(
       scoped_ptr<base::Value> msg) OVERRIDE {
-    EXPECT_EQ(extension_message_loop_, MessageLoop::current());
+    EXPECT_TRUE(CalledOnExtensionSequence());
     g_done.Signal();
     return scoped_ptr<base::Value>();
   }
 
-  MessageLoop* extension_message_loop_;
+  SequencedWorkerPool::SequenceToken sequence_token_;
 };
 
 class TestExtension : public XWalkExtension {
@@ -70,6 +108,43 @@ class TestExtension : public XWalkExtension {
   }
 };
 
+// Checks that it is always called in the thread where it was created, which
+// isn't one of the pool.
+class DedicatedThreadInstance : public XWalkExtensionInstance {
+ public:
+  DedicatedThreadInstance()
+      : thread_id_(base::PlatformThread::CurrentId()) {
+    EXPECT_NE(g_main_message_loop, MessageLoop::current());
+    EXPECT_FALSE(XWalkExtensionThreadedRunner::GetWorkerPool()->
+        RunsTasksOnCurrentThread());
+    g_done.Signal();
+  }
+  virtual ~DedicatedThreadInstance() {
+    EXPECT_EQ(thread_id_, base::PlatformThread::CurrentId());
+    g_done.Signal();
+  }
+
+ private:
+  virtual void HandleMessage(scoped_ptr<base::Value> msg) OVERRIDE {
+    EXPECT_EQ(thread_id_, base::PlatformThread::CurrentId());
+    g_done.Signal();
+  }
+
+  base::PlatformThreadId thread_id_;
+};
+
+class DedicatedThreadExtension : public XWalkExtension {
+ public:
+  DedicatedThreadExtension() {
+    set_uses_dedicated_thread(true);
+  }
+  virtual const char* GetJavaScriptAPI() OVERRIDE { return ""; }
+  virtual XWalkExtensionInstance* CreateInstance(
+      const PostMessageCallback& post_message) OVERRIDE {
+    return new DedicatedThreadInstance;
+  }
+};
+
 class TestRunnerClient : public XWalkExtensionRunner::Client {
  public:
   TestRunnerClient(const base::Closure& handle_message = base::Closure())
@@ -100,6 +175,11 @@ class TestRunnerClient : public XWalkExtensionRunner::Client {
     }
   }
 
+  virtual void StartMessagesToJSAcks(
+      const XWalkExtensionRunner* runner) OVERRIDE {
+    EXPECT_EQ(g_main_message_loop, MessageLoop::current());
+  }
+
  private:
   base::Closure handle_message_;
 };
@@ -130,7 +210,7 @@ TEST(XWalkExtensionThreadedRunnerTest,
       scoped_ptr<base::Value>(base::Value::CreateStringValue("HELLO")));
   g_done.Wait();
 
-  delete runner;
+  runner->Destroy(base::Closure());
   g_done.Wait();
 
   g_main_message_loop = NULL;
@@ -157,7 +237,7 @@ TEST(XWalkExtensionThreadedRunnerTest,
 
   run_loop.Run();
 
-  delete runner;
+  runner->Destroy(base::Closure());
   g_done.Wait();
 
   g_main_message_loop = NULL;
@@ -178,7 +258,149 @@ TEST(XWalkExtensionThreadedRunnerTest,
 
   runner->PostMessageToNative(scoped_ptr<base::Value>(
       base::Value::CreateStringValue("PING")));
-  delete runner;
+  runner->Destroy(base::Closure());
+  g_done.Wait();
+
+  base::RunLoop run_loop;
+  run_loop.RunUntilIdle();
+
+  g_main_message_loop = NULL;
+}
+
+TEST(XWalkExtensionThreadedRunnerTest,
+     DestroyDoesNotWaitForBusyExtension) {
+  MessageLoop loop(MessageLoop::TYPE_DEFAULT);
+  g_main_message_loop = &loop;
+
+  TestExtension extension;
+  TestRunnerClient client;
+
+  XWalkExtensionRunner* runner =
+      new XWalkExtensionThreadedRunner(&extension, &client,
+                                       loop.message_loop_proxy());
+  g_done.Wait();
+
+  // The extension will be blocked handling this message until we signal it,
+  // so Destroy() would never return if it waited for the context.
+  runner->PostMessageToNative(scoped_ptr<base::Value>(
+      base::Value::CreateStringValue("BLOCK")));
+
+  base::WaitableEvent destroyed(false, false);
+  runner->Destroy(base::Bind(&base::WaitableEvent::Signal,
+                             base::Unretained(&destroyed)));
+  EXPECT_FALSE(destroyed.IsSignaled());
+
+  g_unblock.Signal();
+  g_done.Wait();
+  destroyed.Wait();
+
+  base::RunLoop run_loop;
+  run_loop.RunUntilIdle();
+
+  g_main_message_loop = NULL;
+}
+
+TEST(XWalkExtensionThreadedRunnerTest, PriorityLaneIsHandledFirst) {
+  MessageLoop loop(MessageLoop::TYPE_DEFAULT);
+  g_main_message_loop = &loop;
+  g_handled_messages.clear();
+
+  TestExtension extension;
+  TestRunnerClient client;
+
+  XWalkExtensionRunner* runner =
+      new XWalkExtensionThreadedRunner(&extension, &client,
+                                       loop.message_loop_proxy());
+  g_done.Wait();
+
+  // Keep the extension busy while the other messages get queued.
+  runner->PostMessageToNative(scoped_ptr<base::Value>(
+      base::Value::CreateStringValue("BLOCK")));
+  runner->PostMessageToNative(scoped_ptr<base::Value>(
+      base::Value::CreateStringValue("NORMAL1")));
+  runner->PostMessageToNative(scoped_ptr<base::Value>(
+      base::Value::CreateStringValue("NORMAL2")));
+  runner->PostMessageToNative(scoped_ptr<base::Value>(
+      base::Value::CreateStringValue("PRIORITY1")),
+      XWalkExtensionStats::PRIORITY_LANE);
+  runner->PostMessageToNative(scoped_ptr<base::Value>(
+      base::Value::CreateStringValue("PRIORITY2")),
+      XWalkExtensionStats::PRIORITY_LANE);
+
+  g_unblock.Signal();
+  for (int i = 0; i < 4; ++i)
+    g_done.Wait();
+
+  ASSERT_EQ(4u, g_handled_messages.size());
+  EXPECT_EQ("PRIORITY1", g_handled_messages[0]);
+  EXPECT_EQ("PRIORITY2", g_handled_messages[1]);
+  EXPECT_EQ("NORMAL1", g_handled_messages[2]);
+  EXPECT_EQ("NORMAL2", g_handled_messages[3]);
+
+  runner->Destroy(base::Closure());
+  g_done.Wait();
+
+  base::RunLoop run_loop;
+  run_loop.RunUntilIdle();
+
+  g_main_message_loop = NULL;
+}
+
+TEST(XWalkExtensionThreadedRunnerTest, DrainIsNotifiedAtLowWatermark) {
+  MessageLoop loop(MessageLoop::TYPE_DEFAULT);
+  g_main_message_loop = &loop;
+  g_handled_messages.clear();
+
+  TestExtension extension;
+  TestRunnerClient client;
+
+  XWalkExtensionRunner* runner =
+      new XWalkExtensionThreadedRunner(&extension, &client,
+                                       loop.message_loop_proxy());
+  g_done.Wait();
+
+  runner->PostMessageToNative(scoped_ptr<base::Value>(
+      base::Value::CreateStringValue("FLOOD")));
+  g_done.Wait();
+  ASSERT_EQ(1u, g_handled_messages.size());
+  EXPECT_EQ("FLOOD 3", g_handled_messages[0]);
+
+  // 8 bytes are still queued after the first ack, the low watermark is only
+  // reached with the second one.
+  runner->AckMessagesToJS(1);
+  runner->AckMessagesToJS(1);
+  g_done.Wait();
+  ASSERT_EQ(2u, g_handled_messages.size());
+  EXPECT_EQ("DRAINED", g_handled_messages[1]);
+
+  runner->Destroy(base::Closure());
+  g_done.Wait();
+
+  base::RunLoop run_loop;
+  run_loop.RunUntilIdle();
+
+  g_main_message_loop = NULL;
+}
+
+TEST(XWalkExtensionThreadedRunnerTest, DedicatedThreadIsNotFromThePool) {
+  MessageLoop loop(MessageLoop::TYPE_DEFAULT);
+  g_main_message_loop = &loop;
+
+  DedicatedThreadExtension extension;
+  TestRunnerClient client;
+
+  XWalkExtensionRunner* runner =
+      new XWalkExtensionThreadedRunner(&extension, &client,
+                                       loop.message_loop_proxy());
+  g_done.Wait();
+
+  for (int i = 0; i < 3; ++i) {
+    runner->PostMessageToNative(scoped_ptr<base::Value>(
+        base::Value::CreateStringValue("HELLO")));
+    g_done.Wait();
+  }
+
+  runner->Destroy(base::Closure());
   g_done.Wait();
 
   base::RunLoop run_loop;
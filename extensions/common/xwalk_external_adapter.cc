@@ -9,9 +9,7 @@
 namespace xwalk {
 namespace extensions {
 
-XWalkExternalAdapter::XWalkExternalAdapter()
-    : next_xw_extension_(1),
-      next_xw_instance_(1) {}
+XWalkExternalAdapter::XWalkExternalAdapter() {}
 
 XWalkExternalAdapter::~XWalkExternalAdapter() {}
 
@@ -20,41 +18,29 @@ XWalkExternalAdapter* XWalkExternalAdapter::GetInstance() {
 }
 
 XW_Extension XWalkExternalAdapter::GetNextXWExtension() {
-  return next_xw_extension_++;
+  return extensions_.Reserve();
 }
 
 XW_Instance XWalkExternalAdapter::GetNextXWInstance() {
-  return next_xw_instance_++;
+  return instances_.Reserve();
 }
 
 void XWalkExternalAdapter::RegisterExtension(
     XWalkExternalExtension* extension) {
-  XW_Extension xw_extension = extension->xw_extension_;
-  CHECK(IsValidXWExtension(xw_extension));
-  CHECK(extension_map_.find(xw_extension) == extension_map_.end());
-  extension_map_[xw_extension] = extension;
+  extensions_.Set(extension->xw_extension_, extension);
 }
 
 void XWalkExternalAdapter::UnregisterExtension(
     XWalkExternalExtension* extension) {
-  XW_Extension xw_extension = extension->xw_extension_;
-  CHECK(IsValidXWExtension(xw_extension));
-  CHECK(extension_map_.find(xw_extension) != extension_map_.end());
-  extension_map_.erase(xw_extension);
+  extensions_.Release(extension->xw_extension_);
 }
 
 void XWalkExternalAdapter::RegisterInstance(XWalkExternalContext* context) {
-  XW_Instance xw_instance = context->xw_instance_;
-  CHECK(IsValidXWInstance(xw_instance));
-  CHECK(instance_map_.find(xw_instance) == instance_map_.end());
-  instance_map_[xw_instance] = context;
+  instances_.Set(context->xw_instance_, context);
 }
 
 void XWalkExternalAdapter::UnregisterInstance(XWalkExternalContext* context) {
-  XW_Instance xw_instance = context->xw_instance_;
-  CHECK(IsValidXWInstance(xw_instance));
-  CHECK(instance_map_.find(xw_instance) != instance_map_.end());
-  instance_map_.erase(xw_instance);
+  instances_.Release(context->xw_instance_);
 }
 
 const void* XWalkExternalAdapter::GetInterface(const char* name) {
@@ -78,6 +64,39 @@ const void* XWalkExternalAdapter::GetInterface(const char* name) {
     return &messagingInterface1;
   }
 
+  if (!strcmp(name, XW_BINARY_MESSAGING_INTERFACE_1)) {
+    static const XW_BinaryMessagingInterface_1 binaryMessagingInterface1 = {
+      BinaryMessagingRegister,
+      BinaryMessagingPostMessage
+    };
+    return &binaryMessagingInterface1;
+  }
+
+  if (!strcmp(name, XW_FLOW_CONTROL_INTERFACE_1)) {
+    static const XW_FlowControlInterface_1 flowControlInterface1 = {
+      FlowControlRegisterDrainCallback,
+      FlowControlSetWatermarks,
+      FlowControlPostMessage,
+      FlowControlPostBinaryMessage,
+      FlowControlGetQueuedBytes
+    };
+    return &flowControlInterface1;
+  }
+
+  if (!strcmp(name, XW_MESSAGE_BATCHING_INTERFACE_1)) {
+    static const XW_MessageBatchingInterface_1 messageBatchingInterface1 = {
+      MessageBatchingEnable
+    };
+    return &messageBatchingInterface1;
+  }
+
+  if (!strcmp(name, XW_THREADING_INTERFACE_1)) {
+    static const XW_ThreadingInterface_1 threadingInterface1 = {
+      ThreadingRequestDedicatedThread
+    };
+    return &threadingInterface1;
+  }
+
   if (!strcmp(name, XW_INTERNAL_SYNC_MESSAGING_INTERFACE_1)) {
     static const XW_Internal_SyncMessagingInterface_1
         syncMessagingInterface1 = {
@@ -91,30 +110,16 @@ const void* XWalkExternalAdapter::GetInterface(const char* name) {
   return NULL;
 }
 
-bool XWalkExternalAdapter::IsValidXWExtension(XW_Extension xw_extension) {
-  return xw_extension > 0 && xw_extension < next_xw_extension_;
-}
-
-bool XWalkExternalAdapter::IsValidXWInstance(XW_Instance xw_instance) {
-  return xw_instance > 0 && xw_instance < next_xw_instance_;
-}
-
 XWalkExternalExtension* XWalkExternalAdapter::GetExtension(
     XW_Extension xw_extension) {
-  XWalkExternalAdapter* adapter = XWalkExternalAdapter::GetInstance();
-  ExtensionMap::iterator it = adapter->extension_map_.find(xw_extension);
-  if (it == adapter->extension_map_.end())
-    return NULL;
-  return it->second;
+  return static_cast<XWalkExternalExtension*>(
+      XWalkExternalAdapter::GetInstance()->extensions_.Lookup(xw_extension));
 }
 
 XWalkExternalContext* XWalkExternalAdapter::GetInstance(
     XW_Instance xw_instance) {
-  XWalkExternalAdapter* adapter = XWalkExternalAdapter::GetInstance();
-  InstanceMap::iterator it = adapter->instance_map_.find(xw_instance);
-  if (it == adapter->instance_map_.end())
-    return NULL;
-  return it->second;
+  return static_cast<XWalkExternalContext*>(
+      XWalkExternalAdapter::GetInstance()->instances_.Lookup(xw_instance));
 }
 
 // static
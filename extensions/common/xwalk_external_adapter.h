@@ -5,17 +5,26 @@
 #ifndef XWALK_EXTENSIONS_COMMON_XWALK_EXTERNAL_ADAPTER_H_
 #define XWALK_EXTENSIONS_COMMON_XWALK_EXTERNAL_ADAPTER_H_
 
-#include <map>
 #include "base/memory/singleton.h"
 #include "xwalk/extensions/public/XW_Extension.h"
 #include "xwalk/extensions/public/XW_Extension_SyncMessage.h"
 #include "xwalk/extensions/common/xwalk_external_context.h"
 #include "xwalk/extensions/common/xwalk_external_extension.h"
+#include "xwalk/extensions/common/xwalk_external_handle_table.h"
 
 // NOTE: Those macros define functions that are used in the structs by
 // GetInterface(). They dispatch the function to the appropriate
 // extension or instance.
 
+#define DEFINE_FUNCTION_0(TYPE, INTERFACE, NAME)                \
+  static void INTERFACE ## NAME(XW_ ## TYPE xw) {               \
+    XWalkExternal ## TYPE * ptr = Get ## TYPE(xw);              \
+    if (!ptr)                                                   \
+      LogInvalidCall(xw, #TYPE, #INTERFACE, #NAME);             \
+    else                                                        \
+      ptr->INTERFACE ## NAME();                                 \
+  }
+
 #define DEFINE_FUNCTION_1(TYPE, INTERFACE, NAME, ARG1)          \
   static void INTERFACE ## NAME(XW_ ## TYPE xw, ARG1 arg1) {    \
     XWalkExternal ## TYPE * ptr = Get ## TYPE(xw);              \
@@ -34,13 +43,35 @@
       ptr->INTERFACE ## NAME(arg1, arg2);                                \
   }
 
-#define DEFINE_RET_FUNCTION_0(TYPE, INTERFACE, NAME, RET_ARG)   \
-  static RET_ARG INTERFACE ## NAME(XW_ ## TYPE xw) {            \
-    XWalkExternal ## TYPE * ptr = Get ## TYPE(xw);              \
-    if (ptr)                                                    \
-      return ptr->INTERFACE ## NAME();                          \
-    LogInvalidCall(xw, #TYPE, #INTERFACE, #NAME);               \
-    return NULL;                                                \
+// The RET_* variants return INVALID_RET when the XW_Extension or XW_Instance
+// is not valid.
+#define DEFINE_RET_FUNCTION_0(TYPE, INTERFACE, NAME, RET_ARG, INVALID_RET)  \
+  static RET_ARG INTERFACE ## NAME(XW_ ## TYPE xw) {                        \
+    XWalkExternal ## TYPE * ptr = Get ## TYPE(xw);                          \
+    if (ptr)                                                                \
+      return ptr->INTERFACE ## NAME();                                      \
+    LogInvalidCall(xw, #TYPE, #INTERFACE, #NAME);                           \
+    return INVALID_RET;                                                     \
+  }
+
+#define DEFINE_RET_FUNCTION_1(TYPE, INTERFACE, NAME, RET_ARG, INVALID_RET,  \
+                              ARG1)                                         \
+  static RET_ARG INTERFACE ## NAME(XW_ ## TYPE xw, ARG1 arg1) {             \
+    XWalkExternal ## TYPE * ptr = Get ## TYPE(xw);                          \
+    if (ptr)                                                                \
+      return ptr->INTERFACE ## NAME(arg1);                                  \
+    LogInvalidCall(xw, #TYPE, #INTERFACE, #NAME);                           \
+    return INVALID_RET;                                                     \
+  }
+
+#define DEFINE_RET_FUNCTION_2(TYPE, INTERFACE, NAME, RET_ARG, INVALID_RET,  \
+                              ARG1, ARG2)                                   \
+  static RET_ARG INTERFACE ## NAME(XW_ ## TYPE xw, ARG1 arg1, ARG2 arg2) {  \
+    XWalkExternal ## TYPE * ptr = Get ## TYPE(xw);                          \
+    if (ptr)                                                                \
+      return ptr->INTERFACE ## NAME(arg1, arg2);                            \
+    LogInvalidCall(xw, #TYPE, #INTERFACE, #NAME);                           \
+    return INVALID_RET;                                                     \
   }
 
 template <typename T> struct DefaultSingletonTraits;
@@ -59,10 +90,15 @@ typedef XWalkExternalContext XWalkExternalInstance;
 // functions from external extension to their implementations in
 // XWalkExternalExtension and XWalkExternalContext. We have only one
 // adapter per process.
+//
+// Extensions call the C interfaces from any thread, the handles are mapped
+// in lock-free tables so they can be used concurrently.
 class XWalkExternalAdapter {
  public:
   static XWalkExternalAdapter* GetInstance();
 
+  // These reserve a new handle, to be registered and later released by the
+  // corresponding Unregister*() call. They return 0 if none is available.
   XW_Extension GetNextXWExtension();
   XW_Instance GetNextXWInstance();
 
@@ -86,9 +122,6 @@ class XWalkExternalAdapter {
   XWalkExternalAdapter();
   ~XWalkExternalAdapter();
 
-  bool IsValidXWExtension(XW_Extension xw_extension);
-  bool IsValidXWInstance(XW_Instance xw_instance);
-
   // Used by the DEFINE_* macros to bridge the calls using C API identifiers
   // XW_Extension and XW_Instance to the right C++ object.
   static XWalkExternalExtension* GetExtension(XW_Extension xw_extension);
@@ -104,25 +137,41 @@ class XWalkExternalAdapter {
   DEFINE_FUNCTION_1(Extension, Core, RegisterShutdownCallback,
                     XW_ShutdownCallback);
   DEFINE_FUNCTION_1(Instance, Core, SetInstanceData, void*);
-  DEFINE_RET_FUNCTION_0(Instance, Core, GetInstanceData, void*);
+  DEFINE_RET_FUNCTION_0(Instance, Core, GetInstanceData, void*, NULL);
 
   // XW_MessagingInterface_1 from XW_Extension.h.
   DEFINE_FUNCTION_1(Extension, Messaging, Register, XW_HandleMessageCallback);
   DEFINE_FUNCTION_1(Instance, Messaging, PostMessage, const char*);
 
+  // XW_BinaryMessagingInterface_1 from XW_Extension.h.
+  DEFINE_FUNCTION_1(Extension, BinaryMessaging, Register,
+                    XW_HandleBinaryMessageCallback);
+  DEFINE_FUNCTION_2(Instance, BinaryMessaging, PostMessage,
+                    const char*, size_t);
+
+  // XW_FlowControlInterface_1 from XW_Extension.h.
+  DEFINE_FUNCTION_1(Extension, FlowControl, RegisterDrainCallback,
+                    XW_MessagesDrainedCallback);
+  DEFINE_FUNCTION_2(Instance, FlowControl, SetWatermarks, size_t, size_t);
+  DEFINE_RET_FUNCTION_1(Instance, FlowControl, PostMessage,
+                        int32_t, XW_ERROR, const char*);
+  DEFINE_RET_FUNCTION_2(Instance, FlowControl, PostBinaryMessage,
+                        int32_t, XW_ERROR, const char*, size_t);
+  DEFINE_RET_FUNCTION_0(Instance, FlowControl, GetQueuedBytes, size_t, 0);
+
+  // XW_MessageBatchingInterface_1 from XW_Extension.h.
+  DEFINE_FUNCTION_1(Extension, MessageBatching, Enable, uint32_t);
+
+  // XW_ThreadingInterface_1 from XW_Extension.h.
+  DEFINE_FUNCTION_0(Extension, Threading, RequestDedicatedThread);
+
   // XW_Internal_SyncMessaging_1 from XW_Extension_SyncMessage.h.
   DEFINE_FUNCTION_1(Extension, SyncMessaging, Register,
                     XW_HandleSyncMessageCallback);
   DEFINE_FUNCTION_1(Instance, SyncMessaging, SetSyncReply, const char*);
 
-  typedef std::map<XW_Extension, XWalkExternalExtension*> ExtensionMap;
-  ExtensionMap extension_map_;
-
-  typedef std::map<XW_Instance, XWalkExternalContext*> InstanceMap;
-  InstanceMap instance_map_;
-
-  XW_Extension next_xw_extension_;
-  XW_Instance next_xw_instance_;
+  XWalkExternalHandleTable extensions_;
+  XWalkExternalHandleTable instances_;
 
   DISALLOW_COPY_AND_ASSIGN(XWalkExternalAdapter);
 };
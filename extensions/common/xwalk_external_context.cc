@@ -36,6 +36,11 @@ XWalkExternalContext::~XWalkExternalContext() {
 }
 
 void XWalkExternalContext::HandleMessage(scoped_ptr<base::Value> msg) {
+  if (msg->IsType(base::Value::TYPE_BINARY)) {
+    HandleBinaryMessage(*static_cast<base::BinaryValue*>(msg.get()));
+    return;
+  }
+
   XW_HandleMessageCallback callback = extension_->handle_msg_callback_;
   if (!callback) {
     LOG(WARNING) << "Ignoring message sent for external extension '"
@@ -48,6 +53,18 @@ void XWalkExternalContext::HandleMessage(scoped_ptr<base::Value> msg) {
   callback(xw_instance_, string_msg.c_str());
 }
 
+void XWalkExternalContext::HandleBinaryMessage(const base::BinaryValue& msg) {
+  XW_HandleBinaryMessageCallback callback =
+      extension_->handle_binary_msg_callback_;
+  if (!callback) {
+    LOG(WARNING) << "Ignoring binary message sent for external extension '"
+                 << extension_->name() << "' which doesn't support it.";
+    return;
+  }
+
+  callback(xw_instance_, msg.GetBuffer(), msg.GetSize());
+}
+
 scoped_ptr<base::Value> XWalkExternalContext::HandleSyncMessage(
     scoped_ptr<base::Value> msg) {
   XW_HandleSyncMessageCallback callback = extension_->handle_sync_msg_callback_;
@@ -74,6 +91,12 @@ scoped_ptr<base::Value> XWalkExternalContext::HandleSyncMessage(
   return reply.Pass();
 }
 
+void XWalkExternalContext::HandleMessagesToJSDrained() {
+  XW_MessagesDrainedCallback callback = extension_->messages_drained_callback_;
+  if (callback)
+    callback(xw_instance_);
+}
+
 void XWalkExternalContext::CoreSetInstanceData(void* data) {
   instance_data_ = data;
 }
@@ -86,6 +109,36 @@ void XWalkExternalContext::MessagingPostMessage(const char* msg) {
   PostMessageToJS(scoped_ptr<base::Value>(new base::StringValue(msg)));
 }
 
+void XWalkExternalContext::BinaryMessagingPostMessage(const char* data,
+                                                      size_t size) {
+  PostMessageToJS(scoped_ptr<base::Value>(
+      base::BinaryValue::CreateWithCopiedBuffer(data, size)));
+}
+
+void XWalkExternalContext::FlowControlSetWatermarks(size_t high_watermark,
+                                                    size_t low_watermark) {
+  SetMessageToJSWatermarks(high_watermark, low_watermark);
+}
+
+int32_t XWalkExternalContext::FlowControlPostMessage(const char* msg) {
+  if (!CanPostMessageToJS())
+    return XW_ERROR_WOULD_BLOCK;
+  MessagingPostMessage(msg);
+  return XW_OK;
+}
+
+int32_t XWalkExternalContext::FlowControlPostBinaryMessage(const char* data,
+                                                           size_t size) {
+  if (!CanPostMessageToJS())
+    return XW_ERROR_WOULD_BLOCK;
+  BinaryMessagingPostMessage(data, size);
+  return XW_OK;
+}
+
+size_t XWalkExternalContext::FlowControlGetQueuedBytes() {
+  return queued_bytes_to_js();
+}
+
 void XWalkExternalContext::SyncMessagingSetSyncReply(const char* reply) {
   if (!is_handling_sync_msg_) {
     LOG(WARNING) << "Error: can't call SetSyncMessage from"
@@ -35,8 +35,11 @@ class XWalkExternalContext : public XWalkExtensionInstance {
 
   // XWalkExtensionInstance implementation.
   virtual void HandleMessage(scoped_ptr<base::Value> msg) OVERRIDE;
+
+  void HandleBinaryMessage(const base::BinaryValue& msg);
   virtual scoped_ptr<base::Value>
       HandleSyncMessage(scoped_ptr<base::Value> msg) OVERRIDE;
+  virtual void HandleMessagesToJSDrained() OVERRIDE;
 
   // XW_CoreInterface_1 (from XW_Extension.h) implementation.
   void CoreSetInstanceData(void* data);
@@ -45,6 +48,15 @@ class XWalkExternalContext : public XWalkExtensionInstance {
   // XW_MessagingInterface_1 (from XW_Extension.h) implementation.
   void MessagingPostMessage(const char* msg);
 
+  // XW_BinaryMessagingInterface_1 (from XW_Extension.h) implementation.
+  void BinaryMessagingPostMessage(const char* data, size_t size);
+
+  // XW_FlowControlInterface_1 (from XW_Extension.h) implementation.
+  void FlowControlSetWatermarks(size_t high_watermark, size_t low_watermark);
+  int32_t FlowControlPostMessage(const char* msg);
+  int32_t FlowControlPostBinaryMessage(const char* data, size_t size);
+  size_t FlowControlGetQueuedBytes();
+
   // XW_Internal_SyncMessagingInterface_1 (from XW_Extension_SyncMessage.h)
   // implementation.
   void SyncMessagingSetSyncReply(const char* reply);
@@ -15,56 +15,113 @@ namespace extensions {
 
 XWalkExternalExtension::XWalkExternalExtension(
     const base::FilePath& path, base::NativeLibrary native_library)
-    : xw_extension_(0),
+    : path_(path),
+      xw_extension_(0),
       created_instance_callback_(NULL),
       destroyed_instance_callback_(NULL),
       shutdown_callback_(NULL),
       handle_msg_callback_(NULL),
+      handle_binary_msg_callback_(NULL),
       handle_sync_msg_callback_(NULL),
-      initialized_(false) {
+      messages_drained_callback_(NULL),
+      initialized_(false),
+      deferred_(false),
+      initialization_failed_(false) {
+  Initialize(native_library);
+}
+
+XWalkExternalExtension::DescriptorOptions::DescriptorOptions()
+    : message_batching_enabled(false),
+      uses_dedicated_thread(false) {
+}
+
+XWalkExternalExtension::XWalkExternalExtension(
+    const base::FilePath& path, const std::string& name,
+    const std::string& js_api, const DescriptorOptions& options)
+    : path_(path),
+      xw_extension_(0),
+      created_instance_callback_(NULL),
+      destroyed_instance_callback_(NULL),
+      shutdown_callback_(NULL),
+      handle_msg_callback_(NULL),
+      handle_binary_msg_callback_(NULL),
+      handle_sync_msg_callback_(NULL),
+      messages_drained_callback_(NULL),
+      js_api_(js_api),
+      initialized_(false),
+      deferred_(true),
+      initialization_failed_(false) {
+  set_name(name);
+  if (options.message_batching_enabled)
+    EnableMessageBatching(options.message_batching_max_latency);
+  set_uses_dedicated_thread(options.uses_dedicated_thread);
+}
+
+XWalkExternalExtension::~XWalkExternalExtension() {
+  if (!initialized_)
+    return;
+
+  if (shutdown_callback_)
+    shutdown_callback_(xw_extension_);
+  XWalkExternalAdapter::GetInstance()->UnregisterExtension(this);
+}
+
+bool XWalkExternalExtension::is_valid() {
+  base::AutoLock lock(initialization_lock_);
+  if (deferred_)
+    return !initialization_failed_;
+  return initialized_;
+}
+
+bool XWalkExternalExtension::Initialize(base::NativeLibrary native_library) {
   std::string error;
   if (!native_library)
-    native_library = base::LoadNativeLibrary(path, &error);
+    native_library = base::LoadNativeLibrary(path_, &error);
 
   base::ScopedNativeLibrary library(native_library);
   if (!library.is_valid()) {
-    LOG(WARNING) << "Error loading extension '" << path.AsUTF8Unsafe() << "': "
-                 << error;
-    return;
+    LOG(WARNING) << "Error loading extension '" << path_.AsUTF8Unsafe()
+                 << "': " << error;
+    return false;
   }
 
   XW_Initialize_Func initialize = reinterpret_cast<XW_Initialize_Func>(
       library.GetFunctionPointer("XW_Initialize"));
   if (!initialize) {
-    LOG(WARNING) << "Error loading extension '" << path.AsUTF8Unsafe() << "': "
-                 << "couldn't get XW_Initialize function.";
-    return;
+    LOG(WARNING) << "Error loading extension '" << path_.AsUTF8Unsafe()
+                 << "': couldn't get XW_Initialize function.";
+    return false;
   }
 
   XWalkExternalAdapter* external_adapter = XWalkExternalAdapter::GetInstance();
   xw_extension_ = external_adapter->GetNextXWExtension();
+  if (!xw_extension_) {
+    LOG(WARNING) << "Error loading extension '" << path_.AsUTF8Unsafe()
+                 << "': too many extensions loaded.";
+    return false;
+  }
   external_adapter->RegisterExtension(this);
   int ret = initialize(xw_extension_, XWalkExternalAdapter::GetInterface);
   if (ret != XW_OK) {
-    LOG(WARNING) << "Error loading extension '" << path.AsUTF8Unsafe() << "': "
-                 << "XW_Initialize function returned error value.";
-    return;
+    LOG(WARNING) << "Error loading extension '" << path_.AsUTF8Unsafe()
+                 << "': XW_Initialize function returned error value.";
+    external_adapter->UnregisterExtension(this);
+    return false;
   }
 
   library_.Reset(library.Release());
   initialized_ = true;
+  return true;
 }
 
-XWalkExternalExtension::~XWalkExternalExtension() {
-  if (!initialized_)
-    return;
-
-  if (shutdown_callback_)
-    shutdown_callback_(xw_extension_);
-  XWalkExternalAdapter::GetInstance()->UnregisterExtension(this);
-}
+bool XWalkExternalExtension::EnsureInitialized() {
+  base::AutoLock lock(initialization_lock_);
+  if (initialized_ || initialization_failed_ || !deferred_)
+    return initialized_;
 
-bool XWalkExternalExtension::is_valid() {
+  VLOG(1) << "Loading deferred extension '" << name() << "' from "
+          << path_.AsUTF8Unsafe();
+  initialization_failed_ = !Initialize(NULL);
   return initialized_;
 }
 
@@ -74,8 +131,16 @@ const char* XWalkExternalExtension::GetJavaScriptAPI() {
 
 XWalkExtensionInstance* XWalkExternalExtension::CreateInstance(
     const XWalkExtension::PostMessageCallback& post_message) {
+  if (!EnsureInitialized())
+    return NULL;
+
   XW_Instance xw_instance =
       XWalkExternalAdapter::GetInstance()->GetNextXWInstance();
+  if (!xw_instance) {
+    LOG(WARNING) << "Can't create more instances of extension '" << name()
+                 << "'.";
+    return NULL;
+  }
   return new XWalkExternalContext(this, post_message, xw_instance);
 }
 
@@ -89,11 +154,28 @@ XWalkExtensionInstance* XWalkExternalExtension::CreateInstance(
 
 void XWalkExternalExtension::CoreSetExtensionName(const char* name) {
   RETURN_IF_INITIALIZED("SetExtensionName from CoreInterface");
+  // Deferred extensions were registered with the name from their descriptor,
+  // that can't change anymore.
+  if (deferred_) {
+    LOG_IF(WARNING, this->name() != name)
+        << "Extension '" << this->name() << "' from "
+        << path_.AsUTF8Unsafe() << " set its name to '" << name
+        << "', which doesn't match its descriptor.";
+    return;
+  }
   set_name(name);
 }
 
 void XWalkExternalExtension::CoreSetJavaScriptAPI(const char* js_api) {
   RETURN_IF_INITIALIZED("SetJavaScriptAPI from CoreInterface");
+  // The JavaScript API of deferred extensions comes from their descriptor and
+  // may already have been sent to renderers.
+  if (deferred_) {
+    LOG_IF(WARNING, js_api_ != js_api)
+        << "Extension '" << name() << "' set a JavaScript API which doesn't"
+        << " match its descriptor, using the descriptor's.";
+    return;
+  }
   js_api_ = std::string(js_api);
 }
 
@@ -117,6 +199,47 @@ void XWalkExternalExtension::MessagingRegister(
   handle_msg_callback_ = callback;
 }
 
+void XWalkExternalExtension::BinaryMessagingRegister(
+    XW_HandleBinaryMessageCallback callback) {
+  RETURN_IF_INITIALIZED("Register from BinaryMessagingInterface");
+  handle_binary_msg_callback_ = callback;
+}
+
+void XWalkExternalExtension::FlowControlRegisterDrainCallback(
+    XW_MessagesDrainedCallback callback) {
+  RETURN_IF_INITIALIZED("RegisterDrainCallback from FlowControlInterface");
+  messages_drained_callback_ = callback;
+}
+
+void XWalkExternalExtension::MessageBatchingEnable(uint32_t max_latency_ms) {
+  RETURN_IF_INITIALIZED("Enable from MessageBatchingInterface");
+  base::TimeDelta max_latency =
+      base::TimeDelta::FromMilliseconds(max_latency_ms);
+  // Deferred extensions are initialized in an extension thread, while other
+  // threads may already be reading their options. These come from the
+  // descriptor.
+  if (deferred_) {
+    LOG_IF(WARNING, !message_batching_enabled() ||
+                    message_batching_max_latency() != max_latency)
+        << "Extension '" << name() << "' enabled message batching, which"
+        << " doesn't match its descriptor, using the descriptor's.";
+    return;
+  }
+  EnableMessageBatching(max_latency);
+}
+
+void XWalkExternalExtension::ThreadingRequestDedicatedThread() {
+  RETURN_IF_INITIALIZED("RequestDedicatedThread from ThreadingInterface");
+  // Like above, deferred extensions get this from their descriptor.
+  if (deferred_) {
+    LOG_IF(WARNING, !uses_dedicated_thread())
+        << "Extension '" << name() << "' requested a dedicated thread, which"
+        << " doesn't match its descriptor, ignoring it.";
+    return;
+  }
+  set_uses_dedicated_thread(true);
+}
+
 void XWalkExternalExtension::SyncMessagingRegister(
     XW_HandleSyncMessageCallback callback) {
   RETURN_IF_INITIALIZED("Register from Internal_SyncMessagingInterface");
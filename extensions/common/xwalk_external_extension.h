@@ -6,15 +6,13 @@
 #define XWALK_EXTENSIONS_COMMON_XWALK_EXTERNAL_EXTENSION_H_
 
 #include <string>
+#include "base/files/file_path.h"
 #include "base/scoped_native_library.h"
+#include "base/synchronization/lock.h"
 #include "xwalk/extensions/common/xwalk_extension.h"
 #include "xwalk/extensions/public/XW_Extension.h"
 #include "xwalk/extensions/public/XW_Extension_SyncMessage.h"
 
-namespace base {
-class FilePath;
-};
-
 namespace xwalk {
 namespace extensions {
 
@@ -28,6 +26,11 @@ class XWalkExternalContext;
 // library, and store the callbacks to call it back later. The associated
 // XW_Extension is used to identify this extension when calling the shared
 // library.
+//
+// An extension can also be created from the name and JavaScript API listed in
+// the library's descriptor, without loading it. The library is then loaded and
+// initialized the first time an instance is created, which happens in the
+// extension thread.
 class XWalkExternalExtension : public XWalkExtension {
  public:
   // TODO(cmarcelo): Remove extra parameter after old::XWalkExternalExtension is
@@ -36,8 +39,28 @@ class XWalkExternalExtension : public XWalkExtension {
   explicit XWalkExternalExtension(const base::FilePath& path,
                                   base::NativeLibrary = NULL);
 
+  // Options of a deferred extension that its library would otherwise set from
+  // XW_Initialize(). They are read from its descriptor instead, so they are
+  // fixed when the extension is registered, before its library is loaded.
+  struct DescriptorOptions {
+    DescriptorOptions();
+
+    bool message_batching_enabled;
+    base::TimeDelta message_batching_max_latency;
+    bool uses_dedicated_thread;
+  };
+
+  // Creates an extension whose library at |path| is only loaded when the first
+  // instance is created. The name, JavaScript API and |options| set by the
+  // library when initialized must match the ones given here.
+  XWalkExternalExtension(const base::FilePath& path, const std::string& name,
+                         const std::string& js_api,
+                         const DescriptorOptions& options);
+
   virtual ~XWalkExternalExtension();
 
+  // For deferred extensions this is true until loading the library fails,
+  // which is only known after the first instance was requested.
   bool is_valid();
 
  private:
@@ -49,6 +72,13 @@ class XWalkExternalExtension : public XWalkExtension {
   virtual XWalkExtensionInstance* CreateInstance(
       const PostMessageCallback& post_message) OVERRIDE;
 
+  // Loads the library if needed and calls its XW_Initialize. Returns false and
+  // closes the library if any of these fail.
+  bool Initialize(base::NativeLibrary native_library);
+
+  // Initializes deferred extensions, only the first call does any work.
+  bool EnsureInitialized();
+
   // XW_CoreInterface_1 (from XW_Extension.h) implementation.
   void CoreSetExtensionName(const char* name);
   void CoreSetJavaScriptAPI(const char* js_api);
@@ -60,9 +90,22 @@ class XWalkExternalExtension : public XWalkExtension {
   // XW_MessagingInterface_1 (from XW_Extension.h) implementation.
   void MessagingRegister(XW_HandleMessageCallback callback);
 
+  // XW_BinaryMessagingInterface_1 (from XW_Extension.h) implementation.
+  void BinaryMessagingRegister(XW_HandleBinaryMessageCallback callback);
+
+  // XW_FlowControlInterface_1 (from XW_Extension.h) implementation.
+  void FlowControlRegisterDrainCallback(XW_MessagesDrainedCallback callback);
+
+  // XW_MessageBatchingInterface_1 (from XW_Extension.h) implementation.
+  void MessageBatchingEnable(uint32_t max_latency_ms);
+
+  // XW_ThreadingInterface_1 (from XW_Extension.h) implementation.
+  void ThreadingRequestDedicatedThread();
+
   // XW_Internal_SyncMessagingInterface_1 (from XW_Extension.h) implementation.
   void SyncMessagingRegister(XW_HandleSyncMessageCallback callback);
 
+  base::FilePath path_;
   base::ScopedNativeLibrary library_;
   XW_Extension xw_extension_;
 
@@ -70,11 +113,19 @@ class XWalkExternalExtension : public XWalkExtension {
   XW_DestroyedInstanceCallback destroyed_instance_callback_;
   XW_ShutdownCallback shutdown_callback_;
   XW_HandleMessageCallback handle_msg_callback_;
+  XW_HandleBinaryMessageCallback handle_binary_msg_callback_;
   XW_HandleSyncMessageCallback handle_sync_msg_callback_;
+  XW_MessagesDrainedCallback messages_drained_callback_;
 
   std::string js_api_;
   bool initialized_;
 
+  // Protects the initialization of deferred extensions, since instances of the
+  // same extension may be created from different extension threads.
+  base::Lock initialization_lock_;
+  bool deferred_;
+  bool initialization_failed_;
+
   DISALLOW_COPY_AND_ASSIGN(XWalkExternalExtension);
 };
 
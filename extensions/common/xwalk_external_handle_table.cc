@@ -0,0 +1,186 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_external_handle_table.h"
+
+#include <string.h>
+#include "base/logging.h"
+
+using base::subtle::Acquire_CompareAndSwap;
+using base::subtle::Acquire_Load;
+using base::subtle::Atomic32;
+using base::subtle::AtomicWord;
+using base::subtle::NoBarrier_AtomicIncrement;
+using base::subtle::NoBarrier_Load;
+using base::subtle::NoBarrier_Store;
+using base::subtle::Release_CompareAndSwap;
+using base::subtle::Release_Store;
+
+namespace xwalk {
+namespace extensions {
+
+namespace {
+
+const uint32_t kIndexMask = XWalkExternalHandleTable::kMaxIndex;
+
+uint32_t HandleIndex(XWalkExternalHandleTable::Handle handle) {
+  return static_cast<uint32_t>(handle) & kIndexMask;
+}
+
+uint32_t HandleGeneration(XWalkExternalHandleTable::Handle handle) {
+  return static_cast<uint32_t>(handle) >> XWalkExternalHandleTable::kIndexBits;
+}
+
+XWalkExternalHandleTable::Handle MakeHandle(uint32_t index,
+                                            uint32_t generation) {
+  return static_cast<XWalkExternalHandleTable::Handle>(
+      (generation << XWalkExternalHandleTable::kIndexBits) | index);
+}
+
+// The free list head keeps the index in the low bits and the tag above it.
+Atomic32 MakeFreeListHead(Atomic32 previous_head, uint32_t index) {
+  uint32_t tag = (static_cast<uint32_t>(previous_head) >>
+                  XWalkExternalHandleTable::kIndexBits) + 1;
+  return static_cast<Atomic32>(
+      (tag << XWalkExternalHandleTable::kIndexBits) | index);
+}
+
+}  // namespace
+
+const int XWalkExternalHandleTable::kIndexBits;
+const uint32_t XWalkExternalHandleTable::kMaxIndex;
+const uint32_t XWalkExternalHandleTable::kMaxGeneration;
+const uint32_t XWalkExternalHandleTable::kSlotsPerChunk;
+const uint32_t XWalkExternalHandleTable::kChunkCount;
+
+XWalkExternalHandleTable::XWalkExternalHandleTable()
+    : free_list_head_(0),
+      next_unused_index_(1) {
+  memset(chunks_, 0, sizeof(chunks_));
+}
+
+XWalkExternalHandleTable::~XWalkExternalHandleTable() {
+  for (uint32_t i = 0; i < kChunkCount; ++i)
+    delete[] reinterpret_cast<Slot*>(chunks_[i]);
+}
+
+XWalkExternalHandleTable::Handle XWalkExternalHandleTable::Reserve() {
+  uint32_t index = PopFreeIndex();
+  if (!index) {
+    // Checking first keeps the counter from wrapping around once the table
+    // is full.
+    if (static_cast<uint32_t>(NoBarrier_Load(&next_unused_index_)) >
+        kMaxIndex)
+      return 0;
+    index = NoBarrier_AtomicIncrement(&next_unused_index_, 1) - 1;
+    if (index > kMaxIndex)
+      return 0;
+  }
+
+  Slot* slot = GetOrCreateSlot(index);
+  uint32_t generation = Acquire_Load(&slot->generation);
+  return MakeHandle(index, generation);
+}
+
+void XWalkExternalHandleTable::Set(Handle handle, void* object) {
+  Slot* slot = GetSlotForHandle(handle);
+  CHECK(slot);
+  CHECK(!NoBarrier_Load(&slot->object));
+  Release_Store(&slot->object, reinterpret_cast<AtomicWord>(object));
+}
+
+void XWalkExternalHandleTable::Release(Handle handle) {
+  Slot* slot = GetSlotForHandle(handle);
+  CHECK(slot);
+
+  uint32_t generation = (HandleGeneration(handle) + 1) & kMaxGeneration;
+  Release_Store(&slot->object, 0);
+  Release_Store(&slot->generation, generation);
+  PushFreeIndex(HandleIndex(handle));
+}
+
+void* XWalkExternalHandleTable::Lookup(Handle handle) const {
+  Slot* slot = GetSlotForHandle(handle);
+  if (!slot)
+    return NULL;
+
+  void* object = reinterpret_cast<void*>(Acquire_Load(&slot->object));
+
+  // The handle may have been released, and the slot reused, after we checked
+  // the generation.
+  if (static_cast<uint32_t>(Acquire_Load(&slot->generation)) !=
+      HandleGeneration(handle))
+    return NULL;
+  return object;
+}
+
+XWalkExternalHandleTable::Slot* XWalkExternalHandleTable::GetSlot(
+    uint32_t index) const {
+  Slot* chunk = reinterpret_cast<Slot*>(
+      Acquire_Load(&chunks_[index / kSlotsPerChunk]));
+  if (!chunk)
+    return NULL;
+  return &chunk[index % kSlotsPerChunk];
+}
+
+XWalkExternalHandleTable::Slot* XWalkExternalHandleTable::GetOrCreateSlot(
+    uint32_t index) {
+  Slot* slot = GetSlot(index);
+  if (slot)
+    return slot;
+
+  // Another thread may be creating the same chunk, only one of them wins.
+  Slot* chunk = new Slot[kSlotsPerChunk]();
+  AtomicWord* chunk_ptr = &chunks_[index / kSlotsPerChunk];
+  if (Release_CompareAndSwap(chunk_ptr, 0,
+                             reinterpret_cast<AtomicWord>(chunk)) != 0)
+    delete[] chunk;
+  return GetSlot(index);
+}
+
+XWalkExternalHandleTable::Slot* XWalkExternalHandleTable::GetSlotForHandle(
+    Handle handle) const {
+  if (handle <= 0)
+    return NULL;
+
+  uint32_t index = HandleIndex(handle);
+  if (!index)
+    return NULL;
+
+  Slot* slot = GetSlot(index);
+  if (!slot || static_cast<uint32_t>(Acquire_Load(&slot->generation)) !=
+      HandleGeneration(handle))
+    return NULL;
+  return slot;
+}
+
+uint32_t XWalkExternalHandleTable::PopFreeIndex() {
+  for (;;) {
+    Atomic32 head = Acquire_Load(&free_list_head_);
+    uint32_t index = static_cast<uint32_t>(head) & kIndexMask;
+    if (!index)
+      return 0;
+
+    // Slots in the free list always have their chunk allocated.
+    uint32_t next = NoBarrier_Load(&GetSlot(index)->next_free);
+    if (Acquire_CompareAndSwap(&free_list_head_, head,
+                               MakeFreeListHead(head, next)) == head)
+      return index;
+  }
+}
+
+void XWalkExternalHandleTable::PushFreeIndex(uint32_t index) {
+  Slot* slot = GetSlot(index);
+  for (;;) {
+    Atomic32 head = Acquire_Load(&free_list_head_);
+    NoBarrier_Store(&slot->next_free,
+                    static_cast<uint32_t>(head) & kIndexMask);
+    if (Release_CompareAndSwap(&free_list_head_, head,
+                               MakeFreeListHead(head, index)) == head)
+      return;
+  }
+}
+
+}  // namespace extensions
+}  // namespace xwalk
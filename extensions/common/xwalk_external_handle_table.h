@@ -0,0 +1,91 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_COMMON_XWALK_EXTERNAL_HANDLE_TABLE_H_
+#define XWALK_EXTENSIONS_COMMON_XWALK_EXTERNAL_HANDLE_TABLE_H_
+
+#include <stdint.h>
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+
+namespace xwalk {
+namespace extensions {
+
+// Maps the integer handles given to external extensions, XW_Extension and
+// XW_Instance, to the objects behind them. Every call from an extension goes
+// through a lookup, from whatever thread the extension uses, so all methods
+// are thread-safe without taking locks: Lookup() is wait-free and the others
+// are lock-free.
+//
+// A handle holds the index of a slot and the generation of the slot when the
+// handle was reserved. Releasing a handle bumps the generation, so stale
+// handles don't find the object that reuses the slot later. Generations wrap
+// around after kMaxGeneration reuses of the same slot.
+//
+// Lookups don't keep the object alive, callers must ensure it isn't destroyed
+// while they use it, like the C API requires extensions to do.
+class XWalkExternalHandleTable {
+ public:
+  typedef int32_t Handle;
+
+  static const int kIndexBits = 16;
+  static const uint32_t kMaxIndex = (1 << kIndexBits) - 1;
+  static const uint32_t kMaxGeneration = (1 << (31 - kIndexBits)) - 1;
+
+  XWalkExternalHandleTable();
+  ~XWalkExternalHandleTable();
+
+  // Returns a new handle, not mapped to any object yet, or 0 if all of them
+  // are in use. Valid handles are always positive.
+  Handle Reserve();
+
+  // Maps the reserved |handle| to |object|.
+  void Set(Handle handle, void* object);
+
+  // Invalidates |handle| and makes its slot available again.
+  void Release(Handle handle);
+
+  // Returns NULL if |handle| is not valid or not mapped to an object.
+  void* Lookup(Handle handle) const;
+
+ private:
+  struct Slot {
+    base::subtle::Atomic32 generation;
+    base::subtle::AtomicWord object;
+    // Index of the next slot in the free list.
+    base::subtle::Atomic32 next_free;
+  };
+
+  static const uint32_t kSlotsPerChunk = 256;
+  static const uint32_t kChunkCount = (kMaxIndex + 1) / kSlotsPerChunk;
+
+  // Slots are allocated in chunks as they are first needed. Returns NULL if
+  // the chunk of |index| wasn't allocated.
+  Slot* GetSlot(uint32_t index) const;
+  Slot* GetOrCreateSlot(uint32_t index);
+
+  // Returns the slot of |handle|, if it still has the handle's generation.
+  Slot* GetSlotForHandle(Handle handle) const;
+
+  uint32_t PopFreeIndex();
+  void PushFreeIndex(uint32_t index);
+
+  base::subtle::AtomicWord chunks_[kChunkCount];
+
+  // Index of the first slot of the free list in the low bits, and a tag in
+  // the high ones that changes on every update, so a CAS doesn't succeed on
+  // a head that was popped and pushed back meanwhile.
+  base::subtle::Atomic32 free_list_head_;
+
+  // Slots from this index on were never used. Index 0 is never used, so no
+  // handle is 0.
+  base::subtle::Atomic32 next_unused_index_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkExternalHandleTable);
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_COMMON_XWALK_EXTERNAL_HANDLE_TABLE_H_
@@ -0,0 +1,121 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_external_handle_table.h"
+
+#include <vector>
+#include "base/threading/simple_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using xwalk::extensions::XWalkExternalHandleTable;
+
+TEST(XWalkExternalHandleTableTest, ReservedHandleIsMappedOnceSet) {
+  XWalkExternalHandleTable table;
+  int object;
+
+  XWalkExternalHandleTable::Handle handle = table.Reserve();
+  EXPECT_GT(handle, 0);
+  EXPECT_EQ(NULL, table.Lookup(handle));
+
+  table.Set(handle, &object);
+  EXPECT_EQ(&object, table.Lookup(handle));
+
+  table.Release(handle);
+  EXPECT_EQ(NULL, table.Lookup(handle));
+}
+
+TEST(XWalkExternalHandleTableTest, InvalidHandles) {
+  XWalkExternalHandleTable table;
+  EXPECT_EQ(NULL, table.Lookup(0));
+  EXPECT_EQ(NULL, table.Lookup(-1));
+  EXPECT_EQ(NULL, table.Lookup(12345));
+}
+
+TEST(XWalkExternalHandleTableTest, StaleHandleDoesNotFindNewObject) {
+  XWalkExternalHandleTable table;
+  int first;
+  int second;
+
+  XWalkExternalHandleTable::Handle old_handle = table.Reserve();
+  table.Set(old_handle, &first);
+  table.Release(old_handle);
+
+  // The slot is reused, with a different generation.
+  XWalkExternalHandleTable::Handle new_handle = table.Reserve();
+  EXPECT_NE(old_handle, new_handle);
+  table.Set(new_handle, &second);
+
+  EXPECT_EQ(NULL, table.Lookup(old_handle));
+  EXPECT_EQ(&second, table.Lookup(new_handle));
+}
+
+TEST(XWalkExternalHandleTableTest, ReserveFailsWhenFull) {
+  XWalkExternalHandleTable table;
+  std::vector<XWalkExternalHandleTable::Handle> handles;
+  for (uint32_t i = 0; i < XWalkExternalHandleTable::kMaxIndex; ++i) {
+    XWalkExternalHandleTable::Handle handle = table.Reserve();
+    ASSERT_GT(handle, 0);
+    handles.push_back(handle);
+  }
+  EXPECT_EQ(0, table.Reserve());
+
+  table.Release(handles.back());
+  EXPECT_GT(table.Reserve(), 0);
+}
+
+namespace {
+
+// Reserves, looks up and releases handles in a loop, checking that lookups
+// always find its own objects.
+class HandleTableUser : public base::DelegateSimpleThread::Delegate {
+ public:
+  explicit HandleTableUser(XWalkExternalHandleTable* table)
+      : table_(table), failures_(0) {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < 10000; ++i) {
+      XWalkExternalHandleTable::Handle handles[8];
+      for (int j = 0; j < 8; ++j) {
+        handles[j] = table_->Reserve();
+        table_->Set(handles[j], &objects_[j]);
+      }
+      for (int j = 0; j < 8; ++j) {
+        if (table_->Lookup(handles[j]) != &objects_[j])
+          failures_++;
+        table_->Release(handles[j]);
+        if (table_->Lookup(handles[j]))
+          failures_++;
+      }
+    }
+  }
+
+  int failures() const { return failures_; }
+
+ private:
+  XWalkExternalHandleTable* table_;
+  int objects_[8];
+  int failures_;
+};
+
+}  // namespace
+
+TEST(XWalkExternalHandleTableTest, ConcurrentUse) {
+  XWalkExternalHandleTable table;
+  const int kThreadCount = 4;
+  HandleTableUser* users[kThreadCount];
+  base::DelegateSimpleThread* threads[kThreadCount];
+
+  for (int i = 0; i < kThreadCount; ++i) {
+    users[i] = new HandleTableUser(&table);
+    threads[i] = new base::DelegateSimpleThread(users[i], "HandleTableUser");
+    threads[i]->Start();
+  }
+
+  for (int i = 0; i < kThreadCount; ++i) {
+    threads[i]->Join();
+    EXPECT_EQ(0, users[i]->failures());
+    delete threads[i];
+    delete users[i];
+  }
+}
@@ -0,0 +1,178 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_script_data_store.h"
+
+#include "base/bind.h"
+#include "base/file_util.h"
+#include "base/files/file_enumerator.h"
+#include "base/files/important_file_writer.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/sha1.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/worker_pool.h"
+#include "v8/include/v8.h"
+
+namespace xwalk {
+namespace extensions {
+
+namespace {
+
+std::string CodeToEnsureNamespace(const std::string& extension_name) {
+  std::string result;
+  size_t pos = 0;
+  while (true) {
+    pos = extension_name.find('.', pos);
+    if (pos == std::string::npos) {
+      result += extension_name + " = {};";
+      break;
+    }
+    std::string ns = extension_name.substr(0, pos);
+    result += ns + " = " + ns + " || {}; ";
+    pos++;
+  }
+  return result;
+}
+
+// Pre-compiles |source| in an isolate of its own, so this can run on any
+// thread without touching the ones used by the rest of the process. Returns
+// an empty string if V8 couldn't create valid data for it.
+std::string PreCompileScript(const std::string& source) {
+  v8::Isolate* isolate = v8::Isolate::New();
+  std::string data;
+  {
+    v8::Locker locker(isolate);
+    v8::Isolate::Scope isolate_scope(isolate);
+    scoped_ptr<v8::ScriptData> script_data(
+        v8::ScriptData::PreCompile(source.c_str(), source.size()));
+    if (script_data && !script_data->HasError())
+      data.assign(script_data->Data(), script_data->Length());
+  }
+  isolate->Dispose();
+  return data;
+}
+
+}  // namespace
+
+// Wrap API code into a callable form that takes extension object as parameter.
+std::string WrapExtensionAPICode(const std::string& extension_code,
+                                 const std::string& extension_name) {
+  // We take care here to make sure that line numbering for api_code after
+  // wrapping doesn't change, so that syntax errors point to the correct line.
+  return base::StringPrintf(
+      "var %s; (function(extension, requireNative) { "
+      "extension._setupExtensionInternal = function() {"
+      "  xwalk._setupExtensionInternal(extension);"
+      "};"
+      "extension.internal = {};"
+      "extension.internal.sendSyncMessage ="
+      "    extension.sendSyncMessage.bind(extension);"
+      "delete extension.sendSyncMessage;"
+      "return (function(exports) {'use strict'; %s\n})(%s); });",
+      CodeToEnsureNamespace(extension_name).c_str(),
+      extension_code.c_str(),
+      extension_name.c_str());
+}
+
+XWalkScriptDataStore::XWalkScriptDataStore(const base::FilePath& dir)
+    : dir_(dir) {
+}
+
+XWalkScriptDataStore::~XWalkScriptDataStore() {
+}
+
+bool XWalkScriptDataStore::Load() {
+  if (!file_util::CreateDirectory(dir_)) {
+    LOG(WARNING) << "Couldn't create script data directory " << dir_.value();
+    return false;
+  }
+
+  base::FileEnumerator files(dir_, false, base::FileEnumerator::FILES);
+  for (base::FilePath path = files.Next(); !path.empty(); path = files.Next()) {
+    std::string source_hash = path.BaseName().MaybeAsASCII();
+    if (!IsValidHash(source_hash))
+      continue;
+    std::string data;
+    if (!file_util::ReadFileToString(path, &data) || data.empty())
+      continue;
+    base::AutoLock lock(lock_);
+    entries_[source_hash] = data;
+  }
+  return true;
+}
+
+void XWalkScriptDataStore::AddExtensionSoon(const std::string& extension_name,
+                                            const std::string& extension_code) {
+  std::string source = WrapExtensionAPICode(extension_code, extension_name);
+  std::string source_hash = HashScriptSource(source);
+  if (!MarkPending(source_hash))
+    return;
+
+  base::WorkerPool::PostTask(FROM_HERE,
+      base::Bind(&XWalkScriptDataStore::CreateEntry, this, source_hash,
+                 source),
+      true /* task is slow */);
+}
+
+void XWalkScriptDataStore::AddExtension(const std::string& extension_name,
+                                        const std::string& extension_code) {
+  std::string source = WrapExtensionAPICode(extension_code, extension_name);
+  std::string source_hash = HashScriptSource(source);
+  if (!MarkPending(source_hash))
+    return;
+
+  CreateEntry(source_hash, source);
+}
+
+std::map<std::string, std::string> XWalkScriptDataStore::GetEntries() const {
+  base::AutoLock lock(lock_);
+  return entries_;
+}
+
+// static
+std::string XWalkScriptDataStore::HashScriptSource(const std::string& source) {
+  std::string hash = base::SHA1HashString(source);
+  return base::HexEncode(hash.data(), hash.size());
+}
+
+// static
+bool XWalkScriptDataStore::IsValidHash(const std::string& source_hash) {
+  if (source_hash.size() != base::kSHA1Length * 2)
+    return false;
+  for (size_t i = 0; i < source_hash.size(); ++i) {
+    if (!IsHexDigit(source_hash[i]))
+      return false;
+  }
+  return true;
+}
+
+bool XWalkScriptDataStore::MarkPending(const std::string& source_hash) {
+  base::AutoLock lock(lock_);
+  if (entries_.count(source_hash) || pending_hashes_.count(source_hash))
+    return false;
+  pending_hashes_.insert(source_hash);
+  return true;
+}
+
+void XWalkScriptDataStore::CreateEntry(const std::string& source_hash,
+                                       const std::string& source) {
+  std::string data = PreCompileScript(source);
+  // Written to a temporary file first, so a later run never reads a partial
+  // entry.
+  if (!data.empty() && !base::ImportantFileWriter::WriteFileAtomically(
+          dir_.AppendASCII(source_hash), data)) {
+    LOG(WARNING) << "Couldn't store script data " << source_hash;
+  }
+
+  base::AutoLock lock(lock_);
+  pending_hashes_.erase(source_hash);
+  if (!data.empty())
+    entries_[source_hash] = data;
+}
+
+}  // namespace extensions
+}  // namespace xwalk
@@ -0,0 +1,82 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_COMMON_XWALK_SCRIPT_DATA_STORE_H_
+#define XWALK_EXTENSIONS_COMMON_XWALK_SCRIPT_DATA_STORE_H_
+
+#include <map>
+#include <set>
+#include <string>
+#include "base/files/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+
+namespace xwalk {
+namespace extensions {
+
+// Returns the code render processes run for the JS API code of an extension,
+// a callable that takes the extension object as parameter. Its pre-compilation
+// data is created for this exact source.
+std::string WrapExtensionAPICode(const std::string& extension_code,
+                                 const std::string& extension_name);
+
+// Keeps the data V8 generates when pre-compiling the wrapped JS API code of
+// the extensions, stored in a directory so that later runs don't create it
+// again. Entries are keyed by a hash of the source code, see
+// HashScriptSource().
+//
+// The data is only created here, from the API code of the extensions
+// registered in the browser process. Render processes get the entries but
+// never send data back, so one can't feed the others data V8 would trust.
+// It is shared by the servers of all the render processes and can be used
+// from any thread.
+class XWalkScriptDataStore
+    : public base::RefCountedThreadSafe<XWalkScriptDataStore> {
+ public:
+  explicit XWalkScriptDataStore(const base::FilePath& dir);
+
+  // Loads the entries stored in previous runs. Returns false if the directory
+  // can't be created. This does blocking disk I/O.
+  bool Load();
+
+  // Creates and stores the data for the JS API code of an extension on the
+  // worker pool, unless it is already there.
+  void AddExtensionSoon(const std::string& extension_name,
+                        const std::string& extension_code);
+
+  // Same as AddExtensionSoon() but in the calling thread, which should allow
+  // blocking I/O.
+  void AddExtension(const std::string& extension_name,
+                    const std::string& extension_code);
+
+  std::map<std::string, std::string> GetEntries() const;
+
+  static std::string HashScriptSource(const std::string& source);
+
+  // Hashes are used as file names, so we make sure anything else found in the
+  // directory can't be taken for an entry.
+  static bool IsValidHash(const std::string& source_hash);
+
+ private:
+  friend class base::RefCountedThreadSafe<XWalkScriptDataStore>;
+  ~XWalkScriptDataStore();
+
+  // Returns false if the entry for |source_hash| exists or is being created.
+  bool MarkPending(const std::string& source_hash);
+  void CreateEntry(const std::string& source_hash, const std::string& source);
+
+  base::FilePath dir_;
+
+  mutable base::Lock lock_;
+  std::map<std::string, std::string> entries_;
+  // Hashes of the entries being created on the worker pool.
+  std::set<std::string> pending_hashes_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkScriptDataStore);
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_COMMON_XWALK_SCRIPT_DATA_STORE_H_
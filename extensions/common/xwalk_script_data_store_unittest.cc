@@ -0,0 +1,92 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/common/xwalk_script_data_store.h"
+
+#include <map>
+#include <string>
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using xwalk::extensions::WrapExtensionAPICode;
+using xwalk::extensions::XWalkScriptDataStore;
+
+namespace {
+
+const char kExtensionName[] = "store.test";
+const char kExtensionCode[] =
+    "exports.add = function(a, b) { return a + b; };"
+    "exports.twice = function(f) { return function(x) { return f(f(x)); }; };";
+
+std::string GetExtensionHash() {
+  return XWalkScriptDataStore::HashScriptSource(
+      WrapExtensionAPICode(kExtensionCode, kExtensionName));
+}
+
+void WriteEntryFile(const base::FilePath& dir, const std::string& name) {
+  const char kData[] = "data";
+  ASSERT_EQ(static_cast<int>(sizeof(kData)), file_util::WriteFile(
+      dir.AppendASCII(name), kData, sizeof(kData)));
+}
+
+}  // namespace
+
+TEST(XWalkScriptDataStoreTest, ValidHashes) {
+  EXPECT_TRUE(XWalkScriptDataStore::IsValidHash(GetExtensionHash()));
+  EXPECT_TRUE(XWalkScriptDataStore::IsValidHash(
+      "0123456789abcdefABCDEF0123456789abcdef01"));
+
+  EXPECT_FALSE(XWalkScriptDataStore::IsValidHash(""));
+  EXPECT_FALSE(XWalkScriptDataStore::IsValidHash("0123456789abcdef"));
+  EXPECT_FALSE(XWalkScriptDataStore::IsValidHash(
+      "0123456789abcdefABCDEF0123456789abcdef012"));
+  EXPECT_FALSE(XWalkScriptDataStore::IsValidHash(
+      "0123456789abcdefABCDEF0123456789abcdef0g"));
+  EXPECT_FALSE(XWalkScriptDataStore::IsValidHash(
+      "../3456789abcdefABCDEF0123456789abcdef01"));
+}
+
+TEST(XWalkScriptDataStoreTest, EntriesAreStoredForLaterRuns) {
+  base::ScopedTempDir dir;
+  ASSERT_TRUE(dir.CreateUniqueTempDir());
+  std::string hash = GetExtensionHash();
+
+  scoped_refptr<XWalkScriptDataStore> store(
+      new XWalkScriptDataStore(dir.path()));
+  ASSERT_TRUE(store->Load());
+  EXPECT_TRUE(store->GetEntries().empty());
+
+  store->AddExtension(kExtensionName, kExtensionCode);
+  std::map<std::string, std::string> entries = store->GetEntries();
+  ASSERT_EQ(1u, entries.size());
+  ASSERT_EQ(hash, entries.begin()->first);
+  EXPECT_FALSE(entries[hash].empty());
+  EXPECT_TRUE(file_util::PathExists(dir.path().AppendASCII(hash)));
+
+  scoped_refptr<XWalkScriptDataStore> later_store(
+      new XWalkScriptDataStore(dir.path()));
+  ASSERT_TRUE(later_store->Load());
+  EXPECT_EQ(entries, later_store->GetEntries());
+}
+
+TEST(XWalkScriptDataStoreTest, OnlyFilesNamedAfterHashesAreLoaded) {
+  base::ScopedTempDir dir;
+  ASSERT_TRUE(dir.CreateUniqueTempDir());
+  std::string hash = GetExtensionHash();
+  WriteEntryFile(dir.path(), hash);
+  WriteEntryFile(dir.path(), "not-a-hash");
+  WriteEntryFile(dir.path(), hash + ".tmp");
+
+  scoped_refptr<XWalkScriptDataStore> store(
+      new XWalkScriptDataStore(dir.path()));
+  ASSERT_TRUE(store->Load());
+  std::map<std::string, std::string> entries = store->GetEntries();
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ(hash, entries.begin()->first);
+
+  // The entry exists already, so it isn't created again.
+  store->AddExtension(kExtensionName, kExtensionCode);
+  EXPECT_EQ(entries, store->GetEntries());
+}
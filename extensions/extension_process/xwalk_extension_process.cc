@@ -0,0 +1,150 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/extension_process/xwalk_extension_process.h"
+
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+#include "base/message_loop/message_loop.h"
+#include "base/stl_util.h"
+#include "content/public/common/content_switches.h"
+#include "ipc/ipc_channel_handle.h"
+#include "ipc/ipc_sync_channel.h"
+#include "xwalk/extensions/common/xwalk_extension_messages.h"
+#include "xwalk/extensions/common/xwalk_extension_stats.h"
+
+namespace xwalk {
+namespace extensions {
+
+XWalkExtensionProcess::RenderProcessChannelData::RenderProcessChannelData()
+    : server(NULL),
+      channel(NULL) {
+}
+
+XWalkExtensionProcess::XWalkExtensionProcess()
+    : shutdown_event_(false, false),
+      io_thread_("XWalkExtensionProcess_IOThread"),
+      extensions_registered_(false) {
+  io_thread_.StartWithOptions(
+      base::Thread::Options(base::MessageLoop::TYPE_IO, 0));
+  CreateBrowserProcessChannel();
+}
+
+XWalkExtensionProcess::~XWalkExtensionProcess() {
+  // Signaling the event will unblock any pending sync message before the
+  // channels go away.
+  shutdown_event_.Signal();
+  RenderProcessChannelMap::iterator it = render_process_channels_.begin();
+  for (; it != render_process_channels_.end(); ++it)
+    DeleteRenderProcessChannelData(it->second);
+  render_process_channels_.clear();
+  browser_process_channel_.reset();
+  io_thread_.Stop();
+}
+
+bool XWalkExtensionProcess::OnMessageReceived(const IPC::Message& message) {
+  bool handled = true;
+  IPC_BEGIN_MESSAGE_MAP(XWalkExtensionProcess, message)
+    IPC_MESSAGE_HANDLER(XWalkExtensionProcessMsg_RegisterExtensions,
+        OnRegisterExtensions)
+    IPC_MESSAGE_HANDLER(XWalkExtensionProcessMsg_CreateRenderProcessChannel,
+        OnCreateRenderProcessChannel)
+    IPC_MESSAGE_HANDLER(XWalkExtensionProcessMsg_CloseRenderProcessChannel,
+        OnCloseRenderProcessChannel)
+    IPC_MESSAGE_HANDLER(XWalkExtensionProcessMsg_GetExtensionStats,
+        OnGetExtensionStats)
+    IPC_MESSAGE_UNHANDLED(handled = false)
+  IPC_END_MESSAGE_MAP()
+  return handled;
+}
+
+void XWalkExtensionProcess::OnChannelError() {
+  // The browser process is gone, there's nothing left for us to do.
+  base::MessageLoop::current()->Quit();
+}
+
+void XWalkExtensionProcess::OnRegisterExtensions(
+    const base::FilePath& extensions_path) {
+  if (extensions_registered_) {
+    LOG(WARNING) << "Extensions were already registered in this process.";
+    return;
+  }
+  extensions_registered_ = true;
+
+  if (!extensions_path.empty()) {
+    RegisterExternalExtensionsInDirectory(&extensions_registry_,
+                                          extensions_path);
+  }
+}
+
+void XWalkExtensionProcess::OnCreateRenderProcessChannel(
+    int render_process_id) {
+  if (ContainsKey(render_process_channels_, render_process_id)) {
+    LOG(WARNING) << "A channel was already created for render process "
+                 << render_process_id;
+    return;
+  }
+
+  IPC::ChannelHandle handle(IPC::Channel::GenerateVerifiedChannelID(
+      std::string()));
+  RenderProcessChannelData& data = render_process_channels_[render_process_id];
+  data.server = new XWalkExtensionServer();
+  data.server->RegisterExtensionsFrom(extensions_registry_);
+  data.channel = new IPC::SyncChannel(handle,
+      IPC::Channel::MODE_SERVER, data.server,
+      io_thread_.message_loop_proxy(), true, &shutdown_event_);
+#if defined(OS_POSIX)
+  // The render process can't connect by name to our end, so its end of the
+  // socket pair is sent along with the handle.
+  handle.socket = base::FileDescriptor(
+      data.channel->TakeClientFileDescriptor(), true);
+#endif
+
+  data.server->Initialize(data.channel);
+  // These are queued in the channel until the render process connects, so it
+  // knows about the extensions before it gets the channel.
+  data.server->RegisterExtensionsInRenderProcess();
+  browser_process_channel_->Send(
+      new XWalkExtensionProcessHostMsg_RenderProcessChannelCreated(
+          render_process_id, handle));
+}
+
+void XWalkExtensionProcess::OnCloseRenderProcessChannel(
+    int render_process_id) {
+  RenderProcessChannelMap::iterator it =
+      render_process_channels_.find(render_process_id);
+  if (it == render_process_channels_.end())
+    return;
+
+  DeleteRenderProcessChannelData(it->second);
+  render_process_channels_.erase(it);
+}
+
+void XWalkExtensionProcess::OnGetExtensionStats(int request_id) {
+  scoped_ptr<base::DictionaryValue> stats(
+      XWalkExtensionStatsRegistry::GetInstance()->ToValue());
+  browser_process_channel_->Send(
+      new XWalkExtensionProcessHostMsg_ExtensionStats(request_id, *stats));
+}
+
+void XWalkExtensionProcess::DeleteRenderProcessChannelData(
+    const RenderProcessChannelData& data) {
+  // Invalidating the server first avoids it sending messages to the channel
+  // while it is destroyed.
+  data.server->Invalidate();
+  delete data.channel;
+  delete data.server;
+}
+
+void XWalkExtensionProcess::CreateBrowserProcessChannel() {
+  std::string channel_id =
+      CommandLine::ForCurrentProcess()->GetSwitchValueASCII(
+          switches::kProcessChannelID);
+  browser_process_channel_.reset(new IPC::SyncChannel(channel_id,
+      IPC::Channel::MODE_CLIENT, this, io_thread_.message_loop_proxy(),
+      true, &shutdown_event_));
+}
+
+}  // namespace extensions
+}  // namespace xwalk
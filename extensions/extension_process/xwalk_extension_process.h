@@ -0,0 +1,75 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_EXTENSION_PROCESS_XWALK_EXTENSION_PROCESS_H_
+#define XWALK_EXTENSIONS_EXTENSION_PROCESS_XWALK_EXTENSION_PROCESS_H_
+
+#include <map>
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread.h"
+#include "ipc/ipc_listener.h"
+#include "xwalk/extensions/common/xwalk_extension_server.h"
+
+namespace base {
+class FilePath;
+}
+
+namespace IPC {
+class SyncChannel;
+}
+
+namespace xwalk {
+namespace extensions {
+
+// Main object of the extension process. It receives from the browser process
+// the path of the external extensions to load, and creates the channels used
+// by the render processes to talk directly to the XWalkExtensionServers that
+// run them. There is one server per render process, all of them share the
+// extensions loaded once in this process. Lives on the main thread of the
+// extension process.
+class XWalkExtensionProcess : public IPC::Listener {
+ public:
+  XWalkExtensionProcess();
+  virtual ~XWalkExtensionProcess();
+
+ private:
+  // IPC::Listener implementation, for the channel with the browser process.
+  virtual bool OnMessageReceived(const IPC::Message& message) OVERRIDE;
+  virtual void OnChannelError() OVERRIDE;
+
+  // Message Handlers.
+  void OnRegisterExtensions(const base::FilePath& extensions_path);
+  void OnCreateRenderProcessChannel(int render_process_id);
+  void OnCloseRenderProcessChannel(int render_process_id);
+  void OnGetExtensionStats(int request_id);
+
+  void CreateBrowserProcessChannel();
+
+  struct RenderProcessChannelData {
+    RenderProcessChannelData();
+
+    XWalkExtensionServer* server;
+    IPC::SyncChannel* channel;
+  };
+  void DeleteRenderProcessChannelData(const RenderProcessChannelData& data);
+
+  base::WaitableEvent shutdown_event_;
+  base::Thread io_thread_;
+  scoped_ptr<IPC::SyncChannel> browser_process_channel_;
+
+  // Holds the external extensions, it isn't connected to any render process.
+  XWalkExtensionServer extensions_registry_;
+  bool extensions_registered_;
+
+  typedef std::map<int, RenderProcessChannelData> RenderProcessChannelMap;
+  RenderProcessChannelMap render_process_channels_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkExtensionProcess);
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_EXTENSION_PROCESS_XWALK_EXTENSION_PROCESS_H_
@@ -0,0 +1,32 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/extension_process/xwalk_extension_process_main.h"
+
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "content/public/common/main_function_params.h"
+#include "xwalk/extensions/extension_process/xwalk_extension_process.h"
+
+namespace xwalk {
+namespace extensions {
+
+int XWalkExtensionProcessMain(const content::MainFunctionParams& parameters) {
+  // The extensions server watches the sockets used by sync messages in this
+  // loop.
+  base::MessageLoop main_message_loop(base::MessageLoop::TYPE_IO);
+
+  VLOG(1) << "Extension process running!";
+
+  XWalkExtensionProcess extension_process;
+  base::RunLoop run_loop;
+  run_loop.Run();
+
+  VLOG(1) << "Extension process shutting down.";
+
+  return 0;
+}
+
+}  // namespace extensions
+}  // namespace xwalk
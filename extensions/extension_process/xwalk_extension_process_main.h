@@ -0,0 +1,21 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_EXTENSION_PROCESS_XWALK_EXTENSION_PROCESS_MAIN_H_
+#define XWALK_EXTENSIONS_EXTENSION_PROCESS_XWALK_EXTENSION_PROCESS_MAIN_H_
+
+namespace content {
+struct MainFunctionParams;
+}
+
+namespace xwalk {
+namespace extensions {
+
+// Entry point of the extension process, see XWalkMainDelegate::RunProcess().
+int XWalkExtensionProcessMain(const content::MainFunctionParams& parameters);
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_EXTENSION_PROCESS_XWALK_EXTENSION_PROCESS_MAIN_H_
@@ -16,5 +16,29 @@
         'cc_dir': 'xwalk/extensions/test',
         'root_namespace': 'xwalk::jsapi_test',
       },
+      'actions': [
+        {
+          'action_name': 'api_test_function_ids',
+          'variables': {
+            'generator': 'tools/generate_function_ids.py',
+          },
+          'inputs': [
+            '<(generator)',
+            '<@(schema_files)',
+          ],
+          'outputs': [
+            '<(SHARED_INTERMEDIATE_DIR)/<(cc_dir)/test_functions.h',
+          ],
+          'action': [
+            'python',
+            '<(generator)',
+            '<(root_namespace)',
+            '<(cc_dir)',
+            '<(SHARED_INTERMEDIATE_DIR)/<(cc_dir)',
+            '<@(schema_files)',
+          ],
+          'message': 'Generating function ids for <(cc_dir)',
+        },
+      ],
    }],
 }
@@ -22,6 +22,20 @@
 //
 // Crosswalk won't call an extension's XW_Initialize() multiple times in the
 // same process.
+//
+// An extension library libfoo.so may come with a descriptor libfoo.json, e.g.
+// { "name": "foo", "jsapi": "foo_api.js" }, listing the extension name and the
+// file with its JavaScript API. Crosswalk then only loads the library, and
+// calls XW_Initialize(), when the first instance is created, and this may
+// happen in any thread. The name and JavaScript API set by XW_Initialize()
+// should match the descriptor.
+//
+// Such an extension can't use XW_MessageBatchingInterface or
+// XW_ThreadingInterface, as its instances may already be handled when
+// XW_Initialize() runs. Their options go in the descriptor instead, e.g.
+// { "name": "foo", "jsapi": "foo_api.js", "batching": 10,
+//   "dedicated_thread": true }, with the maximum latency of message batching
+// in milliseconds.
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,6 +47,7 @@ extern "C" {
 #define XW_EXPORT __declspec(dllexport)
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 
 
@@ -52,7 +67,8 @@ typedef int32_t XW_Instance;
 
 enum {
   XW_OK = 0,
-  XW_ERROR = -1
+  XW_ERROR = -1,
+  XW_ERROR_WOULD_BLOCK = -2
 };
 
 // Returns a struct containing functions to be used by the extension. Those
@@ -113,10 +129,12 @@ struct XW_CoreInterface_1 {
   //            extension.
   //
   // - extension.postMessage(): post a string message to the extension native
-  //                            code. See below for details.
+  //                            code. See below for details. ArrayBuffers are
+  //                            delivered to the binary messaging callback.
   // - extension.setMessageListener(): allow setting a callback that is called
   //                                   when the native code sends a message
-  //                                   to JavaScript. Callback takes a string.
+  //                                   to JavaScript. Callback takes a string,
+  //                                   or an ArrayBuffer for binary messages.
   //
   // This function should be called only during XW_Initialize().
   void (*SetJavaScriptAPI)(XW_Extension extension, const char* api);
@@ -178,6 +196,148 @@ struct XW_MessagingInterface_1 {
 
 typedef struct XW_MessagingInterface_1 XW_MessagingInterface;
 
+
+//
+// XW_BINARY_MESSAGING_INTERFACE: Exchange asynchronous binary messages with
+// JavaScript code provided by extension. Messages are arbitrary byte buffers,
+// that are exposed to JavaScript as ArrayBuffer objects, without any textual
+// encoding in between.
+//
+
+#define XW_BINARY_MESSAGING_INTERFACE_1 "XW_BinaryMessagingInterface_1"
+#define XW_BINARY_MESSAGING_INTERFACE XW_BINARY_MESSAGING_INTERFACE_1
+
+typedef void (*XW_HandleBinaryMessageCallback)(XW_Instance instance,
+                                               const char* data,
+                                               size_t size);
+
+struct XW_BinaryMessagingInterface_1 {
+  // Register a callback to be called when the JavaScript code associated
+  // with the extension posts an ArrayBuffer (or a view of one) using
+  // extension.postMessage(). The data is only valid during the callback.
+  void (*Register)(XW_Extension extension,
+                   XW_HandleBinaryMessageCallback handle_message);
+
+  // Post |size| bytes starting at |data| to the web content associated with
+  // the instance. The listener set with extension.setMessageListener() will
+  // receive them as an ArrayBuffer. The data is copied before this function
+  // returns, and large buffers are transferred using shared memory.
+  //
+  // This function is thread-safe and can be called until the instance is
+  // destroyed.
+  void (*PostMessage)(XW_Instance instance, const char* data, size_t size);
+};
+
+typedef struct XW_BinaryMessagingInterface_1 XW_BinaryMessagingInterface;
+
+
+//
+// XW_FLOW_CONTROL_INTERFACE: Post messages to JavaScript without letting them
+// pile up when the web content can't keep up. Messages posted to an instance
+// are queued until its JavaScript code handled them, and once the queued
+// bytes go over the instance's high watermark the extension is asked to wait
+// until they fall to the low watermark before posting more.
+//
+
+#define XW_FLOW_CONTROL_INTERFACE_1 "XW_FlowControlInterface_1"
+#define XW_FLOW_CONTROL_INTERFACE XW_FLOW_CONTROL_INTERFACE_1
+
+typedef void (*XW_MessagesDrainedCallback)(XW_Instance instance);
+
+struct XW_FlowControlInterface_1 {
+  // Register a callback to be called when the bytes queued for an instance
+  // fall to its low watermark, after a post to it returned
+  // XW_ERROR_WOULD_BLOCK. The callback is called in the same thread as the
+  // message handling callbacks.
+  //
+  // This function should be called only during XW_Initialize().
+  void (*RegisterDrainCallback)(XW_Extension extension,
+                                XW_MessagesDrainedCallback drained);
+
+  // Set the watermarks, in bytes, of the instance. A zero |high_watermark|
+  // disables flow control for the instance, which is the default. Messages
+  // posted before the watermarks were first set don't count for them.
+  //
+  // This function is thread-safe and can be called until the instance is
+  // destroyed.
+  void (*SetWatermarks)(XW_Instance instance, size_t high_watermark,
+                        size_t low_watermark);
+
+  // Same as the PostMessage() functions of XW_MessagingInterface and
+  // XW_BinaryMessagingInterface, but if the bytes queued for the instance are
+  // over its high watermark the message is not posted and
+  // XW_ERROR_WOULD_BLOCK is returned. Otherwise returns XW_OK. Messages
+  // posted with the other interfaces are always accepted, but still count
+  // for the watermarks.
+  //
+  // These functions are thread-safe and can be called until the instance is
+  // destroyed.
+  int32_t (*PostMessage)(XW_Instance instance, const char* message);
+  int32_t (*PostBinaryMessage)(XW_Instance instance, const char* data,
+                               size_t size);
+
+  // Returns the bytes of the messages posted to the instance that weren't
+  // handled yet by its JavaScript code.
+  //
+  // This function is thread-safe and can be called until the instance is
+  // destroyed.
+  size_t (*GetQueuedBytes)(XW_Instance instance);
+};
+
+typedef struct XW_FlowControlInterface_1 XW_FlowControlInterface;
+
+
+//
+// XW_MESSAGE_BATCHING_INTERFACE: Let Crosswalk batch the messages posted to
+// JavaScript. By default each message is sent to the web content right away,
+// extensions posting bursts of small messages can trade some latency for
+// fewer round trips.
+//
+
+#define XW_MESSAGE_BATCHING_INTERFACE_1 "XW_MessageBatchingInterface_1"
+#define XW_MESSAGE_BATCHING_INTERFACE XW_MESSAGE_BATCHING_INTERFACE_1
+
+struct XW_MessageBatchingInterface_1 {
+  // Allow the messages posted by the instances of the extension to be held
+  // for up to |max_latency_ms| milliseconds, and sent together with other
+  // messages pending to the same web content. Zero means they are held only
+  // until Crosswalk finishes its current task. Messages are still delivered
+  // in the order they were posted, and pending ones are sent before the reply
+  // to a sync message. Binary messages are never held.
+  //
+  // This function should be called only during XW_Initialize(). Extensions
+  // loaded from a descriptor set "batching" there instead, the call is then
+  // ignored.
+  void (*Enable)(XW_Extension extension, uint32_t max_latency_ms);
+};
+
+typedef struct XW_MessageBatchingInterface_1 XW_MessageBatchingInterface;
+
+
+//
+// XW_THREADING_INTERFACE: Choose where the callbacks of the instances run.
+// By default the instances of all extensions share a small pool of threads,
+// each instance having its callbacks called in order but not always in the
+// same thread.
+//
+
+#define XW_THREADING_INTERFACE_1 "XW_ThreadingInterface_1"
+#define XW_THREADING_INTERFACE XW_THREADING_INTERFACE_1
+
+struct XW_ThreadingInterface_1 {
+  // Run each instance of the extension in a thread of its own. Extensions
+  // whose callbacks block, e.g. waiting for a device, should call this, as
+  // otherwise they hold one of the few threads shared with the other
+  // extensions.
+  //
+  // This function should be called only during XW_Initialize(). Extensions
+  // loaded from a descriptor set "dedicated_thread" there instead, the call
+  // is then ignored.
+  void (*RequestDedicatedThread)(XW_Extension extension);
+};
+
+typedef struct XW_ThreadingInterface_1 XW_ThreadingInterface;
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
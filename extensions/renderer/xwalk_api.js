@@ -6,25 +6,16 @@ var xwalk = xwalk || {};
 
 xwalk._setupExtensionInternal = function(extension_obj) {
   var callback_listeners = {};
-  var callback_id = 0;
+  var next_callback_id = 1;
 
-  function wrapCallback(args, callback) {
-    if (callback) {
-      var id = (callback_id++).toString();
-      callback_listeners[id] = callback;
-      args.unshift(id);
-    } else {
-      // The function name and the callback ID are prepended before
-      // the arguments. If there is no callback, an empty string is
-      // should be used. This will be sorted out by the InternalInstance
-      // message handler.
-      args.unshift("");
-    }
-  }
+  // Ids of the API functions, generated from its IDL. See
+  // XWalkInternalExtension::SetJavaScriptAPI().
+  var function_ids = extension_obj._functionIds || {};
+  delete extension_obj._functionIds;
 
   extension_obj.setMessageListener(function(msg) {
     var args = arguments[0];
-    var id = args.shift();
+    var id = args.pop();
     var listener = callback_listeners[id];
 
     if (listener !== undefined) {
@@ -37,9 +28,23 @@ xwalk._setupExtensionInternal = function(extension_obj) {
   // this _internal object, acting like a namespace.
   extension_obj._internal = {};
 
+  // The callback ID and the function ID are appended after the arguments,
+  // so the native side can take them out without moving the arguments. If
+  // there is no callback, zero is used as callback ID.
   extension_obj._internal.postMessage = function(function_name, args, callback) {
-    wrapCallback(args, callback);
-    args.unshift(function_name);
+    var function_id = function_ids[function_name];
+    if (function_id === undefined)
+      throw new Error('Unknown function: ' + function_name);
+
+    var id = 0;
+    if (callback) {
+      id = next_callback_id++;
+      // Keep the IDs small integers, so they are not sent as doubles.
+      if (next_callback_id > 0x7fffffff)
+        next_callback_id = 1;
+      callback_listeners[id] = callback;
+    }
+    args.push(id, function_id);
     extension_obj.postMessage(args);
   };
 };
@@ -4,18 +4,40 @@
 
 #include "xwalk/extensions/renderer/xwalk_extension_client.h"
 
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/message_loop/message_loop.h"
+#include "base/process_util.h"
 #include "base/values.h"
+#include "content/public/renderer/render_thread.h"
 #include "ipc/ipc_sender.h"
 #include "xwalk/extensions/common/xwalk_extension_messages.h"
+#include "xwalk/extensions/common/xwalk_extension_switches.h"
+#include "xwalk/extensions/common/xwalk_extension_sync_message_slot.h"
 #include "xwalk/extensions/renderer/xwalk_extension_module.h"
 #include "xwalk/extensions/renderer/xwalk_module_system.h"
 
 namespace xwalk {
 namespace extensions {
 
+namespace {
+
+// Binary messages bigger than this are sent to the extension process in a
+// shared memory buffer, same as the ones coming from it.
+const size_t kBinaryMessageSharedMemoryThreshold = 64 * 1024;
+
+}  // namespace
+
 XWalkExtensionClient::XWalkExtensionClient(IPC::Sender* sender)
     : sender_(sender),
-      next_instance_id_(0) {
+      next_instance_id_(0),
+      weak_factory_(this) {
+#if defined(OS_POSIX)
+  sync_message_slots_enabled_ =
+      XWalkExtensionSyncMessageSlot::IsSupported() &&
+      !CommandLine::ForCurrentProcess()->HasSwitch(
+          switches::kXWalkDisableExtensionSyncFastPath);
+#endif
 }
 
 XWalkExtensionClient::~XWalkExtensionClient() {
@@ -30,13 +52,8 @@ bool XWalkExtensionClient::Send(IPC::Message* msg) {
 XWalkRemoteExtensionRunner* XWalkExtensionClient::CreateRunner(
     const std::string& extension_name,
     XWalkRemoteExtensionRunner::Client* client) {
-  if (!Send(new XWalkExtensionServerMsg_CreateInstance(next_instance_id_,
-    extension_name))) {
-    return 0;
-  }
-
   XWalkRemoteExtensionRunner* runner = new XWalkRemoteExtensionRunner(client,
-      this, next_instance_id_);
+      this, next_instance_id_, extension_name);
 
   runners_[next_instance_id_] = runner;
   next_instance_id_++;
@@ -49,10 +66,20 @@ bool XWalkExtensionClient::OnMessageReceived(const IPC::Message& message) {
   IPC_BEGIN_MESSAGE_MAP(XWalkExtensionClient, message)
     IPC_MESSAGE_HANDLER(XWalkExtensionClientMsg_PostMessageToJS,
         OnPostMessageToJS)
+    IPC_MESSAGE_HANDLER(XWalkExtensionClientMsg_PostMessagesToJS,
+        OnPostMessagesToJS)
+    IPC_MESSAGE_HANDLER(XWalkExtensionClientMsg_PostBinaryMessageToJS,
+        OnPostBinaryMessageToJS)
     IPC_MESSAGE_HANDLER(XWalkExtensionClientMsg_RegisterExtension,
         OnRegisterExtension)
+    IPC_MESSAGE_HANDLER(XWalkExtensionClientMsg_UnregisterExtension,
+        OnUnregisterExtension)
     IPC_MESSAGE_HANDLER(XWalkExtensionClientMsg_InstanceDestroyed,
         OnInstanceDestroyed)
+    IPC_MESSAGE_HANDLER(XWalkExtensionClientMsg_StartMessagesToJSAcks,
+        OnStartMessagesToJSAcks)
+    IPC_MESSAGE_HANDLER(XWalkExtensionClientMsg_EnableScriptDataPersistence,
+        OnEnableScriptDataPersistence)
     IPC_MESSAGE_UNHANDLED(handled = false)
   IPC_END_MESSAGE_MAP()
 
@@ -71,15 +98,111 @@ void XWalkExtensionClient::OnPostMessageToJS(int64_t instance_id,
   const base::Value* value;
   msg.Get(0, &value);
   (it->second)->PostMessageToJS(*value);
+  AckMessageToJS(instance_id);
+}
+
+void XWalkExtensionClient::OnPostMessagesToJS(
+    const std::vector<int64_t>& instance_ids, const base::ListValue& msgs) {
+  if (instance_ids.size() != msgs.GetSize()) {
+    LOG(WARNING) << "Ignoring malformed batch of extension messages.";
+    return;
+  }
+
+  // Look up the runner for every message, since a message listener might
+  // cause other instances of the batch to be destroyed.
+  for (size_t i = 0; i < instance_ids.size(); ++i) {
+    RunnerMap::const_iterator it = runners_.find(instance_ids[i]);
+    if (it == runners_.end() || !it->second) {
+      LOG(WARNING) << "Can't PostMessage to invalid Extension instance id: "
+          << instance_ids[i];
+      continue;
+    }
+
+    const base::Value* value;
+    msgs.Get(i, &value);
+    (it->second)->PostMessageToJS(*value);
+    AckMessageToJS(instance_ids[i]);
+  }
+}
+
+void XWalkExtensionClient::OnPostBinaryMessageToJS(int64_t instance_id,
+    base::SharedMemoryHandle handle, uint32 size) {
+  // Take ownership of the handle first, so it is closed on every path.
+  base::SharedMemory shared_memory(handle, true);
+
+  RunnerMap::const_iterator it = runners_.find(instance_id);
+  if (it == runners_.end() || !it->second) {
+    LOG(WARNING) << "Can't PostMessage to invalid Extension instance id: "
+        << instance_id;
+    return;
+  }
+
+  // The message is accounted by the server even if it can't be delivered.
+  AckMessageToJS(instance_id);
+
+  if (!shared_memory.Map(size)) {
+    LOG(WARNING) << "Couldn't map binary message for Extension instance id: "
+        << instance_id;
+    return;
+  }
+
+  (it->second)->PostBinaryMessageToJS(
+      static_cast<const char*>(shared_memory.memory()), size);
+}
+
+void XWalkExtensionClient::OnStartMessagesToJSAcks(int64_t instance_id) {
+  acked_instances_.insert(instance_id);
+}
+
+void XWalkExtensionClient::AckMessageToJS(int64_t instance_id) {
+  if (!acked_instances_.count(instance_id))
+    return;
+
+  if (pending_acks_.empty()) {
+    base::MessageLoop::current()->PostTask(
+        FROM_HERE,
+        base::Bind(&XWalkExtensionClient::SendMessagesToJSAcks,
+                   weak_factory_.GetWeakPtr()));
+  }
+  pending_acks_[instance_id]++;
+}
+
+void XWalkExtensionClient::SendMessagesToJSAcks() {
+  MessagesToJSAckMap acks;
+  acks.swap(pending_acks_);
+
+  MessagesToJSAckMap::const_iterator it = acks.begin();
+  for (; it != acks.end(); ++it)
+    Send(new XWalkExtensionServerMsg_MessagesToJSHandled(it->first,
+                                                         it->second));
 }
 
-void XWalkExtensionClient::DestroyInstance(int64_t instance_id) {
+bool XWalkExtensionClient::CreateInstance(int64_t instance_id,
+    const std::string& extension_name) {
+  return Send(new XWalkExtensionServerMsg_CreateInstance(instance_id,
+                                                  extension_name));
+}
+
+void XWalkExtensionClient::DestroyInstance(int64_t instance_id, bool created) {
   RunnerMap::iterator it = runners_.find(instance_id);
   if (it == runners_.end() || !it->second) {
     LOG(WARNING) << "Can't Destroy invalid instance id: " << instance_id;
     return;
   }
 
+#if defined(OS_POSIX)
+  sync_message_slots_.erase(instance_id);
+#endif
+  acked_instances_.erase(instance_id);
+
+  // The server never heard about this instance, so there's no need to wait
+  // for its InstanceDestroyed message.
+  if (!created) {
+    delete it->second;
+    runners_.erase(it);
+    return;
+  }
+
   Send(new XWalkExtensionServerMsg_DestroyInstance(instance_id));
 
   delete it->second;
@@ -104,6 +227,18 @@ void XWalkExtensionClient::OnInstanceDestroyed(int64_t instance_id) {
   runners_.erase(it);
 }
 
+void XWalkExtensionClient::OnUnregisterExtension(const std::string& name) {
+  extension_apis_.erase(name);
+
+  // Instances already created keep running in the server until they are
+  // destroyed, but the server can't create new ones anymore.
+  RunnerMap::const_iterator it = runners_.begin();
+  for (; it != runners_.end(); ++it) {
+    if (it->second && it->second->extension_name() == name)
+      it->second->OnExtensionUnregistered();
+  }
+}
+
 void XWalkExtensionClient::CreateRunnersForModuleSystem(XWalkModuleSystem*
     module_system) {
   // FIXME(cmarcelo): Load extensions sorted by name so parent comes first, so
@@ -113,7 +248,8 @@ void XWalkExtensionClient::CreateRunnersForModuleSystem(XWalkModuleSystem*
     if (it->second.empty())
       continue;
     scoped_ptr<XWalkExtensionModule> module(
-        new XWalkExtensionModule(module_system, it->first, it->second));
+        new XWalkExtensionModule(module_system, it->first, it->second,
+                                 &script_data_cache_));
     XWalkRemoteExtensionRunner* runner = CreateRunner(it->first, module.get());
     module->set_runner(runner);
     module_system->RegisterExtensionModule(module.Pass());
@@ -138,22 +274,145 @@ scoped_ptr<base::ListValue> WrapValueInList(scoped_ptr<base::Value> value) {
 }  // namespace
 
 void XWalkExtensionClient::PostMessageToNative(int64_t instance_id,
-    scoped_ptr<base::Value> msg) {
+    scoped_ptr<base::Value> msg, bool priority) {
   scoped_ptr<base::ListValue> list_msg = WrapValueInList(msg.Pass());
-  Send(new XWalkExtensionServerMsg_PostMessageToNative(instance_id, *list_msg));
+  Send(new XWalkExtensionServerMsg_PostMessageToNative(instance_id, *list_msg,
+                                                       priority));
+  OnAsyncMessagePosted(instance_id);
+}
+
+void XWalkExtensionClient::PostSerializedMessageToNative(
+    int64_t instance_id, const std::string& msg, bool priority) {
+  Send(new XWalkExtensionServerMsg_PostSerializedMessageToNative(
+      instance_id, msg, priority));
+  OnAsyncMessagePosted(instance_id);
+}
+
+bool XWalkExtensionClient::PostBinaryMessageToNative(int64_t instance_id,
+    const char* data, size_t size, bool priority) {
+#if defined(OS_POSIX)
+  if (size < kBinaryMessageSharedMemoryThreshold)
+    return false;
+
+  // The renderer sandbox doesn't allow creating shared memory, the browser
+  // does it for us.
+  content::RenderThread* thread = content::RenderThread::Get();
+  if (!thread)
+    return false;
+  scoped_ptr<base::SharedMemory> shared_memory(
+      thread->HostAllocateSharedMemoryBuffer(size));
+  if (!shared_memory || !shared_memory->Map(size))
+    return false;
+  memcpy(shared_memory->memory(), data, size);
+
+  base::SharedMemoryHandle handle;
+  if (!shared_memory->ShareToProcess(base::GetCurrentProcessHandle(), &handle))
+    return false;
+
+  Send(new XWalkExtensionServerMsg_PostBinaryMessageToNative(
+      instance_id, handle, static_cast<uint32>(size), priority));
+  OnAsyncMessagePosted(instance_id);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void XWalkExtensionClient::OnAsyncMessagePosted(int64_t instance_id) {
+#if defined(OS_POSIX)
+  SyncMessageSlotMap::iterator it = sync_message_slots_.find(instance_id);
+  if (it != sync_message_slots_.end())
+    it->second.async_messages_posted++;
+#endif
 }
 
 scoped_ptr<base::Value> XWalkExtensionClient::SendSyncMessageToNative(
     int64_t instance_id, scoped_ptr<base::Value> msg) {
-  scoped_ptr<base::ListValue> wrapped_msg = WrapValueInList(msg.Pass());
-  base::ListValue* wrapped_reply = new base::ListValue;
-  Send(new XWalkExtensionServerMsg_SendSyncMessageToNative(instance_id,
-      *wrapped_msg, wrapped_reply));
+#if defined(OS_POSIX)
+  // Messages that don't fit in the slot go through IPC, which keeps them in
+  // order with the async ones anyway.
+  XWalkExtensionSyncMessageSlot* slot = GetSyncMessageSlot(instance_id);
+  if (slot && slot->WriteValue(*msg))
+    return SendSyncMessageInSlot(instance_id, slot);
+#endif
 
+  scoped_ptr<base::ListValue> wrapped_msg = WrapValueInList(msg.Pass());
+  base::ListValue wrapped_reply;
   base::Value* reply;
-  wrapped_reply->Remove(0, &reply);
+  if (!Send(new XWalkExtensionServerMsg_SendSyncMessageToNative(instance_id,
+          *wrapped_msg, &wrapped_reply)) ||
+      !wrapped_reply.Remove(0, &reply))
+    return scoped_ptr<base::Value>(base::Value::CreateNullValue());
   return scoped_ptr<base::Value>(reply);
 }
 
+#if defined(OS_POSIX)
+XWalkExtensionClient::SyncMessageSlotData::SyncMessageSlotData()
+    : async_messages_posted(0) {
+}
+
+XWalkExtensionClient::SyncMessageSlotData::~SyncMessageSlotData() {
+}
+
+XWalkExtensionSyncMessageSlot* XWalkExtensionClient::GetSyncMessageSlot(
+    int64_t instance_id) {
+  if (!sync_message_slots_enabled_)
+    return NULL;
+
+  SyncMessageSlotMap::iterator it = sync_message_slots_.find(instance_id);
+  if (it != sync_message_slots_.end())
+    return it->second.slot.get();
+
+  // Remember failures too, so we don't ask again for every message.
+  SyncMessageSlotData& data = sync_message_slots_[instance_id];
+
+  base::SharedMemoryHandle memory = base::SharedMemory::NULLHandle();
+  base::FileDescriptor socket;
+  if (!Send(new XWalkExtensionServerMsg_CreateSyncMessageSlot(
+          instance_id, &memory, &socket)))
+    return NULL;
+
+  if (!base::SharedMemory::IsHandleValid(memory) || socket.fd < 0) {
+    // Closes the memory handle if only the socket is missing.
+    base::SharedMemory unused_memory(memory, false);
+    return NULL;
+  }
+
+  data.slot = XWalkExtensionSyncMessageSlot::Open(memory, socket.fd);
+  return data.slot.get();
+}
+
+scoped_ptr<base::Value> XWalkExtensionClient::SendSyncMessageInSlot(
+    int64_t instance_id, XWalkExtensionSyncMessageSlot* slot) {
+  SyncMessageSlotData& data = sync_message_slots_[instance_id];
+
+  // The server waits until it has got the async messages we posted before,
+  // so the runner gets them in the same order as with IPC.
+  XWalkExtensionSyncMessageSlot::ReplyStatus status =
+      XWalkExtensionSyncMessageSlot::REPLY_NONE;
+  if (slot->SendRequest(data.async_messages_posted))
+    status = slot->WaitForReply();
+
+  scoped_ptr<base::Value> reply;
+  if (status == XWalkExtensionSyncMessageSlot::REPLY_IN_SLOT) {
+    reply = slot->ReadValue();
+  } else if (status == XWalkExtensionSyncMessageSlot::REPLY_TOO_LARGE) {
+    base::ListValue wrapped_reply;
+    base::Value* value;
+    if (Send(new XWalkExtensionServerMsg_GetOversizedSyncReply(
+            instance_id, &wrapped_reply)) &&
+        wrapped_reply.Remove(0, &value))
+      reply.reset(value);
+  } else {
+    // The server side of the slot is gone, so is the instance.
+    data.slot = NULL;
+  }
+
+  if (!reply)
+    reply.reset(base::Value::CreateNullValue());
+  return reply.Pass();
+}
+#endif
+
 }  // namespace extensions
 }  // namespace xwalk
@@ -6,12 +6,18 @@
 #define XWALK_EXTENSIONS_RENDERER_XWALK_EXTENSION_CLIENT_H_
 
 #include <map>
+#include <set>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
+#include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
+#include "base/shared_memory.h"
 #include "ipc/ipc_listener.h"
 #include "xwalk/extensions/renderer/xwalk_remote_extension_runner.h"
+#include "xwalk/extensions/renderer/xwalk_script_data_cache.h"
 
 namespace base {
 class ListValue;
@@ -24,6 +30,7 @@ class Sender;
 namespace xwalk {
 namespace extensions {
 
+class XWalkExtensionSyncMessageSlot;
 class XWalkModuleSystem;
 
 // This class holds the JavaScript context of Extensions. It lives in the
@@ -39,34 +46,104 @@ class XWalkExtensionClient : public IPC::Listener {
 
   void CreateRunnersForModuleSystem(XWalkModuleSystem* module_system);
 
-  void DestroyInstance(int64_t instance_id);
+  // Runners are owned by the client and deleted by DestroyInstance(). Used
+  // directly when there is no module system, e.g. by the perf tests.
+  XWalkRemoteExtensionRunner* CreateRunner(const std::string& extension_name,
+      XWalkRemoteExtensionRunner::Client* client);
 
-  void PostMessageToNative(int64_t instance_id, scoped_ptr<base::Value> msg);
+  // Instances are created in the server on demand by their runners. When
+  // |created| is false, the runner is destroyed without involving the server.
+  // Returns false if the request couldn't be sent.
+  bool CreateInstance(int64_t instance_id, const std::string& extension_name);
+  void DestroyInstance(int64_t instance_id, bool created);
+
+  void PostMessageToNative(int64_t instance_id, scoped_ptr<base::Value> msg,
+                           bool priority);
+  // |msg| is in the format read by XWalkSerializedValue.
+  void PostSerializedMessageToNative(int64_t instance_id,
+                                     const std::string& msg, bool priority);
+  // Sends |data| to the instance in a shared memory buffer, for big binary
+  // messages. Returns false if it wasn't sent, the caller should then post
+  // the message the usual way.
+  bool PostBinaryMessageToNative(int64_t instance_id, const char* data,
+                                 size_t size, bool priority);
   scoped_ptr<base::Value> SendSyncMessageToNative(int64_t instance_id,
       scoped_ptr<base::Value> msg);
 
  private:
-  XWalkRemoteExtensionRunner* CreateRunner(const std::string& extension_name,
-      XWalkRemoteExtensionRunner::Client* client);
-
   bool Send(IPC::Message* msg);
 
+  void OnAsyncMessagePosted(int64_t instance_id);
+
+#if defined(OS_POSIX)
+  // Returns NULL if the instance can't send sync messages through a slot.
+  XWalkExtensionSyncMessageSlot* GetSyncMessageSlot(int64_t instance_id);
+  scoped_ptr<base::Value> SendSyncMessageInSlot(
+      int64_t instance_id, XWalkExtensionSyncMessageSlot* slot);
+#endif
+
+  // Tells the server that a message posted to JS by the instance was handled,
+  // so it can be accounted for flow control. Only done for the instances the
+  // server asked acks for, since it doesn't account the messages of the
+  // others. Acks are sent once the current task finishes, with all the
+  // messages handled for each instance.
+  void AckMessageToJS(int64_t instance_id);
+  void SendMessagesToJSAcks();
+
   // Message Handlers.
   void OnInstanceDestroyed(int64_t instance_id);
+  void OnStartMessagesToJSAcks(int64_t instance_id);
   void OnPostMessageToJS(int64_t instance_id, const base::ListValue& msg);
+  void OnPostMessagesToJS(const std::vector<int64_t>& instance_ids,
+                          const base::ListValue& msgs);
+  void OnPostBinaryMessageToJS(int64_t instance_id,
+                               base::SharedMemoryHandle handle, uint32 size);
   void OnRegisterExtension(const std::string& name, const std::string& api) {
     extension_apis_[name] = api;
   }
+  void OnUnregisterExtension(const std::string& name);
+  void OnEnableScriptDataPersistence(
+      const std::map<std::string, std::string>& entries) {
+    script_data_cache_.AddStoredEntries(entries);
+  }
 
   IPC::Sender* sender_;
 
   typedef std::map<std::string, std::string> ExtensionAPIMap;
   ExtensionAPIMap extension_apis_;
 
+  // Shared by the modules of all frames, so the API code of an extension is
+  // pre-compiled only once per render process.
+  XWalkScriptDataCache script_data_cache_;
+
   typedef std::map<int64_t, XWalkRemoteExtensionRunner*> RunnerMap;
   RunnerMap runners_;
 
+#if defined(OS_POSIX)
+  // Created when the instance sends its first sync message. The slot is NULL
+  // if it couldn't be created, then the instance always uses IPC.
+  struct SyncMessageSlotData {
+    SyncMessageSlotData();
+    ~SyncMessageSlotData();
+
+    scoped_refptr<XWalkExtensionSyncMessageSlot> slot;
+    // Number of async messages the instance posted since the slot was
+    // created.
+    uint64_t async_messages_posted;
+  };
+  typedef std::map<int64_t, SyncMessageSlotData> SyncMessageSlotMap;
+  SyncMessageSlotMap sync_message_slots_;
+  bool sync_message_slots_enabled_;
+#endif
+
+  typedef std::map<int64_t, uint32> MessagesToJSAckMap;
+  MessagesToJSAckMap pending_acks_;
+  // Instances whose messages to JS are accounted by the server.
+  std::set<int64_t> acked_instances_;
+
   int64_t next_instance_id_;
+
+  base::WeakPtrFactory<XWalkExtensionClient> weak_factory_;
 };
 
 }  // namespace extensions
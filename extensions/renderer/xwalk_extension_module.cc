@@ -5,72 +5,86 @@
 
 #include "xwalk/extensions/renderer/xwalk_extension_module.h"
 
+#include "base/command_line.h"
 #include "base/logging.h"
-#include "base/strings/stringprintf.h"
 #include "base/values.h"
 #include "content/public/renderer/v8_value_converter.h"
+#include "third_party/WebKit/public/web/WebArrayBuffer.h"
+#include "third_party/WebKit/public/web/WebArrayBufferView.h"
 #include "third_party/WebKit/public/web/WebFrame.h"
 #include "third_party/WebKit/public/web/WebScopedMicrotaskSuppression.h"
+#include "xwalk/extensions/common/xwalk_extension_switches.h"
+#include "xwalk/extensions/common/xwalk_script_data_store.h"
 #include "xwalk/extensions/renderer/xwalk_module_system.h"
+#include "xwalk/extensions/renderer/xwalk_script_data_cache.h"
+#include "xwalk/extensions/renderer/xwalk_v8_value_serializer.h"
 
 namespace xwalk {
 namespace extensions {
 
 namespace {
 
-// This is the key used in the data object passed to our callbacks to store a
-// pointer back to XWalkExtensionModule.
-const char* kXWalkExtensionModule = "kXWalkExtensionModule";
+// The 'extension' objects keep a pointer back to their XWalkExtensionModule
+// in this internal field.
+const int kExtensionModuleField = 0;
+
+// Posts |value| through a shared memory buffer if it is a big ArrayBuffer or
+// view on one. Returns false if it should be posted the usual way.
+bool PostBinaryMessageToNative(v8::Handle<v8::Value> value,
+                               XWalkRemoteExtensionRunner* runner,
+                               bool priority) {
+  scoped_ptr<WebKit::WebArrayBuffer> array_buffer(
+      WebKit::WebArrayBuffer::createFromV8Value(value));
+  if (array_buffer) {
+    return runner->PostBinaryMessageToNative(
+        static_cast<const char*>(array_buffer->data()),
+        array_buffer->byteLength(), priority);
+  }
+
+  scoped_ptr<WebKit::WebArrayBufferView> view(
+      WebKit::WebArrayBufferView::createFromV8Value(value));
+  if (view) {
+    return runner->PostBinaryMessageToNative(
+        static_cast<const char*>(view->baseAddress()) + view->byteOffset(),
+        view->byteLength(), priority);
+  }
+  return false;
+}
 
 }  // namespace
 
 XWalkExtensionModule::XWalkExtensionModule(
     XWalkModuleSystem* module_system,
     const std::string& extension_name,
-    const std::string& extension_code)
+    const std::string& extension_code,
+    XWalkScriptDataCache* script_data_cache)
     : extension_name_(extension_name),
       extension_code_(extension_code),
       converter_(content::V8ValueConverter::create()),
-      module_system_(module_system) {
-  v8::Isolate* isolate = v8::Isolate::GetCurrent();
-  v8::HandleScope handle_scope(isolate);
-  v8::Handle<v8::Object> function_data = v8::Object::New();
-  function_data->Set(v8::String::New(kXWalkExtensionModule),
-                     v8::External::New(this));
-
-  v8::Handle<v8::ObjectTemplate> object_template = v8::ObjectTemplate::New();
-  object_template->Set(
-      "postMessage",
-      v8::FunctionTemplate::New(PostMessageCallback, function_data));
-  object_template->Set(
-      "sendSyncMessage",
-      v8::FunctionTemplate::New(SendSyncMessageCallback, function_data));
-  object_template->Set(
-      "setMessageListener",
-      v8::FunctionTemplate::New(SetMessageListenerCallback, function_data));
-
-  function_data_.Reset(isolate, function_data);
-  object_template_.Reset(isolate, object_template);
+      serialized_messages_enabled_(
+          !CommandLine::ForCurrentProcess()->HasSwitch(
+              switches::kXWalkDisableExtensionSerializedMessages)),
+      module_system_(module_system),
+      runner_(NULL),
+      script_data_cache_(script_data_cache) {
 }
 
 XWalkExtensionModule::~XWalkExtensionModule() {
   v8::Isolate* isolate = v8::Isolate::GetCurrent();
   v8::HandleScope handle_scope(isolate);
 
-  // Deleting the data will disable the functions, they'll return early. We do
-  // this because it might be the case that the JS objects we created outlive
-  // this object, even if we destroy the references we have.
-  // TODO(cmarcelo): Add a test for this case.
-  // FIXME(cmarcelo): These calls are causing crashes on shutdown with Chromium
-  //                  29.0.1547.57 and had to be commented out.
-  // v8::Handle<v8::Object> function_data =
-  //     v8::Handle<v8::Object>::New(isolate, function_data_);
-  // function_data->Delete(v8::String::New(kXWalkExtensionModule));
-
-  object_template_.Dispose(isolate);
-  object_template_.Clear();
-  function_data_.Dispose(isolate);
-  function_data_.Clear();
+  // The 'extension' object might outlive this object, e.g. if the JS API code
+  // keeps references to it. Clearing the pointer disables its functions,
+  // they'll return early.
+  if (!extension_object_.IsEmpty()) {
+    v8::Handle<v8::Object> extension_object =
+        v8::Handle<v8::Object>::New(isolate, extension_object_);
+    extension_object->SetAlignedPointerInInternalField(kExtensionModuleField,
+                                                       NULL);
+  }
+
+  extension_object_.Dispose(isolate);
+  extension_object_.Clear();
   message_listener_.Dispose(isolate);
   message_listener_.Clear();
 
@@ -80,52 +94,22 @@ XWalkExtensionModule::~XWalkExtensionModule() {
 
 namespace {
 
-std::string CodeToEnsureNamespace(const std::string& extension_name) {
-  std::string result;
-  size_t pos = 0;
-  while (true) {
-    pos = extension_name.find('.', pos);
-    if (pos == std::string::npos) {
-      result += extension_name + " = {};";
-      break;
-    }
-    std::string ns = extension_name.substr(0, pos);
-    result += ns + " = " + ns + " || {}; ";
-    pos++;
-  }
-  return result;
-}
-
-// Wrap API code into a callable form that takes extension object as parameter.
-std::string WrapAPICode(const std::string& extension_code,
-                        const std::string& extension_name) {
-  // We take care here to make sure that line numbering for api_code after
-  // wrapping doesn't change, so that syntax errors point to the correct line.
-  return base::StringPrintf(
-      "var %s; (function(extension, requireNative) { "
-      "extension._setupExtensionInternal = function() {"
-      "  xwalk._setupExtensionInternal(extension);"
-      "};"
-      "extension.internal = {};"
-      "extension.internal.sendSyncMessage = extension.sendSyncMessage;"
-      "delete extension.sendSyncMessage;"
-      "return (function(exports) {'use strict'; %s\n})(%s); });",
-      CodeToEnsureNamespace(extension_name).c_str(),
-      extension_code.c_str(),
-      extension_name.c_str());
-}
-
+// |script_data| is optional, when available V8 uses it to skip the
+// pre-parsing of |code|.
 v8::Handle<v8::Value> RunString(const std::string& code,
-                                const std::string& name) {
+                                const std::string& name,
+                                v8::ScriptData* script_data) {
   v8::HandleScope handle_scope;
   v8::Handle<v8::String> v8_code(v8::String::New(code.c_str()));
   v8::Handle<v8::String> v8_name(v8::String::New(name.c_str()));
+  v8::ScriptOrigin origin(v8_name);
 
   WebKit::WebScopedMicrotaskSuppression suppression;
   v8::TryCatch try_catch;
   try_catch.SetVerbose(true);
 
-  v8::Handle<v8::Script> script(v8::Script::New(v8_code, v8_name));
+  v8::Handle<v8::Script> script(
+      v8::Script::New(v8_code, &origin, script_data));
   if (try_catch.HasCaught())
     return v8::Undefined();
 
@@ -140,22 +124,32 @@ v8::Handle<v8::Value> RunString(const std::string& code,
 
 void XWalkExtensionModule::LoadExtensionCode(
     v8::Handle<v8::Context> context, v8::Handle<v8::Function> requireNative) {
-  std::string wrapped_api_code = WrapAPICode(extension_code_, extension_name_);
-  v8::Handle<v8::Value> result =
-      RunString(wrapped_api_code, "JS API code for " + extension_name_);
+  std::string wrapped_api_code =
+      WrapExtensionAPICode(extension_code_, extension_name_);
+  v8::ScriptData* script_data = script_data_cache_ ?
+      script_data_cache_->GetScriptData(wrapped_api_code) : NULL;
+  v8::Handle<v8::Value> result = RunString(
+      wrapped_api_code, "JS API code for " + extension_name_, script_data);
   if (!result->IsFunction()) {
     LOG(WARNING) << "Couldn't load JS API code for " << extension_name_;
     return;
   }
   v8::Handle<v8::Function> callable_api_code =
       v8::Handle<v8::Function>::Cast(result);
-  v8::Handle<v8::ObjectTemplate> object_template =
-      v8::Handle<v8::ObjectTemplate>::New(context->GetIsolate(),
-                                          object_template_);
+
+  v8::Isolate* isolate = context->GetIsolate();
+  v8::Handle<v8::FunctionTemplate> extension_template =
+      XWalkModuleSystem::GetSharedTemplate(isolate,
+                                           &CreateExtensionObjectTemplate);
+  v8::Handle<v8::Object> extension_object =
+      extension_template->GetFunction()->NewInstance();
+  extension_object->SetAlignedPointerInInternalField(kExtensionModuleField,
+                                                     this);
+  extension_object_.Reset(isolate, extension_object);
 
   const int argc = 2;
   v8::Handle<v8::Value> argv[argc] = {
-    object_template->NewInstance(),
+    extension_object,
     requireNative
   };
 
@@ -179,19 +173,84 @@ void XWalkExtensionModule::HandleMessageFromNative(const base::Value& msg) {
   v8::Context::Scope context_scope(context);
 
   v8::Handle<v8::Value> v8_value(converter_->ToV8Value(&msg, context));
+  CallMessageListener(context, v8_value);
+}
+
+void XWalkExtensionModule::HandleBinaryMessageFromNative(const char* data,
+                                                         size_t size) {
+  if (message_listener_.IsEmpty())
+    return;
+
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+  v8::HandleScope handle_scope(isolate);
+  v8::Handle<v8::Context> context = module_system_->GetV8Context();
+  v8::Context::Scope context_scope(context);
+
+  // Copy straight into the ArrayBuffer backing store, instead of building an
+  // intermediate base::BinaryValue for the converter.
+  WebKit::WebArrayBuffer buffer = WebKit::WebArrayBuffer::create(size, 1);
+  memcpy(buffer.data(), data, size);
+  CallMessageListener(context, buffer.toV8Value());
+}
+
+void XWalkExtensionModule::CallMessageListener(
+    v8::Handle<v8::Context> context, v8::Handle<v8::Value> msg) {
   v8::Handle<v8::Function> message_listener =
-      v8::Handle<v8::Function>::New(isolate, message_listener_);;
+      v8::Handle<v8::Function>::New(context->GetIsolate(), message_listener_);
 
   WebKit::WebScopedMicrotaskSuppression suppression;
   v8::TryCatch try_catch;
-  message_listener->Call(context->Global(), 1, &v8_value);
+  message_listener->Call(context->Global(), 1, &msg);
   if (try_catch.HasCaught())
     LOG(WARNING) << "Exception when running message listener";
 }
 
+// The template is shared by the modules of all frames, see
+// XWalkModuleSystem::GetSharedTemplate(). The signature makes V8 check that
+// the functions are called on an 'extension' object, which holds the module.
+// static
+v8::Handle<v8::FunctionTemplate>
+XWalkExtensionModule::CreateExtensionObjectTemplate() {
+  v8::Handle<v8::FunctionTemplate> constructor = v8::FunctionTemplate::New();
+  v8::Handle<v8::Signature> signature = v8::Signature::New(constructor);
+  v8::Handle<v8::ObjectTemplate> object_template =
+      constructor->InstanceTemplate();
+  object_template->SetInternalFieldCount(1);
+
+  object_template->Set(
+      "postMessage",
+      v8::FunctionTemplate::New(PostMessageCallback,
+                                v8::Handle<v8::Value>(), signature));
+  object_template->Set(
+      "postPriorityMessage",
+      v8::FunctionTemplate::New(PostPriorityMessageCallback,
+                                v8::Handle<v8::Value>(), signature));
+  object_template->Set(
+      "sendSyncMessage",
+      v8::FunctionTemplate::New(SendSyncMessageCallback,
+                                v8::Handle<v8::Value>(), signature));
+  object_template->Set(
+      "setMessageListener",
+      v8::FunctionTemplate::New(SetMessageListenerCallback,
+                                v8::Handle<v8::Value>(), signature));
+  return constructor;
+}
+
 // static
 void XWalkExtensionModule::PostMessageCallback(
     const v8::FunctionCallbackInfo<v8::Value>& info) {
+  PostMessageWithPriority(info, false);
+}
+
+// static
+void XWalkExtensionModule::PostPriorityMessageCallback(
+    const v8::FunctionCallbackInfo<v8::Value>& info) {
+  PostMessageWithPriority(info, true);
+}
+
+// static
+void XWalkExtensionModule::PostMessageWithPriority(
+    const v8::FunctionCallbackInfo<v8::Value>& info, bool priority) {
   v8::ReturnValue<v8::Value> result(info.GetReturnValue());
   XWalkExtensionModule* module = GetExtensionModule(info);
   if (!module || info.Length() != 1) {
@@ -199,12 +258,26 @@ void XWalkExtensionModule::PostMessageCallback(
     return;
   }
 
+  CHECK(module->runner_);
+  if (PostBinaryMessageToNative(info[0], module->runner_, priority)) {
+    result.Set(true);
+    return;
+  }
+
+  if (module->serialized_messages_enabled_) {
+    std::string msg;
+    if (SerializeV8Value(info[0], &msg)) {
+      module->runner_->PostSerializedMessageToNative(msg, priority);
+      result.Set(true);
+      return;
+    }
+  }
+
   v8::Handle<v8::Context> context = info.GetIsolate()->GetCurrentContext();
   scoped_ptr<base::Value> value(
       module->converter_->FromV8Value(info[0], context));
 
-  CHECK(module->runner_);
-  module->runner_->PostMessageToNative(value.Pass());
+  module->runner_->PostMessageToNative(value.Pass(), priority);
   result.Set(true);
 }
 
@@ -259,16 +332,14 @@ void XWalkExtensionModule::SetMessageListenerCallback(
 // static
 XWalkExtensionModule* XWalkExtensionModule::GetExtensionModule(
     const v8::FunctionCallbackInfo<v8::Value>& info) {
-  v8::HandleScope handle_scope(info.GetIsolate());
-  v8::Local<v8::Object> data = info.Data().As<v8::Object>();
-  v8::Local<v8::Value> module =
-      data->Get(v8::String::New(kXWalkExtensionModule));
-  if (module.IsEmpty() || module->IsUndefined()) {
+  // The signature of the functions ensures the holder is an 'extension'
+  // object.
+  XWalkExtensionModule* module = static_cast<XWalkExtensionModule*>(
+      info.Holder()->GetAlignedPointerFromInternalField(
+          kExtensionModuleField));
+  if (!module)
     LOG(WARNING) << "Trying to use extension from already destroyed context!";
-    return NULL;
-  }
-  CHECK(module->IsExternal());
-  return static_cast<XWalkExtensionModule*>(module.As<v8::External>()->Value());
+  return module;
 }
 
 }  // namespace extensions
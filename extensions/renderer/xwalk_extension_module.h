@@ -21,6 +21,7 @@ namespace xwalk {
 namespace extensions {
 
 class XWalkModuleSystem;
+class XWalkScriptDataCache;
 
 // Responsible for running the JS code of a XWalkExtension. This includes
 // creating and exposing an 'extension' object for the execution context of
@@ -32,7 +33,8 @@ class XWalkExtensionModule : public XWalkRemoteExtensionRunner::Client {
  public:
   XWalkExtensionModule(XWalkModuleSystem* module_system,
                        const std::string& extension_name,
-                       const std::string& extension_code);
+                       const std::string& extension_code,
+                       XWalkScriptDataCache* script_data_cache);
   virtual ~XWalkExtensionModule();
 
   // TODO(cmarcelo): Make this return a v8::Handle<v8::Object>, and
@@ -48,24 +50,36 @@ class XWalkExtensionModule : public XWalkRemoteExtensionRunner::Client {
  private:
   // XWalkRemoteExtensionRunner::Client implementation.
   virtual void HandleMessageFromNative(const base::Value& msg) OVERRIDE;
+  virtual void HandleBinaryMessageFromNative(const char* data,
+                                             size_t size) OVERRIDE;
+
+  void CallMessageListener(v8::Handle<v8::Context> context,
+                           v8::Handle<v8::Value> msg);
 
   // Callbacks for JS functions available in 'extension' object.
   static void PostMessageCallback(
       const v8::FunctionCallbackInfo<v8::Value>& info);
+  // Like postMessage, but the message is handled before the ones waiting in
+  // the normal lane of the instance.
+  static void PostPriorityMessageCallback(
+      const v8::FunctionCallbackInfo<v8::Value>& info);
   static void SendSyncMessageCallback(
       const v8::FunctionCallbackInfo<v8::Value>& info);
   static void SetMessageListenerCallback(
       const v8::FunctionCallbackInfo<v8::Value>& info);
 
+  // Creates the template of the 'extension' objects, shared by all modules.
+  static v8::Handle<v8::FunctionTemplate> CreateExtensionObjectTemplate();
+
   static XWalkExtensionModule* GetExtensionModule(
       const v8::FunctionCallbackInfo<v8::Value>& info);
+  static void PostMessageWithPriority(
+      const v8::FunctionCallbackInfo<v8::Value>& info, bool priority);
 
-  // Template for the 'extension' object exposed to the extension JS code.
-  v8::Persistent<v8::ObjectTemplate> object_template_;
-
-  // This JS object contains a pointer back to the XWalkExtensionModule, it is
-  // set as data for the function callbacks.
-  v8::Persistent<v8::Object> function_data_;
+  // The 'extension' object exposed to the extension JS code, created when the
+  // code is loaded. It holds a pointer back to the XWalkExtensionModule in an
+  // internal field.
+  v8::Persistent<v8::Object> extension_object_;
 
   // Function to be called when the extension sends a message to its JS code.
   // This value is registered by using 'extension.setMessageListener()'.
@@ -78,8 +92,13 @@ class XWalkExtensionModule : public XWalkRemoteExtensionRunner::Client {
   // parameters.
   scoped_ptr<content::V8ValueConverter> converter_;
 
+  // Async messages are serialized straight from V8 when possible, instead of
+  // being converted to base::Value, see XWalkSerializedValue.
+  bool serialized_messages_enabled_;
+
   XWalkModuleSystem* module_system_;
   XWalkRemoteExtensionRunner* runner_;
+  XWalkScriptDataCache* script_data_cache_;
 };
 
 }  // namespace extensions
@@ -58,6 +58,8 @@ void XWalkExtensionRendererController::DidCreateScriptContext(
 
   in_browser_process_extensions_client_->CreateRunnersForModuleSystem(
       module_system);
+  if (external_extensions_client_)
+    external_extensions_client_->CreateRunnersForModuleSystem(module_system);
 }
 
 void XWalkExtensionRendererController::WillReleaseScriptContext(
@@ -70,8 +72,39 @@ void XWalkExtensionRendererController::WillReleaseScriptContext(
 
 bool XWalkExtensionRendererController::OnControlMessageReceived(
     const IPC::Message& message) {
+  bool handled = true;
+  IPC_BEGIN_MESSAGE_MAP(XWalkExtensionRendererController, message)
+    IPC_MESSAGE_HANDLER(XWalkExtensionClientMsg_ExtensionProcessChannelCreated,
+        OnExtensionProcessChannelCreated)
+    IPC_MESSAGE_UNHANDLED(
+        handled = in_browser_process_extensions_client_->OnMessageReceived(
+            message))
+  IPC_END_MESSAGE_MAP()
+  return handled;
+}
+
+bool XWalkExtensionRendererController::OnMessageReceived(
+    const IPC::Message& message) {
+  return external_extensions_client_->OnMessageReceived(message);
+}
+
+void XWalkExtensionRendererController::OnExtensionProcessChannelCreated(
+    const IPC::ChannelHandle& handle) {
+  if (extension_process_channel_) {
+    LOG(WARNING) << "The channel to the extension process was already created.";
+    return;
+  }
+
+  // The channel is sent by the browser without the render process waiting for
+  // it, frames with a script context created before it arrives don't get the
+  // external extensions.
+  content::RenderThread* thread = content::RenderThread::Get();
+  extension_process_channel_.reset(new IPC::SyncChannel(handle,
+      IPC::Channel::MODE_CLIENT, this, thread->GetIOMessageLoopProxy(),
+      true, thread->GetShutdownEvent()));
 
-  return in_browser_process_extensions_client_->OnMessageReceived(message);
+  external_extensions_client_.reset(
+      new XWalkExtensionClient(extension_process_channel_.get()));
 }
 
 }  // namespace extensions
@@ -11,12 +11,18 @@
 #include "base/compiler_specific.h"
 #include "base/memory/scoped_ptr.h"
 #include "content/public/renderer/render_process_observer.h"
+#include "ipc/ipc_listener.h"
 #include "v8/include/v8.h"
 
 namespace content {
 class RenderView;
 }
 
+namespace IPC {
+struct ChannelHandle;
+class SyncChannel;
+}
+
 namespace WebKit {
 class WebFrame;
 }
@@ -29,7 +35,12 @@ class XWalkExtensionClient;
 // Renderer controller for XWalk extensions keeps track of the extensions
 // registered into the system. It also watches for new render views to attach
 // the extensions handlers to them.
-class XWalkExtensionRendererController : public content::RenderProcessObserver {
+//
+// Extensions running in the browser process are reached through the render
+// process channel, while the ones running in the extension process, if any,
+// have a channel of their own.
+class XWalkExtensionRendererController : public content::RenderProcessObserver,
+                                         public IPC::Listener {
  public:
   XWalkExtensionRendererController();
   virtual ~XWalkExtensionRendererController();
@@ -44,9 +55,17 @@ class XWalkExtensionRendererController : public content::RenderProcessObserver {
   // RenderProcessObserver implementation.
   virtual bool OnControlMessageReceived(const IPC::Message& message) OVERRIDE;
 
+  // IPC::Listener implementation, for the channel with the extension process.
+  virtual bool OnMessageReceived(const IPC::Message& message) OVERRIDE;
+
  private:
+  void OnExtensionProcessChannelCreated(const IPC::ChannelHandle& handle);
+
   scoped_ptr<XWalkExtensionClient> in_browser_process_extensions_client_;
 
+  scoped_ptr<IPC::SyncChannel> extension_process_channel_;
+  scoped_ptr<XWalkExtensionClient> external_extensions_client_;
+
   DISALLOW_COPY_AND_ASSIGN(XWalkExtensionRendererController);
 };
 
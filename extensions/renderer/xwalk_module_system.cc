@@ -4,8 +4,13 @@
 
 #include "xwalk/extensions/renderer/xwalk_module_system.h"
 
+#include <map>
+#include <utility>
+#include <vector>
+#include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/stl_util.h"
+#include "base/strings/string_split.h"
 #include "xwalk/extensions/renderer/xwalk_extension_module.h"
 
 namespace xwalk {
@@ -22,14 +27,19 @@ const int kModuleSystemEmbedderDataIndex = 8;
 // pointer back to XWalkExtensionModule.
 const char* kXWalkModuleSystem = "kXWalkModuleSystem";
 
-XWalkModuleSystem* GetModuleSystem(
-    const v8::FunctionCallbackInfo<v8::Value>& info) {
+// Keys used in the data object of the lazy accessors, to store the name of the
+// extension and the object holding its namespace.
+const char* kXWalkExtensionName = "kXWalkExtensionName";
+const char* kXWalkExtensionNamespaceParent = "kXWalkExtensionNamespaceParent";
+
+template <typename CallbackInfo>
+XWalkModuleSystem* GetModuleSystem(const CallbackInfo& info) {
   v8::HandleScope handle_scope(info.GetIsolate());
-  v8::Handle<v8::Object> data = info.Data().As<v8::Object>();
+  v8::Handle<v8::Object> data = info.Data().template As<v8::Object>();
   v8::Handle<v8::Value> module_system =
       data->Get(v8::String::New(kXWalkModuleSystem));
   if (module_system.IsEmpty() || module_system->IsUndefined()) {
-    LOG(WARNING) << "Trying to use requireNative from already "
+    LOG(WARNING) << "Trying to load extension from already "
                  << "destroyed module system!";
     return NULL;
   }
@@ -38,9 +48,27 @@ XWalkModuleSystem* GetModuleSystem(
       module_system.As<v8::External>()->Value());
 }
 
+typedef std::map<std::pair<v8::Isolate*, XWalkModuleSystem::TemplateFactory>,
+                 v8::Persistent<v8::FunctionTemplate>*> SharedTemplateMap;
+
+// The templates are never released, the isolates of the render process live
+// as long as it.
+base::LazyInstance<SharedTemplateMap>::Leaky g_shared_templates =
+    LAZY_INSTANCE_INITIALIZER;
+
+// requireNative() is shared by all frames, it finds the module system through
+// the context it was created in.
 void RequireNativeCallback(const v8::FunctionCallbackInfo<v8::Value>& info) {
   v8::ReturnValue<v8::Value> result(info.GetReturnValue());
-  XWalkModuleSystem* module_system = GetModuleSystem(info);
+  XWalkModuleSystem* module_system =
+      XWalkModuleSystem::GetModuleSystemFromContext(
+          info.Callee()->CreationContext());
+  if (!module_system) {
+    LOG(WARNING) << "Trying to use requireNative from already "
+                 << "destroyed module system!";
+    result.SetUndefined();
+    return;
+  }
   if (info.Length() < 1) {
     // TODO(cmarcelo): Throw appropriate exception or warning.
     result.SetUndefined();
@@ -56,21 +84,58 @@ void RequireNativeCallback(const v8::FunctionCallbackInfo<v8::Value>& info) {
   result.Set(object);
 }
 
-}  // namespace
+v8::Handle<v8::FunctionTemplate> CreateRequireNativeTemplate() {
+  return v8::FunctionTemplate::New(RequireNativeCallback);
+}
 
-XWalkModuleSystem::XWalkModuleSystem(v8::Handle<v8::Context> context) {
-  v8::Isolate* isolate = context->GetIsolate();
-  v8_context_.Reset(isolate, context);
+// Replaces the lazy accessor by a regular property. Deleting the accessor
+// before running the JS API code allows it to set the namespace normally.
+v8::Handle<v8::Object> RemoveLazyAccessor(
+    v8::Handle<v8::String> property, v8::Handle<v8::Object> data) {
+  v8::Handle<v8::Object> parent =
+      data->Get(v8::String::New(kXWalkExtensionNamespaceParent))
+      .As<v8::Object>();
+  parent->Delete(property);
+  return parent;
+}
 
-  v8::HandleScope handle_scope(isolate);
-  v8::Handle<v8::Object> function_data = v8::Object::New();
-  function_data->Set(v8::String::New(kXWalkModuleSystem),
-                     v8::External::New(this));
-  v8::Handle<v8::FunctionTemplate> require_native_template =
-      v8::FunctionTemplate::New(RequireNativeCallback, function_data);
+void LazyLoadExtensionGetter(
+    v8::Local<v8::String> property,
+    const v8::PropertyCallbackInfo<v8::Value>& info) {
+  v8::ReturnValue<v8::Value> result(info.GetReturnValue());
+  XWalkModuleSystem* module_system = GetModuleSystem(info);
+  if (!module_system) {
+    result.SetUndefined();
+    return;
+  }
+
+  v8::Handle<v8::Object> data = info.Data().As<v8::Object>();
+  std::string extension_name = *v8::String::Utf8Value(
+      data->Get(v8::String::New(kXWalkExtensionName)));
+
+  v8::Handle<v8::Object> parent = RemoveLazyAccessor(property, data);
+
+  // The namespace might be accessed from another frame, but the JS API code
+  // must run in the context the extension module belongs to.
+  v8::Context::Scope context_scope(module_system->GetV8Context());
+  module_system->LoadExtensionModule(extension_name);
+  result.Set(parent->Get(property));
+}
 
-  function_data_.Reset(isolate, function_data);
-  require_native_template_.Reset(isolate, require_native_template);
+// If the page overwrites the namespace before using it, there's no need to run
+// the JS API code anymore.
+void LazyLoadExtensionSetter(
+    v8::Local<v8::String> property, v8::Local<v8::Value> value,
+    const v8::PropertyCallbackInfo<void>& info) {
+  v8::Handle<v8::Object> parent =
+      RemoveLazyAccessor(property, info.Data().As<v8::Object>());
+  parent->Set(property, value);
+}
+
+}  // namespace
+
+XWalkModuleSystem::XWalkModuleSystem(v8::Handle<v8::Context> context) {
+  v8_context_.Reset(context->GetIsolate(), context);
 }
 
 XWalkModuleSystem::~XWalkModuleSystem() {
@@ -79,21 +144,6 @@ XWalkModuleSystem::~XWalkModuleSystem() {
 
   v8::Isolate* isolate = v8::Isolate::GetCurrent();
   v8::HandleScope handle_scope(isolate);
-
-  // Deleting the data will disable the functions, they'll return early. We do
-  // this because it might be the case that the JS objects we created outlive
-  // this object, even if we destroy the references we have.
-  // TODO(cmarcelo): Add a test for this case.
-  // FIXME(cmarcelo): These calls are causing crashes on shutdown with Chromium
-  //                  29.0.1547.57 and had to be commented out.
-  // v8::Handle<v8::Object> function_data =
-  //     v8::Handle<v8::Object>::New(isolate, function_data_);
-  // function_data->Delete(v8::String::New(kXWalkModuleSystem));
-
-  require_native_template_.Dispose(isolate);
-  require_native_template_.Clear();
-  function_data_.Dispose(isolate);
-  function_data_.Clear();
   v8_context_.Dispose(isolate);
   v8_context_.Clear();
 }
@@ -125,15 +175,51 @@ void XWalkModuleSystem::RegisterExtensionModule(
     scoped_ptr<XWalkExtensionModule> module) {
   const std::string& extension_name = module->extension_name();
   CHECK(extension_modules_.find(extension_name) == extension_modules_.end());
-  // TODO(cmarcelo): Setup lazy loader instead of immediatly running
-  // JS API code.
+  extension_modules_[extension_name] = module.release();
+  SetLazyLoaderForExtensionModule(extension_name);
+}
+
+void XWalkModuleSystem::SetLazyLoaderForExtensionModule(
+    const std::string& extension_name) {
+  v8::Isolate* isolate = v8::Isolate::GetCurrent();
+  v8::HandleScope handle_scope(isolate);
+  v8::Handle<v8::Context> context = GetV8Context();
+
+  std::vector<std::string> components;
+  base::SplitString(extension_name, '.', &components);
+  CHECK(!components.empty());
+
+  // Ensure the objects for the parent namespaces exist. Note that if one of
+  // them is the namespace of another extension, its code will be loaded.
+  v8::Handle<v8::Object> parent = context->Global();
+  for (size_t i = 0; i < components.size() - 1; ++i) {
+    v8::Handle<v8::String> component = v8::String::New(components[i].c_str());
+    v8::Handle<v8::Value> value = parent->Get(component);
+    if (!value->IsObject()) {
+      value = v8::Object::New();
+      parent->Set(component, value);
+    }
+    parent = value.As<v8::Object>();
+  }
+
+  v8::Handle<v8::Object> data = v8::Object::New();
+  data->Set(v8::String::New(kXWalkModuleSystem), v8::External::New(this));
+  data->Set(v8::String::New(kXWalkExtensionName),
+            v8::String::New(extension_name.c_str()));
+  data->Set(v8::String::New(kXWalkExtensionNamespaceParent), parent);
+
+  parent->SetAccessor(v8::String::New(components.back().c_str()),
+                      LazyLoadExtensionGetter, LazyLoadExtensionSetter, data);
+}
+
+void XWalkModuleSystem::LoadExtensionModule(
+    const std::string& extension_name) {
   v8::Isolate* isolate = v8::Isolate::GetCurrent();
   v8::HandleScope handle_scope(isolate);
   v8::Handle<v8::FunctionTemplate> require_native_template =
-      v8::Handle<v8::FunctionTemplate>::New(isolate, require_native_template_);
-  module->LoadExtensionCode(GetV8Context(),
-                            require_native_template->GetFunction());
-  extension_modules_[extension_name] = module.release();
+      GetSharedTemplate(isolate, &CreateRequireNativeTemplate);
+  GetExtensionModule(extension_name)->LoadExtensionCode(
+      GetV8Context(), require_native_template->GetFunction());
 }
 
 XWalkExtensionModule* XWalkModuleSystem::GetExtensionModule(
@@ -161,5 +247,19 @@ v8::Handle<v8::Context> XWalkModuleSystem::GetV8Context() {
   return v8::Handle<v8::Context>::New(v8::Isolate::GetCurrent(), v8_context_);
 }
 
+// static
+v8::Handle<v8::FunctionTemplate> XWalkModuleSystem::GetSharedTemplate(
+    v8::Isolate* isolate, TemplateFactory factory) {
+  SharedTemplateMap& templates = g_shared_templates.Get();
+  SharedTemplateMap::key_type key(isolate, factory);
+  SharedTemplateMap::iterator it = templates.find(key);
+  if (it == templates.end()) {
+    v8::Persistent<v8::FunctionTemplate>* shared_template =
+        new v8::Persistent<v8::FunctionTemplate>(isolate, factory());
+    it = templates.insert(std::make_pair(key, shared_template)).first;
+  }
+  return v8::Handle<v8::FunctionTemplate>::New(isolate, *it->second);
+}
+
 }  // namespace extensions
 }  // namespace xwalk
@@ -44,26 +44,38 @@ class XWalkModuleSystem {
       v8::Handle<v8::Context> context);
   static void ResetModuleSystemFromContext(v8::Handle<v8::Context> context);
 
+  // The JS API code of the extension module is only run the first time its
+  // namespace object is accessed. A lazy accessor is set in place of the last
+  // component of the namespace, e.g. 'dialog' in 'xwalk.experimental.dialog'.
   void RegisterExtensionModule(scoped_ptr<XWalkExtensionModule> module);
   XWalkExtensionModule* GetExtensionModule(const std::string& extension_name);
 
+  // Runs the JS API code of the extension, used by the lazy accessor.
+  void LoadExtensionModule(const std::string& extension_name);
+
   void RegisterNativeModule(const std::string& name,
                             scoped_ptr<XWalkNativeModule> module);
   v8::Handle<v8::Object> RequireNative(const std::string& name);
 
   v8::Handle<v8::Context> GetV8Context();
 
+  // Templates that don't hold any per frame state are created by |factory|
+  // once per isolate, and shared by the module systems of all frames. The
+  // functions created from them get the state of the frame from their
+  // creation context or from internal fields of their receiver.
+  typedef v8::Handle<v8::FunctionTemplate> (*TemplateFactory)();
+  static v8::Handle<v8::FunctionTemplate> GetSharedTemplate(
+      v8::Isolate* isolate, TemplateFactory factory);
+
  private:
+  void SetLazyLoaderForExtensionModule(const std::string& extension_name);
+
   typedef std::map<std::string, XWalkExtensionModule*> ExtensionModuleMap;
   ExtensionModuleMap extension_modules_;
 
   typedef std::map<std::string, XWalkNativeModule*> NativeModuleMap;
   NativeModuleMap native_modules_;
 
-  v8::Persistent<v8::FunctionTemplate> require_native_template_;
-
-  v8::Persistent<v8::Object> function_data_;
-
   // Points back to the current context, used when native wants to callback
   // JavaScript. When WillReleaseScriptContext() is called, we dispose this
   // persistent.
@@ -4,6 +4,7 @@
 
 #include "xwalk/extensions/renderer/xwalk_remote_extension_runner.h"
 
+#include "base/values.h"
 #include "xwalk/extensions/common/xwalk_extension_messages.h"
 #include "xwalk/extensions/renderer/xwalk_extension_client.h"
 
@@ -11,20 +12,44 @@ namespace xwalk {
 namespace extensions {
 
 XWalkRemoteExtensionRunner::XWalkRemoteExtensionRunner(Client* client,
-    XWalkExtensionClient* extension_client, int64_t instance_id)
+    XWalkExtensionClient* extension_client, int64_t instance_id,
+    const std::string& extension_name)
     : client_(client),
       instance_id_(instance_id),
+      extension_name_(extension_name),
+      instance_created_(false),
+      extension_unregistered_(false),
       extension_client_(extension_client) {}
 
 XWalkRemoteExtensionRunner::~XWalkRemoteExtensionRunner() {}
 
 void XWalkRemoteExtensionRunner::PostMessageToNative(
-    scoped_ptr<base::Value> msg) {
-  extension_client_->PostMessageToNative(instance_id_, msg.Pass());
+    scoped_ptr<base::Value> msg, bool priority) {
+  if (!EnsureInstanceCreated())
+    return;
+  extension_client_->PostMessageToNative(instance_id_, msg.Pass(), priority);
+}
+
+void XWalkRemoteExtensionRunner::PostSerializedMessageToNative(
+    const std::string& msg, bool priority) {
+  if (!EnsureInstanceCreated())
+    return;
+  extension_client_->PostSerializedMessageToNative(instance_id_, msg,
+                                                   priority);
+}
+
+bool XWalkRemoteExtensionRunner::PostBinaryMessageToNative(const char* data,
+    size_t size, bool priority) {
+  if (!EnsureInstanceCreated())
+    return false;
+  return extension_client_->PostBinaryMessageToNative(instance_id_, data,
+                                                      size, priority);
 }
 
 scoped_ptr<base::Value> XWalkRemoteExtensionRunner::SendSyncMessageToNative(
     scoped_ptr<base::Value> msg) {
+  if (!EnsureInstanceCreated())
+    return scoped_ptr<base::Value>(base::Value::CreateNullValue());
   scoped_ptr<base::Value> reply(extension_client_->SendSyncMessageToNative(
       instance_id_, msg.Pass()));
   return reply.Pass();
@@ -35,8 +60,22 @@ void XWalkRemoteExtensionRunner::PostMessageToJS(
   client_->HandleMessageFromNative(msg);
 }
 
+void XWalkRemoteExtensionRunner::PostBinaryMessageToJS(
+    const char* data, size_t size) {
+  client_->HandleBinaryMessageFromNative(data, size);
+}
+
 void XWalkRemoteExtensionRunner::Destroy() {
-  extension_client_->DestroyInstance(instance_id_);
+  extension_client_->DestroyInstance(instance_id_, instance_created_);
+}
+
+bool XWalkRemoteExtensionRunner::EnsureInstanceCreated() {
+  // If the request couldn't be sent, the server doesn't know the instance and
+  // the next message tries again.
+  if (!instance_created_ && !extension_unregistered_)
+    instance_created_ =
+        extension_client_->CreateInstance(instance_id_, extension_name_);
+  return instance_created_;
 }
 
 }  // namespace extensions
@@ -25,6 +25,10 @@ class XWalkExtensionModule;
 // XWalkExtensionModule implements the runner's Client interface to handle
 // messages from native. This interface is similar to XWalkExtensionRunner.
 //
+// The instance in the server is only created when the runner is used for the
+// first time, so frames that never use an extension don't cost anything in
+// the server side.
+//
 // TODO(cmarcelo): The interface of this class is conceptually similar to
 // XWalkExtensionRunner, consider whether it is worth to make it a
 // XWalkExtensionRunner subclass or simply a separated object.
@@ -33,27 +37,51 @@ class XWalkRemoteExtensionRunner {
   class Client {
    public:
     virtual void HandleMessageFromNative(const base::Value& msg) = 0;
+    virtual void HandleBinaryMessageFromNative(const char* data,
+                                               size_t size) = 0;
    protected:
     virtual ~Client() {}
   };
 
   XWalkRemoteExtensionRunner(Client* client,
-      XWalkExtensionClient* extension_client, int64_t instance_id);
+      XWalkExtensionClient* extension_client, int64_t instance_id,
+      const std::string& extension_name);
   virtual ~XWalkRemoteExtensionRunner();
 
-  void PostMessageToNative(scoped_ptr<base::Value> msg);
+  // Messages posted with |priority| are handled by the instance before the
+  // other async messages still waiting to be handled.
+  void PostMessageToNative(scoped_ptr<base::Value> msg, bool priority);
+  // |msg| is in the format read by XWalkSerializedValue.
+  void PostSerializedMessageToNative(const std::string& msg, bool priority);
+  // Returns false if |data| should be posted with one of the above instead,
+  // see XWalkExtensionClient::PostBinaryMessageToNative().
+  bool PostBinaryMessageToNative(const char* data, size_t size,
+                                 bool priority);
   scoped_ptr<base::Value> SendSyncMessageToNative(
       scoped_ptr<base::Value> msg);
 
   void PostMessageToJS(const base::Value& msg);
+  void PostBinaryMessageToJS(const char* data, size_t size);
+
+  int64_t instance_id() const { return instance_id_; }
+  const std::string& extension_name() const { return extension_name_; }
+
+  // If the instance wasn't created yet, it never will be: messages are
+  // dropped and sync messages get a null reply.
+  void OnExtensionUnregistered() { extension_unregistered_ = true; }
 
  private:
   friend class XWalkExtensionModule;
 
   void Destroy();
+  // Returns false if the instance couldn't be created in the server.
+  bool EnsureInstanceCreated();
 
   Client* client_;
   int64_t instance_id_;
+  std::string extension_name_;
+  bool instance_created_;
+  bool extension_unregistered_;
   XWalkExtensionClient* extension_client_;
 
   DISALLOW_COPY_AND_ASSIGN(XWalkRemoteExtensionRunner);
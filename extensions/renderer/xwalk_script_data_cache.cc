@@ -0,0 +1,52 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/renderer/xwalk_script_data_cache.h"
+
+#include "base/logging.h"
+#include "xwalk/extensions/common/xwalk_script_data_store.h"
+
+namespace xwalk {
+namespace extensions {
+
+XWalkScriptDataCache::XWalkScriptDataCache() {
+}
+
+XWalkScriptDataCache::~XWalkScriptDataCache() {
+}
+
+v8::ScriptData* XWalkScriptDataCache::GetScriptData(
+    const std::string& source) {
+  std::string hash = XWalkScriptDataStore::HashScriptSource(source);
+  ScriptDataMap::const_iterator it = script_data_.find(hash);
+  if (it != script_data_.end())
+    return it->second.get();
+
+  linked_ptr<v8::ScriptData> script_data(
+      v8::ScriptData::PreCompile(source.c_str(), source.size()));
+  if (!script_data.get() || script_data->HasError())
+    return NULL;
+
+  script_data_[hash] = script_data;
+  return script_data.get();
+}
+
+void XWalkScriptDataCache::AddStoredEntries(
+    const std::map<std::string, std::string>& entries) {
+  std::map<std::string, std::string>::const_iterator it = entries.begin();
+  for (; it != entries.end(); ++it) {
+    if (script_data_.find(it->first) != script_data_.end())
+      continue;
+    linked_ptr<v8::ScriptData> script_data(
+        v8::ScriptData::New(it->second.data(), it->second.size()));
+    if (script_data->HasError()) {
+      LOG(WARNING) << "Ignoring invalid cached script data " << it->first;
+      continue;
+    }
+    script_data_[it->first] = script_data;
+  }
+}
+
+}  // namespace extensions
+}  // namespace xwalk
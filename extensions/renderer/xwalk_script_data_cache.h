@@ -0,0 +1,49 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_RENDERER_XWALK_SCRIPT_DATA_CACHE_H_
+#define XWALK_EXTENSIONS_RENDERER_XWALK_SCRIPT_DATA_CACHE_H_
+
+#include <map>
+#include <string>
+#include "base/basictypes.h"
+#include "base/memory/linked_ptr.h"
+#include "v8/include/v8.h"
+
+namespace xwalk {
+namespace extensions {
+
+// Keeps the data V8 generates when pre-compiling the wrapped JS API code of
+// the extensions, so that creating a new script context doesn't need to parse
+// the same code again. Entries are keyed by a hash of the source code, so a
+// changed API code never gets stale data.
+//
+// When persistence is enabled, the browser sends the entries it created and
+// stored, see XWalkScriptDataStore. The data created here is only used by
+// this render process.
+class XWalkScriptDataCache {
+ public:
+  XWalkScriptDataCache();
+  ~XWalkScriptDataCache();
+
+  // Returns the pre-compilation data for |source|, creating it if needed. The
+  // cache keeps the ownership of the data. Returns NULL if V8 couldn't create
+  // valid data for the source.
+  v8::ScriptData* GetScriptData(const std::string& source);
+
+  // Adds the entries created by the browser, unless there is one for the same
+  // source already.
+  void AddStoredEntries(const std::map<std::string, std::string>& entries);
+
+ private:
+  typedef std::map<std::string, linked_ptr<v8::ScriptData> > ScriptDataMap;
+  ScriptDataMap script_data_;
+
+  DISALLOW_COPY_AND_ASSIGN(XWalkScriptDataCache);
+};
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_RENDERER_XWALK_SCRIPT_DATA_CACHE_H_
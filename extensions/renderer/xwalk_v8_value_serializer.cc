@@ -0,0 +1,149 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xwalk/extensions/renderer/xwalk_v8_value_serializer.h"
+
+#include "base/float_util.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "third_party/WebKit/public/web/WebArrayBuffer.h"
+#include "third_party/WebKit/public/web/WebArrayBufferView.h"
+#include "xwalk/extensions/common/xwalk_extension_serialized_value.h"
+
+namespace xwalk {
+namespace extensions {
+
+namespace {
+
+bool WriteValue(v8::Handle<v8::Value> value,
+                XWalkSerializedValueWriter* writer, int depth);
+
+void WriteString(v8::Handle<v8::String> string,
+                 XWalkSerializedValueWriter* writer) {
+  int length = string->Utf8Length();
+  char* data = writer->WriteStringInPlace(length);
+  if (length)
+    string->WriteUtf8(data, length, NULL, v8::String::NO_NULL_TERMINATION);
+}
+
+// ArrayBuffers and views on them are written as binary data.
+bool WriteBinary(v8::Handle<v8::Value> value,
+                 XWalkSerializedValueWriter* writer) {
+  scoped_ptr<WebKit::WebArrayBuffer> array_buffer(
+      WebKit::WebArrayBuffer::createFromV8Value(value));
+  if (array_buffer) {
+    writer->WriteBinary(static_cast<const char*>(array_buffer->data()),
+                        array_buffer->byteLength());
+    return true;
+  }
+
+  scoped_ptr<WebKit::WebArrayBufferView> view(
+      WebKit::WebArrayBufferView::createFromV8Value(value));
+  if (view) {
+    writer->WriteBinary(
+        static_cast<const char*>(view->baseAddress()) + view->byteOffset(),
+        view->byteLength());
+    return true;
+  }
+  return false;
+}
+
+// Like the converter, holes are left out and getters that throw give null.
+bool WriteArray(v8::Handle<v8::Array> array,
+                XWalkSerializedValueWriter* writer, int depth) {
+  size_t token = writer->BeginArray();
+  size_t count = 0;
+  for (uint32_t i = 0; i < array->Length(); ++i) {
+    v8::TryCatch try_catch;
+    v8::Handle<v8::Value> element = array->Get(i);
+    if (try_catch.HasCaught())
+      element = v8::Null();
+
+    if (!array->HasRealIndexedProperty(i))
+      continue;
+
+    if (!WriteValue(element, writer, depth + 1))
+      return false;
+    count++;
+  }
+  writer->EndArray(token, count);
+  return true;
+}
+
+bool WriteObject(v8::Handle<v8::Object> object,
+                 XWalkSerializedValueWriter* writer, int depth) {
+  size_t token = writer->BeginObject();
+
+  // Host objects, e.g. DOM nodes, are not serialized.
+  if (object->InternalFieldCount()) {
+    writer->EndObject(token, 0);
+    return true;
+  }
+
+  v8::Handle<v8::Array> keys(object->GetOwnPropertyNames());
+  size_t count = 0;
+  for (uint32_t i = 0; i < keys->Length(); ++i) {
+    v8::Handle<v8::Value> key = keys->Get(i);
+    if (!key->IsString() && !key->IsNumber())
+      continue;
+
+    v8::String::Utf8Value key_utf8(key->ToString());
+    writer->WriteKey(*key_utf8, key_utf8.length());
+
+    v8::TryCatch try_catch;
+    v8::Handle<v8::Value> member = object->Get(key);
+    if (try_catch.HasCaught())
+      member = v8::Null();
+
+    if (!WriteValue(member, writer, depth + 1))
+      return false;
+    count++;
+  }
+  writer->EndObject(token, count);
+  return true;
+}
+
+// Values the converter drops, like undefined and functions, are written as
+// undefined, which XWalkSerializedValue::ToValue() drops the same way.
+bool WriteValue(v8::Handle<v8::Value> value,
+                XWalkSerializedValueWriter* writer, int depth) {
+  if (value->IsNull()) {
+    writer->WriteNull();
+  } else if (value->IsBoolean()) {
+    writer->WriteBoolean(value->BooleanValue());
+  } else if (value->IsInt32()) {
+    writer->WriteInteger(value->Int32Value());
+  } else if (value->IsNumber()) {
+    double number = value->NumberValue();
+    if (base::IsFinite(number))
+      writer->WriteDouble(number);
+    else
+      writer->WriteUndefined();
+  } else if (value->IsString()) {
+    WriteString(value.As<v8::String>(), writer);
+  } else if (value->IsUndefined() || value->IsFunction()) {
+    writer->WriteUndefined();
+  } else if (value->IsObject()) {
+    if (depth >= XWalkSerializedValue::kMaxDepth)
+      return false;
+    if (value->IsArray())
+      return WriteArray(value.As<v8::Array>(), writer, depth);
+    if (!WriteBinary(value, writer))
+      return WriteObject(value.As<v8::Object>(), writer, depth);
+  } else {
+    NOTREACHED() << "Unexpected kind of V8 value";
+    writer->WriteUndefined();
+  }
+  return true;
+}
+
+}  // namespace
+
+bool SerializeV8Value(v8::Handle<v8::Value> value, std::string* buffer) {
+  XWalkSerializedValueWriter writer(buffer);
+  return WriteValue(value, &writer, 0);
+}
+
+}  // namespace extensions
+}  // namespace xwalk
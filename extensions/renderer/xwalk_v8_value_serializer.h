@@ -0,0 +1,27 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef XWALK_EXTENSIONS_RENDERER_XWALK_V8_VALUE_SERIALIZER_H_
+#define XWALK_EXTENSIONS_RENDERER_XWALK_V8_VALUE_SERIALIZER_H_
+
+#include <string>
+#include "v8/include/v8.h"
+
+namespace xwalk {
+namespace extensions {
+
+// Appends |value| to |buffer| in the format read by XWalkSerializedValue,
+// walking the V8 value once instead of converting it to base::Value first.
+// The result converts to the same base::Value content::V8ValueConverter would
+// create.
+//
+// Returns false, leaving |buffer| with partial contents, when nesting is too
+// deep, which is also the case of values with cycles. The converter should
+// be used for those.
+bool SerializeV8Value(v8::Handle<v8::Value> value, std::string* buffer);
+
+}  // namespace extensions
+}  // namespace xwalk
+
+#endif  // XWALK_EXTENSIONS_RENDERER_XWALK_V8_VALUE_SERIALIZER_H_
@@ -59,32 +59,29 @@ void LifecycleTracker(const v8::FunctionCallbackInfo<v8::Value>& info) {
   info.GetReturnValue().Set(tracker);
 }
 
-}  // namespace
-
-XWalkV8ToolsModule::XWalkV8ToolsModule() {
-  v8::Isolate* isolate = v8::Isolate::GetCurrent();
-  v8::HandleScope handle_scope(isolate);
-  v8::Handle<v8::ObjectTemplate> object_template = v8::ObjectTemplate::New();
+v8::Handle<v8::FunctionTemplate> CreateV8ToolsTemplate() {
+  v8::Handle<v8::FunctionTemplate> constructor = v8::FunctionTemplate::New();
+  v8::Handle<v8::ObjectTemplate> object_template =
+      constructor->InstanceTemplate();
   object_template->Set("forceSetProperty",
-                        v8::FunctionTemplate::New(ForceSetPropertyCallback));
+                       v8::FunctionTemplate::New(ForceSetPropertyCallback));
   object_template->Set("lifecycleTracker",
                        v8::FunctionTemplate::New(LifecycleTracker));
-
-  object_template_.Reset(isolate, object_template);
+  return constructor;
 }
 
-XWalkV8ToolsModule::~XWalkV8ToolsModule() {
-  v8::Isolate* isolate = v8::Isolate::GetCurrent();
-  object_template_.Dispose(isolate);
-  object_template_.Clear();
-}
+}  // namespace
+
+XWalkV8ToolsModule::XWalkV8ToolsModule() {}
+
+XWalkV8ToolsModule::~XWalkV8ToolsModule() {}
 
 v8::Handle<v8::Object> XWalkV8ToolsModule::NewInstance() {
   v8::Isolate* isolate = v8::Isolate::GetCurrent();
   v8::HandleScope handle_scope(isolate);
-  v8::Handle<v8::ObjectTemplate> object_template =
-      v8::Handle<v8::ObjectTemplate>::New(isolate, object_template_);
-  return handle_scope.Close(object_template->NewInstance());
+  v8::Handle<v8::FunctionTemplate> v8tools_template =
+      XWalkModuleSystem::GetSharedTemplate(isolate, &CreateV8ToolsTemplate);
+  return handle_scope.Close(v8tools_template->GetFunction()->NewInstance());
 }
 
 }  // namespace extensions
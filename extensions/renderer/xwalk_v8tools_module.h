@@ -19,8 +19,6 @@ class XWalkV8ToolsModule : public XWalkNativeModule {
 
  private:
   virtual v8::Handle<v8::Object> NewInstance() OVERRIDE;
-
-  v8::Persistent<v8::ObjectTemplate> object_template_;
 };
 
 }  // namespace extensions
@@ -0,0 +1,19 @@
+// JavaScript API of echo_extension, registered from its descriptor before the
+// library is loaded.
+var echoListener = null;
+extension.setMessageListener(function(msg) {
+  if (echoListener instanceof Function) {
+    echoListener(msg);
+  };
+});
+exports.echo = function(msg, callback) {
+  echoListener = callback;
+  extension.postMessage(msg);
+};
+exports.binaryEcho = function(buffer, callback) {
+  echoListener = callback;
+  extension.postMessage(buffer);
+};
+exports.syncEcho = function(msg) {
+  return extension.internal.sendSyncMessage(msg);
+};
@@ -14,6 +14,7 @@
 XW_Extension g_extension = 0;
 const XW_CoreInterface* g_core = NULL;
 const XW_MessagingInterface* g_messaging = NULL;
+const XW_BinaryMessagingInterface* g_binary_messaging = NULL;
 const XW_Internal_SyncMessagingInterface* g_sync_messaging = NULL;
 
 void instance_created(XW_Instance instance) {
@@ -28,6 +29,11 @@ void handle_message(XW_Instance instance, const char* message) {
   g_messaging->PostMessage(instance, message);
 }
 
+void handle_binary_message(XW_Instance instance, const char* data,
+                           size_t size) {
+  g_binary_messaging->PostMessage(instance, data, size);
+}
+
 void handle_sync_message(XW_Instance instance, const char* message) {
   g_sync_messaging->SetSyncReply(instance, message);
 }
@@ -48,6 +54,10 @@ int32_t XW_Initialize(XW_Extension extension, XW_GetInterface get_interface) {
       "  echoListener = callback;"
       "  extension.postMessage(msg);"
       "};"
+      "exports.binaryEcho = function(buffer, callback) {"
+      "  echoListener = callback;"
+      "  extension.postMessage(buffer);"
+      "};"
       "exports.syncEcho = function(msg) {"
       "  return extension.internal.sendSyncMessage(msg);"
       "};";
@@ -63,6 +73,9 @@ int32_t XW_Initialize(XW_Extension extension, XW_GetInterface get_interface) {
   g_messaging = get_interface(XW_MESSAGING_INTERFACE);
   g_messaging->Register(extension, handle_message);
 
+  g_binary_messaging = get_interface(XW_BINARY_MESSAGING_INTERFACE);
+  g_binary_messaging->Register(extension, handle_binary_message);
+
   g_sync_messaging = get_interface(XW_INTERNAL_SYNC_MESSAGING_INTERFACE);
   g_sync_messaging->Register(extension, handle_sync_message);
 
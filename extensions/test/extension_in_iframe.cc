@@ -22,6 +22,7 @@ namespace {
 
 base::Lock g_count_lock;
 int g_count = 0;
+int g_contexts_created = 0;
 
 }
 
@@ -30,6 +31,8 @@ class CounterExtensionContext : public XWalkExtensionInstance {
   explicit CounterExtensionContext(
       const XWalkExtension::PostMessageCallback& post_message) {
     SetPostMessageCallback(post_message);
+    base::AutoLock lock(g_count_lock);
+    g_contexts_created++;
   }
 
   virtual void HandleMessage(scoped_ptr<base::Value> msg) OVERRIDE {
@@ -93,3 +96,21 @@ IN_PROC_BROWSER_TEST_F(XWalkExtensionsIFrameTest,
   xwalk_test_utils::NavigateToURL(runtime(), url);
   content::TitleWatcher title_watcher2(runtime()->web_contents(), kPassString);
 }
+
+IN_PROC_BROWSER_TEST_F(XWalkExtensionsIFrameTest,
+                       ContextsAreNotCreatedForIFramesNotUsingExtensions) {
+  content::RunAllPendingInMessageLoop();
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+      base::FilePath().AppendASCII("counter_in_one_iframe.html"));
+
+  // Only one of the frames uses the extension, so the others shouldn't cause
+  // an instance to be created.
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+  SPIN_FOR_1_SECOND_OR_UNTIL_TRUE(g_count == 1);
+  ASSERT_EQ(g_count, 1);
+
+  base::AutoLock lock(g_count_lock);
+  ASSERT_EQ(g_contexts_created, 1);
+}
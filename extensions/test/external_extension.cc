@@ -2,20 +2,27 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include "base/command_line.h"
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
 #include "base/native_library.h"
 #include "base/path_service.h"
 #include "base/strings/utf_string_conversions.h"
 #include "xwalk/extensions/browser/xwalk_extension_service.h"
+#include "xwalk/extensions/common/xwalk_extension_switches.h"
 #include "xwalk/extensions/common/xwalk_external_extension.h"
 #include "xwalk/extensions/test/xwalk_extensions_test_base.h"
 #include "xwalk/runtime/browser/runtime.h"
 #include "xwalk/test/base/xwalk_test_utils.h"
+#include "content/public/browser/render_process_host.h"
+#include "content/public/browser/web_contents.h"
 #include "content/public/test/browser_test_utils.h"
 #include "content/public/test/test_utils.h"
 
 using xwalk::extensions::XWalkExtension;
 using xwalk::extensions::XWalkExtensionService;
 using xwalk::extensions::XWalkExternalExtension;
+using xwalk::Runtime;
 
 static base::FilePath GetNativeLibraryFilePath(const char* name) {
   base::string16 library_name = base::GetNativeLibraryName(UTF8ToUTF16(name));
@@ -74,3 +81,163 @@ IN_PROC_BROWSER_TEST_F(ExternalExtensionTest, ExternalExtensionSync) {
   xwalk_test_utils::NavigateToURL(runtime(), url);
   EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
 }
+
+IN_PROC_BROWSER_TEST_F(ExternalExtensionTest, ExternalExtensionBinary) {
+  content::RunAllPendingInMessageLoop();
+  GURL url = GetExtensionsTestURL(
+      base::FilePath(),
+      base::FilePath().AppendASCII("binary_echo.html"));
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+}
+
+IN_PROC_BROWSER_TEST_F(ExternalExtensionTest, MultipleRenderProcesses) {
+  content::RunAllPendingInMessageLoop();
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+                                  base::FilePath().AppendASCII("echo.html"));
+
+  Runtime* new_runtime = Runtime::Create(runtime()->runtime_context(), url);
+  ASSERT_NE(runtime()->web_contents()->GetRenderProcessHost(),
+            new_runtime->web_contents()->GetRenderProcessHost());
+
+  content::TitleWatcher new_title_watcher(new_runtime->web_contents(),
+                                          kPassString);
+  new_title_watcher.AlsoWaitForTitle(kFailString);
+  EXPECT_EQ(kPassString, new_title_watcher.WaitAndGetTitle());
+
+  // Closing the second render process shouldn't affect the instances of the
+  // first one.
+  new_runtime->Close();
+  content::RunAllPendingInMessageLoop();
+
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+}
+
+// Registers echo_extension from a directory where it comes with a descriptor,
+// so its library is only loaded when the page creates an instance.
+class ExternalExtensionDeferredTest : public XWalkExtensionsTestBase {
+ public:
+  void RegisterExtensions(XWalkExtensionService* extension_service) OVERRIDE {
+    ASSERT_TRUE(extensions_dir_.CreateUniqueTempDir());
+
+    base::FilePath library_name = GetNativeLibraryFilePath("echo_extension");
+    base::FilePath exe_dir;
+    PathService::Get(base::DIR_EXE, &exe_dir);
+    ASSERT_TRUE(file_util::CopyFile(
+        exe_dir.Append(library_name),
+        extensions_dir_.path().Append(library_name)));
+
+    base::FilePath js_api_file;
+    PathService::Get(base::DIR_SOURCE_ROOT, &js_api_file);
+    js_api_file = js_api_file
+                  .Append(FILE_PATH_LITERAL("xwalk"))
+                  .Append(FILE_PATH_LITERAL("extensions"))
+                  .Append(FILE_PATH_LITERAL("test"))
+                  .Append(FILE_PATH_LITERAL("data"))
+                  .Append(FILE_PATH_LITERAL("echo_api.js"));
+    ASSERT_TRUE(file_util::CopyFile(
+        js_api_file, extensions_dir_.path().AppendASCII("echo_api.js")));
+
+    const std::string descriptor =
+        "{ \"name\": \"echo\", \"jsapi\": \"echo_api.js\" }";
+    base::FilePath descriptor_file = extensions_dir_.path().Append(
+        library_name.ReplaceExtension(FILE_PATH_LITERAL("json")));
+    ASSERT_EQ(static_cast<int>(descriptor.size()),
+              file_util::WriteFile(descriptor_file, descriptor.data(),
+                                   descriptor.size()));
+
+    extension_service->RegisterExternalExtensionsForPath(
+        extensions_dir_.path());
+  }
+
+ private:
+  base::ScopedTempDir extensions_dir_;
+};
+
+IN_PROC_BROWSER_TEST_F(ExternalExtensionDeferredTest, ExternalExtension) {
+  content::RunAllPendingInMessageLoop();
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+                                  base::FilePath().AppendASCII("echo.html"));
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+}
+
+IN_PROC_BROWSER_TEST_F(ExternalExtensionDeferredTest, ExternalExtensionSync) {
+  content::RunAllPendingInMessageLoop();
+  GURL url = GetExtensionsTestURL(
+      base::FilePath(),
+      base::FilePath().AppendASCII("sync_echo.html"));
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+}
+
+class ExternalExtensionProcessTest : public XWalkExtensionsTestBase {
+ public:
+  virtual void SetUpCommandLine(CommandLine* command_line) OVERRIDE {
+    XWalkExtensionsTestBase::SetUpCommandLine(command_line);
+    command_line->AppendSwitch(switches::kXWalkEnableExtensionProcess);
+  }
+
+  void RegisterExtensions(XWalkExtensionService* extension_service) OVERRIDE {
+    base::FilePath extensions_dir;
+    PathService::Get(base::DIR_EXE, &extensions_dir);
+    extension_service->RegisterExternalExtensionsForPath(extensions_dir);
+  }
+};
+
+IN_PROC_BROWSER_TEST_F(ExternalExtensionProcessTest, ExternalExtension) {
+  content::RunAllPendingInMessageLoop();
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+                                  base::FilePath().AppendASCII("echo.html"));
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+}
+
+IN_PROC_BROWSER_TEST_F(ExternalExtensionProcessTest, ExternalExtensionSync) {
+  content::RunAllPendingInMessageLoop();
+  GURL url = GetExtensionsTestURL(
+      base::FilePath(),
+      base::FilePath().AppendASCII("sync_echo.html"));
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+}
+
+IN_PROC_BROWSER_TEST_F(ExternalExtensionProcessTest, MultipleRenderProcesses) {
+  content::RunAllPendingInMessageLoop();
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+                                  base::FilePath().AppendASCII("echo.html"));
+
+  // Both render processes talk to the same extension process, through a
+  // channel of their own.
+  Runtime* new_runtime = Runtime::Create(runtime()->runtime_context(), url);
+  ASSERT_NE(runtime()->web_contents()->GetRenderProcessHost(),
+            new_runtime->web_contents()->GetRenderProcessHost());
+
+  content::TitleWatcher new_title_watcher(new_runtime->web_contents(),
+                                          kPassString);
+  new_title_watcher.AlsoWaitForTitle(kFailString);
+  EXPECT_EQ(kPassString, new_title_watcher.WaitAndGetTitle());
+
+  // Closing the channel of the second render process shouldn't affect the
+  // first one.
+  new_runtime->Close();
+  content::RunAllPendingInMessageLoop();
+
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+}
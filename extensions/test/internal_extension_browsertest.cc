@@ -10,6 +10,7 @@
 #include "content/public/test/test_utils.h"
 #include "xwalk/extensions/browser/xwalk_extension_service.h"
 #include "xwalk/extensions/test/test.h"
+#include "xwalk/extensions/test/test_functions.h"
 #include "xwalk/extensions/test/xwalk_extensions_test_base.h"
 #include "xwalk/runtime/browser/runtime.h"
 #include "xwalk/test/base/xwalk_test_utils.h"
@@ -21,10 +22,7 @@ using namespace xwalk::jsapi_test::test; // NOLINT
 
 TestExtension::TestExtension() {
   set_name("test");
-}
-
-const char* TestExtension::GetJavaScriptAPI() {
-  return kSource_internal_extension_browsertest_api;
+  SetJavaScriptAPI(kSource_internal_extension_browsertest_api, kFunctionNames);
 }
 
 XWalkExtensionInstance* TestExtension::CreateInstance(
@@ -35,27 +33,24 @@ XWalkExtensionInstance* TestExtension::CreateInstance(
 TestExtensionInstance::TestExtensionInstance(
     const XWalkExtension::PostMessageCallback& post_message)
     : XWalkInternalExtensionInstance(post_message) {
-  RegisterFunction("clearDatabase", &TestExtensionInstance::OnClearDatabase);
-  RegisterFunction("addPerson", &TestExtensionInstance::OnAddPerson);
-  RegisterFunction("addPersonObject",
-      &TestExtensionInstance::OnAddPersonObject);
-  RegisterFunction("getAllPersons", &TestExtensionInstance::OnGetAllPersons);
-  RegisterFunction("getPersonAge", &TestExtensionInstance::OnGetPersonAge);
+  RegisterFunction(kClearDatabase, &TestExtensionInstance::OnClearDatabase);
+  RegisterFunction(kAddPerson, &TestExtensionInstance::OnAddPerson);
+  RegisterFunction(kAddPersonObject, &TestExtensionInstance::OnAddPersonObject);
+  RegisterFunction(kGetAllPersons, &TestExtensionInstance::OnGetAllPersons);
+  RegisterFunction(kGetPersonAge, &TestExtensionInstance::OnGetPersonAge);
 }
 
-void TestExtensionInstance::OnClearDatabase(const std::string&,
-                                                          const std::string&,
-                                                          base::ListValue*) {
+void TestExtensionInstance::OnClearDatabase(int, int, base::ListValue*) {
   database()->clear();
 }
 
 void TestExtensionInstance::OnAddPerson(
-    const std::string& function_name, const std::string&,
-    base::ListValue* args) {
+    int function_id, int, base::ListValue* args) {
   scoped_ptr<AddPerson::Params> params(AddPerson::Params::Create(*args));
 
   if (!params) {
-    LOG(WARNING) << "Malformed parameters passed to " << function_name;
+    LOG(WARNING) << "Malformed parameters passed to "
+                 << kFunctionNames[function_id];
     return;
   }
 
@@ -64,13 +59,13 @@ void TestExtensionInstance::OnAddPerson(
 }
 
 void TestExtensionInstance::OnAddPersonObject(
-    const std::string& function_name, const std::string&,
-    base::ListValue* args) {
+    int function_id, int, base::ListValue* args) {
   scoped_ptr<AddPersonObject::Params>
       params(AddPersonObject::Params::Create(*args));
 
   if (!params) {
-    LOG(WARNING) << "Malformed parameters passed to " << function_name;
+    LOG(WARNING) << "Malformed parameters passed to "
+                 << kFunctionNames[function_id];
     return;
   }
 
@@ -79,16 +74,16 @@ void TestExtensionInstance::OnAddPersonObject(
 }
 
 void TestExtensionInstance::OnGetAllPersons(
-    const std::string& function_name, const std::string& callback_id,
-    base::ListValue* args) {
-  if (callback_id.empty())
+    int function_id, int callback_id, base::ListValue* args) {
+  if (callback_id == kNoCallback)
     return;
 
   scoped_ptr<GetAllPersons::Params>
       params(GetAllPersons::Params::Create(*args));
 
   if (!params) {
-    LOG(WARNING) << "Malformed parameters passed to " << function_name;
+    LOG(WARNING) << "Malformed parameters passed to "
+                 << kFunctionNames[function_id];
     return;
   }
 
@@ -108,23 +103,22 @@ void TestExtensionInstance::OnGetAllPersons(
 }
 
 void TestExtensionInstance::OnGetPersonAge(
-    const std::string& function_name, const std::string& callback_id,
-    base::ListValue* args) {
-  if (callback_id.empty())
+    int function_id, int callback_id, const XWalkSerializedValue& args) {
+  if (callback_id == kNoCallback)
     return;
 
-  scoped_ptr<GetPersonAge::Params>
-      params(GetPersonAge::Params::Create(*args));
-
-  if (!params) {
-    LOG(WARNING) << "Malformed parameters passed to " << function_name;
+  base::StringPiece name;
+  if (args.GetSize() != 1 ||
+      !XWalkSerializedValue::Iterator(args).value().GetAsString(&name)) {
+    LOG(WARNING) << "Malformed parameters passed to "
+                 << kFunctionNames[function_id];
     return;
   }
 
   int age = -1;
 
   for (unsigned i = 0; i < database()->size(); ++i) {
-    if (database()->at(i).first == params->name)
+    if (database()->at(i).first == name)
       age = database()->at(i).second;
   }
 
@@ -14,8 +14,6 @@ class TestExtension : public xwalk::extensions::XWalkInternalExtension {
  public:
   TestExtension();
 
-  virtual const char* GetJavaScriptAPI() OVERRIDE;
-
   virtual xwalk::extensions::XWalkExtensionInstance* CreateInstance(
       const XWalkExtension::PostMessageCallback& post_message) OVERRIDE;
 };
@@ -32,17 +30,16 @@ class TestExtensionInstance
   Database* database() { return &database_; }
 
  private:
-  void OnClearDatabase(const std::string& function_name,
-                       const std::string& callback_id, base::ListValue* args);
-  void OnAddPerson(const std::string& function_name,
-                   const std::string& callback_id, base::ListValue* args);
-  void OnAddPersonObject(const std::string& function_name,
-                         const std::string& callback_id,
+  void OnClearDatabase(int function_id, int callback_id,
+                       base::ListValue* args);
+  void OnAddPerson(int function_id, int callback_id, base::ListValue* args);
+  void OnAddPersonObject(int function_id, int callback_id,
                          base::ListValue* args);
-  void OnGetAllPersons(const std::string& function_name,
-                       const std::string& callback_id, base::ListValue* args);
-  void OnGetPersonAge(const std::string& function_name,
-                      const std::string& callback_id, base::ListValue* args);
+  void OnGetAllPersons(int function_id, int callback_id,
+                       base::ListValue* args);
+  // Reads the name in place, to cover handlers of serialized arguments.
+  void OnGetPersonAge(int function_id, int callback_id,
+                      const xwalk::extensions::XWalkSerializedValue& args);
 
   std::vector<std::pair<std::string, int> > database_;
 };
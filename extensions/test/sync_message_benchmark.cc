@@ -0,0 +1,90 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <string>
+#include "base/command_line.h"
+#include "base/native_library.h"
+#include "base/path_service.h"
+#include "base/strings/utf_string_conversions.h"
+#include "xwalk/extensions/browser/xwalk_extension_service.h"
+#include "xwalk/extensions/common/xwalk_extension_switches.h"
+#include "xwalk/extensions/common/xwalk_external_extension.h"
+#include "xwalk/extensions/test/xwalk_extensions_test_base.h"
+#include "xwalk/runtime/browser/runtime.h"
+#include "xwalk/test/base/xwalk_test_utils.h"
+#include "content/public/browser/web_contents.h"
+#include "content/public/test/browser_test_utils.h"
+#include "content/public/test/test_utils.h"
+
+using xwalk::extensions::XWalkExtension;
+using xwalk::extensions::XWalkExtensionService;
+using xwalk::extensions::XWalkExternalExtension;
+
+static base::FilePath GetNativeLibraryFilePath(const char* name) {
+  base::string16 library_name = base::GetNativeLibraryName(UTF8ToUTF16(name));
+#if defined(OS_WIN)
+  return base::FilePath(library_name);
+#else
+  return base::FilePath(UTF16ToUTF8(library_name));
+#endif
+}
+
+// Measures the round trip time of sync messages sent to the echo extension,
+// with and without the shared memory fast path. The results are printed in
+// the format used by the Chromium perf bots.
+class SyncMessageBenchmarkTest : public XWalkExtensionsTestBase {
+ public:
+  void RegisterExtensions(XWalkExtensionService* extension_service) OVERRIDE {
+    base::FilePath extension_file;
+    PathService::Get(base::DIR_EXE, &extension_file);
+    extension_file = extension_file.Append(
+        GetNativeLibraryFilePath("echo_extension"));
+    XWalkExternalExtension* extension =
+        new XWalkExternalExtension(extension_file);
+    ASSERT_TRUE(extension->is_valid());
+    extension_service->RegisterExtension(scoped_ptr<XWalkExtension>(extension));
+  }
+
+ protected:
+  void RunBenchmark(const std::string& trace) {
+    content::RunAllPendingInMessageLoop();
+    GURL url = GetExtensionsTestURL(
+        base::FilePath(),
+        base::FilePath().AppendASCII("sync_echo_benchmark.html"));
+    content::TitleWatcher title_watcher(runtime()->web_contents(),
+                                        kPassString);
+    title_watcher.AlsoWaitForTitle(kFailString);
+    xwalk_test_utils::NavigateToURL(runtime(), url);
+    ASSERT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+
+    static const char* const kMeasurements[] = { "small", "medium", "large" };
+    for (size_t i = 0; i < arraysize(kMeasurements); ++i) {
+      std::string result;
+      ASSERT_TRUE(content::ExecuteScriptAndExtractString(
+          runtime()->web_contents(),
+          std::string("window.domAutomationController.send("
+                      "String(results['") + kMeasurements[i] + "']));",
+          &result));
+      printf("RESULT sync_echo_round_trip_%s: %s= %s us\n",
+             kMeasurements[i], trace.c_str(), result.c_str());
+    }
+  }
+};
+
+class SyncMessageBenchmarkIPCTest : public SyncMessageBenchmarkTest {
+ public:
+  virtual void SetUpCommandLine(CommandLine* command_line) OVERRIDE {
+    SyncMessageBenchmarkTest::SetUpCommandLine(command_line);
+    command_line->AppendSwitch(switches::kXWalkDisableExtensionSyncFastPath);
+  }
+};
+
+IN_PROC_BROWSER_TEST_F(SyncMessageBenchmarkTest, SyncEchoRoundTrip) {
+  RunBenchmark("fast_path");
+}
+
+IN_PROC_BROWSER_TEST_F(SyncMessageBenchmarkIPCTest, SyncEchoRoundTrip) {
+  RunBenchmark("ipc");
+}
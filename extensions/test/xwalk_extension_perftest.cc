@@ -0,0 +1,464 @@
+// Copyright (c) 2013 Intel Corporation. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/file_util.h"
+#include "base/files/file_path.h"
+#include "base/format_macros.h"
+#include "base/json/json_writer.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop/message_loop.h"
+#include "base/native_library.h"
+#include "base/path_service.h"
+#include "base/run_loop.h"
+#include "base/strings/stringprintf.h"
+#include "base/strings/utf_string_conversions.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/thread.h"
+#include "base/time.h"
+#include "base/values.h"
+#include "ipc/ipc_channel.h"
+#include "ipc/ipc_channel_handle.h"
+#include "ipc/ipc_listener.h"
+#include "ipc/ipc_sync_channel.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "xwalk/extensions/common/xwalk_extension.h"
+#include "xwalk/extensions/common/xwalk_extension_server.h"
+#include "xwalk/extensions/common/xwalk_external_extension.h"
+#include "xwalk/extensions/renderer/xwalk_extension_client.h"
+#include "xwalk/extensions/renderer/xwalk_remote_extension_runner.h"
+
+using xwalk::extensions::XWalkExtension;
+using xwalk::extensions::XWalkExtensionClient;
+using xwalk::extensions::XWalkExtensionInstance;
+using xwalk::extensions::XWalkExtensionServer;
+using xwalk::extensions::XWalkExternalExtension;
+using xwalk::extensions::XWalkRemoteExtensionRunner;
+
+// Drives an XWalkExtensionServer and an XWalkExtensionClient connected by a
+// real IPC channel, without a browser. The server thread plays the role of
+// the browser IO thread and the main thread the one of the render thread.
+//
+// Results are printed in the format used by the Chromium perf bots, and also
+// written as JSON to the file given with --perf-results-json, so they can be
+// compared between builds.
+
+namespace {
+
+const char kPerfResultsJSONSwitch[] = "perf-results-json";
+
+const size_t kPayloadSizes[] = { 16, 256, 4 * 1024, 64 * 1024, 1024 * 1024 };
+const size_t kInstanceCounts[] = { 1, 8 };
+
+// Async messages that each instance may have waiting for their echo.
+const size_t kAsyncWindow = 32;
+
+size_t GetMessageCount(size_t payload_size) {
+  // Enough messages to get stable numbers without taking forever with the
+  // bigger payloads.
+  return std::max<size_t>(50, std::min<size_t>(2000,
+                                               (32 << 20) / payload_size));
+}
+
+class EchoInstance : public XWalkExtensionInstance {
+ public:
+  explicit EchoInstance(
+      const XWalkExtension::PostMessageCallback& post_message) {
+    SetPostMessageCallback(post_message);
+  }
+
+  virtual void HandleMessage(scoped_ptr<base::Value> msg) OVERRIDE {
+    PostMessageToJS(msg.Pass());
+  }
+
+  virtual scoped_ptr<base::Value> HandleSyncMessage(
+      scoped_ptr<base::Value> msg) OVERRIDE {
+    return msg.Pass();
+  }
+};
+
+// Same behavior as test/echo_extension.c, so internal and external extensions
+// can be compared.
+class EchoExtension : public XWalkExtension {
+ public:
+  EchoExtension() {
+    set_name("echo");
+  }
+
+  virtual const char* GetJavaScriptAPI() OVERRIDE { return ""; }
+
+  virtual XWalkExtensionInstance* CreateInstance(
+      const XWalkExtension::PostMessageCallback& post_message) OVERRIDE {
+    return new EchoInstance(post_message);
+  }
+};
+
+scoped_ptr<XWalkExtension> CreateExternalEchoExtension() {
+  base::FilePath extension_file;
+  PathService::Get(base::DIR_EXE, &extension_file);
+  base::string16 library_name =
+      base::GetNativeLibraryName(UTF8ToUTF16("echo_extension"));
+  extension_file = extension_file.AppendASCII(UTF16ToUTF8(library_name));
+
+  scoped_ptr<XWalkExternalExtension> extension(
+      new XWalkExternalExtension(extension_file));
+  if (!extension->is_valid())
+    return scoped_ptr<XWalkExtension>();
+  return extension.PassAs<XWalkExtension>();
+}
+
+double GetPercentile(const std::vector<double>& sorted_values,
+                     size_t percentile) {
+  if (sorted_values.empty())
+    return 0;
+  size_t index = std::min(sorted_values.size() - 1,
+                          sorted_values.size() * percentile / 100);
+  return sorted_values[index];
+}
+
+base::ListValue* GetResults() {
+  static base::ListValue* results = new base::ListValue;
+  return results;
+}
+
+void PrintResult(const std::string& measurement, const std::string& trace,
+                 double value, const std::string& units) {
+  printf("RESULT %s: %s= %.2f %s\n", measurement.c_str(), trace.c_str(), value,
+         units.c_str());
+
+  base::DictionaryValue* result = new base::DictionaryValue;
+  result->SetString("measurement", measurement);
+  result->SetString("trace", trace);
+  result->SetDouble("value", value);
+  result->SetString("units", units);
+  GetResults()->Append(result);
+}
+
+void WriteResultsIfRequested() {
+  base::FilePath path = CommandLine::ForCurrentProcess()->GetSwitchValuePath(
+      kPerfResultsJSONSwitch);
+  if (path.empty())
+    return;
+
+  std::string json;
+  base::JSONWriter::WriteWithOptions(
+      GetResults(), base::JSONWriter::OPTIONS_PRETTY_PRINT, &json);
+  if (file_util::WriteFile(path, json.data(), json.size()) !=
+      static_cast<int>(json.size()))
+    LOG(WARNING) << "Couldn't write perf results to " << path.value();
+}
+
+// Owns the server and its end of the channel, both living in a thread with an
+// IO message loop, like the browser IO thread.
+class ServerThread {
+ public:
+  ServerThread() : thread_("XWalkExtensionPerfServer") {}
+
+  void Start(const IPC::ChannelHandle& handle,
+             scoped_ptr<XWalkExtension> extension) {
+    ASSERT_TRUE(thread_.StartWithOptions(
+        base::Thread::Options(base::MessageLoop::TYPE_IO, 0)));
+
+    // The client end of the channel is only available once the server end
+    // is created.
+    base::WaitableEvent started(false, false);
+    thread_.message_loop()->PostTask(FROM_HERE,
+        base::Bind(&ServerThread::StartOnServerThread, base::Unretained(this),
+                   handle, base::Passed(&extension), &started));
+    started.Wait();
+  }
+
+  void Stop() {
+    if (!thread_.IsRunning())
+      return;
+    thread_.message_loop()->PostTask(FROM_HERE,
+        base::Bind(&ServerThread::StopOnServerThread, base::Unretained(this)));
+    thread_.Stop();
+  }
+
+ private:
+  void StartOnServerThread(const IPC::ChannelHandle& handle,
+                           scoped_ptr<XWalkExtension> extension,
+                           base::WaitableEvent* started) {
+    server_.reset(new XWalkExtensionServer);
+    server_->RegisterExtension(extension.Pass());
+    channel_.reset(new IPC::Channel(handle, IPC::Channel::MODE_SERVER,
+                                    server_.get()));
+    channel_->Connect();
+    server_->Initialize(channel_.get());
+    started->Signal();
+  }
+
+  void StopOnServerThread() {
+    server_->Invalidate();
+    channel_.reset();
+    server_.reset();
+  }
+
+  base::Thread thread_;
+  scoped_ptr<XWalkExtensionServer> server_;
+  scoped_ptr<IPC::Channel> channel_;
+};
+
+class XWalkExtensionPerfTest : public testing::Test,
+                               public IPC::Listener {
+ public:
+  XWalkExtensionPerfTest()
+      : io_thread_("XWalkExtensionPerfClientIO"),
+        shutdown_event_(true, false),
+        run_loop_(NULL),
+        messages_per_instance_(0),
+        messages_received_(0),
+        messages_expected_(0) {}
+
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(io_thread_.StartWithOptions(
+        base::Thread::Options(base::MessageLoop::TYPE_IO, 0)));
+  }
+
+  virtual void TearDown() OVERRIDE {
+    StopServerAndClient();
+    io_thread_.Stop();
+    WriteResultsIfRequested();
+  }
+
+  // IPC::Listener implementation.
+  virtual bool OnMessageReceived(const IPC::Message& message) OVERRIDE {
+    return client_->OnMessageReceived(message);
+  }
+
+ protected:
+  // Receives the echoes of one instance.
+  class EchoReceiver : public XWalkRemoteExtensionRunner::Client {
+   public:
+    EchoReceiver(XWalkExtensionPerfTest* test, size_t index)
+        : test_(test), index_(index) {}
+
+    virtual void HandleMessageFromNative(const base::Value& msg) OVERRIDE {
+      test_->OnEchoReceived(index_);
+    }
+    virtual void HandleBinaryMessageFromNative(const char* data,
+                                               size_t size) OVERRIDE {
+      test_->OnEchoReceived(index_);
+    }
+
+   private:
+    XWalkExtensionPerfTest* test_;
+    size_t index_;
+  };
+
+  void StartServerAndClient(scoped_ptr<XWalkExtension> extension) {
+    IPC::ChannelHandle handle(
+        IPC::Channel::GenerateVerifiedChannelID("xwalk-extension-perf"));
+    server_thread_.Start(handle, extension.Pass());
+
+    channel_.reset(new IPC::SyncChannel(handle, IPC::Channel::MODE_CLIENT,
+        this, io_thread_.message_loop_proxy(), true, &shutdown_event_));
+    client_.reset(new XWalkExtensionClient(channel_.get()));
+  }
+
+  void StopServerAndClient() {
+    DestroyRunners();
+    // Unblocks any pending sync message before the channel goes away.
+    shutdown_event_.Signal();
+    channel_.reset();
+    client_.reset();
+    server_thread_.Stop();
+  }
+
+  void CreateRunners(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      receivers_.push_back(new EchoReceiver(this, i));
+      runners_.push_back(client_->CreateRunner("echo", receivers_.back()));
+    }
+    post_times_.resize(count);
+    messages_posted_.resize(count);
+  }
+
+  void DestroyRunners() {
+    for (size_t i = 0; i < runners_.size(); ++i)
+      client_->DestroyInstance(runners_[i]->instance_id(), true);
+    runners_.clear();
+    receivers_.clear();
+    post_times_.clear();
+    messages_posted_.clear();
+  }
+
+  void RunAsyncBenchmark(const std::string& extension_type) {
+    for (size_t i = 0; i < arraysize(kInstanceCounts); ++i) {
+      for (size_t j = 0; j < arraysize(kPayloadSizes); ++j)
+        RunAsyncCase(extension_type, kInstanceCounts[i], kPayloadSizes[j]);
+    }
+  }
+
+  void RunSyncBenchmark(const std::string& extension_type) {
+    for (size_t i = 0; i < arraysize(kInstanceCounts); ++i) {
+      for (size_t j = 0; j < arraysize(kPayloadSizes); ++j)
+        RunSyncCase(extension_type, kInstanceCounts[i], kPayloadSizes[j]);
+    }
+  }
+
+ private:
+  void RunAsyncCase(const std::string& extension_type, size_t instance_count,
+                    size_t payload_size) {
+    CreateRunners(instance_count);
+    payload_.assign(payload_size, 'x');
+    // The first message of each instance also creates it in the server.
+    WarmUp();
+
+    messages_per_instance_ = GetMessageCount(payload_size) / instance_count;
+    messages_expected_ = messages_per_instance_ * instance_count;
+    messages_received_ = 0;
+    latencies_.clear();
+    latencies_.reserve(messages_expected_);
+
+    base::TimeTicks start_time = base::TimeTicks::Now();
+    for (size_t i = 0; i < runners_.size(); ++i) {
+      messages_posted_[i] = 0;
+      for (size_t k = 0; k < std::min(kAsyncWindow, messages_per_instance_);
+           ++k)
+        PostEcho(i);
+    }
+
+    base::RunLoop run_loop;
+    run_loop_ = &run_loop;
+    run_loop.Run();
+    run_loop_ = NULL;
+
+    ReportCase("async", extension_type, instance_count, payload_size,
+               base::TimeTicks::Now() - start_time);
+    DestroyRunners();
+  }
+
+  void RunSyncCase(const std::string& extension_type, size_t instance_count,
+                   size_t payload_size) {
+    CreateRunners(instance_count);
+    payload_.assign(payload_size, 'x');
+    WarmUp();
+
+    size_t message_count = GetMessageCount(payload_size);
+    latencies_.clear();
+    latencies_.reserve(message_count);
+
+    base::TimeTicks start_time = base::TimeTicks::Now();
+    for (size_t i = 0; i < message_count; ++i) {
+      base::TimeTicks send_time = base::TimeTicks::Now();
+      scoped_ptr<base::Value> reply =
+          runners_[i % runners_.size()]->SendSyncMessageToNative(
+              scoped_ptr<base::Value>(new base::StringValue(payload_)));
+      latencies_.push_back(
+          (base::TimeTicks::Now() - send_time).InMicrosecondsF());
+      ASSERT_TRUE(reply);
+    }
+
+    ReportCase("sync", extension_type, instance_count, payload_size,
+               base::TimeTicks::Now() - start_time);
+    DestroyRunners();
+  }
+
+  void WarmUp() {
+    for (size_t i = 0; i < runners_.size(); ++i) {
+      scoped_ptr<base::Value> reply = runners_[i]->SendSyncMessageToNative(
+          scoped_ptr<base::Value>(new base::StringValue("warm up")));
+      ASSERT_TRUE(reply);
+    }
+  }
+
+  void PostEcho(size_t index) {
+    messages_posted_[index]++;
+    post_times_[index].push_back(base::TimeTicks::Now());
+    runners_[index]->PostMessageToNative(
+        scoped_ptr<base::Value>(new base::StringValue(payload_)), false);
+  }
+
+  void OnEchoReceived(size_t index) {
+    // Each instance gets its echoes in the order they were posted.
+    ASSERT_FALSE(post_times_[index].empty());
+    latencies_.push_back(
+        (base::TimeTicks::Now() - post_times_[index].front())
+            .InMicrosecondsF());
+    post_times_[index].pop_front();
+
+    if (messages_posted_[index] < messages_per_instance_)
+      PostEcho(index);
+
+    if (++messages_received_ == messages_expected_ && run_loop_)
+      run_loop_->Quit();
+  }
+
+  void ReportCase(const std::string& mode, const std::string& extension_type,
+                  size_t instance_count, size_t payload_size,
+                  base::TimeDelta elapsed) {
+    std::string trace = base::StringPrintf(
+        "%s_%" PRIuS "B_x%" PRIuS, extension_type.c_str(), payload_size,
+        instance_count);
+    double seconds = std::max(elapsed.InSecondsF(), 1e-9);
+
+    std::sort(latencies_.begin(), latencies_.end());
+    PrintResult(mode + "_throughput", trace, latencies_.size() / seconds,
+                "messages/s");
+    PrintResult(mode + "_bandwidth", trace,
+                latencies_.size() * payload_size / seconds / (1 << 20),
+                "MB/s");
+    PrintResult(mode + "_latency_p50", trace, GetPercentile(latencies_, 50),
+                "us");
+    PrintResult(mode + "_latency_p99", trace, GetPercentile(latencies_, 99),
+                "us");
+  }
+
+  base::MessageLoop main_loop_;
+  base::Thread io_thread_;
+  base::WaitableEvent shutdown_event_;
+  ServerThread server_thread_;
+  scoped_ptr<IPC::SyncChannel> channel_;
+  scoped_ptr<XWalkExtensionClient> client_;
+
+  ScopedVector<EchoReceiver> receivers_;
+  // Owned by |client_|.
+  std::vector<XWalkRemoteExtensionRunner*> runners_;
+
+  std::string payload_;
+  base::RunLoop* run_loop_;
+  size_t messages_per_instance_;
+  size_t messages_received_;
+  size_t messages_expected_;
+  std::vector<size_t> messages_posted_;
+  std::vector<std::deque<base::TimeTicks> > post_times_;
+  std::vector<double> latencies_;
+};
+
+}  // namespace
+
+TEST_F(XWalkExtensionPerfTest, InternalAsync) {
+  StartServerAndClient(scoped_ptr<XWalkExtension>(new EchoExtension));
+  RunAsyncBenchmark("internal");
+}
+
+TEST_F(XWalkExtensionPerfTest, InternalSync) {
+  StartServerAndClient(scoped_ptr<XWalkExtension>(new EchoExtension));
+  RunSyncBenchmark("internal");
+}
+
+TEST_F(XWalkExtensionPerfTest, ExternalAsync) {
+  scoped_ptr<XWalkExtension> extension = CreateExternalEchoExtension();
+  ASSERT_TRUE(extension);
+  StartServerAndClient(extension.Pass());
+  RunAsyncBenchmark("external");
+}
+
+TEST_F(XWalkExtensionPerfTest, ExternalSync) {
+  scoped_ptr<XWalkExtension> extension = CreateExternalEchoExtension();
+  ASSERT_TRUE(extension);
+  StartServerAndClient(extension.Pass());
+  RunSyncBenchmark("external");
+}
@@ -4,17 +4,32 @@
 
 #include "xwalk/extensions/test/xwalk_extensions_test_base.h"
 
+#include "base/command_line.h"
+#include "base/file_util.h"
+#include "base/files/file_enumerator.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/run_loop.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/thread_restrictions.h"
+#include "content/public/browser/browser_thread.h"
 #include "xwalk/extensions/browser/xwalk_extension_service.h"
 #include "xwalk/extensions/common/xwalk_extension.h"
+#include "xwalk/extensions/common/xwalk_extension_switches.h"
+#include "xwalk/extensions/common/xwalk_script_data_store.h"
 #include "xwalk/runtime/browser/runtime.h"
 #include "xwalk/test/base/in_process_browser_test.h"
 #include "xwalk/test/base/xwalk_test_utils.h"
+#include "content/public/browser/render_process_host.h"
+#include "content/public/browser/web_contents.h"
 #include "content/public/test/browser_test_utils.h"
 #include "content/public/test/test_utils.h"
 
+using content::BrowserThread;
 using xwalk::extensions::XWalkExtension;
 using xwalk::extensions::XWalkExtensionInstance;
 using xwalk::extensions::XWalkExtensionService;
+using xwalk::extensions::XWalkScriptDataStore;
+using xwalk::Runtime;
 
 class EchoContext : public XWalkExtensionInstance {
  public:
@@ -61,6 +76,27 @@ class EchoExtension : public XWalkExtension {
   }
 };
 
+// The JS API code of this extension leaves a mark when it runs, so we can
+// check that it only runs when the namespace is used.
+class LazyExtension : public XWalkExtension {
+ public:
+  LazyExtension() : XWalkExtension() {
+    set_name("lazy.loaded");
+  }
+
+  virtual const char* GetJavaScriptAPI() {
+    static const char* kAPI =
+        "window.lazyLoadedCount = (window.lazyLoadedCount || 0) + 1;"
+        "exports.value = 42;";
+    return kAPI;
+  }
+
+  virtual XWalkExtensionInstance* CreateInstance(
+      const XWalkExtension::PostMessageCallback& post_message) {
+    return new EchoContext(post_message);
+  }
+};
+
 class ExtensionWithInvalidName : public XWalkExtension {
  public:
   ExtensionWithInvalidName() : XWalkExtension() {
@@ -79,6 +115,10 @@ class XWalkExtensionsTest : public XWalkExtensionsTestBase {
         scoped_ptr<XWalkExtension>(new EchoExtension));
     ASSERT_TRUE(registered);
 
+    registered = extension_service->RegisterExtension(
+        scoped_ptr<XWalkExtension>(new LazyExtension));
+    ASSERT_TRUE(registered);
+
     bool invalid_registered = extension_service->RegisterExtension(
         scoped_ptr<XWalkExtension>(new ExtensionWithInvalidName));
     ASSERT_FALSE(invalid_registered);
@@ -105,3 +145,159 @@ IN_PROC_BROWSER_TEST_F(XWalkExtensionsTest, EchoExtensionSync) {
   xwalk_test_utils::NavigateToURL(runtime(), url);
   EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
 }
+
+IN_PROC_BROWSER_TEST_F(XWalkExtensionsTest, LazyLoadExtensionCode) {
+  content::RunAllPendingInMessageLoop();
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+                                  base::FilePath().AppendASCII(
+                                      "lazy_extension.html"));
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+}
+
+// Extensions are registered and unregistered while the render process of the
+// runtime is already running.
+class XWalkExtensionsHotRegistrationTest : public XWalkExtensionsTestBase {
+ public:
+  XWalkExtensionsHotRegistrationTest() : extension_service_(NULL) {}
+
+  void RegisterExtensions(XWalkExtensionService* extension_service) OVERRIDE {
+    extension_service_ = extension_service;
+  }
+
+ protected:
+  XWalkExtensionService* extension_service_;
+};
+
+static void QuitOnUIThread(const base::Closure& quit_closure) {
+  BrowserThread::PostTask(BrowserThread::UI, FROM_HERE, quit_closure);
+}
+
+IN_PROC_BROWSER_TEST_F(XWalkExtensionsHotRegistrationTest,
+                       RegisterWhileRunning) {
+  content::RunAllPendingInMessageLoop();
+  ASSERT_TRUE(extension_service_->RegisterExtension(
+      scoped_ptr<XWalkExtension>(new EchoExtension)));
+
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+      base::FilePath().AppendASCII("test_extension.html"));
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+}
+
+IN_PROC_BROWSER_TEST_F(XWalkExtensionsHotRegistrationTest,
+                       UnregisterWhileRunning) {
+  content::RunAllPendingInMessageLoop();
+  ASSERT_TRUE(extension_service_->RegisterExtension(
+      scoped_ptr<XWalkExtension>(new EchoExtension)));
+
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+      base::FilePath().AppendASCII("test_extension.html"));
+  {
+    content::TitleWatcher title_watcher(runtime()->web_contents(),
+                                        kPassString);
+    title_watcher.AlsoWaitForTitle(kFailString);
+    xwalk_test_utils::NavigateToURL(runtime(), url);
+    EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+  }
+
+  base::RunLoop drained_run_loop;
+  ASSERT_TRUE(extension_service_->UnregisterExtension(
+      "echo", base::Bind(&QuitOnUIThread, drained_run_loop.QuitClosure())));
+
+  url = GetExtensionsTestURL(base::FilePath(),
+      base::FilePath().AppendASCII("unregistered_extension.html"));
+  content::TitleWatcher title_watcher(runtime()->web_contents(), kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+
+  // Leaving the first page destroyed the instance it created, so the
+  // extension goes away.
+  drained_run_loop.Run();
+}
+
+IN_PROC_BROWSER_TEST_F(XWalkExtensionsHotRegistrationTest,
+                       SyncMessageAfterUnregister) {
+  content::RunAllPendingInMessageLoop();
+  ASSERT_TRUE(extension_service_->RegisterExtension(
+      scoped_ptr<XWalkExtension>(new EchoExtension)));
+
+  // The page doesn't use the extension, so its instance isn't created yet.
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+      base::FilePath().AppendASCII("empty.html"));
+  xwalk_test_utils::NavigateToURL(runtime(), url);
+
+  base::RunLoop drained_run_loop;
+  ASSERT_TRUE(extension_service_->UnregisterExtension(
+      "echo", base::Bind(&QuitOnUIThread, drained_run_loop.QuitClosure())));
+  drained_run_loop.Run();
+
+  // Make sure the render process was told about it before running the script.
+  content::RunAllPendingInMessageLoop(BrowserThread::IO);
+
+  // The sync message must get a reply instead of blocking the page.
+  std::string result;
+  ASSERT_TRUE(content::ExecuteScriptAndExtractString(
+      runtime()->web_contents(),
+      "window.domAutomationController.send(String(echo.syncEcho('Pass')));",
+      &result));
+  EXPECT_EQ("null", result);
+}
+
+// The pre-compilation data of the JS API code is created and stored by the
+// browser, render processes started later get it from there.
+class XWalkExtensionsScriptDataTest : public XWalkExtensionsTest {
+ public:
+  virtual void SetUpCommandLine(CommandLine* command_line) OVERRIDE {
+    XWalkExtensionsTest::SetUpCommandLine(command_line);
+    ASSERT_TRUE(script_data_dir_.CreateUniqueTempDir());
+    command_line->AppendSwitchPath(switches::kXWalkExtensionScriptCacheDir,
+                                   script_data_dir_.path());
+  }
+
+  // Waits for the entry of the echo extension to be stored.
+  void WaitForEchoScriptData() {
+    EchoExtension echo;
+    base::FilePath path = script_data_dir_.path().AppendASCII(
+        XWalkScriptDataStore::HashScriptSource(
+            xwalk::extensions::WrapExtensionAPICode(echo.GetJavaScriptAPI(),
+                                                    echo.name())));
+    base::ThreadRestrictions::ScopedAllowIO allow_io;
+    while (!file_util::PathExists(path))
+      base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(10));
+  }
+
+ protected:
+  base::ScopedTempDir script_data_dir_;
+};
+
+IN_PROC_BROWSER_TEST_F(XWalkExtensionsScriptDataTest,
+                       RenderProcessStartedLaterGetsStoredData) {
+  content::RunAllPendingInMessageLoop();
+  WaitForEchoScriptData();
+
+  GURL url = GetExtensionsTestURL(base::FilePath(),
+      base::FilePath().AppendASCII("test_extension.html"));
+  Runtime* new_runtime = Runtime::Create(runtime()->runtime_context(), url);
+  ASSERT_NE(runtime()->web_contents()->GetRenderProcessHost(),
+            new_runtime->web_contents()->GetRenderProcessHost());
+
+  content::TitleWatcher title_watcher(new_runtime->web_contents(),
+                                      kPassString);
+  title_watcher.AlsoWaitForTitle(kFailString);
+  EXPECT_EQ(kPassString, title_watcher.WaitAndGetTitle());
+
+  // Nothing but the entries created by the browser is stored.
+  base::ThreadRestrictions::ScopedAllowIO allow_io;
+  base::FileEnumerator files(script_data_dir_.path(), false,
+                             base::FileEnumerator::FILES);
+  for (base::FilePath path = files.Next(); !path.empty(); path = files.Next()) {
+    EXPECT_TRUE(XWalkScriptDataStore::IsValidHash(
+        path.BaseName().MaybeAsASCII()));
+  }
+}
@@ -0,0 +1,107 @@
+# Copyright (c) 2013 Intel Corporation. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+# Generates a header with the ids of the functions declared in the
+# "interface Functions" of an IDL file, in declaration order. Internal
+# extensions dispatch messages with these ids, see
+# xwalk/extensions/browser/xwalk_extension_internal.h.
+#
+# Usage: generate_function_ids.py ROOT_NAMESPACE CC_DIR DEST_DIR IDL...
+# For each IDL a <name>_functions.h is written to DEST_DIR, and included as
+# CC_DIR/<name>_functions.h.
+
+import os
+import re
+import sys
+
+TEMPLATE = """\
+// Generated from %(idl)s by generate_function_ids.py, do not edit.
+
+#ifndef %(guard)s
+#define %(guard)s
+
+%(namespaces_begin)s
+
+// Functions of the API, numbered in the order they are declared.
+enum FunctionId {
+%(ids)s
+  kFunctionCount
+};
+
+// Indexed by FunctionId.
+const char* const kFunctionNames[] = {
+%(names)s
+};
+
+%(namespaces_end)s
+
+#endif  // %(guard)s
+"""
+
+
+def StripComments(idl):
+  idl = re.sub(r'/\*.*?\*/', '', idl, flags=re.DOTALL)
+  return re.sub(r'//[^\n]*', '', idl)
+
+
+def ParseIDL(path):
+  idl = StripComments(open(path).read())
+
+  namespace = re.search(r'namespace\s+([\w.]+)\s*{', idl)
+  if not namespace:
+    raise Exception('%s: no namespace found' % path)
+
+  functions = re.search(r'interface\s+Functions\s*{(.*?)}\s*;', idl,
+                        flags=re.DOTALL)
+  if not functions:
+    raise Exception('%s: no interface Functions found' % path)
+
+  names = re.findall(r'static\s+[\w<>\[\]]+\s+(\w+)\s*\(',
+                     functions.group(1))
+  if not names:
+    raise Exception('%s: no functions found' % path)
+  return namespace.group(1).replace('.', '_'), names
+
+
+def GenerateHeader(idl_path, root_namespace, cc_dir, dest_dir):
+  namespace, names = ParseIDL(idl_path)
+  idl_name = os.path.splitext(os.path.basename(idl_path))[0]
+  header_name = '%s_functions.h' % idl_name
+
+  namespaces = root_namespace.split('::') + [namespace]
+  guard = re.sub(r'[^A-Z0-9]', '_',
+                 ('%s/%s_' % (cc_dir, header_name)).upper())
+
+  values = {
+    'idl': os.path.basename(idl_path),
+    'guard': guard,
+    'namespaces_begin': '\n'.join('namespace %s {' % ns for ns in namespaces),
+    'namespaces_end': '\n'.join('}  // namespace %s' % ns
+                                for ns in reversed(namespaces)),
+    'ids': '\n'.join('  k%s%s,' % (name[0].upper(), name[1:])
+                     for name in names),
+    'names': '\n'.join('  "%s",' % name for name in names),
+  }
+
+  output = open(os.path.join(dest_dir, header_name), 'w')
+  output.write(TEMPLATE % values)
+  output.close()
+
+
+def main(args):
+  if len(args) < 4:
+    sys.stderr.write('Usage: %s ROOT_NAMESPACE CC_DIR DEST_DIR IDL...\n' %
+                     sys.argv[0])
+    return 1
+
+  root_namespace, cc_dir, dest_dir = args[:3]
+  if not os.path.isdir(dest_dir):
+    os.makedirs(dest_dir)
+  for idl_path in args[3:]:
+    GenerateHeader(idl_path, root_namespace, cc_dir, dest_dir)
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main(sys.argv[1:]))
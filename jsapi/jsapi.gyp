@@ -17,5 +17,32 @@
         'cc_dir': 'xwalk/jsapi',
         'root_namespace': 'xwalk::jsapi',
       },
+      'actions': [
+        {
+          # Ids used by the internal extensions to dispatch the functions of
+          # their API, see xwalk_extension_internal.h.
+          'action_name': 'xwalk_jsapi_function_ids',
+          'variables': {
+            'generator': '../extensions/tools/generate_function_ids.py',
+          },
+          'inputs': [
+            '<(generator)',
+            '<@(schema_files)',
+          ],
+          'outputs': [
+            '<(SHARED_INTERMEDIATE_DIR)/<(cc_dir)/dialog_functions.h',
+            '<(SHARED_INTERMEDIATE_DIR)/<(cc_dir)/runtime_functions.h',
+          ],
+          'action': [
+            'python',
+            '<(generator)',
+            '<(root_namespace)',
+            '<(cc_dir)',
+            '<(SHARED_INTERMEDIATE_DIR)/<(cc_dir)',
+            '<@(schema_files)',
+          ],
+          'message': 'Generating function ids for <(cc_dir)',
+        },
+      ],
    }],
 }
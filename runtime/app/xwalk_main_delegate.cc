@@ -7,6 +7,8 @@
 #include "base/files/file_path.h"
 #include "base/logging.h"
 #include "base/path_service.h"
+#include "xwalk/extensions/common/xwalk_extension_switches.h"
+#include "xwalk/extensions/extension_process/xwalk_extension_process_main.h"
 #include "xwalk/runtime/browser/xwalk_content_browser_client.h"
 #include "xwalk/runtime/browser/ui/taskbar_util.h"
 #include "xwalk/runtime/common/paths_mac.h"
@@ -57,6 +59,9 @@ void XWalkMainDelegate::PreSandboxStartup() {
 
 int XWalkMainDelegate::RunProcess(const std::string& process_type,
     const content::MainFunctionParams& main_function_params) {
+  if (process_type == switches::kXWalkExtensionProcess)
+    return extensions::XWalkExtensionProcessMain(main_function_params);
+
   // Tell content to use default process main entries by returning -1.
   return -1;
 }
@@ -323,7 +323,7 @@ void XWalkBrowserMainParts::PostMainMessageLoopRun() {
 
 void XWalkBrowserMainParts::RegisterInternalExtensions() {
   extension_service_->RegisterExtension(scoped_ptr<XWalkExtension>(
-      new RuntimeExtension()));
+      new RuntimeExtension(extension_service_.get())));
   extension_service_->RegisterExtension(scoped_ptr<XWalkExtension>(
       new experimental::DialogExtension(runtime_registry_.get())));
 }
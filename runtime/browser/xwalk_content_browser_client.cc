@@ -10,6 +10,7 @@
 #include "base/path_service.h"
 #include "base/platform_file.h"
 #include "xwalk/extensions/browser/xwalk_extension_service.h"
+#include "xwalk/extensions/common/xwalk_extension_switches.h"
 #include "xwalk/runtime/browser/xwalk_browser_main_parts.h"
 #include "xwalk/runtime/browser/geolocation/xwalk_access_token_store.h"
 #include "xwalk/runtime/browser/media/media_capture_devices_dispatcher.h"
@@ -18,6 +19,7 @@
 #include "content/public/browser/browser_main_parts.h"
 #include "content/public/browser/render_process_host.h"
 #include "content/public/browser/web_contents.h"
+#include "content/public/common/content_switches.h"
 #include "content/public/common/main_function_params.h"
 #include "net/url_request/url_request_context_getter.h"
 
@@ -125,6 +127,23 @@ void XWalkContentBrowserClient::RenderProcessHostCreated(
 #endif
 }
 
+void XWalkContentBrowserClient::AppendExtraCommandLineSwitches(
+    CommandLine* command_line, int child_process_id) {
+  // The render process needs to know how to send messages to extensions. The
+  // channel to the extension process, if any, is sent to it by the browser.
+  std::string process_type =
+      command_line->GetSwitchValueASCII(switches::kProcessType);
+  if (process_type != switches::kRendererProcess)
+    return;
+
+  static const char* const kSwitchNames[] = {
+    switches::kXWalkDisableExtensionSyncFastPath,
+    switches::kXWalkDisableExtensionSerializedMessages,
+  };
+  command_line->CopySwitchesFrom(*CommandLine::ForCurrentProcess(),
+                                 kSwitchNames, arraysize(kSwitchNames));
+}
+
 content::MediaObserver* XWalkContentBrowserClient::GetMediaObserver() {
   return XWalkMediaCaptureDevicesDispatcher::GetInstance();
 }
@@ -55,6 +55,8 @@ class XWalkContentBrowserClient : public content::ContentBrowserClient {
       content::WebContents* web_contents) OVERRIDE;
   virtual void RenderProcessHostCreated(
       content::RenderProcessHost* host) OVERRIDE;
+  virtual void AppendExtraCommandLineSwitches(CommandLine* command_line,
+                                              int child_process_id) OVERRIDE;
   virtual content::MediaObserver* GetMediaObserver() OVERRIDE;
 
 #if defined(OS_ANDROID)
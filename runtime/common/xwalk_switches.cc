@@ -25,4 +25,12 @@ const char kXWalkExternalExtensionsPath[] = "external-extensions-path";
 const char kXWalkAllowExternalExtensionsForRemoteSources[] =
     "allow-external-extensions-for-remote-sources";
 
+// Keeps the database of installed applications in an append-only log instead
+// of a JSON file, which is migrated to the log.
+const char kXWalkApplicationDBLog[] = "application-db-log";
+
+// Installs applications by moving their verified package into the data path,
+// instead of unpacking it. Their resources are served from the package.
+const char kXWalkKeepApplicationPackage[] = "keep-application-package";
+
 }  // namespace switches
@@ -20,6 +20,10 @@ extern const char kXWalkExternalExtensionsPath[];
 
 extern const char kXWalkAllowExternalExtensionsForRemoteSources[];
 
+extern const char kXWalkApplicationDBLog[];
+
+extern const char kXWalkKeepApplicationPackage[];
+
 }  // namespace switches
 
 #endif  // XWALK_RUNTIME_COMMON_XWALK_SWITCHES_H_
@@ -5,35 +5,145 @@
 #include "xwalk/runtime/extension/runtime_extension.h"
 
 #include "base/bind.h"
+#include "base/command_line.h"
+#include "base/synchronization/lock.h"
+#include "base/values.h"
+#include "xwalk/extensions/browser/xwalk_extension_service.h"
+#include "xwalk/extensions/common/xwalk_extension_stats.h"
+#include "xwalk/extensions/common/xwalk_extension_switches.h"
 #include "xwalk/jsapi/runtime.h"
+#include "xwalk/jsapi/runtime_functions.h"
 
 extern const char kSource_runtime_api[];
 
 namespace xwalk {
 
-RuntimeExtension::RuntimeExtension() {
-  set_name("xwalk.runtime");
+namespace {
+
+// Appended to the API code only when the stats are enabled, so pages don't
+// see the function otherwise.
+const char kExtensionStatsAPI[] =
+    "exports.getExtensionStats = function(callback) {"
+    "  internal.postMessage('getExtensionStats', [], callback);"
+    "};";
+
+bool IsExtensionStatsEnabled() {
+  return CommandLine::ForCurrentProcess()->HasSwitch(
+      switches::kXWalkEnableExtensionStats);
+}
+
+// Adds the extensions and instances of |process_stats| to |stats|, both in
+// the format of XWalkExtensionStatsRegistry::ToValue(). External extensions
+// run either here or in the extension process, so names don't clash.
+void MergeExtensionStats(base::DictionaryValue* stats,
+                         const base::DictionaryValue& process_stats) {
+  base::DictionaryValue* extensions;
+  const base::DictionaryValue* process_extensions;
+  if (stats->GetDictionary("extensions", &extensions) &&
+      process_stats.GetDictionary("extensions", &process_extensions)) {
+    for (base::DictionaryValue::Iterator it(*process_extensions);
+         !it.IsAtEnd(); it.Advance()) {
+      extensions->SetWithoutPathExpansion(it.key(), it.value().DeepCopy());
+    }
+  }
+
+  base::ListValue* instances;
+  const base::ListValue* process_instances;
+  if (stats->GetList("instances", &instances) &&
+      process_stats.GetList("instances", &process_instances)) {
+    for (size_t i = 0; i < process_instances->GetSize(); ++i) {
+      const base::DictionaryValue* instance;
+      if (!process_instances->GetDictionary(i, &instance))
+        continue;
+      base::DictionaryValue* copy = instance->DeepCopy();
+      copy->SetBoolean("extension_process", true);
+      instances->Append(copy);
+    }
+  }
 }
 
-const char* RuntimeExtension::GetJavaScriptAPI() {
-  return kSource_runtime_api;
+}  // namespace
+
+// The stats of the extension process arrive in another thread, possibly after
+// the instance is gone. The instance invalidates this when destroyed, like the
+// helper of XWalkExtensionThreadedRunner.
+class RuntimeInstance::StatsReplier
+    : public base::RefCountedThreadSafe<RuntimeInstance::StatsReplier> {
+ public:
+  explicit StatsReplier(RuntimeInstance* instance) : instance_(instance) {}
+
+  void Invalidate() {
+    base::AutoLock lock(lock_);
+    instance_ = NULL;
+  }
+
+  void PostStats(int callback_id,
+                 scoped_ptr<base::DictionaryValue> process_stats) {
+    scoped_ptr<base::DictionaryValue> stats(
+        extensions::XWalkExtensionStatsRegistry::GetInstance()->ToValue());
+    if (process_stats)
+      MergeExtensionStats(stats.get(), *process_stats);
+
+    scoped_ptr<base::ListValue> results(new base::ListValue);
+    results->Append(stats.release());
+
+    base::AutoLock lock(lock_);
+    if (instance_)
+      instance_->PostResult(callback_id, results.Pass());
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<StatsReplier>;
+  ~StatsReplier() {}
+
+  base::Lock lock_;
+  RuntimeInstance* instance_;
+};
+
+RuntimeExtension::RuntimeExtension(XWalkExtensionService* extension_service)
+    : extension_service_(extension_service) {
+  set_name("xwalk.runtime");
+  std::string api(kSource_runtime_api);
+  if (IsExtensionStatsEnabled())
+    api += kExtensionStatsAPI;
+  SetJavaScriptAPI(api.c_str(), jsapi::runtime::kFunctionNames);
 }
 
 XWalkExtensionInstance* RuntimeExtension::CreateInstance(
     const XWalkExtension::PostMessageCallback& post_message) {
-  return new RuntimeInstance(post_message);
+  return new RuntimeInstance(post_message, extension_service_);
 }
 
 RuntimeInstance::RuntimeInstance(
-    const XWalkExtension::PostMessageCallback& post_message)
-  : XWalkInternalExtensionInstance(post_message) {
-  RegisterFunction("getAPIVersion", &RuntimeInstance::OnGetAPIVersion);
+    const XWalkExtension::PostMessageCallback& post_message,
+    XWalkExtensionService* extension_service)
+  : XWalkInternalExtensionInstance(post_message),
+    extension_service_(extension_service),
+    stats_replier_(new StatsReplier(this)) {
+  RegisterFunction(jsapi::runtime::kGetAPIVersion,
+                   &RuntimeInstance::OnGetAPIVersion);
+  if (IsExtensionStatsEnabled()) {
+    RegisterFunction(jsapi::runtime::kGetExtensionStats,
+                     &RuntimeInstance::OnGetExtensionStats);
+  }
+}
+
+RuntimeInstance::~RuntimeInstance() {
+  stats_replier_->Invalidate();
 }
 
-void RuntimeInstance::OnGetAPIVersion(
-    const std::string&, const std::string& callback_id,
-    base::ListValue* args) {
+void RuntimeInstance::OnGetAPIVersion(int, int callback_id,
+                                      base::ListValue* args) {
   PostResult(callback_id, jsapi::runtime::GetAPIVersion::Results::Create(1));
 };
 
+// The stats of the extensions running here and in the extension process are
+// reported together. They include the instances of all render processes, hence
+// the switch.
+void RuntimeInstance::OnGetExtensionStats(int, int callback_id,
+                                          base::ListValue* args) {
+  extension_service_->GetExtensionProcessStats(
+      base::Bind(&StatsReplier::PostStats, stats_replier_, callback_id));
+}
+
 }  // namespace xwalk
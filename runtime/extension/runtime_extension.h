@@ -6,33 +6,49 @@
 #define XWALK_RUNTIME_EXTENSION_RUNTIME_EXTENSION_H_
 
 #include <string>
+#include "base/memory/ref_counted.h"
 #include "xwalk/extensions/browser/xwalk_extension_internal.h"
 
 namespace xwalk {
 
+namespace extensions {
+class XWalkExtensionService;
+}
+
 using extensions::XWalkExtension;
+using extensions::XWalkExtensionService;
 using extensions::XWalkExtensionInstance;
 using extensions::XWalkInternalExtension;
 using extensions::XWalkInternalExtensionInstance;
 
 class RuntimeExtension : public XWalkInternalExtension {
  public:
-  RuntimeExtension();
-
-  virtual const char* GetJavaScriptAPI() OVERRIDE;
+  // |extension_service| is used to get the stats of the extension process.
+  explicit RuntimeExtension(XWalkExtensionService* extension_service);
 
   virtual XWalkExtensionInstance* CreateInstance(
       const XWalkExtension::PostMessageCallback& post_message) OVERRIDE;
+
+ private:
+  XWalkExtensionService* extension_service_;
 };
 
 class RuntimeInstance : public XWalkInternalExtensionInstance {
  public:
-  explicit RuntimeInstance(
-      const XWalkExtension::PostMessageCallback& post_message);
+  RuntimeInstance(const XWalkExtension::PostMessageCallback& post_message,
+                  XWalkExtensionService* extension_service);
+  virtual ~RuntimeInstance();
 
  private:
-  void OnGetAPIVersion(const std::string& function_name,
-                       const std::string& callback_id, base::ListValue* args);
+  class StatsReplier;
+
+  void OnGetAPIVersion(int function_id, int callback_id,
+                       base::ListValue* args);
+  void OnGetExtensionStats(int function_id, int callback_id,
+                           base::ListValue* args);
+
+  XWalkExtensionService* extension_service_;
+  scoped_refptr<StatsReplier> stats_replier_;
 };
 
 }  // namespace xwalk
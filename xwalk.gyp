@@ -533,6 +533,7 @@
           'dependencies': [
             'xwalk',
             'xwalk_browsertest',
+            'xwalk_extension_perftests',
             'xwalk_unittest',
           ],
         },